@@ -3,6 +3,9 @@
 
 set -e
 
+# The protocol of the filter, NATS_STREAMING unless given.
+PROTOCOL=${1:-NATS_STREAMING}
+
 # prepare envoy config file.
 
 cat > envoy.yaml << EOF
@@ -44,6 +47,7 @@ static_resources:
               op_timeout: 1s
               cluster: cluster_0
               max_connections: 1
+              protocol: $PROTOCOL
           - name: envoy.router
   clusters:
   - connect_timeout: 5.000s
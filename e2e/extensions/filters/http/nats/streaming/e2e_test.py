@@ -1,5 +1,6 @@
 import grequests
 import httplib
+import json
 import logging
 import os
 import requests
@@ -31,14 +32,29 @@ class NatsStreamingTestCase(filtertest.TestCase):
       self.stderr.close()
     self.stderr = None
 
-  def __create_config(self):
+  def __create_config(self, protocol="NATS_STREAMING"):
     create_config_path = self._join_artifact_path("create_config.sh")
-    subprocess.check_call(create_config_path)
+    subprocess.check_call([create_config_path, protocol])
 
   def __start_nats_server(self):
     args = ["gnatsd", "-DV"] if DEBUG else "gnatsd"
     self._processes["nats_server"] = subprocess.Popen(args)
 
+  def __start_jetstream_server(self):
+    args = ["nats-server", "-js", "-DV"] if DEBUG else ["nats-server", "-js"]
+    self._processes["nats_server"] = subprocess.Popen(args)
+    time.sleep(.1)
+
+  def __add_stream(self):
+    subprocess.check_call(["nats", "stream", "add", "stream1",
+                           "--subjects", "subject1", "--storage", "memory",
+                           "--defaults"])
+
+  def __stream_messages(self):
+    info = json.loads(subprocess.check_output(
+      ["nats", "stream", "info", "stream1", "--json"]))
+    return info["state"]["messages"]
+
   def __start_nats_streaming_server(self):
     args = ["nats-streaming-server", "-ns", "nats://localhost:4222"]
     if DEBUG:
@@ -103,6 +119,20 @@ class NatsStreamingTestCase(filtertest.TestCase):
     # Make many requests and assert that they timeout.
     self.__make_request_batches("solopayload %d %d", 2, 1024, 0.1, httplib.REQUEST_TIMEOUT)
 
+  def test_jetstream(self):
+    # Set up environment.
+    self.__create_config("JETSTREAM")
+    self.__start_jetstream_server()
+    self._start_envoy("./envoy.yaml", DEBUG)
+
+    # With no stream to capture the subject, requests fail at once.
+    self.__make_request("solopayload", httplib.INTERNAL_SERVER_ERROR)
+
+    # Make many requests and assert that each is stored once.
+    self.__add_stream()
+    self.__make_request_batches("solopayload %d %d", 3, 1024, 0.1, httplib.OK)
+    self.assertEqual(3 * 1024, self.__stream_messages())
+
   def test_profile(self):
     report_loc = os.environ.get("TEST_PROF_REPORT","")
     if not report_loc:
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "envoy/buffer/buffer.h"
@@ -8,12 +9,17 @@
 namespace Envoy {
 namespace Nats {
 
+typedef std::shared_ptr<const Buffer::Instance> PayloadSharedPtr;
+
 class Message {
 public:
   Message() {}
 
   explicit Message(const std::string &string) : string_(string) {}
 
+  Message(const std::string &string, PayloadSharedPtr payload)
+      : string_(string), payload_(std::move(payload)) {}
+
   ~Message() {}
 
   /**
@@ -27,8 +33,16 @@ public:
   std::string &asString();
   const std::string &asString() const;
 
+  /**
+   * The payload following the line of the message, if any. It is shared by
+   * copies of the message and referenced by the encoded buffers rather than
+   * copied, so it must not be modified once the message is created.
+   */
+  const PayloadSharedPtr &payload() const;
+
 private:
   std::string string_;
+  PayloadSharedPtr payload_;
 };
 
 typedef std::unique_ptr<Message> MessagePtr;
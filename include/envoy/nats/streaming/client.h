@@ -46,6 +46,40 @@ public:
    * Called when a timeout occurs and there is no response.
    */
   virtual void onTimeout() PURE;
+
+  /**
+   * Called when the request is rejected because too many requests are already
+   * waiting to be published.
+   */
+  virtual void onOverflow() PURE;
+};
+
+/**
+ * A handle to a publish window watch.
+ */
+class WindowWatch {
+public:
+  virtual ~WindowWatch() {}
+
+  /**
+   * Cancel the watch. No further window callbacks will be called.
+   */
+  virtual void cancel() PURE;
+};
+
+typedef std::unique_ptr<WindowWatch> WindowWatchPtr;
+
+/**
+ * Publish window callbacks.
+ */
+class WindowCallbacks {
+public:
+  virtual ~WindowCallbacks() {}
+
+  /**
+   * Called once no request is queued behind a full publish window anymore.
+   */
+  virtual void onWindowOpen() PURE;
 };
 
 /**
@@ -56,6 +90,17 @@ class Client {
 public:
   virtual ~Client() {}
 
+  /**
+   * Selects the client which a request to the subject is made on, so that the
+   * publish window watched ahead of the request is the one it is published
+   * in.
+   * @param subject supplies the subject of the request about to be made.
+   * @return Client& the client to watch the window of and make the request
+   * on, which lives as long as this one. A client which does not spread its
+   * requests over others returns itself.
+   */
+  virtual Client &selectClient(const std::string &subject) PURE;
+
   // TODO(talnordan): Add `ack_prefix`.
   /**
    * Makes a request.
@@ -64,8 +109,12 @@ public:
    * Server was started.
    * @param discover_prefix supplies the prefix subject used to connect to the
    * NATS Streaming server.
+   * @param headers supplies the NATS header lines of the request, each
+   * formatted by `MessageBuilder::addHeader()`. It is drained by the client.
+   * Only JetStream clients publish headers, and others expect it to be empty.
    * @param payload supplies the fully buffered payload as buffered by this
-   * filter or previous ones in the filter chain.
+   * filter or previous ones in the filter chain. It is drained by the client,
+   * which publishes its slices without copying them.
    * @param callbacks supplies the request completion callbacks.
    * @return PublishRequestPtr a handle to the active request or nullptr if the
    * request could not be made for some reason.
@@ -73,8 +122,19 @@ public:
   virtual PublishRequestPtr makeRequest(const std::string &subject,
                                         const std::string &cluster_id,
                                         const std::string &discover_prefix,
-                                        std::string &&payload,
+                                        Buffer::Instance &headers,
+                                        Buffer::Instance &payload,
                                         PublishCallbacks &callbacks) PURE;
+
+  /**
+   * Watches the publish window, once requests are queued behind it.
+   * @param subject supplies the subject of the request about to be made.
+   * @param callbacks supplies the callbacks to notify when the queue drains.
+   * @return WindowWatchPtr a handle to the watch, or nullptr if no request is
+   * queued behind a full window, in which case no callback is made.
+   */
+  virtual WindowWatchPtr watchWindow(const std::string &subject,
+                                     WindowCallbacks &callbacks) PURE;
 };
 
 typedef std::shared_ptr<Client> ClientPtr;
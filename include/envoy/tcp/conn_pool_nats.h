@@ -50,7 +50,8 @@ public:
   virtual void close() PURE;
 
   /**
-   * Make a pipelined request to the remote server.
+   * Make a pipelined request to the remote server. The request may be
+   * buffered and written along with the next ones.
    * @param request supplies the request to make.
    */
   virtual void makeRequest(const T &request) PURE;
@@ -76,6 +77,13 @@ public:
    * counting active healthcheck operations as passive healthcheck operations.
    */
   virtual bool disableOutlierEvents() const PURE;
+
+  /**
+   * @return uint32_t the number of bytes of encoded requests that can be
+   * buffered before they are written. Below it, the requests made during a
+   * dispatcher iteration are written together at its end.
+   */
+  virtual uint32_t maxBufferSizeBeforeFlush() const PURE;
 };
 
 /**
@@ -118,6 +126,11 @@ public:
    * @param request supplies the request to make.
    */
   virtual void makeRequest(const std::string &hash_key, const T &request) PURE;
+
+  /**
+   * Closes the active connection, if any. The next request opens a new one.
+   */
+  virtual void close() PURE;
 };
 
 template <typename T> using InstancePtr = std::unique_ptr<Instance<T>>;
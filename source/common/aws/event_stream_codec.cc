@@ -0,0 +1,274 @@
+#include "source/common/aws/event_stream_codec.h"
+
+#include <algorithm>
+
+#include "zlib.h"
+
+namespace Envoy {
+namespace AwsEventStream {
+
+namespace {
+
+// Header value types
+enum HeaderType : uint8_t {
+  BoolTrue = 0,
+  BoolFalse = 1,
+  Byte = 2,
+  Short = 3,
+  Integer = 4,
+  Long = 5,
+  ByteArray = 6,
+  String = 7,
+  Timestamp = 8,
+  Uuid = 9,
+};
+
+uint32_t readUint32(const char *data) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(data);
+  return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+         (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+uint16_t readUint16(const char *data) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(data);
+  return (uint16_t(bytes[0]) << 8) | uint16_t(bytes[1]);
+}
+
+void appendUint32(std::string &out, uint32_t value) {
+  const char bytes[4] = {static_cast<char>(value >> 24),
+                         static_cast<char>(value >> 16),
+                         static_cast<char>(value >> 8),
+                         static_cast<char>(value)};
+  out.append(bytes, 4);
+}
+
+void appendUint16(std::string &out, uint16_t value) {
+  const char bytes[2] = {static_cast<char>(value >> 8),
+                         static_cast<char>(value)};
+  out.append(bytes, 2);
+}
+
+uint32_t crc32(absl::string_view data, uint32_t crc = 0) {
+  return ::crc32(crc, reinterpret_cast<const Bytef *>(data.data()),
+                 data.size());
+}
+
+/**
+ * @brief Walk a header block
+ *
+ * @param on_header called with the name, type and raw value of each header
+ * @return false if the block is malformed
+ */
+template <class Callback>
+bool forEachHeader(absl::string_view headers, Callback on_header) {
+  while (!headers.empty()) {
+    const size_t name_length = static_cast<uint8_t>(headers[0]);
+    if (name_length == 0 || headers.size() < 1 + name_length + 1) {
+      return false;
+    }
+    const absl::string_view name = headers.substr(1, name_length);
+    const uint8_t type = headers[1 + name_length];
+    headers.remove_prefix(1 + name_length + 1);
+
+    size_t value_offset = 0;
+    size_t value_length = 0;
+    switch (type) {
+    case BoolTrue:
+    case BoolFalse:
+      break;
+    case Byte:
+      value_length = 1;
+      break;
+    case Short:
+      value_length = 2;
+      break;
+    case Integer:
+      value_length = 4;
+      break;
+    case Long:
+    case Timestamp:
+      value_length = 8;
+      break;
+    case Uuid:
+      value_length = 16;
+      break;
+    case ByteArray:
+    case String:
+      if (headers.size() < 2) {
+        return false;
+      }
+      value_offset = 2;
+      value_length = readUint16(headers.data());
+      break;
+    default:
+      return false;
+    }
+    if (headers.size() < value_offset + value_length) {
+      return false;
+    }
+    if (!on_header(name, type, headers.substr(value_offset, value_length))) {
+      return true;
+    }
+    headers.remove_prefix(value_offset + value_length);
+  }
+  return true;
+}
+
+// The total length of the message, or 0 if the prelude is invalid
+uint32_t messageLength(const char *prelude) {
+  const uint32_t total_length = readUint32(prelude);
+  const uint32_t headers_length = readUint32(prelude + 4);
+  if (uint64_t(total_length) < Decoder::PreludeLength + uint64_t(headers_length) +
+                                   Decoder::MessageCrcLength ||
+      readUint32(prelude + 8) != crc32(absl::string_view(prelude, 8))) {
+    return 0;
+  }
+  return total_length;
+}
+
+} // namespace
+
+absl::string_view Message::header(absl::string_view name) const {
+  absl::string_view found;
+  forEachHeader(headers, [&](absl::string_view header_name, uint8_t type,
+                             absl::string_view value) {
+    if (type == String && header_name == name) {
+      found = value;
+      return false;
+    }
+    return true;
+  });
+  return found;
+}
+
+bool Decoder::decode(absl::string_view data) {
+  while (!data.empty() && !failed_) {
+    if (bytes_to_skip_ > 0) {
+      const size_t skip = std::min<uint64_t>(bytes_to_skip_, data.size());
+      data.remove_prefix(skip);
+      bytes_to_skip_ -= skip;
+      continue;
+    }
+
+    // Messages that arrive whole are dispatched in place
+    if (partial_.empty() && data.size() >= PreludeLength) {
+      const uint32_t total_length = messageLength(data.data());
+      if (total_length == 0) {
+        return fail("invalid prelude");
+      }
+      if (total_length > max_message_size_) {
+        if (oversized_ == Oversized::Fail) {
+          return fail("message too large");
+        }
+        bytes_to_skip_ = total_length;
+        continue;
+      }
+      if (data.size() >= total_length) {
+        if (!onMessage(data.substr(0, total_length))) {
+          return false;
+        }
+        data.remove_prefix(total_length);
+        continue;
+      }
+    }
+
+    if (partial_.size() < PreludeLength) {
+      const size_t needed =
+          std::min(PreludeLength - partial_.size(), data.size());
+      partial_.append(data.data(), needed);
+      data.remove_prefix(needed);
+      if (partial_.size() < PreludeLength) {
+        return true;
+      }
+    }
+
+    const uint32_t total_length = messageLength(partial_.data());
+    if (total_length == 0) {
+      return fail("invalid prelude");
+    }
+    if (total_length > max_message_size_) {
+      if (oversized_ == Oversized::Fail) {
+        return fail("message too large");
+      }
+      bytes_to_skip_ = total_length - partial_.size();
+      partial_.clear();
+      continue;
+    }
+
+    const size_t needed =
+        std::min<size_t>(total_length - partial_.size(), data.size());
+    partial_.append(data.data(), needed);
+    data.remove_prefix(needed);
+    if (partial_.size() == total_length) {
+      const std::string message = std::move(partial_);
+      partial_.clear();
+      if (!onMessage(message)) {
+        return false;
+      }
+    }
+  }
+  return !failed_;
+}
+
+void Decoder::reset() {
+  partial_.clear();
+  bytes_to_skip_ = 0;
+  failed_ = false;
+}
+
+bool Decoder::onMessage(absl::string_view message) {
+  const size_t crc_offset = message.size() - MessageCrcLength;
+  if (readUint32(message.data() + crc_offset) !=
+      crc32(message.substr(0, crc_offset))) {
+    return fail("invalid message crc");
+  }
+
+  const uint32_t headers_length = readUint32(message.data() + 4);
+  const absl::string_view headers =
+      message.substr(PreludeLength, headers_length);
+  if (!forEachHeader(headers, [](absl::string_view, uint8_t,
+                                 absl::string_view) { return true; })) {
+    return fail("invalid headers");
+  }
+
+  on_message_(Message{headers, message.substr(PreludeLength + headers_length,
+                                              crc_offset - PreludeLength -
+                                                  headers_length)});
+  return true;
+}
+
+bool Decoder::fail(absl::string_view reason) {
+  ENVOY_LOG(debug, "event stream: {}, stop decoding", reason);
+  partial_.clear();
+  bytes_to_skip_ = 0;
+  failed_ = true;
+  return false;
+}
+
+void encode(std::initializer_list<std::pair<absl::string_view, absl::string_view>>
+                string_headers,
+            absl::string_view payload, std::string &out) {
+  const size_t start = out.size();
+  // the lengths and CRCs are filled in once the headers are written
+  out.append(Decoder::PreludeLength, '\0');
+  for (const auto &header : string_headers) {
+    out.push_back(static_cast<char>(header.first.size()));
+    out.append(header.first.data(), header.first.size());
+    out.push_back(static_cast<char>(String));
+    appendUint16(out, header.second.size());
+    out.append(header.second.data(), header.second.size());
+  }
+  const uint32_t headers_length = out.size() - start - Decoder::PreludeLength;
+  out.append(payload.data(), payload.size());
+  const uint32_t total_length = out.size() - start + Decoder::MessageCrcLength;
+
+  std::string prelude;
+  appendUint32(prelude, total_length);
+  appendUint32(prelude, headers_length);
+  appendUint32(prelude, crc32(prelude));
+  out.replace(start, Decoder::PreludeLength, prelude);
+  appendUint32(out, crc32(absl::string_view(out).substr(start)));
+}
+
+} // namespace AwsEventStream
+} // namespace Envoy
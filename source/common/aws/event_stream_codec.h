@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <utility>
+
+#include "source/common/common/logger.h"
+
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace AwsEventStream {
+
+/**
+ * A decoded message. The views point into the decoder's input or internal
+ * buffer and are only valid during the message callback.
+ */
+struct Message {
+  // The raw header block, see header()
+  absl::string_view headers;
+  absl::string_view payload;
+
+  /**
+   * @brief Find a header of type string
+   *
+   * @param name the header name, such as `:event-type`
+   * @return the value, or an empty view if there is no such string header
+   */
+  absl::string_view header(absl::string_view name) const;
+};
+
+/**
+ * Decoder of the `application/vnd.amazon.eventstream` binary framing, used by
+ * Lambda `InvokeWithResponseStream` and Bedrock `converse-stream`:
+ * https://docs.aws.amazon.com/transcribe/latest/dg/event-stream.html
+ *
+ * Each message is a 12 byte prelude (total length, headers length and the
+ * CRC32 of both), the headers, the payload and the CRC32 of the whole
+ * message. Both CRCs and the header block are validated before a message is
+ * dispatched. Messages that arrive whole in one call are dispatched without
+ * copying; only a message split across calls is buffered, up to
+ * `max_message_size`. Larger messages are either skipped, unvalidated, or
+ * treated as invalid, see `Oversized`.
+ *
+ * After an invalid message the decoder stops and ignores all further input.
+ */
+class Decoder : public Logger::Loggable<Logger::Id::filter> {
+public:
+  static constexpr size_t PreludeLength = 12;
+  static constexpr size_t MessageCrcLength = 4;
+
+  using MessageCallback = std::function<void(const Message &message)>;
+
+  // What to do with a message larger than `max_message_size`
+  enum class Oversized {
+    Skip,
+    // For streams whose messages may not be dropped, such as the chunks of a
+    // response body
+    Fail,
+  };
+
+  Decoder(size_t max_message_size, MessageCallback on_message,
+          Oversized oversized = Oversized::Skip)
+      : max_message_size_(max_message_size),
+        on_message_(std::move(on_message)), oversized_(oversized) {}
+
+  /**
+   * @brief Decode raw stream bytes, dispatching the complete messages
+   *
+   * @return false if the stream is invalid
+   */
+  bool decode(absl::string_view data);
+
+  // Whether an invalid message was found
+  bool failed() const { return failed_; }
+  // Whether a message is partially decoded
+  bool hasPartialMessage() const {
+    return !partial_.empty() || bytes_to_skip_ > 0;
+  }
+
+  // Drops any partial message and clears the failure.
+  void reset();
+
+private:
+  // Validates and dispatches a complete message.
+  bool onMessage(absl::string_view message);
+  bool fail(absl::string_view reason);
+
+  const size_t max_message_size_;
+  const MessageCallback on_message_;
+  const Oversized oversized_;
+  // Partial message
+  std::string partial_;
+  // Remaining bytes of an oversized message to skip
+  uint64_t bytes_to_skip_{};
+  bool failed_{};
+};
+
+/**
+ * Appends a message with string headers to `out`.
+ */
+void encode(std::initializer_list<std::pair<absl::string_view, absl::string_view>>
+                string_headers,
+            absl::string_view payload, std::string &out);
+
+} // namespace AwsEventStream
+} // namespace Envoy
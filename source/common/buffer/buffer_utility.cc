@@ -1,13 +1,110 @@
 #include "source/common/buffer/buffer_utility.h"
 
+#include <array>
+#include <memory>
+
+#include "source/common/buffer/buffer_impl.h"
+
 namespace Envoy {
 namespace Buffer {
 
+namespace {
+
+constexpr uint8_t InvalidBase64 = 0xff;
+
+constexpr std::array<uint8_t, 256> makeBase64Table() {
+  std::array<uint8_t, 256> table{};
+  for (auto &value : table) {
+    value = InvalidBase64;
+  }
+  constexpr char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (uint8_t i = 0; i < 64; i++) {
+    table[static_cast<uint8_t>(alphabet[i])] = i;
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, 256> Base64Table = makeBase64Table();
+
+} // namespace
+
 std::string BufferUtility::drainBufferToString(Buffer::Instance &buffer) {
   std::string output = buffer.toString();
   buffer.drain(buffer.length());
   return output;
 }
 
+void BufferUtility::moveStringToBuffer(std::string &&data,
+                                       Buffer::Instance &buffer) {
+  if (data.empty()) {
+    return;
+  }
+  auto *owned = new std::string(std::move(data));
+  buffer.addBufferFragment(*new BufferFragmentImpl(
+      owned->data(), owned->size(),
+      [owned](const void *, size_t, const BufferFragmentImpl *fragment) {
+        delete owned;
+        delete fragment;
+      }));
+}
+
+void BufferUtility::addSharedBuffer(
+    std::shared_ptr<const Buffer::Instance> data, Buffer::Instance &buffer) {
+  for (const RawSlice &slice : data->getRawSlices()) {
+    buffer.addBufferFragment(*new BufferFragmentImpl(
+        slice.mem_, slice.len_,
+        [data](const void *, size_t, const BufferFragmentImpl *fragment) {
+          delete fragment;
+        }));
+  }
+}
+
+bool BufferUtility::base64DecodeToBuffer(absl::string_view input,
+                                         Buffer::Instance &buffer) {
+  if (input.size() % 4 != 0) {
+    return false;
+  }
+  size_t padding = 0;
+  if (!input.empty() && input.back() == '=') {
+    padding = input[input.size() - 2] == '=' ? 2 : 1;
+  }
+  const uint64_t length = input.size() / 4 * 3 - padding;
+  if (length == 0) {
+    return padding == 0;
+  }
+
+  auto reservation = buffer.reserveSingleSlice(length);
+  auto *out = static_cast<uint8_t *>(reservation.slice().mem_);
+  const auto *in = reinterpret_cast<const uint8_t *>(input.data());
+  const size_t full_groups = input.size() / 4 - (padding != 0 ? 1 : 0);
+  for (size_t group = 0; group < full_groups; group++, in += 4, out += 3) {
+    const uint8_t a = Base64Table[in[0]], b = Base64Table[in[1]],
+                  c = Base64Table[in[2]], d = Base64Table[in[3]];
+    // InvalidBase64 is the only table value with the top bits set
+    if (((a | b | c | d) & 0xc0) != 0) {
+      return false;
+    }
+    out[0] = (a << 2) | (b >> 4);
+    out[1] = (b << 4) | (c >> 2);
+    out[2] = (c << 6) | d;
+  }
+  if (padding != 0) {
+    const uint8_t a = Base64Table[in[0]], b = Base64Table[in[1]];
+    const uint8_t c = padding == 1 ? Base64Table[in[2]] : 0;
+    if (((a | b | c) & 0xc0) != 0 ||
+        // the unused bits must be zero, as in canonical encodings
+        (padding == 2 ? (b & 0x0f) : (c & 0x03)) != 0) {
+      return false;
+    }
+    out[0] = (a << 2) | (b >> 4);
+    if (padding == 1) {
+      out[1] = (b << 4) | (c >> 2);
+    }
+  }
+  reservation.commit(length);
+  return true;
+}
+
 } // namespace Buffer
 } // namespace Envoy
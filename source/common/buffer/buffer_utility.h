@@ -1,9 +1,12 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "envoy/buffer/buffer.h"
 
+#include "absl/strings/string_view.h"
+
 namespace Envoy {
 namespace Buffer {
 
@@ -18,6 +21,35 @@ public:
    * @return std::string the converted string.
    */
   static std::string drainBufferToString(Buffer::Instance &buffer);
+
+  /**
+   * Append a string to a buffer without copying it. The buffer takes
+   * ownership of the string's memory.
+   * @param data supplies the string to move.
+   * @param buffer supplies the buffer to append to.
+   */
+  static void moveStringToBuffer(std::string &&data, Buffer::Instance &buffer);
+
+  /**
+   * Append the contents of a shared buffer to another buffer without copying
+   * them. Each slice is appended as a fragment holding a reference to the
+   * shared buffer, which must therefore not be modified anymore.
+   * @param data supplies the buffer to reference.
+   * @param buffer supplies the buffer to append to.
+   */
+  static void addSharedBuffer(std::shared_ptr<const Buffer::Instance> data,
+                              Buffer::Instance &buffer);
+
+  /**
+   * Decode padded standard base64 straight into a buffer, without an
+   * intermediate string.
+   * @param input supplies the base64 text.
+   * @param buffer supplies the buffer to append to.
+   * @return bool false if the input is not valid base64, in which case
+   * nothing is appended.
+   */
+  static bool base64DecodeToBuffer(absl::string_view input,
+                                   Buffer::Instance &buffer);
 };
 
 } // namespace Buffer
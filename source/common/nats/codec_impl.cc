@@ -1,11 +1,24 @@
 #include "source/common/nats/codec_impl.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "include/envoy/nats/codec.h"
 
+#include "source/common/buffer/buffer_utility.h"
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+
 namespace Envoy {
 namespace Nats {
 
 std::string Message::toString() const {
+  if (payload_ != nullptr) {
+    return fmt::format("\"{}\" with a {} byte payload", asString(),
+                       payload_->length());
+  }
   return fmt::format("\"{}\"", asString());
 }
 
@@ -13,7 +26,10 @@ std::string &Message::asString() { return string_; }
 
 const std::string &Message::asString() const { return string_; }
 
+const PayloadSharedPtr &Message::payload() const { return payload_; }
+
 void DecoderImpl::decode(Buffer::Instance &data) {
+  ENVOY_LOG(trace, "decode: {} bytes", data.length());
   for (const Buffer::RawSlice &slice : data.getRawSlices()) {
     parseSlice(slice);
   }
@@ -23,58 +39,112 @@ void DecoderImpl::decode(Buffer::Instance &data) {
 
 void DecoderImpl::parseSlice(const Buffer::RawSlice &slice) {
   const char *buffer = reinterpret_cast<const char *>(slice.mem_);
-  uint64_t remaining = slice.len_;
+  const char *const end = buffer + slice.len_;
+
+  while (buffer != end) {
+    if (pending_value_ == nullptr) {
+      pending_value_ = std::make_unique<Message>();
+    }
 
-  while (remaining || state_ == State::ValueComplete) {
-    ENVOY_LOG(trace, "parse slice: {} remaining", remaining);
     switch (state_) {
-    case State::ValueRootStart: {
-      ENVOY_LOG(trace, "parse slice: ValueRootStart");
-      pending_value_root_.reset(new Message());
-      state_ = State::SimpleString;
+    case State::Line: {
+      const char *cr = static_cast<const char *>(
+          memchr(buffer, '\r', end - buffer));
+      if (cr == nullptr) {
+        pending_value_->asString().append(buffer, end - buffer);
+        return;
+      }
+      pending_value_->asString().append(buffer, cr - buffer);
+      buffer = cr + 1;
+      state_ = State::LineLF;
       break;
     }
 
-    case State::SimpleString: {
-      ENVOY_LOG(trace, "parse slice: SimpleString: {}", buffer[0]);
-      if (buffer[0] == '\r') {
-        state_ = State::LF;
-      } else {
-        pending_value_root_->asString().push_back(buffer[0]);
+    case State::LineLF: {
+      if (*buffer != '\n') {
+        // TODO(talnordan): Consider gracefully ignoring this error.
+        throw ProtocolError("expected new line");
       }
-
-      remaining--;
       buffer++;
+      onLine();
       break;
     }
 
-    case State::LF: {
-      ENVOY_LOG(trace, "parse slice: LF");
-      if (buffer[0] != '\n') {
-        // TODO(talnordan): Consider gracefully ignoring this error.
-        throw ProtocolError("expected new line");
+    case State::Payload: {
+      const uint64_t size =
+          std::min<uint64_t>(payload_remaining_, end - buffer);
+      pending_value_->asString().append(buffer, size);
+      buffer += size;
+      payload_remaining_ -= size;
+      if (payload_remaining_ == 0) {
+        state_ = State::PayloadCR;
       }
+      break;
+    }
 
-      remaining--;
+    case State::PayloadCR: {
+      if (*buffer != '\r') {
+        throw ProtocolError("expected carriage return after payload");
+      }
       buffer++;
-      state_ = State::ValueComplete;
+      state_ = State::PayloadLF;
       break;
     }
 
-    case State::ValueComplete: {
-      ENVOY_LOG(trace, "parse slice: ValueComplete");
-      callbacks_.onValue(std::move(pending_value_root_));
-      state_ = State::ValueRootStart;
-
+    case State::PayloadLF: {
+      if (*buffer != '\n') {
+        throw ProtocolError("expected new line after payload");
+      }
+      buffer++;
+      state_ = State::Line;
+      onValue();
       break;
     }
     }
   }
 }
 
+void DecoderImpl::onLine() {
+  const absl::optional<uint64_t> payload_size = payloadSize();
+  onValue();
+  if (!payload_size.has_value()) {
+    state_ = State::Line;
+    return;
+  }
+  payload_remaining_ = payload_size.value();
+  state_ = payload_remaining_ > 0 ? State::Payload : State::PayloadCR;
+}
+
+absl::optional<uint64_t> DecoderImpl::payloadSize() const {
+  // MSG <subject> <sid> [reply-to] <#bytes>
+  // HMSG <subject> <sid> [reply-to] <#header bytes> <#total bytes>
+  absl::string_view line = pending_value_->asString();
+  const size_t op_size =
+      !line.empty() && absl::ascii_tolower(line[0]) == 'h' ? 4 : 3;
+  if (line.size() <= op_size ||
+      !absl::EqualsIgnoreCase(line.substr(op_size - 3, 3), "MSG") ||
+      (line[op_size] != ' ' && line[op_size] != '\t')) {
+    return absl::nullopt;
+  }
+  line = absl::StripTrailingAsciiWhitespace(line);
+  const size_t last_space = line.find_last_of(" \t");
+  uint64_t size;
+  if (last_space == op_size ||
+      !absl::SimpleAtoi(line.substr(last_space + 1), &size)) {
+    throw ProtocolError("invalid MSG payload size");
+  }
+  return size;
+}
+
+void DecoderImpl::onValue() { callbacks_.onValue(std::move(pending_value_)); }
+
 void EncoderImpl::encode(const Message &value, Buffer::Instance &out) {
   out.add(value.asString());
   out.add("\r\n", 2);
+  if (value.payload() != nullptr) {
+    Buffer::BufferUtility::addSharedBuffer(value.payload(), out);
+    out.add("\r\n", 2);
+  }
 }
 
 } // namespace Nats
@@ -5,6 +5,8 @@
 
 #include "source/common/common/logger.h"
 
+#include "absl/types/optional.h"
+
 namespace Envoy {
 namespace Nats {
 
@@ -16,6 +18,11 @@ using Tcp::Encoder;
  * Decoder implementation of
  * https://nats.io/documentation/internals/nats-protocol/
  *
+ * Each protocol line is decoded into a value. The payload following a `MSG`
+ * or `HMSG` line, headers included, is read by its declared byte count, so it
+ * may hold any byte, and is decoded into the next value. Lines and payloads are found with memchr and
+ * copied in bulk from the slices of the decoded buffer, once per value.
+ *
  * This implementation buffers when needed and will always consume all bytes
  * passed for decoding.
  */
@@ -27,13 +34,18 @@ public:
   void decode(Buffer::Instance &data) override;
 
 private:
-  enum class State { ValueRootStart, SimpleString, LF, ValueComplete };
+  enum class State { Line, LineLF, Payload, PayloadCR, PayloadLF };
 
   void parseSlice(const Buffer::RawSlice &slice);
+  void onLine();
+  // @return the payload size if the pending line is a `MSG` or `HMSG` line
+  absl::optional<uint64_t> payloadSize() const;
+  void onValue();
 
   DecoderCallbacks<Message> &callbacks_;
-  State state_{State::ValueRootStart};
-  MessagePtr pending_value_root_;
+  State state_{State::Line};
+  MessagePtr pending_value_;
+  uint64_t payload_remaining_{};
 };
 
 /**
@@ -0,0 +1,82 @@
+#include "source/common/nats/jetstream/client_impl.h"
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/macros.h"
+#include "source/common/nats/jetstream/pub_ack_handler.h"
+#include "source/common/nats/message_builder.h"
+
+#include "absl/strings/str_cat.h"
+
+namespace Envoy {
+namespace Nats {
+namespace JetStream {
+
+ClientImpl::ClientImpl(Tcp::ConnPoolNats::InstancePtr<Message> &&conn_pool,
+                       Random::RandomGenerator &random,
+                       Event::Dispatcher &dispatcher,
+                       const std::chrono::milliseconds &op_timeout,
+                       uint32_t max_inflight, uint32_t max_pending,
+                       const ClientStats &stats)
+    : ClientBase(std::move(conn_pool), random, dispatcher, op_timeout,
+                 max_inflight, max_pending, stats),
+      root_pub_ack_inbox_(
+          SubjectUtility::randomChild(INBOX_PREFIX, token_generator_)),
+      client_id_(token_generator_.random()) {}
+
+void ClientImpl::onInfo() {
+  // The server handles the operations of a connection in order, so the
+  // subscription is in place before the first publish.
+  subChildWildcardInbox(root_pub_ack_inbox_);
+  onHandshakeComplete();
+}
+
+void ClientImpl::onInboxMessage(const std::string &subject,
+                                const absl::optional<std::string> &reply_to,
+                                uint64_t header_size,
+                                const std::string &payload) {
+  UNREFERENCED_PARAMETER(reply_to);
+
+  // Gracefully ignore messages to other inboxes.
+  const absl::optional<uint64_t> pub_ack_inbox =
+      SubjectUtility::parseNumericChild(root_pub_ack_inbox_, subject);
+  if (pub_ack_inbox.has_value()) {
+    PubAckHandler::onMessage(pub_ack_inbox.value(), header_size, payload,
+                             pub_request_per_inbox_);
+    onPubRequestsDone();
+  }
+}
+
+PubRequest ClientImpl::createPubRequest(uint64_t pub_ack_inbox,
+                                        const std::string &subject,
+                                        Buffer::Instance &headers,
+                                        Buffer::Instance &payload,
+                                        PublishCallbacks &callbacks) {
+  // The ack inbox numbers are never reused by a client, so they make unique
+  // message IDs too. The headers and the payload are moved rather than
+  // copied.
+  auto pub_msg = std::make_shared<Buffer::OwnedImpl>("NATS/1.0\r\n");
+  MessageBuilder::addHeader("Nats-Msg-Id",
+                            absl::StrCat(client_id_, "-", pub_ack_inbox),
+                            *pub_msg);
+  pub_msg->move(headers);
+  pub_msg->add("\r\n");
+  const uint64_t header_size = pub_msg->length();
+  pub_msg->move(payload);
+  return PubRequest(&callbacks, subject, std::move(pub_msg), header_size);
+}
+
+void ClientImpl::sendPubMsg(uint64_t pub_ack_inbox,
+                            const PubRequest &pub_request) {
+  sendNatsMessage(MessageBuilder::createHpubMessage(
+      pub_request.subject(),
+      SubjectUtility::numericChild(root_pub_ack_inbox_, pub_ack_inbox),
+      pub_request.headerSize(), pub_request.pubMsg()));
+}
+
+Message ClientImpl::createConnectMessage() {
+  return MessageBuilder::createConnectMessageWithHeaders();
+}
+
+} // namespace JetStream
+} // namespace Nats
+} // namespace Envoy
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "include/envoy/nats/codec.h"
+
+#include "source/common/nats/streaming/client_base.h"
+
+#include "absl/types/optional.h"
+
+namespace Envoy {
+namespace Nats {
+namespace JetStream {
+
+using Streaming::ClientStats;
+using Streaming::PublishCallbacks;
+using Streaming::PubRequest;
+
+/**
+ * Publishes to JetStream, the persistence layer of NATS 2.x. Each request is
+ * published with `HPUB` to its own subject, which a stream is expected to
+ * capture, and the stream replies with a `PubAck` to a numbered child of the
+ * ack inbox of the client. There is no handshake beyond `CONNECT` and `SUB`,
+ * and as many requests as the window allows are awaiting their ack.
+ *
+ * Each request has a `Nats-Msg-Id` header, unique to the client and the
+ * request, so the stream drops the copy of a request replayed after a
+ * reconnect, within its duplicate window.
+ */
+class ClientImpl : public Streaming::ClientBase {
+public:
+  ClientImpl(Tcp::ConnPoolNats::InstancePtr<Message> &&conn_pool,
+             Random::RandomGenerator &random, Event::Dispatcher &dispatcher,
+             const std::chrono::milliseconds &op_timeout,
+             uint32_t max_inflight, uint32_t max_pending,
+             const ClientStats &stats);
+
+protected:
+  // Nats::Streaming::ClientBase
+  void onInfo() override;
+  void onInboxMessage(const std::string &subject,
+                      const absl::optional<std::string> &reply_to,
+                      uint64_t header_size,
+                      const std::string &payload) override;
+  PubRequest createPubRequest(uint64_t pub_ack_inbox,
+                              const std::string &subject,
+                              Buffer::Instance &headers,
+                              Buffer::Instance &payload,
+                              PublishCallbacks &callbacks) override;
+  void sendPubMsg(uint64_t pub_ack_inbox,
+                  const PubRequest &pub_request) override;
+  Message createConnectMessage() override;
+
+private:
+  // The ack inboxes of the requests are its numbered children.
+  const std::string root_pub_ack_inbox_;
+  // The prefix of the message IDs of the requests.
+  const std::string client_id_;
+};
+
+} // namespace JetStream
+} // namespace Nats
+} // namespace Envoy
@@ -0,0 +1,70 @@
+#include "source/common/nats/jetstream/pub_ack_handler.h"
+
+#include <algorithm>
+
+#include "absl/strings/strip.h"
+#include "nlohmann/json.hpp"
+
+namespace Envoy {
+namespace Nats {
+namespace JetStream {
+
+void PubAckHandler::onMessage(uint64_t inbox, uint64_t header_size,
+                              const std::string &payload,
+                              PubRequestMap &request_per_inbox) {
+  // Gracefully ignore a missing inbox, e.g. of a request which timed out.
+  auto it = request_per_inbox.find(inbox);
+  if (it == request_per_inbox.end()) {
+    return;
+  }
+
+  // The request is removed before its callbacks are notified.
+  Streaming::PublishCallbacks &publish_callbacks = it->second.callbacks();
+  request_per_inbox.erase(it);
+
+  if (getError(header_size, payload).has_value()) {
+    publish_callbacks.onFailure();
+  } else {
+    publish_callbacks.onResponse();
+  }
+}
+
+absl::optional<std::string>
+PubAckHandler::getError(uint64_t header_size, absl::string_view payload) {
+  // A reply with a status, such as `503` when no stream captures the subject,
+  // comes from the server rather than from a stream.
+  // NATS/1.0 [<status> [<description>]]\r\n
+  if (header_size > 0) {
+    absl::string_view status_line = payload.substr(0, payload.find("\r\n"));
+    if (absl::ConsumePrefix(&status_line, "NATS/1.0 ")) {
+      return std::string(status_line);
+    }
+  }
+
+  // A `PubAck` is a JSON object, with either the stream and sequence of the
+  // message or an error. A duplicate message is acked as well.
+  const nlohmann::json pub_ack = nlohmann::json::parse(
+      payload.substr(std::min<uint64_t>(header_size, payload.size())), nullptr,
+      false);
+  if (!pub_ack.is_object()) {
+    return std::string("invalid PubAck");
+  }
+  const auto error = pub_ack.find("error");
+  if (error != pub_ack.end()) {
+    // The description is read only when it is a string, as the reply comes
+    // from the network.
+    if (error->is_object() && error->contains("description") &&
+        (*error)["description"].is_string()) {
+      return (*error)["description"].get<std::string>();
+    }
+    return std::string("error");
+  }
+  if (!pub_ack.contains("stream")) {
+    return std::string("PubAck without stream");
+  }
+  return absl::nullopt;
+}
+
+} // namespace JetStream
+} // namespace Nats
+} // namespace Envoy
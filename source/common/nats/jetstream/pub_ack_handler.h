@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include "source/common/nats/streaming/pub_request_handler.h"
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace Envoy {
+namespace Nats {
+namespace JetStream {
+
+using Streaming::PubRequestMap;
+
+class PubAckHandler {
+public:
+  // Completes the request with the specified inbox, if any, on the reply of
+  // the stream. The first `header_size` bytes of the reply are its headers.
+  static void onMessage(uint64_t inbox, uint64_t header_size,
+                        const std::string &payload,
+                        PubRequestMap &request_per_inbox);
+
+  // @return the error of a reply which does not ack the publish, if any.
+  static absl::optional<std::string> getError(uint64_t header_size,
+                                              absl::string_view payload);
+};
+
+} // namespace JetStream
+} // namespace Nats
+} // namespace Envoy
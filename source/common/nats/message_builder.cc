@@ -1,6 +1,6 @@
 #include "source/common/nats/message_builder.h"
 
-#include <sstream>
+#include "absl/strings/str_cat.h"
 
 namespace Envoy {
 namespace Nats {
@@ -10,10 +10,13 @@ Message MessageBuilder::createConnectMessage() {
       R"(CONNECT {"verbose":false,"pedantic":false,"tls_required":false,"name":"","lang":"cpp","version":"1.2.2","protocol":1})");
 }
 
+Message MessageBuilder::createConnectMessageWithHeaders() {
+  return Message(
+      R"(CONNECT {"verbose":false,"pedantic":false,"tls_required":false,"name":"","lang":"cpp","version":"1.2.2","protocol":1,"headers":true,"no_responders":true})");
+}
+
 Message MessageBuilder::createPubMessage(const std::string &subject) {
-  std::stringstream ss;
-  ss << "PUB " << subject << " 0\r\n";
-  return Message(ss.str());
+  return Message(absl::StrCat("PUB ", subject, " 0\r\n"));
 }
 
 Message MessageBuilder::createPubMessage(const std::string &subject,
@@ -21,18 +24,37 @@ Message MessageBuilder::createPubMessage(const std::string &subject,
                                          const std::string &payload) {
   // TODO(talnordan): Consider introducing a more explicit way to construct and
   // encode messages consisting of two lines.
-  std::stringstream ss;
-  ss << "PUB " << subject << " " << reply_to << " " << payload.length()
-     << "\r\n"
-     << payload;
-  return Message(ss.str());
+  return Message(absl::StrCat("PUB ", subject, " ", reply_to, " ",
+                              payload.length(), "\r\n", payload));
+}
+
+Message MessageBuilder::createPubMessage(const std::string &subject,
+                                         const std::string &reply_to,
+                                         PayloadSharedPtr payload) {
+  const uint64_t length = payload->length();
+  return Message(absl::StrCat("PUB ", subject, " ", reply_to, " ", length),
+                 std::move(payload));
+}
+
+Message MessageBuilder::createHpubMessage(const std::string &subject,
+                                          const std::string &reply_to,
+                                          uint64_t header_size,
+                                          PayloadSharedPtr payload) {
+  const uint64_t length = payload->length();
+  return Message(absl::StrCat("HPUB ", subject, " ", reply_to, " ",
+                              header_size, " ", length),
+                 std::move(payload));
+}
+
+void MessageBuilder::addHeader(absl::string_view name,
+                               absl::string_view value,
+                               Buffer::Instance &headers) {
+  headers.add(absl::StrCat(name, ": ", value, "\r\n"));
 }
 
 Message MessageBuilder::createSubMessage(const std::string &subject,
                                          uint64_t sid) {
-  std::stringstream ss;
-  ss << "SUB " << subject << " " << sid;
-  return Message(ss.str());
+  return Message(absl::StrCat("SUB ", subject, " ", sid));
 }
 
 Message MessageBuilder::createPongMessage() { return Message("PONG"); }
@@ -4,16 +4,33 @@
 
 #include "include/envoy/nats/codec.h"
 
+#include "absl/strings/string_view.h"
+
 namespace Envoy {
 namespace Nats {
 
 class MessageBuilder {
 public:
   static Message createConnectMessage();
+  // Enables headers and makes a request with no subscriber fail at once, with
+  // a `503` status.
+  static Message createConnectMessageWithHeaders();
   static Message createPubMessage(const std::string &subject);
   static Message createPubMessage(const std::string &subject,
                                   const std::string &reply_to,
                                   const std::string &payload);
+  // The payload is referenced by the message rather than copied.
+  static Message createPubMessage(const std::string &subject,
+                                  const std::string &reply_to,
+                                  PayloadSharedPtr payload);
+  // The first `header_size` bytes of the payload are the headers.
+  static Message createHpubMessage(const std::string &subject,
+                                   const std::string &reply_to,
+                                   uint64_t header_size,
+                                   PayloadSharedPtr payload);
+  // Appends a header line of an `HPUB` to `headers`.
+  static void addHeader(absl::string_view name, absl::string_view value,
+                        Buffer::Instance &headers);
   static Message createSubMessage(const std::string &subject, uint64_t sid);
   static Message createPongMessage();
 };
@@ -0,0 +1,427 @@
+#include "source/common/nats/streaming/client_base.h"
+
+#include <algorithm>
+
+#include "envoy/event/dispatcher.h"
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/assert.h"
+#include "source/common/common/backoff_strategy.h"
+#include "source/common/common/macros.h"
+#include "source/common/common/utility.h"
+#include "source/common/nats/message_builder.h"
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+const std::string ClientBase::INBOX_PREFIX{"_INBOX"};
+
+ClientBase::ClientBase(Tcp::ConnPoolNats::InstancePtr<Message> &&conn_pool,
+                       Random::RandomGenerator &random,
+                       Event::Dispatcher &dispatcher,
+                       const std::chrono::milliseconds &op_timeout,
+                       uint32_t max_inflight, uint32_t max_pending,
+                       const ClientStats &stats)
+    : token_generator_(random), conn_pool_(std::move(conn_pool)),
+      op_timeout_(op_timeout),
+      pub_ack_timeouts_(dispatcher, op_timeout,
+                        [this](const std::vector<uint64_t> &pub_ack_inboxes)
+                            -> void { onTimeouts(pub_ack_inboxes); }),
+      connect_timer_(dispatcher.createTimer(
+          [this]() -> void { disconnect("connect timeout"); })),
+      reconnect_timer_(dispatcher.createTimer([this]() -> void {
+        stats_.reconnect_.inc();
+        startConnecting();
+      })),
+      reconnect_backoff_(std::make_unique<JitteredExponentialBackOffStrategy>(
+          RECONNECT_BASE_INTERVAL_MS, RECONNECT_MAX_INTERVAL_MS, random)),
+      max_inflight_(max_inflight), max_pending_(max_pending), stats_(stats),
+      sid_(1) {}
+
+ClientBase::~ClientBase() {
+  // Closing the connection calls `onClose()`, which is ignored unless
+  // connecting or connected.
+  state_ = State::NotConnected;
+  conn_pool_.reset();
+
+  for (WindowWatcher *window_watcher : window_watchers_) {
+    window_watcher->watching_ = false;
+  }
+  stats_.publish_in_flight_.sub(reported_in_flight_);
+  stats_.publish_queued_.sub(reported_queued_);
+}
+
+ClientStats ClientBase::generateStats(const std::string &prefix,
+                                      Stats::Scope &scope) {
+  const std::string final_prefix = prefix + "nats_streaming.";
+  return {ALL_NATS_STREAMING_CLIENT_STATS(
+      POOL_COUNTER_PREFIX(scope, final_prefix),
+      POOL_GAUGE_PREFIX(scope, final_prefix))};
+}
+
+PublishRequestPtr ClientBase::makeRequest(const std::string &subject,
+                                          const std::string &cluster_id,
+                                          const std::string &discover_prefix,
+                                          Buffer::Instance &headers,
+                                          Buffer::Instance &payload,
+                                          PublishCallbacks &callbacks) {
+  // A request is queued, rather than published, while connecting, and behind
+  // a full window or other queued requests.
+  const bool publish = state_ == State::Connected &&
+                       pending_request_per_inbox_.empty() && hasRoomInWindow();
+  if (!publish && isQueueFull()) {
+    stats_.publish_overflow_.inc();
+    callbacks.onOverflow();
+    return nullptr;
+  }
+
+  // The ack inboxes are numbered children of a random root, which is unique to
+  // this client. The timeout covers the time spent queued as well as awaiting
+  // the ack.
+  const uint64_t pub_ack_inbox = next_pub_ack_inbox_++;
+  pub_ack_timeouts_.add(pub_ack_inbox);
+
+  switch (state_) {
+  case State::NotConnected:
+    enqueuePendingRequest(subject, headers, payload, callbacks,
+                          pub_ack_inbox);
+    connect(cluster_id, discover_prefix);
+    break;
+  case State::Connecting:
+  case State::Disconnected:
+    enqueuePendingRequest(subject, headers, payload, callbacks,
+                          pub_ack_inbox);
+    break;
+  case State::Connected:
+    if (publish) {
+      pubPubMsg(subject, headers, payload, callbacks, pub_ack_inbox);
+    } else {
+      enqueuePendingRequest(subject, headers, payload, callbacks,
+                            pub_ack_inbox);
+    }
+    break;
+  }
+  updateGauges();
+
+  PublishRequestPtr request_ptr(
+      new PublishRequestCanceler(*this, pub_ack_inbox));
+  return request_ptr;
+}
+
+WindowWatchPtr ClientBase::watchWindow(const std::string &,
+                                       WindowCallbacks &callbacks) {
+  if (state_ != State::Connected || pending_request_per_inbox_.empty()) {
+    return nullptr;
+  }
+
+  return std::make_unique<WindowWatcher>(*this, callbacks);
+}
+
+void ClientBase::onResponse(Nats::MessagePtr &&value) {
+  ENVOY_LOG(trace, "on response: value is\n[{}]", value->asString());
+
+  // Ignore the rest of the data read from a connection being closed.
+  if (state_ == State::Disconnected) {
+    return;
+  }
+
+  // Check whether a payload is expected prior to NATS operation extraction.
+  // TODO(talnordan): Eventually, we might want `onResponse()` to be passed a
+  // single decoded message consisting of both the `MSG` arguments and the
+  // payload.
+  if (msg_waiting_for_payload_.has_value()) {
+    onPayload(std::move(value));
+  } else {
+    onOperation(std::move(value));
+  }
+}
+
+void ClientBase::onClose() {
+  if (state_ == State::Connecting || state_ == State::Connected) {
+    ENVOY_LOG(warn, "connection closed");
+    onDisconnected();
+  }
+}
+
+void ClientBase::connect(const std::string &cluster_id,
+                         const std::string &discover_prefix) {
+  if (state_ != State::NotConnected) {
+    return;
+  }
+
+  cluster_id_.emplace(cluster_id);
+  discover_prefix_.emplace(discover_prefix);
+  conn_pool_->setPoolCallbacks(*this);
+  startConnecting();
+}
+
+void ClientBase::cancel(uint64_t pub_ack_inbox) {
+  // Remove the pending request with the specified inbox, if such exists.
+  if (pending_request_per_inbox_.erase(pub_ack_inbox) == 0) {
+    PubRequestHandler::onCancel(pub_ack_inbox, pub_request_per_inbox_);
+    publishPendingRequests();
+  }
+  updateGauges();
+}
+
+void ClientBase::onHandshakeComplete() {
+  state_ = State::Connected;
+  connect_timer_->disableTimer();
+  reconnect_backoff_->reset();
+
+  replayPubRequests();
+  publishPendingRequests();
+  updateGauges();
+}
+
+void ClientBase::disconnect(const std::string &error) {
+  // TODO(talnordan): Do a best effort to gracefully unsubscribe and disconnect
+  // from NATS streaming and NATS.
+  ENVOY_LOG(error, "on failure: error is\n[{}]", error);
+  onDisconnected();
+  conn_pool_->close();
+}
+
+void ClientBase::onPubRequestsDone() {
+  publishPendingRequests();
+  updateGauges();
+}
+
+void ClientBase::subInbox(const std::string &subject) {
+  sendNatsMessage(MessageBuilder::createSubMessage(subject, sid_));
+  ++sid_;
+}
+
+void ClientBase::subChildWildcardInbox(const std::string &parent_subject) {
+  std::string child_wildcard{SubjectUtility::childWildcard(parent_subject)};
+  subInbox(child_wildcard);
+}
+
+void ClientBase::sendNatsMessage(const Message &message) {
+  // TODO(talnordan): Manage hash key computation.
+  const std::string hash_key;
+
+  conn_pool_->makeRequest(hash_key, message);
+}
+
+ClientBase::PublishRequestCanceler::PublishRequestCanceler(
+    ClientBase &parent, uint64_t pub_ack_inbox)
+    : parent_(parent), pub_ack_inbox_(pub_ack_inbox) {}
+
+void ClientBase::PublishRequestCanceler::cancel() {
+  parent_.cancel(pub_ack_inbox_);
+}
+
+ClientBase::WindowWatcher::WindowWatcher(ClientBase &parent,
+                                         WindowCallbacks &callbacks)
+    : parent_(parent), callbacks_(callbacks),
+      position_(parent.window_watchers_.insert(parent.window_watchers_.end(),
+                                               this)) {}
+
+ClientBase::WindowWatcher::~WindowWatcher() { cancel(); }
+
+void ClientBase::WindowWatcher::cancel() {
+  if (watching_) {
+    parent_.window_watchers_.erase(position_);
+    watching_ = false;
+  }
+}
+
+void ClientBase::onOperation(Nats::MessagePtr &&value) {
+  // TODO(talnordan): For better performance, a future decoder implementation
+  // might use zero allocation byte parsing. In such case, this function would
+  // need to switch over an `enum class` representing the message type. See:
+  // https://github.com/nats-io/go-nats/blob/master/parser.go
+  // https://youtu.be/ylRKac5kSOk?t=10m46s
+
+  auto delimiters = " \t";
+  auto keep_empty_string = false;
+  auto tokens =
+      StringUtil::splitToken(value->asString(), delimiters, keep_empty_string);
+
+  auto &&op = tokens[0];
+  if (absl::EqualsIgnoreCase(op, "INFO")) {
+    // TODO(talnordan): Process `INFO` options.
+    // The server might send `INFO` again, e.g. when the cluster changes.
+    if (state_ == State::Connecting) {
+      onInfo();
+    }
+  } else if (absl::EqualsIgnoreCase(op, "MSG")) {
+    onMsg(std::move(tokens), false);
+  } else if (absl::EqualsIgnoreCase(op, "HMSG")) {
+    onMsg(std::move(tokens), true);
+  } else if (absl::EqualsIgnoreCase(op, "PING")) {
+    onPing();
+  } else if (absl::EqualsIgnoreCase(op, "+OK")) {
+    ENVOY_LOG(error, "on operation: op is [{}], not throwing", op);
+  } else {
+    // TODO(talnordan): Error handling.
+    // TODO(talnordan): Increment error stats.
+    ENVOY_LOG(error, "on operation: op is [{}], throwing", op);
+    throw ProtocolError("invalid message");
+  }
+}
+
+void ClientBase::onPayload(Nats::MessagePtr &&value) {
+  // Mark that the payload has been received before handling it, since the
+  // handler might disconnect.
+  MsgWaitingForPayload msg = std::move(msg_waiting_for_payload_.value());
+  msg_waiting_for_payload_.reset();
+  onInboxMessage(msg.subject, msg.reply_to, msg.header_size, value->asString());
+}
+
+void ClientBase::onMsg(std::vector<absl::string_view> &&tokens,
+                       bool has_headers) {
+  // MSG <subject> <sid> [reply-to] <#bytes>
+  // HMSG <subject> <sid> [reply-to] <#header bytes> <#total bytes>
+  const size_t num_tokens = tokens.size();
+  const size_t num_size_tokens = has_headers ? 2 : 1;
+  uint64_t header_size{};
+  if ((num_tokens != 3 + num_size_tokens &&
+       num_tokens != 4 + num_size_tokens) ||
+      (has_headers &&
+       !absl::SimpleAtoi(tokens[num_tokens - 2], &header_size))) {
+    // TODO(talnordan): Error handling.
+    ENVOY_LOG(error, "on {}: num_tokens is {}", tokens[0], num_tokens);
+    throw ProtocolError("invalid MSG");
+  }
+
+  absl::optional<std::string> reply_to{};
+  if (num_tokens == 4 + num_size_tokens) {
+    reply_to.emplace(std::string(tokens[3]));
+  }
+  msg_waiting_for_payload_.emplace(
+      MsgWaitingForPayload{std::string(tokens[1]), reply_to, header_size});
+}
+
+void ClientBase::onPing() { pong(); }
+
+void ClientBase::onTimeouts(const std::vector<uint64_t> &pub_ack_inboxes) {
+  // The inboxes of requests which have been acked or cancelled are ignored.
+  for (uint64_t pub_ack_inbox : pub_ack_inboxes) {
+    auto it = pending_request_per_inbox_.find(pub_ack_inbox);
+    if (it == pending_request_per_inbox_.end()) {
+      PubRequestHandler::onTimeout(pub_ack_inbox, pub_request_per_inbox_);
+      continue;
+    }
+
+    // A request still queued is removed before its callbacks are notified.
+    PublishCallbacks *callbacks = it->second.callbacks;
+    pending_request_per_inbox_.erase(it);
+    callbacks->onTimeout();
+  }
+  onPubRequestsDone();
+}
+
+void ClientBase::startConnecting() {
+  state_ = State::Connecting;
+  connect_timer_->enableTimer(op_timeout_);
+  sendNatsMessage(createConnectMessage());
+}
+
+void ClientBase::onDisconnected() {
+  ENVOY_LOG(debug, "reconnecting, with {} publishes in flight",
+            pub_request_per_inbox_.size());
+  state_ = State::Disconnected;
+  connect_timer_->disableTimer();
+  msg_waiting_for_payload_.reset();
+
+  // The requests in flight keep their timeouts, and are published again once
+  // connected.
+  reconnect_timer_->enableTimer(
+      std::chrono::milliseconds(reconnect_backoff_->nextBackOffMs()));
+}
+
+void ClientBase::replayPubRequests() {
+  if (pub_request_per_inbox_.empty()) {
+    return;
+  }
+
+  std::vector<uint64_t> pub_ack_inboxes;
+  pub_ack_inboxes.reserve(pub_request_per_inbox_.size());
+  for (const auto &entry : pub_request_per_inbox_) {
+    pub_ack_inboxes.push_back(entry.first);
+  }
+  std::sort(pub_ack_inboxes.begin(), pub_ack_inboxes.end());
+
+  for (uint64_t pub_ack_inbox : pub_ack_inboxes) {
+    sendPubMsg(pub_ack_inbox, pub_request_per_inbox_.at(pub_ack_inbox));
+  }
+  stats_.publish_replayed_.add(pub_ack_inboxes.size());
+}
+
+void ClientBase::enqueuePendingRequest(const std::string &subject,
+                                       Buffer::Instance &headers,
+                                       Buffer::Instance &payload,
+                                       PublishCallbacks &callbacks,
+                                       uint64_t pub_ack_inbox) {
+  PendingRequest pending_request{subject,
+                                 std::make_unique<Buffer::OwnedImpl>(),
+                                 std::make_unique<Buffer::OwnedImpl>(),
+                                 &callbacks};
+  pending_request.headers->move(headers);
+  pending_request.payload->move(payload);
+  pending_request_per_inbox_.emplace(pub_ack_inbox, std::move(pending_request));
+}
+
+void ClientBase::pubPubMsg(const std::string &subject,
+                           Buffer::Instance &headers,
+                           Buffer::Instance &payload,
+                           PublishCallbacks &callbacks,
+                           uint64_t pub_ack_inbox) {
+  auto position =
+      pub_request_per_inbox_
+          .emplace(pub_ack_inbox, createPubRequest(pub_ack_inbox, subject,
+                                                   headers, payload, callbacks))
+          .first;
+  sendPubMsg(pub_ack_inbox, position->second);
+}
+
+void ClientBase::publishPendingRequests() {
+  // Requests are only published while connected.
+  if (state_ != State::Connected) {
+    return;
+  }
+
+  while (!pending_request_per_inbox_.empty() && hasRoomInWindow()) {
+    auto it = pending_request_per_inbox_.begin();
+    const uint64_t pub_ack_inbox = it->first;
+    PendingRequest pending_request = std::move(it->second);
+    pending_request_per_inbox_.erase(it);
+    pubPubMsg(pending_request.subject, *pending_request.headers,
+              *pending_request.payload, *pending_request.callbacks,
+              pub_ack_inbox);
+  }
+
+  // A watcher is removed before being notified, since notifying it might
+  // destroy other watchers.
+  while (!window_watchers_.empty() && pending_request_per_inbox_.empty()) {
+    WindowWatcher *window_watcher = window_watchers_.front();
+    window_watchers_.pop_front();
+    window_watcher->watching_ = false;
+    window_watcher->callbacks_.onWindowOpen();
+  }
+}
+
+void ClientBase::updateGauges() {
+  // Each gauge is added to before being subtracted from, so that the total of
+  // all workers never goes below zero.
+  const uint64_t in_flight = pub_request_per_inbox_.size();
+  stats_.publish_in_flight_.add(in_flight);
+  stats_.publish_in_flight_.sub(reported_in_flight_);
+  reported_in_flight_ = in_flight;
+
+  const uint64_t queued = pending_request_per_inbox_.size();
+  stats_.publish_queued_.add(queued);
+  stats_.publish_queued_.sub(reported_queued_);
+  reported_queued_ = queued;
+}
+
+void ClientBase::pong() {
+  sendNatsMessage(MessageBuilder::createPongMessage());
+}
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
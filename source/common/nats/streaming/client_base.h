@@ -0,0 +1,262 @@
+#pragma once
+
+#include <list>
+
+#include "envoy/common/backoff_strategy.h"
+#include "envoy/event/timer.h"
+#include "include/envoy/nats/codec.h"
+#include "include/envoy/nats/streaming/client.h"
+#include "envoy/runtime/runtime.h"
+#include "envoy/stats/scope.h"
+#include "envoy/stats/stats_macros.h"
+#include "include/envoy/tcp/conn_pool_nats.h"
+
+#include "source/common/common/logger.h"
+#include "source/common/nats/streaming/pub_request_handler.h"
+#include "source/common/nats/streaming/timeout_wheel.h"
+#include "source/common/nats/subject_utility.h"
+#include "source/common/nats/token_generator_impl.h"
+
+#include "absl/container/btree_map.h"
+#include "absl/types/optional.h"
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+/**
+ * All stats for the NATS Streaming client. @see stats_macros.h
+ */
+#define ALL_NATS_STREAMING_CLIENT_STATS(COUNTER, GAUGE)                        \
+  COUNTER(publish_overflow)                                                    \
+  COUNTER(publish_replayed)                                                    \
+  COUNTER(reconnect)                                                           \
+  GAUGE(publish_in_flight, Accumulate)                                         \
+  GAUGE(publish_queued, Accumulate)
+
+/**
+ * Wrapper struct for NATS Streaming client stats. @see stats_macros.h
+ */
+struct ClientStats {
+  ALL_NATS_STREAMING_CLIENT_STATS(GENERATE_COUNTER_STRUCT,
+                                  GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * The parts of a publishing client which do not depend on the protocol on top
+ * of NATS: the connection and its reconnects, the queue and window of
+ * requests, their ack timeouts and replay, and the parsing of NATS operations.
+ * A subclass does the handshake, and publishes and acks the requests.
+ */
+class ClientBase : public Client,
+                   public Tcp::ConnPoolNats::PoolCallbacks<Message>,
+                   public Envoy::Logger::Loggable<Envoy::Logger::Id::filter> {
+public:
+  // A `max_inflight` or `max_pending` of 0 means no limit.
+  ClientBase(Tcp::ConnPoolNats::InstancePtr<Message> &&conn_pool,
+             Random::RandomGenerator &random, Event::Dispatcher &dispatcher,
+             const std::chrono::milliseconds &op_timeout,
+             uint32_t max_inflight, uint32_t max_pending,
+             const ClientStats &stats);
+  virtual ~ClientBase();
+
+  // @param prefix the stats prefix of the filter
+  static ClientStats generateStats(const std::string &prefix,
+                                   Stats::Scope &scope);
+
+  // Nats::Streaming::Client
+  Client &selectClient(const std::string &) override { return *this; }
+  PublishRequestPtr makeRequest(const std::string &subject,
+                                const std::string &cluster_id,
+                                const std::string &discover_prefix,
+                                Buffer::Instance &headers,
+                                Buffer::Instance &payload,
+                                PublishCallbacks &callbacks) override;
+  WindowWatchPtr watchWindow(const std::string &subject,
+                             WindowCallbacks &callbacks) override;
+
+  // Tcp::ConnPoolNats::PoolCallbacks
+  void onResponse(Nats::MessagePtr &&value) override;
+  void onClose() override;
+
+  // Connects ahead of the first request, unless already connected.
+  void connect(const std::string &cluster_id,
+               const std::string &discover_prefix);
+
+  void cancel(uint64_t pub_ack_inbox);
+
+  // The bounds of the jittered exponential backoff between reconnects.
+  static constexpr uint64_t RECONNECT_BASE_INTERVAL_MS = 100;
+  static constexpr uint64_t RECONNECT_MAX_INTERVAL_MS = 10000;
+
+protected:
+  // Called on `INFO` while connecting, once `CONNECT` has been sent. The
+  // handshake ends with a call to `onHandshakeComplete()`.
+  virtual void onInfo() PURE;
+
+  // Called with a message delivered to one of the subscriptions. The first
+  // `header_size` bytes of the payload are the headers of an `HMSG`.
+  virtual void onInboxMessage(const std::string &subject,
+                              const absl::optional<std::string> &reply_to,
+                              uint64_t header_size,
+                              const std::string &payload) PURE;
+
+  // Serializes the message to publish, draining the headers and the payload
+  // into it. The request is kept until acked, to be sent again after a
+  // reconnect.
+  virtual PubRequest createPubRequest(uint64_t pub_ack_inbox,
+                                      const std::string &subject,
+                                      Buffer::Instance &headers,
+                                      Buffer::Instance &payload,
+                                      PublishCallbacks &callbacks) PURE;
+
+  virtual void sendPubMsg(uint64_t pub_ack_inbox,
+                          const PubRequest &pub_request) PURE;
+
+  // The `CONNECT` sent on each connection.
+  virtual Message createConnectMessage() PURE;
+
+  // Replays the requests in flight, then publishes the queued ones.
+  void onHandshakeComplete();
+
+  // Closes the connection, to reconnect after a backoff.
+  void disconnect(const std::string &error);
+
+  // Publishes the queued requests which fit in the window after requests
+  // have completed.
+  void onPubRequestsDone();
+
+  void subInbox(const std::string &subject);
+
+  void subChildWildcardInbox(const std::string &parent_subject);
+
+  void sendNatsMessage(const Message &message);
+
+  TokenGeneratorImpl token_generator_;
+  PubRequestMap pub_request_per_inbox_;
+  absl::optional<std::string> cluster_id_{};
+  absl::optional<std::string> discover_prefix_{};
+
+  static const std::string INBOX_PREFIX;
+
+private:
+  // A client is `Disconnected` after losing its connection, until the backoff
+  // timer starts connecting again.
+  enum class State { NotConnected, Connecting, Connected, Disconnected };
+
+  struct PendingRequest {
+    std::string subject;
+    Buffer::InstancePtr headers;
+    Buffer::InstancePtr payload;
+    PublishCallbacks *callbacks;
+  };
+
+  struct MsgWaitingForPayload {
+    std::string subject;
+    absl::optional<std::string> reply_to;
+    uint64_t header_size;
+  };
+
+  class PublishRequestCanceler : public PublishRequest {
+  public:
+    PublishRequestCanceler(ClientBase &parent, uint64_t pub_ack_inbox);
+
+    // Nats::Streaming::PublishRequest
+    void cancel();
+
+  private:
+    ClientBase &parent_;
+    const uint64_t pub_ack_inbox_;
+  };
+
+  class WindowWatcher : public WindowWatch {
+  public:
+    WindowWatcher(ClientBase &parent, WindowCallbacks &callbacks);
+    ~WindowWatcher();
+
+    // Nats::Streaming::WindowWatch
+    void cancel() override;
+
+  private:
+    friend class ClientBase;
+
+    ClientBase &parent_;
+    WindowCallbacks &callbacks_;
+    std::list<WindowWatcher *>::iterator position_;
+    bool watching_{true};
+  };
+
+  inline void onOperation(Nats::MessagePtr &&value);
+
+  inline void onPayload(Nats::MessagePtr &&value);
+
+  // Handles both `MSG` and `HMSG`, which has the size of its headers before
+  // the total size.
+  inline void onMsg(std::vector<absl::string_view> &&tokens, bool has_headers);
+
+  inline void onPing();
+
+  void onTimeouts(const std::vector<uint64_t> &pub_ack_inboxes);
+
+  // Sends `CONNECT` and arms the connect timer.
+  void startConnecting();
+
+  void onDisconnected();
+
+  // Publishes the requests which were in flight when the connection was lost,
+  // oldest first.
+  void replayPubRequests();
+
+  inline void enqueuePendingRequest(const std::string &subject,
+                                    Buffer::Instance &headers,
+                                    Buffer::Instance &payload,
+                                    PublishCallbacks &callbacks,
+                                    uint64_t pub_ack_inbox);
+
+  inline void pubPubMsg(const std::string &subject, Buffer::Instance &headers,
+                        Buffer::Instance &payload, PublishCallbacks &callbacks,
+                        uint64_t pub_ack_inbox);
+
+  inline bool hasRoomInWindow() const {
+    return max_inflight_ == 0 || pub_request_per_inbox_.size() < max_inflight_;
+  }
+
+  inline bool isQueueFull() const {
+    return max_pending_ != 0 &&
+           pending_request_per_inbox_.size() >= max_pending_;
+  }
+
+  // Publishes the queued requests that fit in the window, oldest first, and
+  // notifies the window watchers once the queue is empty.
+  void publishPendingRequests();
+
+  void updateGauges();
+
+  inline void pong();
+
+  Tcp::ConnPoolNats::InstancePtr<Message> conn_pool_;
+  const std::chrono::milliseconds op_timeout_;
+  TimeoutWheel pub_ack_timeouts_;
+  const Event::TimerPtr connect_timer_;
+  const Event::TimerPtr reconnect_timer_;
+  const BackOffStrategyPtr reconnect_backoff_;
+  const uint32_t max_inflight_;
+  const uint32_t max_pending_;
+  ClientStats stats_;
+  State state_{};
+  // Keyed by the number of the ack inbox. The numbers are increasing, so the
+  // ordered map of pending requests is also their queue.
+  absl::btree_map<uint64_t, PendingRequest> pending_request_per_inbox_;
+  std::list<WindowWatcher *> window_watchers_;
+  // The sizes last added to the gauges, which are shared by the clients of all
+  // workers.
+  uint64_t reported_in_flight_{};
+  uint64_t reported_queued_{};
+  uint64_t next_pub_ack_inbox_{};
+  uint64_t sid_;
+  absl::optional<MsgWaitingForPayload> msg_waiting_for_payload_{};
+};
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
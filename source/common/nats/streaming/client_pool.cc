@@ -1,6 +1,8 @@
 #include "source/common/nats/streaming/client_pool.h"
 
+#include "source/common/common/hash.h"
 #include "source/common/nats/codec_impl.h"
+#include "source/common/nats/jetstream/client_impl.h"
 #include "source/common/nats/streaming/client_impl.h"
 #include "source/common/tcp/conn_pool_impl.h"
 
@@ -11,36 +13,106 @@ namespace Streaming {
 ClientPool::ClientPool(
     const std::string &cluster_name, Upstream::ClusterManager &cm,
     Tcp::ConnPoolNats::ClientFactory<Message> &client_factory,
-    ThreadLocal::SlotAllocator &tls, Random::RandomGenerator &random,
-    const std::chrono::milliseconds &op_timeout)
-    : cm_(cm), client_factory_(client_factory), slot_(tls.allocateSlot()),
-      random_(random), op_timeout_(op_timeout) {
-  slot_->set([this, cluster_name](Event::Dispatcher &dispatcher)
+    ThreadLocal::SlotAllocator &tls, Event::Dispatcher &main_dispatcher,
+    Random::RandomGenerator &random,
+    const std::chrono::milliseconds &op_timeout, Protocol protocol,
+    uint32_t max_connections, ConnectionSelection connection_selection,
+    uint32_t max_inflight, uint32_t max_pending,
+    const std::string &prewarm_cluster_id,
+    const std::string &prewarm_discover_prefix, const ClientStats &stats)
+    : cluster_name_(cluster_name), cm_(cm), client_factory_(client_factory),
+      slot_(tls.allocateSlot()), main_dispatcher_(main_dispatcher),
+      random_(random), op_timeout_(op_timeout), protocol_(protocol),
+      max_connections_(max_connections),
+      connection_selection_(connection_selection), max_inflight_(max_inflight),
+      max_pending_(max_pending), prewarm_cluster_id_(prewarm_cluster_id),
+      prewarm_discover_prefix_(prewarm_discover_prefix), stats_(stats) {
+  ASSERT(max_connections_ > 0);
+  slot_->set([this](Event::Dispatcher &dispatcher)
                  -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    Tcp::ConnPoolNats::InstancePtr<Message> conn_pool(
-        new Tcp::ConnPoolNats::InstanceImpl<Message, DecoderImpl>(
-            cluster_name, cm_, client_factory_, dispatcher));
-    return std::make_shared<ThreadLocalPool>(std::move(conn_pool), random_,
-                                             dispatcher, op_timeout_);
+    // The main thread publishes no requests, so only the clients of the
+    // workers connect ahead of the first request.
+    const bool worker = &dispatcher != &main_dispatcher_;
+
+    // Each client has a connection pool of its own, hence a connection, a
+    // client ID and inboxes of its own.
+    std::vector<std::unique_ptr<ClientBase>> clients;
+    clients.reserve(max_connections_);
+    for (uint32_t i = 0; i < max_connections_; ++i) {
+      Tcp::ConnPoolNats::InstancePtr<Message> conn_pool(
+          new Tcp::ConnPoolNats::InstanceImpl<Message, DecoderImpl>(
+              cluster_name_, cm_, client_factory_, dispatcher));
+      switch (protocol_) {
+      case Protocol::NatsStreaming:
+        clients.push_back(std::make_unique<ClientImpl>(
+            std::move(conn_pool), random_, dispatcher, op_timeout_,
+            max_inflight_, max_pending_, stats_));
+        break;
+      case Protocol::JetStream:
+        clients.push_back(std::make_unique<JetStream::ClientImpl>(
+            std::move(conn_pool), random_, dispatcher, op_timeout_,
+            max_inflight_, max_pending_, stats_));
+        break;
+      }
+      // A JetStream client needs no cluster ID or discover prefix, so it can
+      // always connect ahead of the first request.
+      if (worker && (protocol_ == Protocol::JetStream ||
+                     !prewarm_cluster_id_.empty())) {
+        clients.back()->connect(prewarm_cluster_id_, prewarm_discover_prefix_);
+      }
+    }
+    return std::make_shared<ThreadLocalPool>(std::move(clients),
+                                             connection_selection_);
   });
 }
 
+Client &ClientPool::selectClient(const std::string &subject) {
+  return slot_->getTyped<ThreadLocalPool>().getClient(subject);
+}
+
 PublishRequestPtr ClientPool::makeRequest(const std::string &subject,
                                           const std::string &cluster_id,
                                           const std::string &discover_prefix,
-                                          std::string &&payload,
+                                          Buffer::Instance &headers,
+                                          Buffer::Instance &payload,
                                           PublishCallbacks &callbacks) {
-  return slot_->getTyped<ThreadLocalPool>().getClient().makeRequest(
-      subject, cluster_id, discover_prefix, std::move(payload), callbacks);
+  return selectClient(subject).makeRequest(subject, cluster_id, discover_prefix,
+                                           headers, payload, callbacks);
+}
+
+WindowWatchPtr ClientPool::watchWindow(const std::string &subject,
+                                       WindowCallbacks &callbacks) {
+  return slot_->getTyped<ThreadLocalPool>().peekClient(subject).watchWindow(
+      subject, callbacks);
 }
 
 ClientPool::ThreadLocalPool::ThreadLocalPool(
-    Tcp::ConnPoolNats::InstancePtr<Message> &&conn_pool,
-    Random::RandomGenerator &random, Event::Dispatcher &dispatcher,
-    const std::chrono::milliseconds &op_timeout)
-    : client_(std::move(conn_pool), random, dispatcher, op_timeout) {}
+    std::vector<std::unique_ptr<ClientBase>> &&clients,
+    ConnectionSelection connection_selection)
+    : clients_(std::move(clients)),
+      connection_selection_(connection_selection) {}
 
-Client &ClientPool::ThreadLocalPool::getClient() { return client_; }
+Client &ClientPool::ThreadLocalPool::getClient(const std::string &subject) {
+  Client &client = peekClient(subject);
+  if (connection_selection_ == ConnectionSelection::RoundRobin) {
+    next_client_ = (next_client_ + 1) % clients_.size();
+  }
+  return client;
+}
+
+Client &ClientPool::ThreadLocalPool::peekClient(const std::string &subject) {
+  if (clients_.size() == 1) {
+    return *clients_[0];
+  }
+
+  switch (connection_selection_) {
+  case ConnectionSelection::RoundRobin:
+    return *clients_[next_client_];
+  case ConnectionSelection::SubjectHash:
+    return *clients_[HashUtil::xxHash64(subject) % clients_.size()];
+  }
+  PANIC_DUE_TO_CORRUPT_ENUM
+}
 
 } // namespace Streaming
 } // namespace Nats
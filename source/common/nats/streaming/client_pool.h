@@ -1,48 +1,91 @@
 #pragma once
 
+#include <vector>
+
 #include "include/envoy/nats/codec.h"
 #include "include/envoy/nats/streaming/client.h"
 #include "include/envoy/tcp/conn_pool_nats.h"
 #include "envoy/thread_local/thread_local.h"
 #include "envoy/upstream/cluster_manager.h"
 
-#include "source/common/nats/streaming/client_impl.h"
+#include "source/common/nats/streaming/client_base.h"
 
 namespace Envoy {
 namespace Nats {
 namespace Streaming {
 
+// How the requests of a worker are spread over its connections.
+enum class ConnectionSelection {
+  RoundRobin,
+  // Keeps the requests to each subject on a single connection, in order.
+  SubjectHash
+};
+
+// The protocol on top of NATS which requests are published with.
+enum class Protocol { NatsStreaming, JetStream };
+
 class ClientPool : public Client {
 public:
   ClientPool(const std::string &cluster_name, Upstream::ClusterManager &cm,
              Tcp::ConnPoolNats::ClientFactory<Message> &client_factory,
-             ThreadLocal::SlotAllocator &tls, Random::RandomGenerator &random,
-             const std::chrono::milliseconds &op_timeout);
+             ThreadLocal::SlotAllocator &tls, Event::Dispatcher &main_dispatcher,
+             Random::RandomGenerator &random,
+             const std::chrono::milliseconds &op_timeout, Protocol protocol,
+             uint32_t max_connections, ConnectionSelection connection_selection,
+             uint32_t max_inflight, uint32_t max_pending,
+             const std::string &prewarm_cluster_id,
+             const std::string &prewarm_discover_prefix,
+             const ClientStats &stats);
 
   // Nats::Streaming::Client
+  Client &selectClient(const std::string &subject) override;
   PublishRequestPtr makeRequest(const std::string &subject,
                                 const std::string &cluster_id,
                                 const std::string &discover_prefix,
-                                std::string &&payload,
+                                Buffer::Instance &headers,
+                                Buffer::Instance &payload,
                                 PublishCallbacks &callbacks) override;
+  WindowWatchPtr watchWindow(const std::string &subject,
+                             WindowCallbacks &callbacks) override;
 
 private:
   struct ThreadLocalPool : public ThreadLocal::ThreadLocalObject {
-    ThreadLocalPool(Tcp::ConnPoolNats::InstancePtr<Message> &&conn_pool,
-                    Random::RandomGenerator &random,
-                    Event::Dispatcher &dispatcher,
-                    const std::chrono::milliseconds &op_timeout);
-    Client &getClient();
+    ThreadLocalPool(std::vector<std::unique_ptr<ClientBase>> &&clients,
+                    ConnectionSelection connection_selection);
+
+    // Returns the client to publish a request to the subject on, and moves on
+    // to the next client when selecting round-robin.
+    Client &getClient(const std::string &subject);
+
+    // Returns the client which the next request to the subject would be
+    // published on.
+    Client &peekClient(const std::string &subject);
 
   private:
-    ClientImpl client_;
+    const std::vector<std::unique_ptr<ClientBase>> clients_;
+    const ConnectionSelection connection_selection_;
+    size_t next_client_{};
   };
 
+  const std::string cluster_name_;
   Upstream::ClusterManager &cm_;
   Tcp::ConnPoolNats::ClientFactory<Message> &client_factory_;
   ThreadLocal::SlotPtr slot_;
+  // Tells the clients of the main thread, which publishes no requests, from
+  // those of the workers.
+  Event::Dispatcher &main_dispatcher_;
   Random::RandomGenerator &random_;
   const std::chrono::milliseconds op_timeout_;
+  const Protocol protocol_;
+  const uint32_t max_connections_;
+  const ConnectionSelection connection_selection_;
+  const uint32_t max_inflight_;
+  const uint32_t max_pending_;
+  // Unless empty, each client of a worker connects as soon as it is created.
+  // The JetStream clients of a worker always do.
+  const std::string prewarm_cluster_id_;
+  const std::string prewarm_discover_prefix_;
+  const ClientStats stats_;
 };
 
 } // namespace Streaming
@@ -8,9 +8,9 @@ namespace Envoy {
 namespace Nats {
 namespace Streaming {
 
-void ConnectResponseHandler::onMessage(absl::optional<std::string> &reply_to,
-                                       const std::string &payload,
-                                       Callbacks &callbacks) {
+void ConnectResponseHandler::onMessage(
+    const absl::optional<std::string> &reply_to, const std::string &payload,
+    Callbacks &callbacks) {
   if (reply_to.has_value()) {
     callbacks.onFailure(
         "incoming ConnectResponse with non-empty reply subject");
@@ -19,7 +19,7 @@ public:
     virtual void onConnected(const std::string &pub_prefix) PURE;
   };
 
-  static void onMessage(absl::optional<std::string> &reply_to,
+  static void onMessage(const absl::optional<std::string> &reply_to,
                         const std::string &payload, Callbacks &callbacks);
 };
 
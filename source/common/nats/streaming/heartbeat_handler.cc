@@ -8,7 +8,7 @@ namespace Envoy {
 namespace Nats {
 namespace Streaming {
 
-void HeartbeatHandler::onMessage(absl::optional<std::string> &reply_to,
+void HeartbeatHandler::onMessage(const absl::optional<std::string> &reply_to,
                                  const std::string &payload,
                                  Callbacks &callbacks) {
   if (!reply_to.has_value()) {
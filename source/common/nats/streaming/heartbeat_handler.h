@@ -22,7 +22,7 @@ public:
 
   // TODO(talnordan): For this handler, the payload is always empty. In the
   // genral case, use a NATS streaming message type instead of a raw payload.
-  static void onMessage(absl::optional<std::string> &reply_to,
+  static void onMessage(const absl::optional<std::string> &reply_to,
                         const std::string &payload, Callbacks &callbacks);
 };
 
@@ -4,6 +4,10 @@ namespace Envoy {
 namespace Nats {
 namespace Streaming {
 
+namespace {
+constexpr uint64_t WIRETYPE_LENGTH_DELIMITED = 2;
+} // namespace
+
 std::string MessageUtility::createConnectRequestMessage(
     const std::string &client_id, const std::string &heartbeat_inbox) {
   pb::ConnectRequest connect_request;
@@ -38,6 +42,46 @@ std::string MessageUtility::createPubMsgMessage(const std::string &client_id,
   return serializeToString(pub_msg);
 }
 
+void MessageUtility::createPubMsgMessage(const std::string &client_id,
+                                         const std::string &guid,
+                                         const std::string &subject,
+                                         Buffer::Instance &data,
+                                         Buffer::Instance &out) {
+  pb::PubMsg pub_msg;
+  pub_msg.set_clientid(client_id);
+  pub_msg.set_guid(guid);
+  pub_msg.set_subject(subject);
+
+  out.add(serializeToString(pub_msg));
+  moveBytesField(pb::PubMsg::kDataFieldNumber, data, out);
+}
+
+void MessageUtility::moveBytesField(uint32_t field_number,
+                                    Buffer::Instance &value,
+                                    Buffer::Instance &out) {
+  if (value.length() == 0) {
+    return;
+  }
+
+  // The tag and the length of the field are varints, of 5 and 10 bytes at
+  // most.
+  uint8_t prefix[15];
+  size_t prefix_size = 0;
+  const auto add_varint = [&prefix, &prefix_size](uint64_t varint) {
+    while (varint >= 0x80) {
+      prefix[prefix_size++] = static_cast<uint8_t>(varint | 0x80);
+      varint >>= 7;
+    }
+    prefix[prefix_size++] = static_cast<uint8_t>(varint);
+  };
+  add_varint(static_cast<uint64_t>(field_number) << 3 |
+             WIRETYPE_LENGTH_DELIMITED);
+  add_varint(value.length());
+
+  out.add(prefix, prefix_size);
+  out.move(value);
+}
+
 std::string MessageUtility::createPubAckMessage(const std::string &guid,
                                                 const std::string &error) {
   pb::PubAck pub_ack;
@@ -3,6 +3,8 @@
 #include <string>
 #include <utility>
 
+#include "envoy/buffer/buffer.h"
+
 #include "absl/types/optional.h"
 #include "api/envoy/type/streaming/protocol.pb.h"
 
@@ -25,6 +27,23 @@ public:
                                          const std::string &subject,
                                          const std::string &data);
 
+  // Serializes a `PubMsg` to `out`, draining `data` into it without copying.
+  static void createPubMsgMessage(const std::string &client_id,
+                                  const std::string &guid,
+                                  const std::string &subject,
+                                  Buffer::Instance &data,
+                                  Buffer::Instance &out);
+
+  /**
+   * Appends a bytes field to a serialized message, draining its value from
+   * `value` without copying it. As in proto3, an empty value is omitted.
+   * @param field_number supplies the number of the field.
+   * @param value supplies the value of the field.
+   * @param out supplies the serialized message to append to.
+   */
+  static void moveBytesField(uint32_t field_number, Buffer::Instance &value,
+                             Buffer::Instance &out);
+
   static std::string createPubAckMessage(const std::string &guid,
                                          const std::string &error);
 
@@ -29,10 +29,11 @@ void PubRequestHandler::onMessage(const absl::optional<std::string> &reply_to,
   }
 }
 
-void PubRequestHandler::onMessage(
-    const std::string &inbox, const absl::optional<std::string> &reply_to,
-    const std::string &payload, InboxCallbacks &inbox_callbacks,
-    std::map<std::string, PubRequest> &request_per_inbox) {
+void PubRequestHandler::onMessage(uint64_t inbox,
+                                  const absl::optional<std::string> &reply_to,
+                                  const std::string &payload,
+                                  InboxCallbacks &inbox_callbacks,
+                                  PubRequestMap &request_per_inbox) {
   // Find the inbox in the map.
   auto it = request_per_inbox.find(inbox);
 
@@ -51,9 +52,8 @@ void PubRequestHandler::onMessage(
   eraseRequest(request_per_inbox, it);
 }
 
-void PubRequestHandler::onTimeout(
-    const std::string &inbox,
-    std::map<std::string, PubRequest> &request_per_inbox) {
+void PubRequestHandler::onTimeout(uint64_t inbox,
+                                  PubRequestMap &request_per_inbox) {
   // Find the inbox in the map.
   auto it = request_per_inbox.find(inbox);
 
@@ -70,9 +70,8 @@ void PubRequestHandler::onTimeout(
   eraseRequest(request_per_inbox, it);
 }
 
-void PubRequestHandler::onCancel(
-    const std::string &inbox,
-    std::map<std::string, PubRequest> &request_per_inbox) {
+void PubRequestHandler::onCancel(uint64_t inbox,
+                                 PubRequestMap &request_per_inbox) {
   // Find the inbox in the map.
   auto it = request_per_inbox.find(inbox);
 
@@ -85,11 +84,8 @@ void PubRequestHandler::onCancel(
   eraseRequest(request_per_inbox, it);
 }
 
-void PubRequestHandler::eraseRequest(
-    std::map<std::string, PubRequest> &request_per_inbox,
-    std::map<std::string, PubRequest>::iterator position) {
-  PubRequest &request = position->second;
-  request.onDestroy();
+void PubRequestHandler::eraseRequest(PubRequestMap &request_per_inbox,
+                                     PubRequestMap::iterator position) {
   request_per_inbox.erase(position);
 }
 
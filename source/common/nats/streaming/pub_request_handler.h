@@ -1,12 +1,12 @@
 #pragma once
 
-#include <map>
 #include <string>
 
-#include "envoy/event/timer.h"
+#include "include/envoy/nats/codec.h"
 #include "include/envoy/nats/streaming/client.h"
 #include "include/envoy/nats/streaming/inbox_handler.h"
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/types/optional.h"
 
 namespace Envoy {
@@ -16,21 +16,33 @@ namespace Streaming {
 // TODO(talnordan): Consider moving to `include/envoy`.
 class PubRequest {
 public:
-  PubRequest(PublishCallbacks *callbacks, Event::TimerPtr timeout_timer)
-      : callbacks_(callbacks), timeout_timer_(std::move(timeout_timer)) {}
+  PubRequest(PublishCallbacks *callbacks, const std::string &subject,
+             PayloadSharedPtr pub_msg, uint64_t header_size = 0)
+      : callbacks_(callbacks), subject_(subject), pub_msg_(std::move(pub_msg)),
+        header_size_(header_size) {}
 
   PublishCallbacks &callbacks() { return *callbacks_; }
 
-  void onDestroy() {
-    timeout_timer_->disableTimer();
-    timeout_timer_ = nullptr;
-  }
+  const std::string &subject() const { return subject_; }
+
+  // The serialized message, such as a `PubMsg`, kept until the request
+  // completes so that it can be published again after a reconnect.
+  const PayloadSharedPtr &pubMsg() const { return pub_msg_; }
+
+  // The size of the headers at the start of the message, which is published
+  // with `HPUB` unless 0.
+  uint64_t headerSize() const { return header_size_; }
 
 private:
   PublishCallbacks *callbacks_;
-  Event::TimerPtr timeout_timer_;
+  std::string subject_;
+  PayloadSharedPtr pub_msg_;
+  uint64_t header_size_;
 };
 
+// Publish requests, keyed by the number of their ack inbox.
+typedef absl::flat_hash_map<uint64_t, PubRequest> PubRequestMap;
+
 class PubRequestHandler {
 public:
   static void onMessage(const absl::optional<std::string> &reply_to,
@@ -38,22 +50,19 @@ public:
                         InboxCallbacks &inbox_callbacks,
                         PublishCallbacks &publish_callbacks);
 
-  static void onMessage(const std::string &inbox,
+  static void onMessage(uint64_t inbox,
                         const absl::optional<std::string> &reply_to,
                         const std::string &payload,
                         InboxCallbacks &inbox_callbacks,
-                        std::map<std::string, PubRequest> &request_per_inbox);
+                        PubRequestMap &request_per_inbox);
 
-  static void onTimeout(const std::string &inbox,
-                        std::map<std::string, PubRequest> &request_per_inbox);
+  static void onTimeout(uint64_t inbox, PubRequestMap &request_per_inbox);
 
-  static void onCancel(const std::string &inbox,
-                       std::map<std::string, PubRequest> &request_per_inbox);
+  static void onCancel(uint64_t inbox, PubRequestMap &request_per_inbox);
 
 private:
-  static inline void
-  eraseRequest(std::map<std::string, PubRequest> &request_per_inbox,
-               std::map<std::string, PubRequest>::iterator position);
+  static inline void eraseRequest(PubRequestMap &request_per_inbox,
+                                  PubRequestMap::iterator position);
 };
 
 } // namespace Streaming
@@ -0,0 +1,57 @@
+#include "source/common/nats/streaming/timeout_wheel.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+namespace {
+
+std::chrono::milliseconds tickOf(const std::chrono::milliseconds &timeout) {
+  // Rounded up, so that no id expires before the timeout.
+  const int64_t ticks = TimeoutWheel::TICKS_PER_TIMEOUT;
+  return std::chrono::milliseconds(
+      std::max<int64_t>(1, (timeout.count() + ticks - 1) / ticks));
+}
+
+} // namespace
+
+TimeoutWheel::TimeoutWheel(Event::Dispatcher &dispatcher,
+                           const std::chrono::milliseconds &timeout,
+                           ExpiryCb expiry_cb)
+    : tick_(tickOf(timeout)), expiry_cb_(std::move(expiry_cb)),
+      timer_(dispatcher.createTimer([this]() -> void { onTick(); })) {}
+
+void TimeoutWheel::add(uint64_t id) {
+  slots_[current_slot_].push_back(id);
+  if (size_++ == 0) {
+    timer_->enableTimer(tick_);
+  }
+}
+
+void TimeoutWheel::onTick() {
+  current_slot_ = (current_slot_ + 1) % slots_.size();
+
+  std::vector<uint64_t> expired;
+  expired.swap(slots_[current_slot_]);
+  size_ -= expired.size();
+  if (!expired.empty()) {
+    expiry_cb_(expired);
+  }
+
+  // Reuse the capacity of the expired slot, unless the callback has added ids
+  // to it.
+  if (slots_[current_slot_].empty()) {
+    expired.clear();
+    slots_[current_slot_].swap(expired);
+  }
+
+  if (size_ > 0 && !timer_->enabled()) {
+    timer_->enableTimer(tick_);
+  }
+}
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+/**
+ * A hashed timer wheel for timeouts of a single duration, such as the ack
+ * timeouts of the publish requests of a client. While ids are pending, a
+ * single timer ticks `TICKS_PER_TIMEOUT` times per timeout, and each tick
+ * expires the ids added one rotation earlier in a single batch.
+ *
+ * Ids are never removed: the expiry callback is expected to ignore the ids
+ * which have been completed or cancelled in the meantime.
+ */
+class TimeoutWheel {
+public:
+  typedef std::function<void(const std::vector<uint64_t> &ids)> ExpiryCb;
+
+  TimeoutWheel(Event::Dispatcher &dispatcher,
+               const std::chrono::milliseconds &timeout, ExpiryCb expiry_cb);
+
+  /**
+   * Adds an id, which expires no sooner than the timeout and no later than a
+   * tick after it.
+   */
+  void add(uint64_t id);
+
+  const std::chrono::milliseconds &tick() const { return tick_; }
+
+  static constexpr uint32_t TICKS_PER_TIMEOUT = 8;
+
+private:
+  void onTick();
+
+  const std::chrono::milliseconds tick_;
+  const ExpiryCb expiry_cb_;
+  const Event::TimerPtr timer_;
+  // The ids added during a tick go to the current slot, which expires once the
+  // wheel has come back to it.
+  std::array<std::vector<uint64_t>, TICKS_PER_TIMEOUT + 1> slots_;
+  size_t current_slot_{};
+  size_t size_{};
+};
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
@@ -4,6 +4,11 @@
 
 #include "include/envoy/nats/token_generator.h"
 
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
 #include "fmt/format.h"
 
 namespace Envoy {
@@ -25,6 +30,27 @@ public:
     return join(parent, token_generator.random());
   }
 
+  static inline std::string numericChild(const std::string &parent,
+                                         uint64_t number) {
+    return absl::StrCat(parent, ".", number);
+  }
+
+  // The inverse of `numericChild()`, without copying the subject.
+  static inline absl::optional<uint64_t>
+  parseNumericChild(absl::string_view parent, absl::string_view subject) {
+    if (subject.size() <= parent.size() + 1 ||
+        !absl::StartsWith(subject, parent) || subject[parent.size()] != '.') {
+      return {};
+    }
+    const absl::string_view suffix = subject.substr(parent.size() + 1);
+    uint64_t number;
+    if (!absl::ascii_isdigit(suffix.front()) ||
+        !absl::SimpleAtoi(suffix, &number)) {
+      return {};
+    }
+    return number;
+  }
+
   static inline std::string childWildcard(const std::string &parent) {
     return join(parent, "*");
   }
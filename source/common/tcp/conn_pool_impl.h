@@ -23,6 +23,7 @@ namespace ConnPoolNats {
 class ConfigImpl : public Config {
 public:
   bool disableOutlierEvents() const override { return false; }
+  uint32_t maxBufferSizeBeforeFlush() const override { return 64 * 1024; }
 };
 
 template <typename T>
@@ -36,6 +37,8 @@ public:
          PoolCallbacks<T> &callbacks, const Config &config) {
     std::unique_ptr<ClientImpl> client(new ClientImpl(
         host, std::move(encoder), decoder_factory, callbacks, config));
+    client->flush_callback_ = dispatcher.createSchedulableCallback(
+        [client_ptr = client.get()]() { client_ptr->flush(); });
     client->connection_ =
         host->createConnection(dispatcher, nullptr, nullptr).connection_;
     client->connection_->addConnectionCallbacks(*client);
@@ -65,7 +68,13 @@ public:
 
     incRequestStats();
     encoder_->encode(request, encoder_buffer_);
-    connection_->write(encoder_buffer_, false);
+    // Requests are coalesced into a single write per dispatcher iteration,
+    // unless enough of them are buffered already.
+    if (encoder_buffer_.length() >= config_.maxBufferSizeBeforeFlush()) {
+      flush();
+    } else if (!flush_callback_->enabled()) {
+      flush_callback_->scheduleCallbackCurrentIteration();
+    }
   }
   void cancel() override {
     // If we get a cancellation, we just mark all pending request as canceled,
@@ -110,6 +119,18 @@ private:
     host->stats().cx_total_.inc();
     host->stats().cx_active_.inc();
   }
+  void flush() {
+    flush_callback_->cancel();
+    if (encoder_buffer_.length() == 0) {
+      return;
+    }
+    if (connection_->state() != Network::Connection::State::Open) {
+      // The requests are lost along with the connection.
+      encoder_buffer_.drain(encoder_buffer_.length());
+      return;
+    }
+    connection_->write(encoder_buffer_, false);
+  }
   void onData(Buffer::Instance &data) {
     try {
       decoder_->decode(data);
@@ -186,6 +207,7 @@ private:
   Network::ClientConnectionPtr connection_;
   EncoderPtr<T> encoder_;
   Buffer::OwnedImpl encoder_buffer_;
+  Event::SchedulableCallbackPtr flush_callback_;
   DecoderPtr decoder_;
   PoolCallbacks<T> &callbacks_;
   const Config &config_;
@@ -236,6 +258,7 @@ public:
   void makeRequest(const std::string &hash_key, const T &request) override {
     thread_local_pool_->makeRequest(hash_key, request);
   }
+  void close() override { thread_local_pool_->close(); }
 
 private:
   struct ThreadLocalPool;
@@ -303,6 +326,11 @@ private:
 
       client->client_->makeRequest(request);
     }
+    void close() {
+      if (maybe_client_) {
+        maybe_client_->client_->close();
+      }
+    }
 
     InstanceImpl &parent_;
     Event::Dispatcher &dispatcher_;
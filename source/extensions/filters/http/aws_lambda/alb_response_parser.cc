@@ -0,0 +1,458 @@
+#include "source/extensions/filters/http/aws_lambda/alb_response_parser.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "source/common/buffer/buffer_utility.h"
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+
+namespace {
+
+// Nesting limit of the skipped fields
+constexpr int MaxDepth = 64;
+// Longest number accepted as the status code
+constexpr size_t MaxNumberLength = 32;
+
+// Reads the slices of a buffer in place.
+class Cursor {
+public:
+  explicit Cursor(const Buffer::Instance &buffer)
+      : slices_(buffer.getRawSlices()) {
+    skipEmptySlices();
+  }
+
+  bool done() const { return slice_ == slices_.size(); }
+  // The current byte, the cursor must not be done.
+  char peek() const { return data()[pos_]; }
+  // The rest of the current slice, never empty unless the cursor is done.
+  absl::string_view rest() const {
+    return {data() + pos_, slices_[slice_].len_ - pos_};
+  }
+  // Moves forward by at most rest().size() bytes.
+  void advance(size_t count = 1) {
+    pos_ += count;
+    if (pos_ == slices_[slice_].len_) {
+      slice_++;
+      pos_ = 0;
+      skipEmptySlices();
+    }
+  }
+
+  // @return false if only whitespace is left
+  bool skipWhitespace() {
+    while (!done()) {
+      const char c = peek();
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+        return true;
+      }
+      advance();
+    }
+    return false;
+  }
+
+  // Consumes `expected` if it is the next byte, after whitespace if allowed.
+  bool consume(char expected, bool skip_whitespace = true) {
+    if ((skip_whitespace ? !skipWhitespace() : done()) ||
+        peek() != expected) {
+      return false;
+    }
+    advance();
+    return true;
+  }
+
+private:
+  const char *data() const {
+    return static_cast<const char *>(slices_[slice_].mem_);
+  }
+  void skipEmptySlices() {
+    while (slice_ < slices_.size() && slices_[slice_].len_ == 0) {
+      slice_++;
+    }
+  }
+
+  const Buffer::RawSliceVector slices_;
+  size_t slice_{};
+  size_t pos_{};
+};
+
+void appendUtf8(uint32_t code, std::string &out) {
+  if (code < 0x80) {
+    out.push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  } else if (code < 0x10000) {
+    out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  } else {
+    out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  }
+}
+
+class Parser {
+public:
+  explicit Parser(const Buffer::Instance &json) : cursor_(json) {}
+
+  bool parse(Http::ResponseHeaderMap &headers, Buffer::Instance &body) {
+    bool has_body{};
+    bool is_base64_encoded{};
+    bool invalid_base64_field{};
+    std::string raw_body;
+
+    const bool valid = parseObject([&](const std::string &key) {
+      if (key == "body") {
+        // Like a protobuf Struct, a body that is not a string is empty
+        has_body = true;
+        raw_body.clear();
+        return isNext('"') ? parseString(&raw_body) : skipValue(0);
+      }
+      if (key == "isBase64Encoded") {
+        invalid_base64_field = false;
+        if (isNext('t')) {
+          is_base64_encoded = true;
+          return parseLiteral("true");
+        }
+        if (isNext('f')) {
+          is_base64_encoded = false;
+          return parseLiteral("false");
+        }
+        invalid_base64_field = true;
+        return skipValue(0);
+      }
+      if (key == "statusCode") {
+        return parseStatus();
+      }
+      if (key == "headers") {
+        return isNext('{') ? parseHeaders() : skipValue(0);
+      }
+      // While ALB would refuse to parse something with headers + multivalue
+      // Being more permissive in this case was determined to be better.
+      if (key == "multiValueHeaders") {
+        return isNext('{') ? parseMultiValueHeaders() : skipValue(0);
+      }
+      return skipValue(0);
+    });
+    // Nothing but whitespace may follow the object
+    if (!valid || cursor_.skipWhitespace()) {
+      return false;
+    }
+
+    if (has_body && invalid_base64_field) {
+      return false;
+    }
+
+    // The payload is valid, so its status and headers can be applied
+    if (status_.has_value()) {
+      headers.setStatus(status_.value());
+    }
+    for (auto &header : headers_) {
+      headers.addCopy(header.first, header.second);
+    }
+    if (!has_body) {
+      return true;
+    }
+    if (is_base64_encoded) {
+      // invalid base64 leaves the body empty
+      Buffer::BufferUtility::base64DecodeToBuffer(raw_body, body);
+    } else {
+      Buffer::BufferUtility::moveStringToBuffer(std::move(raw_body), body);
+    }
+    return true;
+  }
+
+private:
+  bool isNext(char c) { return cursor_.skipWhitespace() && cursor_.peek() == c; }
+
+  // Calls on_member(key) with the cursor on the value of each member.
+  template <typename MemberCallback>
+  bool parseObject(MemberCallback on_member) {
+    if (!cursor_.consume('{')) {
+      return false;
+    }
+    std::string key;
+    while (cursor_.skipWhitespace()) {
+      // A trailing comma is accepted, as protobuf's json parser does
+      if (cursor_.peek() == '}') {
+        cursor_.advance();
+        return true;
+      }
+      key.clear();
+      if (cursor_.peek() != '"' || !parseString(&key) ||
+          !cursor_.consume(':') || !on_member(key) ||
+          !cursor_.skipWhitespace()) {
+        return false;
+      }
+      if (cursor_.peek() != '}' && !cursor_.consume(',', false)) {
+        return false;
+      }
+    }
+    return false;
+  }
+
+  // Calls on_element() with the cursor on each element.
+  template <typename ElementCallback>
+  bool parseArray(ElementCallback on_element) {
+    if (!cursor_.consume('[')) {
+      return false;
+    }
+    while (cursor_.skipWhitespace()) {
+      if (cursor_.peek() == ']') {
+        cursor_.advance();
+        return true;
+      }
+      if (!on_element() || !cursor_.skipWhitespace()) {
+        return false;
+      }
+      if (cursor_.peek() != ']' && !cursor_.consume(',', false)) {
+        return false;
+      }
+    }
+    return false;
+  }
+
+  // Parses a string, appending its unescaped value to `out` unless null.
+  bool parseString(std::string *out) {
+    if (!cursor_.consume('"')) {
+      return false;
+    }
+    while (!cursor_.done()) {
+      // Copy the run of plain bytes at once
+      const absl::string_view rest = cursor_.rest();
+      size_t run = 0;
+      while (run < rest.size() && rest[run] != '"' && rest[run] != '\\' &&
+             static_cast<uint8_t>(rest[run]) >= 0x20) {
+        run++;
+      }
+      if (out != nullptr) {
+        out->append(rest.data(), run);
+      }
+      if (run == rest.size()) {
+        cursor_.advance(run);
+        continue;
+      }
+
+      const char c = rest[run];
+      cursor_.advance(run + 1);
+      if (c == '"') {
+        return true;
+      }
+      // Control characters must be escaped
+      if (c != '\\' || cursor_.done()) {
+        return false;
+      }
+      const char escape = cursor_.peek();
+      cursor_.advance();
+      char unescaped;
+      switch (escape) {
+      case '"':
+      case '\\':
+      case '/':
+        unescaped = escape;
+        break;
+      case 'b':
+        unescaped = '\b';
+        break;
+      case 'f':
+        unescaped = '\f';
+        break;
+      case 'n':
+        unescaped = '\n';
+        break;
+      case 'r':
+        unescaped = '\r';
+        break;
+      case 't':
+        unescaped = '\t';
+        break;
+      case 'u': {
+        uint32_t code;
+        if (!parseCodePoint(code)) {
+          return false;
+        }
+        if (out != nullptr) {
+          appendUtf8(code, *out);
+        }
+        continue;
+      }
+      default:
+        return false;
+      }
+      if (out != nullptr) {
+        out->push_back(unescaped);
+      }
+    }
+    return false;
+  }
+
+  // Parses the digits of a \u escape, and the low surrogate that must follow
+  // a high one.
+  bool parseCodePoint(uint32_t &code) {
+    if (!parseHex4(code) || (code >= 0xdc00 && code < 0xe000)) {
+      return false;
+    }
+    if (code < 0xd800 || code >= 0xdc00) {
+      return true;
+    }
+    uint32_t low;
+    if (!cursor_.consume('\\', false) || !cursor_.consume('u', false) ||
+        !parseHex4(low) || low < 0xdc00 || low >= 0xe000) {
+      return false;
+    }
+    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+    return true;
+  }
+
+  bool parseHex4(uint32_t &value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+      if (cursor_.done()) {
+        return false;
+      }
+      const char c = cursor_.peek();
+      uint32_t digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      value = (value << 4) | digit;
+      cursor_.advance();
+    }
+    return true;
+  }
+
+  bool parseLiteral(absl::string_view literal) {
+    for (const char c : literal) {
+      if (!cursor_.consume(c, false)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool parseNumber(double &value) {
+    if (!cursor_.skipWhitespace()) {
+      return false;
+    }
+    char number[MaxNumberLength];
+    size_t length = 0;
+    while (!cursor_.done()) {
+      const char c = cursor_.peek();
+      if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+            c == 'e' || c == 'E')) {
+        break;
+      }
+      if (length == MaxNumberLength) {
+        return false;
+      }
+      number[length++] = c;
+      cursor_.advance();
+    }
+    return length > 0 &&
+           absl::SimpleAtod(absl::string_view(number, length), &value);
+  }
+
+  bool parseStatus() {
+    double status;
+    if (!parseNumber(status) || status < 0 || status >= 1000) {
+      return false;
+    }
+    status_ = static_cast<uint64_t>(status);
+    return true;
+  }
+
+  // A header value that is not a string is added empty, as the protobuf
+  // Struct the payload used to be parsed into did.
+  bool parseHeaderValue(std::string &value) {
+    value.clear();
+    return isNext('"') ? parseString(&value) : skipValue(0);
+  }
+
+  bool parseHeaders() {
+    std::string value;
+    return parseObject([this, &value](const std::string &key) {
+      if (!parseHeaderValue(value)) {
+        return false;
+      }
+      headers_.emplace_back(Http::LowerCaseString(key), value);
+      return true;
+    });
+  }
+
+  bool parseMultiValueHeaders() {
+    std::string value;
+    return parseObject([this, &value](const std::string &key) {
+      if (!isNext('[')) {
+        return skipValue(0);
+      }
+      const Http::LowerCaseString name(key);
+      return parseArray([this, &value, &name]() {
+        if (!parseHeaderValue(value)) {
+          return false;
+        }
+        headers_.emplace_back(name, value);
+        return true;
+      });
+    });
+  }
+
+  bool skipValue(int depth) {
+    if (depth > MaxDepth || !cursor_.skipWhitespace()) {
+      return false;
+    }
+    switch (cursor_.peek()) {
+    case '"':
+      return parseString(nullptr);
+    case '{':
+      return parseObject(
+          [this, depth](const std::string &) { return skipValue(depth + 1); });
+    case '[':
+      return parseArray([this, depth]() { return skipValue(depth + 1); });
+    case 't':
+      return parseLiteral("true");
+    case 'f':
+      return parseLiteral("false");
+    case 'n':
+      return parseLiteral("null");
+    default: {
+      double number;
+      return parseNumber(number);
+    }
+    }
+  }
+
+  Cursor cursor_;
+  // Staged until the whole payload has been validated
+  absl::optional<uint64_t> status_;
+  std::vector<std::pair<Http::LowerCaseString, std::string>> headers_;
+};
+
+} // namespace
+
+bool AlbResponseParser::parse(const Buffer::Instance &json,
+                              Http::ResponseHeaderMap &headers,
+                              Buffer::Instance &body) {
+  return Parser(json).parse(headers, body);
+}
+
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
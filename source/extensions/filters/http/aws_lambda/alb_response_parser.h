@@ -0,0 +1,37 @@
+#pragma once
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/http/header_map.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+
+/**
+ * Parses the json a Lambda function returns to an ALB:
+ * https://docs.aws.amazon.com/elasticloadbalancing/latest/application/lambda-functions.html#respond-to-load-balancer
+ *
+ * Only `statusCode`, `headers`, `multiValueHeaders`, `body` and
+ * `isBase64Encoded` are read, any other field is skipped. The payload is read
+ * slice by slice without linearizing it. The status and headers are applied
+ * to the response headers, and the body is moved or decoded into the output
+ * buffer, once the whole payload has been validated.
+ */
+class AlbResponseParser {
+public:
+  /**
+   * @param json the payload returned by the function
+   * @param headers receives the status and headers of the payload
+   * @param body receives the decoded body
+   * @return false if the payload is not valid json or has a field of the
+   * wrong type. Neither the headers nor the body are changed then.
+   */
+  static bool parse(const Buffer::Instance &json,
+                    Http::ResponseHeaderMap &headers, Buffer::Instance &body);
+};
+
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
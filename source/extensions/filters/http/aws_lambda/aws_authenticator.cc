@@ -6,6 +6,7 @@
 
 #include "envoy/http/header_map.h"
 
+#include "source/common/buffer/buffer_impl.h"
 #include "source/common/common/assert.h"
 #include "source/common/common/empty_string.h"
 #include "source/common/common/hex.h"
@@ -14,6 +15,8 @@
 #include "source/common/http/utility.h"
 #include "source/common/singleton/const_singleton.h"
 
+#include "absl/strings/str_cat.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace HttpFilters {
@@ -40,240 +43,468 @@ AwsAuthenticator::AwsAuthenticator(TimeSource &time_source,
 // call to authenticator. Data may be added prior to this call.
 void AwsAuthenticator::init(const std::string *access_key,
                             const std::string *secret_key,
-                            const std::string *session_token) {
+                            const std::string *session_token,
+                            SigningKeyCache *signing_keys) {
   access_key_ = access_key;
   session_token_ = session_token;
+  signing_keys_ = signing_keys;
   const std::string &secret_key_ref = *secret_key;
   first_key_ = "AWS4" + secret_key_ref;
 }
 
 AwsAuthenticator::~AwsAuthenticator() {}
 
+namespace {
+
+void hexEncode(const uint8_t *bytes, size_t size, char *out) {
+  static const char hex[] = "0123456789abcdef";
+  for (size_t i = 0; i < size; i++) {
+    out[2 * i] = hex[bytes[i] >> 4];
+    out[2 * i + 1] = hex[bytes[i] & 0xf];
+  }
+}
+
+void formatDigits(char *out, int value, int digits) {
+  for (int i = digits - 1; i >= 0; i--) {
+    out[i] = '0' + value % 10;
+    value /= 10;
+  }
+}
+
+} // namespace
+
+HeaderList::HeaderList(std::vector<Http::LowerCaseString> headers)
+    : headers_(std::move(headers)) {
+  std::sort(headers_.begin(), headers_.end(),
+            [](const Http::LowerCaseString &i, const Http::LowerCaseString &j) {
+              return i.get() < j.get();
+            });
+  headers_.erase(std::unique(headers_.begin(), headers_.end()),
+                 headers_.end());
+  for (const auto &header : headers_) {
+    if (!signed_headers_.empty()) {
+      signed_headers_.push_back(';');
+    }
+    signed_headers_.append(header.get());
+  }
+}
+
+absl::string_view SigningScratch::dateTime(SystemTime now) {
+  const int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+                             now.time_since_epoch())
+                             .count();
+  if (second != date_time_second_) {
+    date_time_second_ = second;
+    const time_t time = second;
+    struct tm utc;
+    gmtime_r(&time, &utc);
+    formatDigits(date_time_, utc.tm_year + 1900, 4);
+    formatDigits(date_time_ + 4, utc.tm_mon + 1, 2);
+    formatDigits(date_time_ + 6, utc.tm_mday, 2);
+    date_time_[8] = 'T';
+    formatDigits(date_time_ + 9, utc.tm_hour, 2);
+    formatDigits(date_time_ + 11, utc.tm_min, 2);
+    formatDigits(date_time_ + 13, utc.tm_sec, 2);
+    date_time_[15] = 'Z';
+  }
+  return absl::string_view(date_time_, DateTimeLength);
+}
+
 HeaderList AwsAuthenticator::createHeaderToSign(
     std::initializer_list<Http::LowerCaseString> headers) {
-  // A C++ set is sorted. which is required by AWS signature algorithm.
-  HeaderList ret(AwsAuthenticator::lowercasecompare);
-  ret.insert(headers);
-  ret.insert(AwsAuthenticatorConsts::get().DateHeader);
-  return ret;
+  std::vector<Http::LowerCaseString> all_headers(headers);
+  all_headers.push_back(AwsAuthenticatorConsts::get().DateHeader);
+  return HeaderList(std::move(all_headers));
 }
 
 void AwsAuthenticator::updatePayloadHash(const Buffer::Instance &data) {
   body_sha_.update(data);
 }
 
-bool AwsAuthenticator::lowercasecompare(const Http::LowerCaseString &i,
-                                        const Http::LowerCaseString &j) {
-  return (i.get() < j.get());
+void AwsAuthenticator::getBodyHexSha(char *out) {
+  uint8_t payload_out[SHA256_DIGEST_LENGTH];
+  body_sha_.finalize(payload_out);
+  hexEncode(payload_out, SHA256_DIGEST_LENGTH, out);
 }
 
-std::string AwsAuthenticator::addDate(
-    std::chrono::time_point<std::chrono::system_clock> now) {
-  // TODO(yuval-k): This can be cached or optimized if needed
-  std::string request_date_time = DateFormatter("%Y%m%dT%H%M%SZ").fromTime(now);
-  request_headers_->addReferenceKey(AwsAuthenticatorConsts::get().DateHeader,
-                                    request_date_time);
-  return request_date_time;
+std::string AwsAuthenticator::getBodyHexSha() {
+  std::string hexpayload(HexSha256Length, '\0');
+  getBodyHexSha(hexpayload.data());
+  return hexpayload;
 }
 
-std::pair<std::string, std::string>
-AwsAuthenticator::prepareHeaders(const HeaderList &headers_to_sign) {
-  std::stringstream canonical_headers_stream;
-  std::stringstream signed_headers_stream;
+void AwsAuthenticator::fetchUrl() {
+  const absl::string_view canonical_url = request_headers_->getPathValue();
 
-  for (auto header = headers_to_sign.begin(), end = headers_to_sign.end();
-       header != end; header++) {
+  query_string_ = Http::Utility::findQueryStringStart(
+      request_headers_->Path()->value());
+  absl::string_view url_base =
+      canonical_url.substr(0, canonical_url.size() - query_string_.size());
+  if (!query_string_.empty()) {
+    // remove the ? from the query string
+    query_string_.remove_prefix(1);
+  }
+
+  // although the URL base is already encode it, due to a bug in AWS we need
+  // to encode it again, which only escapes the '%' characters.
+  std::string &url = signingScratch().url_;
+  url.clear();
+  for (size_t pos = url_base.find('%'); pos != absl::string_view::npos;
+       pos = url_base.find('%')) {
+    url.append(url_base.data(), pos);
+    url.append("%25");
+    url_base.remove_prefix(pos + 1);
+  }
+  url.append(url_base.data(), url_base.size());
+  url_base_ = url;
+}
 
+void AwsAuthenticator::computeCanonicalRequestHash(
+    const HeaderList &headers_to_sign, absl::string_view &signed_headers,
+    char *out) {
+  // The canonical request is hashed as it is produced, without building it.
+  Sha256 canonicalRequestHash;
+
+  canonicalRequestHash.update(*method_);
+  canonicalRequestHash.update('\n');
+  canonicalRequestHash.update(url_base_);
+  canonicalRequestHash.update('\n');
+  canonicalRequestHash.update(query_string_);
+  canonicalRequestHash.update('\n');
+
+  // Headers missing from the request are left out of the signed headers
+  bool all_present = true;
+  std::string &partial_signed_headers = signingScratch().signed_headers_;
+  for (const auto &header : headers_to_sign.headers()) {
     const Http::HeaderEntry *headerEntry{};
-    if (*header == AwsAuthenticatorConsts::get().Host) {
+    if (header == AwsAuthenticatorConsts::get().Host) {
       headerEntry = request_headers_->Host();
     } else {
-      const auto getter = request_headers_->get(*header);
+      const auto getter = request_headers_->get(header);
       if (!getter.empty()) {
         headerEntry = getter[0];
       }
-      
     }
 
-    // Should not happen, need to check now that envoy does not default header entries
     if (headerEntry == nullptr) {
+      if (all_present) {
+        all_present = false;
+        partial_signed_headers.clear();
+        for (const auto &previous : headers_to_sign.headers()) {
+          if (&previous == &header) {
+            break;
+          }
+          partial_signed_headers.append(previous.get());
+          partial_signed_headers.push_back(';');
+        }
+      }
       continue;
     }
 
-    auto headerName = header->get();
-    canonical_headers_stream << headerName;
-    signed_headers_stream << headerName;
-
-    canonical_headers_stream << ':';
-    if (headerEntry != nullptr) {
-      canonical_headers_stream << headerEntry->value().getStringView();
-      // TODO: add warning if null
-    }
-    canonical_headers_stream << '\n';
-    HeaderList::const_iterator next = header;
-    next++;
-    if (next != end) {
-      signed_headers_stream << ";";
+    canonicalRequestHash.update(header.get());
+    canonicalRequestHash.update(':');
+    canonicalRequestHash.update(headerEntry->value().getStringView());
+    canonicalRequestHash.update('\n');
+    if (!all_present) {
+      partial_signed_headers.append(header.get());
+      partial_signed_headers.push_back(';');
     }
   }
-  std::string canonical_headers = canonical_headers_stream.str();
-  std::string signed_headers = signed_headers_stream.str();
-
-  std::pair<std::string, std::string> pair =
-      std::make_pair(std::move(canonical_headers), std::move(signed_headers));
-  return pair;
-}
-
-std::string AwsAuthenticator::getBodyHexSha() {
-
-  uint8_t payload_out[SHA256_DIGEST_LENGTH];
-  body_sha_.finalize(payload_out);
-  std::string hexpayload = Hex::encode(payload_out, SHA256_DIGEST_LENGTH);
-  return hexpayload;
-}
-
-void AwsAuthenticator::fetchUrl() {
-  const Http::HeaderString &canonical_url = request_headers_->Path()->value();
-  
-  url_base_ = std::string(canonical_url.getStringView());
-  query_string_ = std::string(Http::Utility::findQueryStringStart(canonical_url));
-  if (query_string_.length() != 0) {
-    // remove the query string from the url_base
-    url_base_ = url_base_.substr(0, url_base_.length() - query_string_.length());
-    // remove the ? from the query string
-    query_string_ = query_string_.substr(1);
+  if (all_present) {
+    signed_headers = headers_to_sign.signedHeaders();
+  } else {
+    if (!partial_signed_headers.empty()) {
+      partial_signed_headers.pop_back();
+    }
+    signed_headers = partial_signed_headers;
   }
 
-  // although the URL base is already encode it, due to a bug in AWS we need to encode it again
-  url_base_ = Http::Utility::PercentEncoding::encode(url_base_, "%");
-}
-
-std::string AwsAuthenticator::computeCanonicalRequestHash(
-    const std::string &request_method, const std::string &canonical_headers,
-    const std::string &signed_headers, const std::string &hexpayload) {
-
-  // Do iternal classes for sha and hmac.
-  Sha256 canonicalRequestHash;
-
-  canonicalRequestHash.update(request_method);
-  canonicalRequestHash.update('\n');
-  canonicalRequestHash.update(url_base_);
-  canonicalRequestHash.update('\n');
-  if (query_string_.length() != 0) {
-    canonicalRequestHash.update(query_string_);
-  }
-  canonicalRequestHash.update('\n');
-  canonicalRequestHash.update(canonical_headers);
   canonicalRequestHash.update('\n');
   canonicalRequestHash.update(signed_headers);
   canonicalRequestHash.update('\n');
-  canonicalRequestHash.update(hexpayload);
+  switch (payload_signing_) {
+  case PayloadSigning::Signed: {
+    char hexpayload[HexSha256Length];
+    getBodyHexSha(hexpayload);
+    canonicalRequestHash.update(hexpayload, HexSha256Length);
+    break;
+  }
+  case PayloadSigning::Unsigned:
+    canonicalRequestHash.update(AwsAuthenticatorConsts::get().UnsignedPayload);
+    break;
+  case PayloadSigning::Streaming:
+    canonicalRequestHash.update(
+        AwsAuthenticatorConsts::get().StreamingPayload);
+    break;
+  }
 
   uint8_t cononicalRequestHashOut[SHA256_DIGEST_LENGTH];
-
   canonicalRequestHash.finalize(cononicalRequestHashOut);
-  return Hex::encode(cononicalRequestHashOut, SHA256_DIGEST_LENGTH);
+  hexEncode(cononicalRequestHashOut, SHA256_DIGEST_LENGTH, out);
 }
 
-std::string AwsAuthenticator::getCredntialScopeDate(
-    std::chrono::time_point<std::chrono::system_clock> now) {
+void AwsAuthenticator::deriveSigningKey(
+    const std::string &region, absl::string_view credentials_scope_date,
+    SigningKeyCache::Key &key) {
+  static const std::string aws_request = "aws4_request";
 
-  std::string credentials_scope_date = DateFormatter("%Y%m%d").fromTime(now);
-  return credentials_scope_date;
-}
+  HMACSha256 sighmac;
+  unsigned int out_len = key.size();
 
-std::string
-AwsAuthenticator::getCredntialScope(const std::string &region,
-                                    const std::string &credentials_scope_date) {
+  sighmac.init(first_key_);
+  sighmac.update(credentials_scope_date);
+  sighmac.finalize(key.data(), &out_len);
 
-  std::stringstream credential_scope_stream;
-  credential_scope_stream << credentials_scope_date << "/" << region << "/"
-                          << (*service_) << "/aws4_request";
-  return credential_scope_stream.str();
+  recusiveHmacHelper(sighmac, key.data(), out_len, region);
+  recusiveHmacHelper(sighmac, key.data(), out_len, *service_);
+  recusiveHmacHelper(sighmac, key.data(), out_len, aws_request);
 }
 
-std::string AwsAuthenticator::computeSignature(
-    const std::string &region, const std::string &credentials_scope_date,
-    const std::string &credential_scope, const std::string &request_date_time,
-    const std::string &hashed_canonical_request) {
-  static const std::string aws_request = "aws4_request";
+void AwsAuthenticator::signingKey(const std::string &region,
+                                  absl::string_view credentials_scope_date,
+                                  SigningKeyCache::Key &key) {
+  const SigningKeyCache::Key *cached_key =
+      signing_keys_ != nullptr
+          ? signing_keys_->find(*access_key_, credentials_scope_date, region,
+                                *service_)
+          : nullptr;
+  if (cached_key != nullptr) {
+    key = *cached_key;
+    return;
+  }
+  deriveSigningKey(region, credentials_scope_date, key);
+  if (signing_keys_ != nullptr) {
+    signing_keys_->insert(*access_key_, credentials_scope_date, region,
+                          *service_, key);
+  }
+}
 
+void AwsAuthenticator::computeSignature(
+    const SigningKeyCache::Key &key, absl::string_view algorithm,
+    std::initializer_list<absl::string_view> string_to_sign, char *out) {
   HMACSha256 sighmac;
-  unsigned int out_len = sighmac.length();
-  absl::FixedArray<uint8_t> out(out_len);
+  unsigned int out_len = SHA256_DIGEST_LENGTH;
+  uint8_t signature[SHA256_DIGEST_LENGTH];
+
+  sighmac.init(key.data(), key.size());
+  sighmac.update(algorithm);
+  for (absl::string_view line : string_to_sign) {
+    sighmac.update(AwsAuthenticatorConsts::get().Newline);
+    sighmac.update(line);
+  }
+  sighmac.finalize(signature, &out_len);
 
-  sighmac.init(first_key_);
-  sighmac.update(credentials_scope_date);
-  sighmac.finalize(out.begin(), &out_len);
+  hexEncode(signature, SHA256_DIGEST_LENGTH, out);
+}
 
-  recusiveHmacHelper(sighmac, out.begin(), out_len, region);
-  recusiveHmacHelper(sighmac, out.begin(), out_len, *service_);
-  recusiveHmacHelper(sighmac, out.begin(), out_len, aws_request);
-  const auto &nl = AwsAuthenticatorConsts::get().Newline;
+uint64_t AwsAuthenticator::streamingContentLength(uint64_t decoded_length) {
+  // `<hex size>;chunk-signature=<signature>\r\n<data>\r\n`
+  auto chunk_length = [](uint64_t size) {
+    return absl::StrCat(absl::Hex(size)).size() + 17 + HexSha256Length + 2 +
+           size + 2;
+  };
+  const uint64_t full_chunks = decoded_length / StreamingChunkSize;
+  const uint64_t last_chunk = decoded_length % StreamingChunkSize;
+  return full_chunks * chunk_length(StreamingChunkSize) +
+         (last_chunk != 0 ? chunk_length(last_chunk) : 0) + chunk_length(0);
+}
 
-  recusiveHmacHelper<std::initializer_list<const std::string *>>(
-      sighmac, out.begin(), out_len,
-      {&AwsAuthenticatorConsts::get().Algorithm, &nl, &request_date_time, &nl,
-       &credential_scope, &nl, &hashed_canonical_request});
+void AwsAuthenticator::signChunks(Buffer::Instance &pending,
+                                  Buffer::Instance &output, bool end_stream) {
+  ASSERT(payload_signing_ == PayloadSigning::Streaming);
+  while (pending.length() >= StreamingChunkSize ||
+         (end_stream && pending.length() > 0)) {
+    Buffer::OwnedImpl chunk;
+    chunk.move(pending, std::min<uint64_t>(pending.length(), StreamingChunkSize));
+    signChunk(chunk, output);
+  }
+  if (end_stream) {
+    Buffer::OwnedImpl final_chunk;
+    signChunk(final_chunk, output);
+  }
+}
 
-  return Hex::encode(out.begin(), out_len);
+void AwsAuthenticator::signChunk(Buffer::Instance &chunk,
+                                 Buffer::Instance &output) {
+  // hex encoded SHA-256 of an empty string
+  static const std::string empty_hash =
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+  Sha256 chunk_hash;
+  chunk_hash.update(chunk);
+  uint8_t chunk_hash_out[SHA256_DIGEST_LENGTH];
+  chunk_hash.finalize(chunk_hash_out);
+  char hex_chunk_hash[HexSha256Length];
+  hexEncode(chunk_hash_out, SHA256_DIGEST_LENGTH, hex_chunk_hash);
+
+  const absl::string_view previous_signature(previous_signature_,
+                                             HexSha256Length);
+  computeSignature(
+      streaming_key_, AwsAuthenticatorConsts::get().StreamingPayloadAlgorithm,
+      {streaming_date_time_, streaming_scope_, previous_signature, empty_hash,
+       absl::string_view(hex_chunk_hash, HexSha256Length)},
+      previous_signature_);
+
+  output.add(absl::StrCat(absl::Hex(chunk.length()), ";chunk-signature=",
+                          previous_signature, "\r\n"));
+  output.move(chunk);
+  output.add("\r\n", 2);
 }
 
 void AwsAuthenticator::sign(Http::RequestHeaderMap *request_headers,
                             const HeaderList &headers_to_sign,
                             const std::string &region) {
-
-  // we can't use the date provider interface as this is not the date header,
-  // plus the date format is different. use slow method now, optimize in the
-  // future.
   auto now = time_source_.systemTime();
 
-  std::string sig = signWithTime(request_headers, headers_to_sign, region, now);
+  absl::string_view sig =
+      signWithTime(request_headers, headers_to_sign, region, now);
   request_headers->setInline(authorization_handle.handle(), sig);
 }
 
-std::string AwsAuthenticator::signWithTime(
+absl::string_view AwsAuthenticator::signWithTime(
     Http::RequestHeaderMap *request_headers, const HeaderList &headers_to_sign,
     const std::string &region,
     std::chrono::time_point<std::chrono::system_clock> now) {
   request_headers_ = request_headers;
+  SigningScratch &scratch = signingScratch();
 
-  std::string request_date_time = addDate(now);
+  const absl::string_view request_date_time = scratch.dateTime(now);
+  const absl::string_view credentials_scope_date =
+      request_date_time.substr(0, SigningScratch::DateLength);
+  request_headers_->addReferenceKey(AwsAuthenticatorConsts::get().DateHeader,
+                                    request_date_time);
 
   // Add session token header if present
   if (session_token_ != nullptr) {
-    request_headers->addCopy(AwsAuthenticatorConsts::get().SecurityTokenHeader,
-                             (*session_token_));
+    request_headers->addReferenceKey(
+        AwsAuthenticatorConsts::get().SecurityTokenHeader, *session_token_);
   }
 
-  auto &&preparedHeaders = prepareHeaders(headers_to_sign);
-  std::string canonical_headers = std::move(preparedHeaders.first);
-  std::string signed_headers = std::move(preparedHeaders.second);
-
-  std::string hexpayload = getBodyHexSha();
+  switch (payload_signing_) {
+  case PayloadSigning::Signed:
+    break;
+  case PayloadSigning::Unsigned:
+    request_headers->setReferenceKey(
+        AwsAuthenticatorConsts::get().ContentSha256Header,
+        AwsAuthenticatorConsts::get().UnsignedPayload);
+    break;
+  case PayloadSigning::Streaming: {
+    request_headers->setReferenceKey(
+        AwsAuthenticatorConsts::get().ContentSha256Header,
+        AwsAuthenticatorConsts::get().StreamingPayload);
+    request_headers->setCopy(
+        AwsAuthenticatorConsts::get().DecodedContentLengthHeader,
+        absl::StrCat(decoded_length_));
+    request_headers->setContentLength(streamingContentLength(decoded_length_));
+    // aws-chunked is the outermost content encoding
+    const auto content_encoding =
+        request_headers->get(Http::CustomHeaders::get().ContentEncoding);
+    std::string encoding = AwsAuthenticatorConsts::get().AwsChunked;
+    if (!content_encoding.empty()) {
+      absl::StrAppend(&encoding, ",",
+                      content_encoding[0]->value().getStringView());
+    }
+    request_headers->setCopy(Http::CustomHeaders::get().ContentEncoding,
+                             encoding);
+    break;
+  }
+  }
 
   fetchUrl();
 
-  std::string hashed_canonical_request = computeCanonicalRequestHash(
-      *method_, canonical_headers, signed_headers, hexpayload);
-  std::string credentials_scope_date = getCredntialScopeDate(now);
-  std::string CredentialScope =
-      getCredntialScope(region, credentials_scope_date);
-
-  std::string signature =
-      computeSignature(region, credentials_scope_date, CredentialScope,
-                       request_date_time, hashed_canonical_request);
-
-  std::stringstream authorizationvalue;
+  absl::string_view signed_headers;
+  char hashed_canonical_request[HexSha256Length];
+  computeCanonicalRequestHash(headers_to_sign, signed_headers,
+                              hashed_canonical_request);
+
+  std::string &credential_scope = scratch.credential_scope_;
+  credential_scope.clear();
+  absl::StrAppend(&credential_scope, credentials_scope_date, "/", region, "/",
+                  *service_, "/aws4_request");
+
+  SigningKeyCache::Key key;
+  signingKey(region, credentials_scope_date, key);
+  char signature[HexSha256Length];
+  computeSignature(
+      key, AwsAuthenticatorConsts::get().Algorithm,
+      {request_date_time, credential_scope,
+       absl::string_view(hashed_canonical_request, HexSha256Length)},
+      signature);
+
+  if (payload_signing_ == PayloadSigning::Streaming) {
+    // The chunk signatures chain off the seed signature
+    streaming_key_ = key;
+    streaming_date_time_.assign(request_date_time.data(),
+                                request_date_time.size());
+    streaming_scope_.assign(credential_scope.data(), credential_scope.size());
+    std::copy(signature, signature + HexSha256Length, previous_signature_);
+  }
 
   // TODO(talnordan): Provide `DETAILS`.
   RELEASE_ASSERT(access_key_, "");
 
-  authorizationvalue << AwsAuthenticatorConsts::get().Algorithm
-                     << " Credential=" << (*access_key_) << "/"
-                     << CredentialScope << ", SignedHeaders=" << signed_headers
-                     << ", Signature=" << signature;
-  return authorizationvalue.str();
+  std::string &authorization = scratch.authorization_;
+  authorization.clear();
+  absl::StrAppend(&authorization, AwsAuthenticatorConsts::get().Algorithm,
+                  " Credential=", *access_key_, "/", credential_scope,
+                  ", SignedHeaders=", signed_headers, ", Signature=",
+                  absl::string_view(signature, HexSha256Length));
+  return authorization;
+}
+
+void SigningKeyCache::onCredentials(const std::string &access_key,
+                                    const std::string &secret_key) {
+  auto it = credentials_.find(access_key);
+  if (it != credentials_.end()) {
+    if (it->second.secret_key_ != secret_key) {
+      it->second.secret_key_ = secret_key;
+      it->second.entries_.clear();
+    }
+    return;
+  }
+  if (credentials_.size() >= MaxCredentials) {
+    credentials_.clear();
+  }
+  credentials_[access_key].secret_key_ = secret_key;
+}
+
+const SigningKeyCache::Key *
+SigningKeyCache::find(const std::string &access_key, absl::string_view date,
+                      absl::string_view region,
+                      absl::string_view service) const {
+  auto it = credentials_.find(access_key);
+  if (it == credentials_.end()) {
+    return nullptr;
+  }
+  for (const Entry &entry : it->second.entries_) {
+    if (entry.region_ == region && entry.service_ == service) {
+      return entry.date_ == date ? &entry.key_ : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+void SigningKeyCache::insert(const std::string &access_key,
+                             absl::string_view date, absl::string_view region,
+                             absl::string_view service, const Key &key) {
+  auto it = credentials_.find(access_key);
+  if (it == credentials_.end()) {
+    return;
+  }
+  std::vector<Entry> &entries = it->second.entries_;
+  for (Entry &entry : entries) {
+    if (entry.region_ == region && entry.service_ == service) {
+      // the date rolled over
+      entry.date_ = std::string(date);
+      entry.key_ = key;
+      return;
+    }
+  }
+  if (entries.size() >= MaxKeysPerCredential) {
+    entries.clear();
+  }
+  entries.push_back(
+      {std::string(region), std::string(service), std::string(date), key});
 }
 
 AwsAuthenticator::Sha256::Sha256() { SHA256_Init(&context_); }
@@ -329,10 +560,14 @@ void AwsAuthenticator::HMACSha256::update(const std::string &data) {
   update(reinterpret_cast<const uint8_t *>(data.c_str()), data.size());
 }
 
+void AwsAuthenticator::HMACSha256::update(absl::string_view data) {
+  update(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+}
+
 void AwsAuthenticator::HMACSha256::update(
-    std::initializer_list<const std::string *> strings) {
-  for (auto &&str : strings) {
-    update(*str);
+    std::initializer_list<absl::string_view> strings) {
+  for (absl::string_view str : strings) {
+    update(str);
   }
 }
 
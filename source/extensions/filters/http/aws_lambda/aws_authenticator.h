@@ -1,6 +1,7 @@
 #pragma once
-#include <set>
+#include <array>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/common/time.h"
@@ -8,6 +9,7 @@
 
 #include "source/common/singleton/const_singleton.h"
 
+#include "absl/container/flat_hash_map.h"
 #include "openssl/digest.h"
 #include "openssl/hmac.h"
 #include "openssl/sha.h"
@@ -24,15 +26,112 @@ public:
   const std::string Newline{"\n"};
   const Http::LowerCaseString DateHeader{"x-amz-date"};
   const Http::LowerCaseString SecurityTokenHeader{"x-amz-security-token"};
+  const Http::LowerCaseString ContentSha256Header{"x-amz-content-sha256"};
+  const Http::LowerCaseString DecodedContentLengthHeader{
+      "x-amz-decoded-content-length"};
+  const std::string UnsignedPayload{"UNSIGNED-PAYLOAD"};
+  const std::string StreamingPayload{"STREAMING-AWS4-HMAC-SHA256-PAYLOAD"};
+  const std::string StreamingPayloadAlgorithm{"AWS4-HMAC-SHA256-PAYLOAD"};
+  const std::string AwsChunked{"aws-chunked"};
   const Http::LowerCaseString Host{"host"};
 };
 
 typedef ConstSingleton<AwsAuthenticatorValues> AwsAuthenticatorConsts;
 
-typedef bool (*LowerCaseStringCompareFunc)(const Http::LowerCaseString &,
-                                           const Http::LowerCaseString &);
+/**
+ * The headers to sign, sorted and deduplicated once at config time as the
+ * AWS signature algorithm requires, with the `SignedHeaders` value of a
+ * request that has all of them.
+ */
+class HeaderList {
+public:
+  explicit HeaderList(std::vector<Http::LowerCaseString> headers);
+
+  const std::vector<Http::LowerCaseString> &headers() const {
+    return headers_;
+  }
+  const std::string &signedHeaders() const { return signed_headers_; }
+
+private:
+  std::vector<Http::LowerCaseString> headers_;
+  std::string signed_headers_;
+};
+
+/**
+ * Buffers reused across signatures, and the request dates of the current
+ * second. Not thread safe, each worker owns one.
+ */
+class SigningScratch {
+public:
+  // `YYYYMMDDTHHMMSSZ`; the first 8 characters are the credential scope date
+  static constexpr size_t DateTimeLength = 16;
+  static constexpr size_t DateLength = 8;
+
+  // The request date of `now`, formatted once per second.
+  absl::string_view dateTime(SystemTime now);
+
+private:
+  friend class AwsAuthenticator;
+
+  int64_t date_time_second_{-1};
+  char date_time_[DateTimeLength + 1]{};
+
+  std::string url_;
+  std::string signed_headers_;
+  std::string credential_scope_;
+  std::string authorization_;
+};
+
+/**
+ * SigV4 signing keys derived from a secret key, keyed on the access key,
+ * region and service. A key is valid for one UTC day, so the four HMACs that
+ * derive it run once a day instead of once per request. Not thread safe, each
+ * worker owns one.
+ */
+class SigningKeyCache {
+public:
+  using Key = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+  // Bounds on the cached credentials, and on the (region, service) pairs of
+  // each credential. The cache or the credential is cleared when full.
+  static constexpr size_t MaxCredentials = 64;
+  static constexpr size_t MaxKeysPerCredential = 16;
+
+  /**
+   * Records the credentials a request is signed with, dropping the keys of
+   * the access key if its secret key was rotated.
+   */
+  void onCredentials(const std::string &access_key,
+                     const std::string &secret_key);
+
+  // The cached key, or nullptr if it is missing or was derived for another
+  // date.
+  const Key *find(const std::string &access_key, absl::string_view date,
+                  absl::string_view region, absl::string_view service) const;
+
+  // Caches a key of credentials recorded with onCredentials().
+  void insert(const std::string &access_key, absl::string_view date,
+              absl::string_view region, absl::string_view service,
+              const Key &key);
+
+  size_t size() const { return credentials_.size(); }
+
+private:
+  struct Entry {
+    std::string region_;
+    std::string service_;
+    std::string date_;
+    Key key_;
+  };
 
-typedef std::set<Http::LowerCaseString, LowerCaseStringCompareFunc> HeaderList;
+  struct CredentialKeys {
+    std::string secret_key_;
+    // A handful of entries, searched linearly.
+    std::vector<Entry> entries_;
+  };
+
+  absl::flat_hash_map<std::string, CredentialKeys> credentials_;
+};
 
 class AwsAuthenticator {
 public:
@@ -41,11 +140,62 @@ public:
 
   ~AwsAuthenticator();
 
+  /**
+   * @param signing_keys optional cache of the signing keys, which must
+   * outlive the authenticator and have seen the credentials in
+   * SigningKeyCache::onCredentials().
+   */
   void init(const std::string *access_key, const std::string *secret_key,
-            const std::string *session_token);
+            const std::string *session_token,
+            SigningKeyCache *signing_keys = nullptr);
 
   void updatePayloadHash(const Buffer::Instance &data);
 
+  /**
+   * @param scratch optional buffers reused across requests, which must
+   * outlive the authenticator. The authenticator uses buffers of its own
+   * otherwise.
+   */
+  void setScratch(SigningScratch *scratch) { scratch_ = scratch; }
+
+  /**
+   * Signs the headers only, without hashing the payload, and adds the
+   * `x-amz-content-sha256: UNSIGNED-PAYLOAD` header, which must be in the
+   * headers to sign.
+   */
+  void setUnsignedPayload() { payload_signing_ = PayloadSigning::Unsigned; }
+
+  /**
+   * Signs the headers for an `aws-chunked` body of `decoded_length` bytes,
+   * which is then signed chunk by chunk with signChunks(). Sets the
+   * content length, content encoding and the `x-amz-content-sha256` and
+   * `x-amz-decoded-content-length` headers, which must be in the headers to
+   * sign.
+   */
+  void setStreamingPayload(uint64_t decoded_length) {
+    payload_signing_ = PayloadSigning::Streaming;
+    decoded_length_ = decoded_length;
+  }
+
+  // The body is framed in chunks of this size, except for the last one.
+  static constexpr uint64_t StreamingChunkSize = 64 * 1024;
+
+  // The length of the aws-chunked encoding of a body
+  static uint64_t streamingContentLength(uint64_t decoded_length);
+
+  /**
+   * Frames and signs the complete chunks of `pending`, each chaining off the
+   * signature of the previous one, starting from the seed signature of the
+   * headers. Must be called after sign().
+   *
+   * @param pending body bytes not yet signed, drained as chunks are signed
+   * @param output receives the framed chunks
+   * @param end_stream whether `pending` holds the end of the body, in which
+   * case the last partial chunk and the final empty chunk are written too
+   */
+  void signChunks(Buffer::Instance &pending, Buffer::Instance &output,
+                  bool end_stream);
+
   void sign(Http::RequestHeaderMap *request_headers,
             const HeaderList &headers_to_sign, const std::string &region);
 
@@ -61,32 +211,38 @@ private:
   // TODO(yuval-k) can I refactor our the friendliness?
   friend class AwsAuthenticatorTest;
 
-  std::string signWithTime(Http::RequestHeaderMap *request_headers,
-                           const HeaderList &headers_to_sign,
-                           const std::string &region, SystemTime now);
+  static constexpr size_t HexSha256Length = 2 * SHA256_DIGEST_LENGTH;
 
-  std::string addDate(SystemTime now);
+  // Returns the authorization header value, valid until the next signature.
+  absl::string_view signWithTime(Http::RequestHeaderMap *request_headers,
+                                 const HeaderList &headers_to_sign,
+                                 const std::string &region, SystemTime now);
 
-  std::pair<std::string, std::string>
-  prepareHeaders(const HeaderList &headers_to_sign);
+  SigningScratch &signingScratch() {
+    return scratch_ != nullptr ? *scratch_ : own_scratch_;
+  }
+
+  void getBodyHexSha(char *out);
 
   void fetchUrl();
-  std::string computeCanonicalRequestHash(const std::string &request_method,
-                                          const std::string &canonical_Headers,
-                                          const std::string &signed_headers,
-                                          const std::string &hexpayload);
-  std::string getCredntialScopeDate(SystemTime now);
-  std::string getCredntialScope(const std::string &region,
-                                const std::string &datenow);
-
-  std::string computeSignature(const std::string &region,
-                               const std::string &credential_scope_date,
-                               const std::string &credential_scope,
-                               const std::string &request_date_time,
-                               const std::string &hashed_canonical_request);
-
-  static bool lowercasecompare(const Http::LowerCaseString &i,
-                               const Http::LowerCaseString &j);
+  void computeCanonicalRequestHash(const HeaderList &headers_to_sign,
+                                   absl::string_view &signed_headers,
+                                   char *out);
+
+  void deriveSigningKey(const std::string &region,
+                        absl::string_view credentials_scope_date,
+                        SigningKeyCache::Key &key);
+
+  void signingKey(const std::string &region,
+                  absl::string_view credentials_scope_date,
+                  SigningKeyCache::Key &key);
+
+  void computeSignature(const SigningKeyCache::Key &key,
+                        absl::string_view algorithm,
+                        std::initializer_list<absl::string_view> string_to_sign,
+                        char *out);
+
+  void signChunk(Buffer::Instance &chunk, Buffer::Instance &output);
 
   class Sha256 {
   public:
@@ -113,7 +269,8 @@ private:
     void init(const std::string &data);
     void init(const uint8_t *bytes, size_t size);
     void update(const std::string &data);
-    void update(std::initializer_list<const std::string *> strings);
+    void update(absl::string_view data);
+    void update(std::initializer_list<absl::string_view> strings);
     void update(const uint8_t *bytes, size_t size);
     void finalize(uint8_t *out, unsigned int *out_len);
 
@@ -137,10 +294,25 @@ private:
   const std::string *access_key_{};
   const std::string *session_token_{};
   std::string first_key_;
+  SigningKeyCache *signing_keys_{};
   const std::string *service_{};
   const std::string *method_{};
-  std::string query_string_{};
-  std::string url_base_{};
+  // Views of the path of the request being signed, and of its double
+  // encoded version in the scratch buffers.
+  absl::string_view query_string_{};
+  absl::string_view url_base_{};
+  SigningScratch *scratch_{};
+  SigningScratch own_scratch_;
+
+  enum class PayloadSigning { Signed, Unsigned, Streaming };
+  PayloadSigning payload_signing_{PayloadSigning::Signed};
+
+  // State of the aws-chunked signature, kept from the seed signature
+  uint64_t decoded_length_{};
+  SigningKeyCache::Key streaming_key_{};
+  std::string streaming_date_time_;
+  std::string streaming_scope_;
+  char previous_signature_[HexSha256Length]{};
 
   Http::RequestHeaderMap *request_headers_{};
 };
@@ -17,8 +17,12 @@
 #include "source/common/http/utility.h"
 #include "source/common/singleton/const_singleton.h"
 
+#include "source/extensions/filters/http/aws_lambda/alb_response_parser.h"
 #include "source/extensions/filters/http/solo_well_known_names.h"
 
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+
 
 namespace Envoy {
 namespace Extensions {
@@ -46,6 +50,8 @@ public:
   const std::string LogNone{"None"};
   const Http::LowerCaseString HostHead{"x-amz-log-type"};
   const Http::LowerCaseString FunctionError{"x-amz-function-error"};
+  const std::string PayloadChunkEvent{"PayloadChunk"};
+  const std::string InvokeCompleteEvent{"InvokeComplete"};
 };
 
 typedef ConstSingleton<AWSLambdaHeaderValues> AWSLambdaHeaderNames;
@@ -56,6 +62,22 @@ const HeaderList AWSLambdaFilter::HeadersToSign =
          AWSLambdaHeaderNames::get().LogType, Http::Headers::get().HostLegacy,
          Http::Headers::get().ContentType});
 
+const HeaderList AWSLambdaFilter::UnsignedPayloadHeadersToSign =
+    AwsAuthenticator::createHeaderToSign(
+        {AWSLambdaHeaderNames::get().InvocationType,
+         AWSLambdaHeaderNames::get().LogType, Http::Headers::get().HostLegacy,
+         Http::Headers::get().ContentType,
+         AwsAuthenticatorConsts::get().ContentSha256Header});
+
+const HeaderList AWSLambdaFilter::StreamingPayloadHeadersToSign =
+    AwsAuthenticator::createHeaderToSign(
+        {AWSLambdaHeaderNames::get().InvocationType,
+         AWSLambdaHeaderNames::get().LogType, Http::Headers::get().HostLegacy,
+         Http::Headers::get().ContentType, Http::Headers::get().ContentLength,
+         Http::CustomHeaders::get().ContentEncoding,
+         AwsAuthenticatorConsts::get().ContentSha256Header,
+         AwsAuthenticatorConsts::get().DecodedContentLengthHeader});
+
 AWSLambdaFilter::AWSLambdaFilter(Upstream::ClusterManager &cluster_manager,
                                  Api::Api &api,
                                  AWSLambdaConfigConstSharedPtr filter_config)
@@ -93,6 +115,23 @@ AWSLambdaFilter::decodeHeaders(Http::RequestHeaderMap &headers,
     return Http::FilterHeadersStatus::StopIteration;
   }
 
+  // The body of a request that is not transformed is streamed when the
+  // payload is not signed, or signed chunk by chunk. The chunked signature
+  // covers the decoded length, so it needs the content length upfront.
+  uint64_t content_length = 0;
+  if (!end_stream && !isRequestTransformationNeeded()) {
+    if (protocol_options_->unsignedPayload()) {
+      stream_body_ = true;
+      aws_authenticator_.setUnsignedPayload();
+    } else if (protocol_options_->streamingSignedPayload() &&
+               absl::SimpleAtoi(headers.getContentLengthValue(),
+                                &content_length)) {
+      stream_body_ = true;
+      sign_chunks_ = true;
+      aws_authenticator_.setStreamingPayload(content_length);
+    }
+  }
+
   // If the state is still the initial, attempt to get credentials
   ASSERT(state_ == State::Init);
   state_ = State::Calling;
@@ -115,7 +154,7 @@ AWSLambdaFilter::decodeHeaders(Http::RequestHeaderMap &headers,
     }
   }
 
-  if (end_stream) {
+  if (end_stream || stream_body_) {
     finalizeRequest();
     return Http::FilterHeadersStatus::Continue;
   }
@@ -132,6 +171,20 @@ AWSLambdaFilter::encodeHeaders(Http::ResponseHeaderMap &headers, bool end_stream
     headers.setStatus(504);
   }
   response_headers_ = &headers;
+  if (functionOnRoute() != nullptr && functionOnRoute()->responseStreaming() &&
+      !end_stream && Http::Utility::getResponseStatus(headers) == 200 &&
+      headers.get(AWSLambdaHeaderNames::get().FunctionError).empty()) {
+    // The body is an event stream that wraps the function's response stream.
+    // Skipping an event would drop part of the body, so an event too large to
+    // decode fails the stream.
+    response_decoder_ = std::make_unique<AwsEventStream::Decoder>(
+        MaxResponseEventSize,
+        [this](const AwsEventStream::Message &message) {
+          onResponseStreamMessage(message);
+        },
+        AwsEventStream::Decoder::Oversized::Fail);
+    headers.removeContentLength();
+  }
   if (isResponseTransformationNeeded() && !end_stream){
     // Stop iteration so that encodedata can mutate headers from alb json
     return Http::FilterHeadersStatus::StopIteration;
@@ -149,6 +202,15 @@ Http::FilterDataStatus AWSLambdaFilter::encodeData(
     return Http::FilterDataStatus::StopIterationNoBuffer;
   }
 
+  if (response_decoder_ != nullptr &&
+      !decodeResponseStream(data, end_stream) &&
+      !isResponseTransformationNeeded()) {
+    // The headers are already sent, the client can only see that the
+    // response is cut short
+    encoder_callbacks_->resetStream();
+    return Http::FilterDataStatus::StopIterationNoBuffer;
+  }
+
   if (!isResponseTransformationNeeded()){
     // return response as is if not configured for alb mode/transformation
     return Http::FilterDataStatus::Continue;
@@ -168,6 +230,14 @@ Http::FilterDataStatus AWSLambdaFilter::encodeData(
 Http::FilterTrailersStatus
 AWSLambdaFilter::encodeTrailers(Http::ResponseTrailerMap &) {
 
+  if (response_decoder_ != nullptr && !response_stream_error_) {
+    checkResponseStreamEnd();
+    if (response_stream_error_ && !isResponseTransformationNeeded()) {
+      encoder_callbacks_->resetStream();
+      return Http::FilterTrailersStatus::StopIteration;
+    }
+  }
+
   if (!isResponseTransformationNeeded()){
    return Http::FilterTrailersStatus::Continue;
   }
@@ -182,13 +252,20 @@ void AWSLambdaFilter::finalizeResponse(){
   // as the following options will only make the resulting buffer smaller.
   const Buffer::Instance&  buff = *encoder_callbacks_->encodingBuffer();
   encoder_callbacks_->modifyEncodingBuffer([this](Buffer::Instance& enc_buf) {
-    Buffer::OwnedImpl body;
-    if (functionOnRoute()->unwrapAsAlb()) {
+    if (response_stream_error_) {
+      // The function's response is incomplete, so it is not unwrapped
+      response_headers_->setStatus(504);
+      enc_buf.drain(enc_buf.length());
+    } else if (functionOnRoute()->unwrapAsAlb()) {
+      Buffer::OwnedImpl body;
       if (parseResponseAsALB(*response_headers_, enc_buf, body)){
         response_headers_->setStatus(static_cast<int>(Http::Code::InternalServerError));
         body.drain(body.length());
       }
+      enc_buf.drain(enc_buf.length());
+      enc_buf.move(body);
     } else if (functionOnRoute()->hasTransformerConfig()) {
+      // The transformer rewrites the buffer in place
       auto transformer_config = functionOnRoute()->transformerConfig();
       transformer_config->transform(
         *response_headers_,
@@ -196,68 +273,73 @@ void AWSLambdaFilter::finalizeResponse(){
         enc_buf,
         *encoder_callbacks_
       );
-
-      body.add(enc_buf.toString().c_str());
     }
-    enc_buf.drain(enc_buf.length());
-    enc_buf.move(body);
   });
   response_headers_->setContentLength(buff.length());
 }
 
-bool AWSLambdaFilter::parseResponseAsALB(Http::ResponseHeaderMap& headers,
-                const Buffer::Instance& json_buf, Buffer::Instance& body) {
-
-  Protobuf::Struct alb_response;
-  try {
-    MessageUtil::loadFromJson(json_buf.toString(), alb_response);
-  } catch (EnvoyException& ex) {
-    ENVOY_LOG(debug, "{}: alb_unwrap set but did not recieve a json payload",
-                                                   functionOnRoute()->path());
-    headers.setStatus(static_cast<int>(Http::Code::InternalServerError));
-    return true;
-  }
-
-  const auto& flds = alb_response.fields();
-  if (flds.contains("body")) {
-    auto rawBody = flds.at("body").string_value();
-    if (flds.contains("isBase64Encoded")){
-      if (!flds.at("isBase64Encoded").has_bool_value()){
-        return true;
-      }
-      if (flds.at("isBase64Encoded").bool_value()){
-        rawBody = Base64::decode(rawBody);
-      }
+bool AWSLambdaFilter::decodeResponseStream(Buffer::Instance &data,
+                                           bool end_stream) {
+  // Replaces the event stream bytes with the payload of the events
+  for (const Buffer::RawSlice &slice : data.getRawSlices()) {
+    if (!response_decoder_->decode(absl::string_view(
+            static_cast<const char *>(slice.mem_), slice.len_))) {
+      response_stream_error_ = true;
+      break;
     }
-    body.add(rawBody);
   }
+  if (end_stream && !response_stream_error_) {
+    checkResponseStreamEnd();
+  }
+  data.drain(data.length());
+  data.move(response_payload_);
+  return !response_stream_error_;
+}
 
-  if (flds.contains("statusCode")){
-    headers.setStatus(flds.at("statusCode").number_value());
-    if (!flds.at("statusCode").has_number_value()){
-      return true;
-    }
+void AWSLambdaFilter::checkResponseStreamEnd() {
+  // A stream that is cut short, or that ends without the summary of the
+  // invocation, did not complete
+  if (response_decoder_->hasPartialMessage()) {
+    ENVOY_LOG(debug, "{}: streamed response ends in a partial event",
+              __func__);
+    response_stream_error_ = true;
+  } else if (!response_stream_complete_) {
+    ENVOY_LOG(debug, "{}: streamed response ends without {}", __func__,
+              AWSLambdaHeaderNames::get().InvokeCompleteEvent);
+    response_stream_error_ = true;
   }
-  if (flds.contains("headers")){
-    const auto& hds = flds.at("headers").struct_value();
-    const auto& hdsFields = hds.fields();
-    for (auto const& hdrEntry : hdsFields) {
-      headers.addCopy(Http::LowerCaseString(hdrEntry.first),
-                             hdrEntry.second.string_value());
+}
+
+void AWSLambdaFilter::onResponseStreamMessage(
+    const AwsEventStream::Message &message) {
+  const absl::string_view message_type = message.header(":message-type");
+  const absl::string_view event_type = message.header(":event-type");
+  if (message_type == "event" &&
+      event_type == AWSLambdaHeaderNames::get().PayloadChunkEvent) {
+    response_payload_.add(message.payload);
+  } else if (message_type == "event" &&
+             event_type == AWSLambdaHeaderNames::get().InvokeCompleteEvent) {
+    response_stream_complete_ = true;
+    // The function failed if the summary has an error code
+    if (absl::StrContains(message.payload, "\"ErrorCode\"")) {
+      ENVOY_LOG(debug, "{}: streamed invocation failed: {}", __func__,
+                message.payload);
+      response_stream_error_ = true;
     }
+  } else if (message_type == "exception" || message_type == "error") {
+    ENVOY_LOG(debug, "{}: streamed invocation failed: {}", __func__,
+              message.payload);
+    response_stream_error_ = true;
   }
-  // While ALB would refuse to parse something with headers + multivalue
-  // Being more permissive in this case was determined to be better.
-  if (flds.contains("multiValueHeaders")){
-    const auto& hds = flds.at("multiValueHeaders").struct_value();
-    const auto& hdsFields = hds.fields();
-    for (auto const& hdrEntry : hdsFields) {
-      const auto& list = hdrEntry.second.list_value();
-      for (auto const& val : list.values()){
-        headers.addCopy(Http::LowerCaseString(hdrEntry.first),
-                                                            val.string_value());
-      }
-    }
+}
+
+bool AWSLambdaFilter::parseResponseAsALB(Http::ResponseHeaderMap& headers,
+                const Buffer::Instance& json_buf, Buffer::Instance& body) {
+  if (!AlbResponseParser::parse(json_buf, headers, body)) {
+    ENVOY_LOG(debug, "{}: alb_unwrap set but did not recieve a valid alb response",
+                                                   functionOnRoute()->path());
+    headers.setStatus(static_cast<int>(Http::Code::InternalServerError));
+    return true;
   }
   return false;
 }
@@ -301,17 +383,27 @@ void AWSLambdaFilter::onSuccess(
                                        RcDetails::get().CredentialsNotFound);
     return;
   }
-  aws_authenticator_.init(access_key, secret_key, session_token);
+  // Drops the cached signing keys if the credentials were rotated
+  SigningKeyCache &signing_keys = filter_config_->signingKeyCache();
+  signing_keys.onCredentials(*access_key, *secret_key);
+  aws_authenticator_.init(access_key, secret_key, session_token,
+                          &signing_keys);
+  aws_authenticator_.setScratch(&filter_config_->signingScratch());
 
   if (stopped_) {
-    if (end_stream_) {
+    if (end_stream_ || stream_body_) {
       // edge cases that we need to finalize the request and continue the filter iteration here:
       // 1. header only request because decodeHeaders() has been called with end_stream=true already and
       // no decodeData() will be called
       // 2. by the time we got the credential refreshed, the last decodeData() has been called with end_stream=true
       // already. The last decodeData() saw that state_==Calling, it stopped iteration and buffered and no
       // further decodeData() will be called
+      // 3. the body is streamed, so the headers are signed as soon as the
+      // credentials are available
       finalizeRequest();
+      if (sign_chunks_) {
+        signBufferedChunks();
+      }
       decoder_callbacks_->continueDecoding();
     }
 
@@ -343,6 +435,21 @@ Http::FilterDataStatus AWSLambdaFilter::decodeData(Buffer::Instance &data,
     has_body_ = true;
   }
 
+  if (stream_body_) {
+    // The headers are signed as soon as the credentials are available, and
+    // the body is passed through.
+    if (state_ == Calling) {
+      return Http::FilterDataStatus::StopIterationAndBuffer;
+    } else if (state_ == Responded) {
+      return Http::FilterDataStatus::StopIterationNoBuffer;
+    }
+    if (sign_chunks_) {
+      pending_chunk_.move(data);
+      aws_authenticator_.signChunks(pending_chunk_, data, end_stream);
+    }
+    return Http::FilterDataStatus::Continue;
+  }
+
   // If we are not transforming the request, then update the payload hash according to the incoming data
   // If we are transforming the request, then we will update the payload hash after the transformation
   if (!isRequestTransformationNeeded()) {
@@ -380,24 +487,51 @@ AWSLambdaFilter::decodeTrailers(Http::RequestTrailerMap &) {
     return Http::FilterTrailersStatus::StopIteration;
   }
 
-  if (function_on_route_ != nullptr) {
+  if (function_on_route_ != nullptr && !stream_body_) {
     finalizeRequest();
   }
+  if (sign_chunks_) {
+    // the trailers end the body, so the last chunks are added here
+    Buffer::OwnedImpl chunks;
+    aws_authenticator_.signChunks(pending_chunk_, chunks, true);
+    decoder_callbacks_->addDecodedData(chunks, true);
+  }
 
   return Http::FilterTrailersStatus::Continue;
 }
 
 void AWSLambdaFilter::finalizeRequest() {
-  handleDefaultBody();
+  if (!stream_body_) {
+    // a streamed body is still to come
+    handleDefaultBody();
+  }
   if (isRequestTransformationNeeded()) {
       transformRequest();
   }
   updateHeaders();
 
-  aws_authenticator_.sign(request_headers_, HeadersToSign,
+  const HeaderList &headers_to_sign =
+      sign_chunks_   ? StreamingPayloadHeadersToSign
+      : stream_body_ ? UnsignedPayloadHeadersToSign
+                     : HeadersToSign;
+  aws_authenticator_.sign(request_headers_, headers_to_sign,
                           protocol_options_->region());
 }
 
+void AWSLambdaFilter::signBufferedChunks() {
+  // Frames the body buffered while waiting for the credentials
+  if (decoder_callbacks_->decodingBuffer() != nullptr) {
+    decoder_callbacks_->modifyDecodingBuffer([this](Buffer::Instance &data) {
+      pending_chunk_.move(data);
+      aws_authenticator_.signChunks(pending_chunk_, data, end_stream_);
+    });
+  } else if (end_stream_) {
+    Buffer::OwnedImpl chunks;
+    aws_authenticator_.signChunks(pending_chunk_, chunks, true);
+    decoder_callbacks_->addDecodedData(chunks, true);
+  }
+}
+
 void AWSLambdaFilter::handleDefaultBody() {
   if ((!has_body_) && function_on_route_->defaultBody()) {
     Buffer::OwnedImpl data(function_on_route_->defaultBody().value());
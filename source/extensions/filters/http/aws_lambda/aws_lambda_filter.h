@@ -6,6 +6,7 @@
 #include "envoy/server/filter_config.h"
 #include "envoy/http/filter.h"
 #include "envoy/upstream/cluster_manager.h"
+#include "source/common/aws/event_stream_codec.h"
 #include "source/common/common/base64.h"
 #include "source/common/buffer/buffer_impl.h"
 
@@ -86,12 +87,23 @@ public:
   }
 
 private:
+  // The largest event of a streamed response, as limited by the event stream
+  // encoding
+  static constexpr size_t MaxResponseEventSize = 16 * 1024 * 1024;
+
   static const HeaderList HeadersToSign;
+  static const HeaderList UnsignedPayloadHeadersToSign;
+  static const HeaderList StreamingPayloadHeadersToSign;
 
   void handleDefaultBody();
 
   void finalizeRequest();
+  void signBufferedChunks();
   void finalizeResponse();
+  bool decodeResponseStream(Buffer::Instance &data, bool end_stream);
+  // Flags a response stream that ends before its InvokeComplete event
+  void checkResponseStreamEnd();
+  void onResponseStreamMessage(const AwsEventStream::Message &message);
   bool parseResponseAsALB(Http::ResponseHeaderMap&,
                           const Buffer::Instance&, Buffer::Instance&);
   bool isResponseTransformationNeeded();
@@ -112,6 +124,13 @@ private:
   Router::RouteConstSharedPtr route_;
   const AWSLambdaRouteConfig *function_on_route_{};
   bool has_body_{};
+  // Whether the headers are signed without the payload, and the body
+  // streamed
+  bool stream_body_{};
+  // Whether the streamed body is signed chunk by chunk
+  bool sign_chunks_{};
+  // Body bytes that do not fill a signed chunk yet
+  Buffer::OwnedImpl pending_chunk_;
 
   AWSLambdaConfigConstSharedPtr filter_config_;
 
@@ -128,6 +147,15 @@ private:
 
   // if end_stream_is true before stopping iteration
   bool end_stream_{};
+
+  // Decodes the event stream of an InvokeWithResponseStream response
+  std::unique_ptr<AwsEventStream::Decoder> response_decoder_;
+  // Payload of the decoded response events not yet forwarded
+  Buffer::OwnedImpl response_payload_;
+  // Whether the streamed response reported a function error, or ended early
+  bool response_stream_error_{};
+  // Whether the streamed response ended with an InvokeComplete event
+  bool response_stream_complete_{};
 };
 
 } // namespace AwsLambda
@@ -45,11 +45,14 @@ AWSLambdaConfigImpl::AWSLambdaConfigImpl(
     const envoy::config::filter::http::aws_lambda::v2::AWSLambdaConfig
         &protoconfig)
     : stats_(generateStats(stats_prefix, scope)), api_(api),
-      tls_(tls),
+      tls_(tls), signing_tls_(tls),
       credential_refresh_delay_(std::chrono::milliseconds(
         DurationUtil::durationToMilliseconds(
           protoconfig.credential_refresh_delay()))),
           propagate_original_routing_(protoconfig.propagate_original_routing()){
+  signing_tls_.set([](Event::Dispatcher &) {
+    return std::make_shared<ThreadLocalSigningState>();
+  });
 
 
   // Initialize Credential fetcher, if none exists do nothing. Filter will
@@ -81,14 +84,14 @@ AWSLambdaConfigImpl::AWSLambdaConfigImpl(
     // transfer ptr ownership to sts_factor isn't cleaned up before we get into
     // tls set
     sts_factory_ = std::move(sts_factory);
-    auto service_account_creds = protoconfig.service_account_credentials();
-    tls_.set([this, web_token = web_token_, role_arn = role_arn_,
-                    service_account_creds](Event::Dispatcher &dispatcher) {
-      StsCredentialsProviderPtr sts_cred_provider = sts_factory_->build(
-          service_account_creds, dispatcher, web_token, role_arn);
-      return std::make_shared<ThreadLocalCredentials>(
-          std::move(sts_cred_provider));
-    });
+    // Roles are assumed on the main thread and shared with the workers, so
+    // that each role is fetched once per refresh rather than once per worker.
+    sts_credentials_ = std::make_shared<StsCredentialsCache>(
+        dispatcher, tls, api_.timeSource(), api_.randomGenerator(),
+        StsCredentialsCache::generateStats(stats_prefix, scope),
+        sts_factory_->build(protoconfig.service_account_credentials(),
+                            dispatcher, web_token_, role_arn_),
+        role_arn_);
     sts_refresher_ = std::make_shared<AWSLambdaStsRefresher>(this, dispatcher);
     sts_refresher_->init(dispatcher);
     break;
@@ -166,10 +169,7 @@ void AWSLambdaConfigImpl::AWSLambdaStsRefresher::init(Event::Dispatcher &dispatc
               shared_this->parent_->stats_.webtoken_failure_.inc();
             }else{
               shared_this->parent_->stats_.webtoken_state_.set(1);
-              shared_this->parent_->tls_.runOnAllThreads(
-                  [web_token](OptRef<ThreadLocalCredentials> prev_config) {
-                    prev_config->sts_credentials_->setWebToken(web_token);
-                  });
+              shared_this->parent_->sts_credentials_->setWebToken(web_token);
             }
             // TODO: check if web_token is valid
             // TODO: stats here 
@@ -244,8 +244,8 @@ StsConnectionPool::Context *AWSLambdaConfigImpl::getCredentials(
   if (sts_refresher_ != nullptr) {
     ENVOY_LOG(trace, "{}: Credentials being retrieved from STS provider",
               __func__);
-    return tls_->sts_credentials_->find(ext_cfg->roleArn(),
-                             ext_cfg->disableRoleChaining(), callbacks);
+    return sts_credentials_->find(ext_cfg->roleArn(),
+                                  ext_cfg->disableRoleChaining(), callbacks);
   }
 
   ENVOY_LOG(debug, "{}: No valid credentials source found", __func__);
@@ -295,8 +295,12 @@ AWSLambdaRouteConfig::AWSLambdaRouteConfig(
     const envoy::config::filter::http::aws_lambda::v2::AWSLambdaPerRoute &protoconfig,
     Server::Configuration::ServerFactoryContext &context
     )
-    : path_(functionUrlPath(protoconfig.name(), protoconfig.qualifier())),
+    : path_(functionUrlPath(protoconfig.name(), protoconfig.qualifier(),
+                            protoconfig.response_streaming() &&
+                                !protoconfig.async())),
       async_(protoconfig.async()),
+      response_streaming_(protoconfig.response_streaming() &&
+                          !protoconfig.async()),
       unwrap_as_alb_(protoconfig.unwrap_as_alb()),
       has_transformer_config_(protoconfig.has_transformer_config())
     {
@@ -320,10 +324,16 @@ AWSLambdaRouteConfig::AWSLambdaRouteConfig(
 
 std::string
 AWSLambdaRouteConfig::functionUrlPath(const std::string &name,
-                                      const std::string &qualifier) {
+                                      const std::string &qualifier,
+                                      bool response_streaming) {
 
   std::stringstream val;
-  val << "/2015-03-31/functions/" << name << "/invocations";
+  if (response_streaming) {
+    val << "/2021-11-15/functions/" << name
+        << "/response-streaming-invocations";
+  } else {
+    val << "/2015-03-31/functions/" << name << "/invocations";
+  }
   if (!qualifier.empty()) {
     val << "?Qualifier=" << qualifier;
   }
@@ -347,6 +357,8 @@ AWSLambdaProtocolExtensionConfig::AWSLambdaProtocolExtensionConfig(
     role_arn_ = protoconfig.role_arn();
   }
   disable_role_chaining_ = protoconfig.disable_role_chaining();
+  unsigned_payload_ = protoconfig.unsigned_payload();
+  streaming_signed_payload_ = protoconfig.streaming_signed_payload();
 }
 
 } // namespace AwsLambda
@@ -9,7 +9,8 @@
 #include "envoy/upstream/cluster_manager.h"
 
 #include "source/extensions/common/aws/credentials_provider.h"
-#include "source/extensions/filters/http/aws_lambda/sts_credentials_provider.h"
+#include "source/extensions/filters/http/aws_lambda/aws_authenticator.h"
+#include "source/extensions/filters/http/aws_lambda/sts_credentials_cache.h"
 #include "source/extensions/filters/http/transformation/transformer.h"
 
 #include "absl/types/optional.h"
@@ -60,6 +61,8 @@ public:
   }
   const absl::optional<std::string> &roleArn() const { return role_arn_; }
   const bool &disableRoleChaining() const { return disable_role_chaining_; }
+  bool unsignedPayload() const { return unsigned_payload_; }
+  bool streamingSignedPayload() const { return streaming_signed_payload_; }
 
 private:
   std::string host_;
@@ -69,6 +72,8 @@ private:
   absl::optional<std::string> session_token_;
   absl::optional<std::string> role_arn_;
   bool disable_role_chaining_;
+  bool unsigned_payload_;
+  bool streaming_signed_payload_;
 };
 
 using SharedAWSLambdaProtocolExtensionConfig =
@@ -80,6 +85,10 @@ public:
   getCredentials(SharedAWSLambdaProtocolExtensionConfig ext_cfg,
                  StsConnectionPool::Context::Callbacks *callbacks) const PURE;
   virtual bool propagateOriginalRouting() const PURE;
+  // The signing key cache of the calling worker thread.
+  virtual SigningKeyCache &signingKeyCache() const PURE;
+  // The signing buffers of the calling worker thread.
+  virtual SigningScratch &signingScratch() const PURE;
   virtual ~AWSLambdaConfig() = default;
 };
 
@@ -111,6 +120,14 @@ public:
       return propagate_original_routing_;
     }
 
+  SigningKeyCache &signingKeyCache() const override {
+    return signing_tls_->signing_keys_;
+  }
+
+  SigningScratch &signingScratch() const override {
+    return signing_tls_->signing_scratch_;
+  }
+
 private:
 
   class AWSLambdaStsRefresher :
@@ -132,10 +149,12 @@ private:
   struct ThreadLocalCredentials : public Envoy::ThreadLocal::ThreadLocalObject {
     ThreadLocalCredentials(CredentialsConstSharedPtr credentials)
         : credentials_(credentials) {}
-    ThreadLocalCredentials(StsCredentialsProviderPtr credentials)
-        : sts_credentials_(std::move(credentials)) {}
     CredentialsConstSharedPtr credentials_;
-    StsCredentialsProviderPtr sts_credentials_;
+  };
+  struct ThreadLocalSigningState
+      : public Envoy::ThreadLocal::ThreadLocalObject {
+    SigningKeyCache signing_keys_;
+    SigningScratch signing_scratch_;
   };
 
   CredentialsConstSharedPtr getProviderCredentials() const;
@@ -157,11 +176,14 @@ private:
       provider_;
 
   ThreadLocal::TypedSlot<ThreadLocalCredentials> tls_;
+  ThreadLocal::TypedSlot<ThreadLocalSigningState> signing_tls_;
   std::string token_file_;
   std::string web_token_;
   std::string role_arn_;
 
   std::shared_ptr<AWSLambdaStsRefresher> sts_refresher_;
+  // Shared by the workers, fetches on the main thread
+  StsCredentialsCacheSharedPtr sts_credentials_;
 
   Event::TimerPtr timer_;
 
@@ -190,9 +212,11 @@ public:
   Transformation::TransformerConstSharedPtr requestTransformerConfig() const { return request_transformer_config_; }
   bool hasTransformerConfig() const { return has_transformer_config_; }
   bool hasRequestTransformerConfig() const { return request_transformer_config_ != nullptr; }
+  bool responseStreaming() const { return response_streaming_; }
 private:
   std::string path_;
   bool async_;
+  bool response_streaming_;
   bool unwrap_as_alb_;
   Transformation::TransformerConstSharedPtr transformer_config_;
   bool has_transformer_config_;
@@ -200,7 +224,8 @@ private:
   absl::optional<std::string> default_body_;
 
   static std::string functionUrlPath(const std::string &name,
-                                     const std::string &qualifier);
+                                     const std::string &qualifier,
+                                     bool response_streaming);
 };
 
 } // namespace AwsLambda
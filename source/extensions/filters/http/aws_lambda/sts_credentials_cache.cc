@@ -0,0 +1,293 @@
+#include "source/extensions/filters/http/aws_lambda/sts_credentials_cache.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+
+namespace {
+// Roles are refreshed between 1/2 and 3/4 of the lifetime of their
+// credentials, spread so that the roles of all the filter configs do not hit
+// STS at once.
+constexpr double REFRESH_LIFETIME_FRACTION = 0.5;
+constexpr double REFRESH_JITTER_FRACTION = 0.25;
+// Delay between the attempts of a failed refresh, which are given up once the
+// workers would fetch the role on their own.
+constexpr std::chrono::milliseconds REFRESH_RETRY_INTERVAL =
+    std::chrono::seconds(30);
+} // namespace
+
+StsCredentialsCache::StsCredentialsCache(Event::Dispatcher &main_dispatcher,
+                                         ThreadLocal::SlotAllocator &tls,
+                                         TimeSource &time_source,
+                                         Random::RandomGenerator &random,
+                                         const StsCredentialsCacheStats &stats,
+                                         StsCredentialsProviderPtr provider,
+                                         absl::string_view default_role_arn)
+    : main_dispatcher_(main_dispatcher), time_source_(time_source),
+      random_(random), stats_(stats), default_role_arn_(default_role_arn),
+      tls_(tls),
+      provider_(std::move(provider)) {
+  tls_.set([](Event::Dispatcher &dispatcher) {
+    return std::make_shared<ThreadLocalCache>(dispatcher);
+  });
+}
+
+StsCredentialsCache::~StsCredentialsCache() {
+  // The provider must not call back into the fetches once they are gone
+  for (auto &fetch : fetches_) {
+    if (fetch.second->context_ != nullptr) {
+      fetch.second->context_->cancel();
+    }
+  }
+}
+
+std::string StsCredentialsCache::cacheKey(const std::string &role_arn,
+                                          bool disable_role_chaining) {
+  // Same distinction as the provider's cache, so that chained and non-chained
+  // credentials of a role can both be served.
+  return disable_role_chaining ? "no-chain-" + role_arn : role_arn;
+}
+
+void StsCredentialsCache::setWebToken(absl::string_view web_token) {
+  provider_->setWebToken(web_token);
+}
+
+StsCredentialsCacheStats
+StsCredentialsCache::generateStats(const std::string &prefix,
+                                   Stats::Scope &scope) {
+  const std::string final_prefix = prefix + "aws_lambda.";
+  return {ALL_STS_CREDENTIALS_CACHE_STATS(
+      POOL_COUNTER_PREFIX(scope, final_prefix),
+      POOL_HISTOGRAM_PREFIX(scope, final_prefix))};
+}
+
+StsConnectionPool::Context *StsCredentialsCache::find(
+    const absl::optional<std::string> &role_arn, bool disable_role_chaining,
+    StsConnectionPool::Context::Callbacks *callbacks) {
+  const std::string key = cacheKey(role_arn.value_or(default_role_arn_),
+                                   disable_role_chaining);
+  ThreadLocalCache &cache = *tls_;
+
+  const auto cached = cache.credentials_.find(key);
+  if (cached != cache.credentials_.end() &&
+      cached->second.expiration_time_ - time_source_.systemTime() >
+          REFRESH_GRACE_PERIOD) {
+    // Only written when not set, so that the workers do not contend for it
+    std::atomic<bool> &used = *cached->second.used_;
+    if (!used.load(std::memory_order_relaxed)) {
+      used.store(true, std::memory_order_relaxed);
+    }
+    callbacks->onSuccess(cached->second.credentials_);
+    return nullptr;
+  }
+
+  // Only the first waiting request of the worker asks the main thread, which
+  // fetches the role at most once at a time for all workers.
+  std::list<ContextImplPtr> &waiting = cache.waiting_[key];
+  const bool first = waiting.empty();
+  auto context =
+      std::make_unique<ContextImpl>(callbacks, waiting, cache.dispatcher_);
+  ContextImpl *context_ptr = context.get();
+  LinkedList::moveIntoList(std::move(context), waiting);
+  if (!first) {
+    return context_ptr;
+  }
+
+  ENVOY_LOG(trace, "{}: requesting credentials for {}", __func__, key);
+  main_dispatcher_.post([weak_this = weak_from_this(), key, role_arn,
+                         disable_role_chaining]() {
+    if (auto shared_this = weak_this.lock()) {
+      shared_this->fetch(key, role_arn, disable_role_chaining, false);
+    }
+  });
+  // Posts are always queued, so the context is completed later, on this
+  // worker, once the main thread publishes the result.
+  return context_ptr;
+}
+
+void StsCredentialsCache::fetch(const std::string &key,
+                                const absl::optional<std::string> &role_arn,
+                                bool disable_role_chaining, bool refresh) {
+  if (fetches_.contains(key)) {
+    ENVOY_LOG(trace, "{}: joining the fetch in flight for {}", __func__, key);
+    return;
+  }
+  auto refresh_it = refreshes_.find(key);
+  if (refresh_it == refreshes_.end()) {
+    refresh_it =
+        refreshes_
+            .emplace(key, std::make_unique<Refresh>(Refresh{
+                              role_arn, disable_role_chaining, SystemTime(),
+                              nullptr, std::make_shared<std::atomic<bool>>()}))
+            .first;
+  }
+  if (!refresh) {
+    // Requested by a worker
+    refresh_it->second->used_->store(true, std::memory_order_relaxed);
+  }
+  Fetch *fetch =
+      fetches_
+          .emplace(key, std::make_unique<Fetch>(
+                            *this, key, time_source_.monotonicTime(), refresh))
+          .first->second.get();
+  StsConnectionPool::Context *context =
+      refresh ? provider_->refresh(role_arn, disable_role_chaining, fetch)
+              : provider_->find(role_arn, disable_role_chaining, fetch);
+  // The provider completes the fetch before returning when it has fresh
+  // credentials, in which case it is already erased.
+  const auto in_flight = fetches_.find(key);
+  if (in_flight != fetches_.end() && in_flight->second.get() == fetch) {
+    fetch->context_ = context;
+  }
+}
+
+StsCredentialsCache::FetchPtr
+StsCredentialsCache::completeFetch(const std::string &key) {
+  auto node = fetches_.extract(key);
+  ASSERT(!node.empty());
+  FetchPtr fetch = std::move(node.mapped());
+  // Fetches completed before the provider returned did not reach STS
+  if (fetch->context_ != nullptr) {
+    stats_.sts_fetch_latency_.recordValue(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            time_source_.monotonicTime() - fetch->start_time_)
+            .count());
+  }
+  return fetch;
+}
+
+void StsCredentialsCache::scheduleRefresh(const std::string &key,
+                                          SystemTime expiration_time) {
+  Refresh &refresh = *refreshes_.at(key);
+  refresh.expiration_time_ = expiration_time;
+  refresh.retry_ = false;
+  if (refresh.timer_ == nullptr) {
+    refresh.timer_ =
+        main_dispatcher_.createTimer([this, key]() { onRefreshTimer(key); });
+  }
+
+  const auto lifetime = std::chrono::duration_cast<std::chrono::milliseconds>(
+      expiration_time - time_source_.systemTime());
+  // The refresh must be done before the workers fetch the role on their own
+  const auto latest = lifetime - REFRESH_GRACE_PERIOD - REFRESH_RETRY_INTERVAL;
+  if (latest <= std::chrono::milliseconds::zero()) {
+    ENVOY_LOG(debug, "{}: credentials of {} are too short lived to refresh",
+              __func__, key);
+    refresh.timer_->disableTimer();
+    return;
+  }
+  const double fraction =
+      REFRESH_LIFETIME_FRACTION +
+      REFRESH_JITTER_FRACTION * (random_.random() % 1000) / 1000;
+  const std::chrono::milliseconds delay = std::min(
+      std::chrono::milliseconds(
+          static_cast<int64_t>(static_cast<double>(lifetime.count()) * fraction)),
+      latest);
+  ENVOY_LOG(trace, "{}: refreshing {} in {}ms", __func__, key, delay.count());
+  refresh.timer_->enableTimer(delay);
+}
+
+void StsCredentialsCache::retryRefresh(const std::string &key) {
+  Refresh &refresh = *refreshes_.at(key);
+  // Nothing to keep fresh if the role was never fetched
+  if (refresh.timer_ == nullptr) {
+    return;
+  }
+  if (refresh.expiration_time_ - time_source_.systemTime() >
+      REFRESH_GRACE_PERIOD + REFRESH_RETRY_INTERVAL) {
+    refresh.retry_ = true;
+    refresh.timer_->enableTimer(REFRESH_RETRY_INTERVAL);
+  } else {
+    // The next request of a worker fetches the role again
+    refresh.timer_->disableTimer();
+  }
+}
+
+void StsCredentialsCache::onRefreshTimer(const std::string &key) {
+  const auto it = refreshes_.find(key);
+  ASSERT(it != refreshes_.end());
+  const Refresh &refresh = *it->second;
+  if (!refresh.retry_ && !refresh.used_->exchange(false) &&
+      !fetches_.contains(key)) {
+    // The workers keep their credentials until they expire, and then fetch
+    // the role again if it is still used.
+    ENVOY_LOG(debug, "{}: {} was not used since its last refresh, dropping it",
+              __func__, key);
+    refreshes_.erase(it);
+    return;
+  }
+  fetch(key, refresh.role_arn_, refresh.disable_role_chaining_, true);
+}
+
+void StsCredentialsCache::onFetchSuccess(
+    std::string key,
+    std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+        credentials) {
+  const FetchPtr fetch = completeFetch(key);
+  if (fetch->refresh_) {
+    stats_.sts_refresh_success_.inc();
+  }
+
+  // Credentials without an expiration are handed to the waiting requests but
+  // neither kept nor refreshed.
+  const auto sts_credentials =
+      std::dynamic_pointer_cast<const StsCredentials>(credentials);
+  if (sts_credentials != nullptr) {
+    scheduleRefresh(key, sts_credentials->expirationTime());
+  }
+  const CachedCredentials cached{std::move(credentials),
+                                 sts_credentials != nullptr
+                                     ? sts_credentials->expirationTime()
+                                     : SystemTime(),
+                                 refreshes_.at(key)->used_};
+  tls_.runOnAllThreads([key, cached](OptRef<ThreadLocalCache> cache) {
+    cache->onSuccess(key, cached);
+  });
+}
+
+void StsCredentialsCache::onFetchFailure(std::string key,
+                                         CredentialsFailureStatus status) {
+  const FetchPtr fetch = completeFetch(key);
+  if (fetch->refresh_) {
+    stats_.sts_refresh_failed_.inc();
+  }
+  retryRefresh(key);
+  tls_.runOnAllThreads([key, status](OptRef<ThreadLocalCache> cache) {
+    cache->onFailure(key, status);
+  });
+}
+
+void StsCredentialsCache::ThreadLocalCache::onSuccess(
+    const std::string &key, const CachedCredentials &cached) {
+  if (cached.expiration_time_ != SystemTime()) {
+    credentials_[key] = cached;
+  }
+  const auto waiting = waiting_.find(key);
+  if (waiting == waiting_.end()) {
+    return;
+  }
+  while (!waiting->second.empty()) {
+    waiting->second.back()->callbacks()->onSuccess(cached.credentials_);
+    waiting->second.pop_back();
+  }
+}
+
+void StsCredentialsCache::ThreadLocalCache::onFailure(
+    const std::string &key, CredentialsFailureStatus status) {
+  const auto waiting = waiting_.find(key);
+  if (waiting == waiting_.end()) {
+    return;
+  }
+  while (!waiting->second.empty()) {
+    waiting->second.back()->callbacks()->onFailure(status);
+    waiting->second.pop_back();
+  }
+}
+
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "envoy/common/random_generator.h"
+#include "envoy/common/time.h"
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/stats/scope.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "source/common/common/linked_object.h"
+#include "source/common/common/logger.h"
+#include "source/extensions/filters/http/aws_lambda/sts_credentials_provider.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+
+/**
+ * All stats for the shared STS credentials. @see stats_macros.h
+ */
+#define ALL_STS_CREDENTIALS_CACHE_STATS(COUNTER, HISTOGRAM)                    \
+  COUNTER(sts_refresh_success)                                                 \
+  COUNTER(sts_refresh_failed)                                                  \
+  HISTOGRAM(sts_fetch_latency, Milliseconds)
+
+/**
+ * Wrapper struct for the shared STS credentials stats. @see stats_macros.h
+ */
+struct StsCredentialsCacheStats {
+  ALL_STS_CREDENTIALS_CACHE_STATS(GENERATE_COUNTER_STRUCT,
+                                  GENERATE_HISTOGRAM_STRUCT)
+};
+
+class StsCredentialsCache;
+using StsCredentialsCacheSharedPtr = std::shared_ptr<StsCredentialsCache>;
+
+/**
+ * STS credentials shared by all the workers of a filter config. Roles are
+ * assumed on the main thread by a single StsCredentialsProvider, so a role is
+ * fetched once per refresh instead of once per worker, and each result is
+ * published to a thread local snapshot on every worker. A worker that misses
+ * its snapshot waits for the one fetch in flight for the role.
+ *
+ * Every role fetched once is then refreshed in the background, at a jittered
+ * fraction of the lifetime of its credentials, so that requests do not wait
+ * on STS once the role is cached. A role that no request has used since the
+ * previous refresh is no longer refreshed, and is fetched again on its next
+ * use once its credentials expire.
+ *
+ * Must be created and destroyed on the main thread; find() is called on the
+ * workers.
+ */
+class StsCredentialsCache
+    : public std::enable_shared_from_this<StsCredentialsCache>,
+      public Logger::Loggable<Logger::Id::aws> {
+public:
+  /**
+   * @param main_dispatcher the dispatcher of the main thread
+   * @param random picks the jitter of the refreshes
+   * @param provider assumes the roles, on the main thread
+   * @param default_role_arn the role used when a request names none
+   */
+  StsCredentialsCache(Event::Dispatcher &main_dispatcher,
+                      ThreadLocal::SlotAllocator &tls, TimeSource &time_source,
+                      Random::RandomGenerator &random,
+                      const StsCredentialsCacheStats &stats,
+                      StsCredentialsProviderPtr provider,
+                      absl::string_view default_role_arn);
+  ~StsCredentialsCache();
+
+  /**
+   * Same contract as StsCredentialsProvider::find(): the callbacks are either
+   * called before returning, with nullptr returned, or later, unless the
+   * returned context is cancelled first.
+   */
+  StsConnectionPool::Context *
+  find(const absl::optional<std::string> &role_arn, bool disable_role_chaining,
+       StsConnectionPool::Context::Callbacks *callbacks);
+
+  // Sets the web token of the following fetches. Main thread only.
+  void setWebToken(absl::string_view web_token);
+
+  // @param prefix the stats prefix of the filter
+  static StsCredentialsCacheStats generateStats(const std::string &prefix,
+                                                Stats::Scope &scope);
+
+private:
+  // Set by the workers whenever they serve the credentials of a role, and
+  // cleared by each refresh of the role.
+  using UsedFlagSharedPtr = std::shared_ptr<std::atomic<bool>>;
+
+  struct CachedCredentials {
+    std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+        credentials_;
+    SystemTime expiration_time_;
+    UsedFlagSharedPtr used_;
+  };
+
+  class ContextImpl : public StsConnectionPool::Context,
+                      public Event::DeferredDeletable,
+                      public LinkedObject<ContextImpl> {
+  public:
+    ContextImpl(StsConnectionPool::Context::Callbacks *callbacks,
+                std::list<std::unique_ptr<ContextImpl>> &waiting,
+                Event::Dispatcher &dispatcher)
+        : callbacks_(callbacks), waiting_(waiting), dispatcher_(dispatcher) {}
+
+    StsConnectionPool::Context::Callbacks *callbacks() const override {
+      return callbacks_;
+    }
+    void cancel() override {
+      ASSERT(inserted());
+      if (inserted()) {
+        dispatcher_.deferredDelete(removeFromList(waiting_));
+      }
+    }
+
+  private:
+    StsConnectionPool::Context::Callbacks *callbacks_;
+    std::list<std::unique_ptr<ContextImpl>> &waiting_;
+    Event::Dispatcher &dispatcher_;
+  };
+  using ContextImplPtr = std::unique_ptr<ContextImpl>;
+
+  // The snapshot and the waiting requests of one worker, keyed like the
+  // provider's cache.
+  struct ThreadLocalCache : public ThreadLocal::ThreadLocalObject {
+    ThreadLocalCache(Event::Dispatcher &dispatcher) : dispatcher_(dispatcher) {}
+
+    void onSuccess(const std::string &key, const CachedCredentials &cached);
+    void onFailure(const std::string &key, CredentialsFailureStatus status);
+
+    Event::Dispatcher &dispatcher_;
+    absl::flat_hash_map<std::string, CachedCredentials> credentials_;
+    // The lists are referenced by their contexts, so they must not move.
+    absl::node_hash_map<std::string, std::list<ContextImplPtr>> waiting_;
+  };
+
+  // A fetch of the provider on the main thread
+  class Fetch : public StsConnectionPool::Context::Callbacks {
+  public:
+    Fetch(StsCredentialsCache &parent, const std::string &key,
+          MonotonicTime start_time, bool refresh)
+        : start_time_(start_time), refresh_(refresh), parent_(parent),
+          key_(key) {}
+
+    void onSuccess(
+        std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+            credentials) override {
+      parent_.onFetchSuccess(key_, std::move(credentials));
+    }
+    void onFailure(CredentialsFailureStatus status) override {
+      parent_.onFetchFailure(key_, status);
+    }
+
+    // Not set when the provider completes the fetch before returning
+    StsConnectionPool::Context *context_{};
+    const MonotonicTime start_time_;
+    // Started by the refresh timer rather than by a request
+    const bool refresh_;
+
+  private:
+    StsCredentialsCache &parent_;
+    const std::string key_;
+  };
+
+  using FetchPtr = std::unique_ptr<Fetch>;
+
+  // The background refresh of a role, on the main thread
+  struct Refresh {
+    absl::optional<std::string> role_arn_;
+    bool disable_role_chaining_;
+    // Expiration of the credentials the workers hold
+    SystemTime expiration_time_;
+    Event::TimerPtr timer_;
+    UsedFlagSharedPtr used_;
+    // Whether the timer retries a failed refresh, which is done regardless of
+    // the use of the role.
+    bool retry_{};
+  };
+
+  static std::string cacheKey(const std::string &role_arn,
+                              bool disable_role_chaining);
+
+  // Main thread
+  void fetch(const std::string &key,
+             const absl::optional<std::string> &role_arn,
+             bool disable_role_chaining, bool refresh);
+  FetchPtr completeFetch(const std::string &key);
+  void scheduleRefresh(const std::string &key, SystemTime expiration_time);
+  void retryRefresh(const std::string &key);
+  void onRefreshTimer(const std::string &key);
+  void onFetchSuccess(
+      std::string key,
+      std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+          credentials);
+  void onFetchFailure(std::string key, CredentialsFailureStatus status);
+
+  Event::Dispatcher &main_dispatcher_;
+  TimeSource &time_source_;
+  Random::RandomGenerator &random_;
+  StsCredentialsCacheStats stats_;
+  const std::string default_role_arn_;
+  ThreadLocal::TypedSlot<ThreadLocalCache> tls_;
+  StsCredentialsProviderPtr provider_;
+  absl::flat_hash_map<std::string, FetchPtr> fetches_;
+  // Keyed like the fetches, so that the refresh of a role joins its fetch in
+  // flight.
+  absl::flat_hash_map<std::string, std::unique_ptr<Refresh>> refreshes_;
+};
+
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -33,6 +33,11 @@ public:
       bool disable_role_chaining,
         StsConnectionPool::Context::Callbacks *callbacks) override;
 
+  StsConnectionPool::Context *
+  refresh(const absl::optional<std::string> &role_arn_arg,
+          bool disable_role_chaining,
+          StsConnectionPool::Context::Callbacks *callbacks) override;
+
   void setWebToken(std::string_view web_token) override;
 
   void onResult(std::shared_ptr<const StsCredentials>,
@@ -42,6 +47,11 @@ public:
               std::list<std::string>  &chained_requests) override; 
 
 private:
+  StsConnectionPool::Context *
+  assumeRole(const absl::optional<std::string> &role_arn_arg,
+             bool disable_role_chaining, bool use_cache,
+             StsConnectionPool::Context::Callbacks *callbacks);
+
   Api::Api &api_;
   Upstream::ClusterManager &cm_;
   const envoy::config::filter::http::aws_lambda::v2::
@@ -127,6 +137,22 @@ StsConnectionPool::Context *StsCredentialsProviderImpl::find(
     const absl::optional<std::string> &role_arn_arg,
     bool disable_role_chaining,
     StsConnectionPool::Context::Callbacks *callbacks) {
+  return assumeRole(role_arn_arg, disable_role_chaining, true, callbacks);
+}
+
+// Chained roles still reuse the cached base credentials, which are refreshed
+// on their own.
+StsConnectionPool::Context *StsCredentialsProviderImpl::refresh(
+    const absl::optional<std::string> &role_arn_arg,
+    bool disable_role_chaining,
+    StsConnectionPool::Context::Callbacks *callbacks) {
+  return assumeRole(role_arn_arg, disable_role_chaining, false, callbacks);
+}
+
+StsConnectionPool::Context *StsCredentialsProviderImpl::assumeRole(
+    const absl::optional<std::string> &role_arn_arg,
+    bool disable_role_chaining, bool use_cache,
+    StsConnectionPool::Context::Callbacks *callbacks) {
 
   std::string role_arn = default_role_arn_;
  
@@ -148,7 +174,7 @@ StsConnectionPool::Context *StsCredentialsProviderImpl::find(
   ENVOY_LOG(trace, "{}: Attempting to assume role ({})", __func__, role_arn);
 
   const auto existing_token = credentials_cache_.find(role_arn_lookup);
-  if (existing_token != credentials_cache_.end()) {
+  if (use_cache && existing_token != credentials_cache_.end()) {
     // thing  exists
     const auto now = api_.timeSource().systemTime();
     // If the expiration time is more than a minute away, return it immediately
@@ -36,6 +36,13 @@ public:
       bool disable_role_chaining,
        StsConnectionPool::Context::Callbacks *callbacks) PURE;
 
+  // Same as find(), but assumes the role even if its cached credentials are
+  // still fresh.
+  virtual StsConnectionPool::Context *
+  refresh(const absl::optional<std::string> &role_arn,
+          bool disable_role_chaining,
+          StsConnectionPool::Context::Callbacks *callbacks) PURE;
+
   virtual void setWebToken(std::string_view web_token) PURE;
 
   static StsCredentialsProviderPtr
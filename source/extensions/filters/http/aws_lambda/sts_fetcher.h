@@ -8,7 +8,6 @@
 #include "source/extensions/common/aws/credentials_provider.h"
 #include "source/extensions/filters/http/aws_lambda/aws_authenticator.h"
 #include "source/extensions/filters/http/aws_lambda/sts_status.h"
-#include "source/extensions/filters/http/aws_lambda/sts_response_parser.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -0,0 +1,82 @@
+#include "source/extensions/filters/http/aws_lambda/sts_response_parser.h"
+
+#include "absl/strings/match.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+
+namespace {
+
+struct Element {
+  absl::string_view name_;
+  absl::string_view StsResponseFields::*field_;
+};
+
+constexpr Element Elements[] = {
+    {"AccessKeyId", &StsResponseFields::access_key_id_},
+    {"SecretAccessKey", &StsResponseFields::secret_access_key_},
+    {"SessionToken", &StsResponseFields::session_token_},
+    {"Expiration", &StsResponseFields::expiration_},
+};
+constexpr size_t ElementCount = sizeof(Elements) / sizeof(Elements[0]);
+
+// @return the position of the `</name>` tag at or after `pos`, or npos
+size_t findClosingTag(absl::string_view body, size_t pos,
+                      absl::string_view name) {
+  while ((pos = body.find("</", pos)) != absl::string_view::npos) {
+    const absl::string_view tag = body.substr(pos + 2);
+    if (absl::StartsWith(tag, name) && tag.size() > name.size() &&
+        tag[name.size()] == '>') {
+      return pos;
+    }
+    pos += 2;
+  }
+  return absl::string_view::npos;
+}
+
+} // namespace
+
+bool StsResponseParser::parse(absl::string_view body,
+                              StsResponseFields &fields) {
+  fields = {};
+  bool found[ElementCount] = {};
+  size_t found_count = 0;
+  size_t pos = 0;
+
+  while (found_count < ElementCount) {
+    const size_t open = body.find('<', pos);
+    if (open == absl::string_view::npos) {
+      return false;
+    }
+    const size_t open_end = body.find('>', open + 1);
+    if (open_end == absl::string_view::npos) {
+      return false;
+    }
+    const absl::string_view name = body.substr(open + 1, open_end - open - 1);
+    pos = open_end + 1;
+
+    for (size_t i = 0; i < ElementCount; i++) {
+      if (found[i] || name != Elements[i].name_) {
+        continue;
+      }
+      const size_t close = findClosingTag(body, pos, name);
+      if (close == absl::string_view::npos) {
+        return false;
+      }
+      fields.*Elements[i].field_ = body.substr(pos, close - pos);
+      found[i] = true;
+      found_count++;
+      // Resume after the closing tag, the value holds no element we need
+      pos = close + name.size() + 3;
+      break;
+    }
+  }
+  return true;
+}
+
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -13,9 +13,14 @@
 #include "source/common/grpc/common.h"
 #include "source/common/http/solo_filter_utility.h"
 #include "source/common/http/utility.h"
+#include "source/common/nats/message_builder.h"
+#include "source/common/nats/streaming/message_utility.h"
 
 #include "source/extensions/filters/http/solo_well_known_names.h"
 
+#include "absl/strings/match.h"
+#include "absl/strings/strip.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace HttpFilters {
@@ -42,6 +47,13 @@ void NatsStreamingFilter::onDestroy() {
     in_flight_request_->cancel();
     in_flight_request_ = nullptr;
   }
+
+  if (window_watch_ != nullptr) {
+    // The watermark was raised when the watch started.
+    decoder_callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+    window_watch_->cancel();
+    window_watch_ = nullptr;
+  }
 }
 
 Http::FilterHeadersStatus
@@ -53,19 +65,46 @@ NatsStreamingFilter::decodeHeaders(Envoy::Http::RequestHeaderMap &headers,
     return Http::FilterHeadersStatus::Continue;
   }
 
+  selected_client_ = &nats_streaming_client_->selectClient(
+      optional_route_specific_filter_config_.value()->subject());
+
   // Fill in the headers.
-  // TODO(talnordan): Consider extracting a common utility function which
-  // converts a `HeaderMap` to a Protobuf `Map`, to reduce code duplication
-  // with `Filters::Common::ExtAuthz::CheckRequestUtils::setHttpRequest()`.
-  auto *mutable_headers = payload_.mutable_headers();
-  headers.iterate([mutable_headers](const Envoy::Http::HeaderEntry &e) {
-    (*mutable_headers)[std::string(e.key().getStringView())] =
-        std::string(e.value().getStringView());
-    return Envoy::Http::HeaderMap::Iterate::Continue;
-  });
+  if (config_->natsHeaders()) {
+    // NATS header names are like HTTP/1 ones, so pseudo-headers lose their
+    // `:`. Repeated headers stay separate lines, as NATS allows. The `Nats-`
+    // headers control how JetStream stores a message, e.g. `Nats-Msg-Id` or
+    // `Nats-Rollup`, so the client is not allowed to set them.
+    headers.iterate([this](const Envoy::Http::HeaderEntry &e) {
+      if (absl::StartsWithIgnoreCase(e.key().getStringView(), "nats-")) {
+        return Envoy::Http::HeaderMap::Iterate::Continue;
+      }
+      Envoy::Nats::MessageBuilder::addHeader(
+          absl::StripPrefix(e.key().getStringView(), ":"),
+          e.value().getStringView(), headers_);
+      return Envoy::Http::HeaderMap::Iterate::Continue;
+    });
+  } else {
+    // TODO(talnordan): Consider extracting a common utility function which
+    // converts a `HeaderMap` to a Protobuf `Map`, to reduce code duplication
+    // with `Filters::Common::ExtAuthz::CheckRequestUtils::setHttpRequest()`.
+    auto *mutable_headers = payload_.mutable_headers();
+    headers.iterate([mutable_headers](const Envoy::Http::HeaderEntry &e) {
+      (*mutable_headers)[std::string(e.key().getStringView())] =
+          std::string(e.value().getStringView());
+      return Envoy::Http::HeaderMap::Iterate::Continue;
+    });
+  }
 
   if (end_stream) {
     relayToNatsStreaming();
+  } else {
+    // Stop reading the body while requests are queued behind a full publish
+    // window, rather than buffering yet another request.
+    window_watch_ = selected_client_->watchWindow(
+        optional_route_specific_filter_config_.value()->subject(), *this);
+    if (window_watch_ != nullptr) {
+      decoder_callbacks_->onDecoderFilterAboveWriteBufferHighWatermark();
+    }
   }
 
   return Http::FilterHeadersStatus::StopIteration;
@@ -124,6 +163,16 @@ void NatsStreamingFilter::onTimeout() {
                StreamInfo::CoreResponseFlag::UpstreamRequestTimeout);
 }
 
+void NatsStreamingFilter::onOverflow() {
+  onCompletion(Http::Code::ServiceUnavailable, "nats streaming filter overflow",
+               StreamInfo::CoreResponseFlag::UpstreamOverflow);
+}
+
+void NatsStreamingFilter::onWindowOpen() {
+  window_watch_ = nullptr;
+  decoder_callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+}
+
 void NatsStreamingFilter::retrieveRouteSpecificFilterConfig() {
 
   const auto *route_local = Http::Utility::resolveMostSpecificPerFilterConfig<
@@ -154,11 +203,20 @@ void NatsStreamingFilter::relayToNatsStreaming() {
   const std::string &discover_prefix =
       route_specific_filter_config->discoverPrefix();
 
-  // TODO(talnordan): Consider minimizing content copying.
-  payload_.set_body(body_.toString());
-  std::string payload_string = payload_.SerializeAsString();
-  in_flight_request_ = nats_streaming_client_->makeRequest(
-      subject, cluster_id, discover_prefix, std::move(payload_string), *this);
+  if (config_->natsHeaders()) {
+    // The body is published as is, after the headers.
+    in_flight_request_ = selected_client_->makeRequest(
+        subject, cluster_id, discover_prefix, headers_, body_, *this);
+    return;
+  }
+
+  // The body is moved after the serialized headers rather than being copied
+  // into the payload.
+  Buffer::OwnedImpl payload(payload_.SerializeAsString());
+  Envoy::Nats::Streaming::MessageUtility::moveBytesField(
+      pb::Payload::kBodyFieldNumber, body_, payload);
+  in_flight_request_ = selected_client_->makeRequest(
+      subject, cluster_id, discover_prefix, headers_, payload, *this);
 }
 
 void NatsStreamingFilter::onCompletion(Http::Code response_code,
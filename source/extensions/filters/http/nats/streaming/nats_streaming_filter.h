@@ -17,7 +17,8 @@ namespace Streaming {
 using Upstream::ClusterManager;
 
 class NatsStreamingFilter : public Http::StreamDecoderFilter,
-                            public Envoy::Nats::Streaming::PublishCallbacks {
+                            public Envoy::Nats::Streaming::PublishCallbacks,
+                            public Envoy::Nats::Streaming::WindowCallbacks {
 public:
   NatsStreamingFilter(NatsStreamingFilterConfigSharedPtr config,
                       Envoy::Nats::Streaming::ClientPtr nats_streaming_client);
@@ -45,6 +46,10 @@ public:
   virtual void onResponse() override;
   virtual void onFailure() override;
   virtual void onTimeout() override;
+  virtual void onOverflow() override;
+
+  // Nats::Streaming::WindowCallbacks
+  virtual void onWindowOpen() override;
 
 private:
   void retrieveRouteSpecificFilterConfig();
@@ -64,14 +69,20 @@ private:
 
   const NatsStreamingFilterConfigSharedPtr config_;
   Envoy::Nats::Streaming::ClientPtr nats_streaming_client_;
+  // Selected once the subject is known, so that the window watched is the one
+  // the request is published in.
+  Envoy::Nats::Streaming::Client *selected_client_{};
   Router::RouteConstSharedPtr route_;
   absl::optional<const NatsStreamingRouteSpecificFilterConfig *>
       optional_route_specific_filter_config_;
   Http::StreamDecoderFilterCallbacks *decoder_callbacks_{};
   absl::optional<uint32_t> decoder_buffer_limit_{};
   pb::Payload payload_;
+  // The NATS headers, used instead of `payload_` when the config enables them.
+  Buffer::OwnedImpl headers_{};
   Buffer::OwnedImpl body_{};
   Envoy::Nats::Streaming::PublishRequestPtr in_flight_request_{};
+  Envoy::Nats::Streaming::WindowWatchPtr window_watch_{};
 };
 
 } // namespace Streaming
@@ -5,6 +5,7 @@
 
 #include "envoy/upstream/cluster_manager.h"
 
+#include "source/common/nats/streaming/client_pool.h"
 #include "source/common/protobuf/utility.h"
 
 #include "api/envoy/config/filter/http/nats/streaming/v2/nats_streaming.pb.validate.h"
@@ -25,10 +26,29 @@ public:
                             Upstream::ClusterManager &clusterManager)
       : op_timeout_(PROTOBUF_GET_MS_OR_DEFAULT(proto_config, op_timeout, 5000)),
         cluster_(proto_config.cluster()),
-        max_connections_(proto_config.max_connections()) {
-    if (max_connections_ != 1) {
-      throw EnvoyException("nats-streaming filter: only one concurrent "
-                           "connection is currently supported");
+        protocol_(proto_config.protocol() == ProtoConfig::JETSTREAM
+                      ? Envoy::Nats::Streaming::Protocol::JetStream
+                      : Envoy::Nats::Streaming::Protocol::NatsStreaming),
+        max_connections_(proto_config.max_connections()),
+        max_inflight_(proto_config.max_inflight()),
+        max_pending_(proto_config.max_pending() == 0
+                         ? 1024
+                         : proto_config.max_pending()),
+        connection_selection_(
+            proto_config.connection_selection() == ProtoConfig::SUBJECT_HASH
+                ? Envoy::Nats::Streaming::ConnectionSelection::SubjectHash
+                : Envoy::Nats::Streaming::ConnectionSelection::RoundRobin),
+        prewarm_cluster_id_(proto_config.prewarm().cluster_id()),
+        prewarm_discover_prefix_(proto_config.prewarm().discover_prefix()),
+        nats_headers_(proto_config.nats_headers()) {
+    if (max_connections_ == 0) {
+      throw EnvoyException(
+          "nats-streaming filter: max_connections must be at least 1");
+    }
+    if (nats_headers_ &&
+        protocol_ != Envoy::Nats::Streaming::Protocol::JetStream) {
+      throw EnvoyException("nats-streaming filter: nats_headers requires the "
+                           "JETSTREAM protocol");
     }
     if (!clusterManager.clusters().hasCluster(cluster_)) {
       throw EnvoyException(fmt::format(
@@ -38,12 +58,32 @@ public:
 
   const std::chrono::milliseconds &opTimeout() const { return op_timeout_; }
   const std::string &cluster() const { return cluster_; }
+  Envoy::Nats::Streaming::Protocol protocol() const { return protocol_; }
   uint32_t maxConnections() const { return max_connections_; }
+  uint32_t maxInflight() const { return max_inflight_; }
+  uint32_t maxPending() const { return max_pending_; }
+  Envoy::Nats::Streaming::ConnectionSelection connectionSelection() const {
+    return connection_selection_;
+  }
+  // Empty unless the connections are made ahead of the first request.
+  const std::string &prewarmClusterId() const { return prewarm_cluster_id_; }
+  const std::string &prewarmDiscoverPrefix() const {
+    return prewarm_discover_prefix_;
+  }
+  // Whether the HTTP headers are published as NATS headers.
+  bool natsHeaders() const { return nats_headers_; }
 
 private:
   std::chrono::milliseconds op_timeout_;
   std::string cluster_;
+  Envoy::Nats::Streaming::Protocol protocol_;
   uint32_t max_connections_;
+  uint32_t max_inflight_;
+  uint32_t max_pending_;
+  Envoy::Nats::Streaming::ConnectionSelection connection_selection_;
+  std::string prewarm_cluster_id_;
+  std::string prewarm_discover_prefix_;
+  bool nats_headers_;
 };
 
 typedef std::shared_ptr<NatsStreamingFilterConfig>
@@ -20,7 +20,8 @@ Http::FilterFactoryCb
 NatsStreamingFilterConfigFactory::createFilterFactoryFromProtoTyped(
     const envoy::config::filter::http::nats::streaming::v2::NatsStreaming
         &proto_config,
-    const std::string &, Server::Configuration::FactoryContext &context) {
+    const std::string &stats_prefix,
+    Server::Configuration::FactoryContext &context) {
 
   NatsStreamingFilterConfigSharedPtr config =
       std::make_shared<NatsStreamingFilterConfig>(
@@ -34,7 +35,14 @@ NatsStreamingFilterConfigFactory::createFilterFactoryFromProtoTyped(
   Envoy::Nats::Streaming::ClientPtr nats_streaming_client =
       std::make_shared<Envoy::Nats::Streaming::ClientPool>(
           config->cluster(), context.serverFactoryContext().clusterManager(), client_factory,
-          context.serverFactoryContext().threadLocal(), context.serverFactoryContext().api().randomGenerator(), config->opTimeout());
+          context.serverFactoryContext().threadLocal(),
+          context.serverFactoryContext().mainThreadDispatcher(),
+          context.serverFactoryContext().api().randomGenerator(), config->opTimeout(),
+          config->protocol(), config->maxConnections(), config->connectionSelection(),
+          config->maxInflight(), config->maxPending(),
+          config->prewarmClusterId(), config->prewarmDiscoverPrefix(),
+          Envoy::Nats::Streaming::ClientBase::generateStats(stats_prefix,
+                                                            context.scope()));
 
   return [config, nats_streaming_client](
              Envoy::Http::FilterChainFactoryCallbacks &callbacks) -> void {
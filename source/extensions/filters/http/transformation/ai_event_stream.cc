@@ -0,0 +1,165 @@
+#include "source/extensions/filters/http/transformation/ai_event_stream.h"
+
+#include <algorithm>
+
+#include "absl/strings/match.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+AiEventStreamSplitter::AiEventStreamSplitter(size_t max_event_size,
+                                             EventCallback on_event)
+    : max_event_size_(max_event_size), on_event_(std::move(on_event)),
+      aws_decoder_(max_event_size,
+                   [this](const AwsEventStream::Message &message) {
+                     onAwsEventStreamMessage(message);
+                   }) {}
+
+AiEventStreamSplitter::Format
+AiEventStreamSplitter::formatForContentType(absl::string_view content_type) {
+  if (absl::StartsWithIgnoreCase(
+          content_type, AiEventStreamConstants::get().EventStreamContentType)) {
+    return Format::ServerSentEvents;
+  }
+  if (absl::StartsWithIgnoreCase(
+          content_type,
+          AiEventStreamConstants::get().AwsEventStreamContentType)) {
+    return Format::AwsEventStream;
+  }
+  return Format::None;
+}
+
+void AiEventStreamSplitter::parse(absl::string_view data) {
+  switch (format_) {
+  case Format::ServerSentEvents:
+    parseServerSentEvents(data);
+    break;
+  case Format::AwsEventStream:
+    if (!aws_decoder_.decode(data)) {
+      ENVOY_LOG(debug, "invalid event stream frame, stop splitting events");
+      format_ = Format::None;
+    }
+    break;
+  case Format::None:
+    break;
+  }
+}
+
+void AiEventStreamSplitter::finish() {
+  // A final SSE event is not always terminated by a blank line.
+  if (format_ == Format::ServerSentEvents) {
+    if (!partial_.empty() && !discard_line_) {
+      const std::string line = std::move(partial_);
+      onServerSentEventLine(line);
+    }
+    onServerSentEventLine("");
+  }
+  partial_.clear();
+  event_type_.clear();
+  event_data_.clear();
+  skip_event_ = false;
+  discard_line_ = false;
+  aws_decoder_.reset();
+}
+
+void AiEventStreamSplitter::parseServerSentEvents(absl::string_view data) {
+  while (!data.empty()) {
+    const size_t eol = data.find('\n');
+    const absl::string_view segment = data.substr(0, eol);
+    if (eol == absl::string_view::npos) {
+      if (discard_line_) {
+        return;
+      }
+      if (partial_.size() + segment.size() > max_event_size_) {
+        partial_.clear();
+        event_data_.clear();
+        skip_event_ = true;
+        discard_line_ = true;
+        return;
+      }
+      partial_.append(segment.data(), segment.size());
+      return;
+    }
+
+    data.remove_prefix(eol + 1);
+    if (discard_line_) {
+      discard_line_ = false;
+      continue;
+    }
+    if (partial_.empty()) {
+      onServerSentEventLine(segment);
+    } else {
+      partial_.append(segment.data(), segment.size());
+      onServerSentEventLine(partial_);
+      partial_.clear();
+    }
+  }
+}
+
+void AiEventStreamSplitter::onServerSentEventLine(absl::string_view line) {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+
+  // A blank line dispatches the event
+  if (line.empty()) {
+    if (!skip_event_ && !event_data_.empty()) {
+      on_event_(event_type_, event_data_);
+    }
+    event_type_.clear();
+    event_data_.clear();
+    skip_event_ = false;
+    return;
+  }
+
+  if (skip_event_) {
+    return;
+  }
+  // `id:`, `retry:` and comments are dropped.
+  if (absl::StartsWith(line, "event:")) {
+    line.remove_prefix(6);
+    if (!line.empty() && line.front() == ' ') {
+      line.remove_prefix(1);
+    }
+    if (line.size() <= max_event_size_) {
+      event_type_.assign(line.data(), line.size());
+    }
+    return;
+  }
+  if (!absl::StartsWith(line, "data:")) {
+    return;
+  }
+  line.remove_prefix(5);
+  if (!line.empty() && line.front() == ' ') {
+    line.remove_prefix(1);
+  }
+
+  if (event_data_.size() + line.size() + 1 > max_event_size_) {
+    event_data_.clear();
+    skip_event_ = true;
+    return;
+  }
+  if (!event_data_.empty()) {
+    event_data_.push_back('\n');
+  }
+  event_data_.append(line.data(), line.size());
+}
+
+void AiEventStreamSplitter::onAwsEventStreamMessage(
+    const AwsEventStream::Message &message) {
+  const absl::string_view message_type = message.header(":message-type");
+  if (message_type == "exception") {
+    on_event_(message.header(":exception-type"), message.payload);
+  } else if (message_type == "error") {
+    on_event_(message.header(":error-code"), message.payload);
+  } else {
+    on_event_(message.header(":event-type"), message.payload);
+  }
+}
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
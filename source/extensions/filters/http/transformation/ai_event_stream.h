@@ -0,0 +1,79 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "source/common/aws/event_stream_codec.h"
+#include "source/common/common/logger.h"
+#include "source/common/singleton/const_singleton.h"
+
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+struct AiEventStreamValues {
+  const std::string EventStreamContentType{"text/event-stream"};
+  const std::string AwsEventStreamContentType{
+      "application/vnd.amazon.eventstream"};
+};
+
+using AiEventStreamConstants = ConstSingleton<AiEventStreamValues>;
+
+/**
+ * Splits a streamed LLM response into events as the body chunks arrive.
+ *
+ * Server-sent event streams (OpenAI, Anthropic and Gemini with `alt=sse`)
+ * yield the `event:` type and `data:` payload of each event, AWS event
+ * streams (Bedrock `converse-stream`) the `:event-type` (or
+ * `:exception-type`) header and payload of each frame, whose CRCs are
+ * checked. At most one event is held in memory; events larger than the
+ * configured limit are skipped.
+ */
+class AiEventStreamSplitter : public Logger::Loggable<Logger::Id::filter> {
+public:
+  enum class Format { None, ServerSentEvents, AwsEventStream };
+
+  using EventCallback = std::function<void(absl::string_view event_type,
+                                           absl::string_view payload)>;
+
+  AiEventStreamSplitter(size_t max_event_size, EventCallback on_event);
+
+  // The format of a response body with the given content type.
+  static Format formatForContentType(absl::string_view content_type);
+
+  void setFormat(Format format) { format_ = format; }
+  Format format() const { return format_; }
+
+  // Feeds raw body bytes to the parser of the current format.
+  void parse(absl::string_view data);
+  // Dispatches a final server-sent event that is not terminated by a blank
+  // line, and drops any partial frame.
+  void finish();
+
+private:
+  void parseServerSentEvents(absl::string_view data);
+  void onServerSentEventLine(absl::string_view line);
+  void onAwsEventStreamMessage(const AwsEventStream::Message &message);
+
+  const size_t max_event_size_;
+  const EventCallback on_event_;
+  Format format_{Format::None};
+  // Partial SSE line
+  std::string partial_;
+  // `event:` type and `data:` payload of the current SSE event.
+  std::string event_type_;
+  std::string event_data_;
+  // Set while the current SSE event exceeds the size limit.
+  bool skip_event_{};
+  // Set while the rest of an oversized SSE line is dropped.
+  bool discard_line_{};
+  AwsEventStream::Decoder aws_decoder_;
+};
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,191 @@
+#include "source/extensions/filters/http/transformation/ai_stream_usage.h"
+
+#include "source/common/protobuf/protobuf.h"
+#include "source/extensions/filters/http/solo_well_known_names.h"
+
+#include "absl/strings/ascii.h"
+
+using json = nlohmann::json;
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+namespace {
+
+/**
+ * @brief Cheap check before parsing an event as JSON: does the event contain a
+ * `usage` (or `usageMetadata`) key whose value is an object? OpenAI sends
+ * `"usage":null` on every chunk once `include_usage` is set, so the key alone
+ * is not enough.
+ *
+ * @param event the event payload
+ * @return true if the event may carry token usage
+ */
+bool hasUsageObject(absl::string_view event) {
+  static constexpr absl::string_view key = "\"usage";
+  size_t pos = event.find(key);
+  while (pos != absl::string_view::npos) {
+    size_t i = pos + key.size();
+    // skip the remainder of the key, e.g. `Metadata` in `usageMetadata`
+    while (i < event.size() && event[i] != '"') {
+      i++;
+    }
+    i++;
+    while (i < event.size() && absl::ascii_isspace(event[i])) {
+      i++;
+    }
+    if (i < event.size() && event[i] == ':') {
+      i++;
+      while (i < event.size() && absl::ascii_isspace(event[i])) {
+        i++;
+      }
+      if (i < event.size() && event[i] == '{') {
+        return true;
+      }
+    }
+    pos = event.find(key, pos + key.size());
+  }
+  return false;
+}
+
+bool readTokenCount(const json &usage, const char *key, uint64_t &count) {
+  const auto it = usage.find(key);
+  if (it == usage.end() || !it->is_number_unsigned()) {
+    return false;
+  }
+  count = it->get<uint64_t>();
+  return true;
+}
+
+} // namespace
+
+AiStreamUsageExtractor::AiStreamUsageExtractor()
+    : splitter_(MaxEventSize,
+                [this](absl::string_view, absl::string_view payload) {
+                  onEvent(payload);
+                }) {}
+
+void AiStreamUsageExtractor::onHeaders(const Http::ResponseHeaderMap &headers,
+                                       Http::StreamFilterCallbacks &callbacks) {
+  const absl::string_view content_type = headers.getContentTypeValue();
+  splitter_.setFormat(
+      AiEventStreamSplitter::formatForContentType(content_type));
+  ENVOY_STREAM_LOG(trace, "streaming usage extraction for content type '{}': {}",
+                   callbacks, content_type,
+                   splitter_.format() != AiEventStreamSplitter::Format::None);
+}
+
+void AiStreamUsageExtractor::onData(const Buffer::Instance &data,
+                                    Http::StreamFilterCallbacks &) {
+  if (splitter_.format() == AiEventStreamSplitter::Format::None) {
+    return;
+  }
+  for (const Buffer::RawSlice &slice : data.getRawSlices()) {
+    parse(absl::string_view(static_cast<const char *>(slice.mem_), slice.len_));
+  }
+}
+
+void AiStreamUsageExtractor::onComplete(Http::StreamFilterCallbacks &callbacks) {
+  if (completed_) {
+    return;
+  }
+  completed_ = true;
+  splitter_.finish();
+
+  if (!has_usage_) {
+    return;
+  }
+  if (!total_reported_) {
+    // Anthropic only reports input and output tokens
+    usage_.total_tokens = usage_.prompt_tokens + usage_.completion_tokens;
+  }
+
+  ENVOY_STREAM_LOG(debug, "streamed token usage: prompt {} completion {} total {}",
+                   callbacks, usage_.prompt_tokens, usage_.completion_tokens,
+                   usage_.total_tokens);
+  Protobuf::Struct metadata;
+  auto &fields = *metadata.mutable_fields();
+  fields[AiStreamUsageConstants::get().PromptTokens].set_number_value(
+      usage_.prompt_tokens);
+  fields[AiStreamUsageConstants::get().CompletionTokens].set_number_value(
+      usage_.completion_tokens);
+  fields[AiStreamUsageConstants::get().TotalTokens].set_number_value(
+      usage_.total_tokens);
+  callbacks.streamInfo().setDynamicMetadata(
+      SoloHttpFilterNames::get().Transformation, metadata);
+}
+
+void AiStreamUsageExtractor::parse(absl::string_view data) {
+  splitter_.parse(data);
+}
+
+void AiStreamUsageExtractor::onEvent(absl::string_view payload) {
+  if (!hasUsageObject(payload)) {
+    return;
+  }
+
+  const json event = json::parse(payload, nullptr, false);
+  if (event.is_discarded() || !event.is_object()) {
+    ENVOY_LOG(debug, "failed to parse usage event as json");
+    return;
+  }
+  updateUsage(event);
+}
+
+void AiStreamUsageExtractor::updateUsage(const json &event) {
+  const json *usage = nullptr;
+  const auto usage_it = event.find("usage");
+  if (usage_it != event.end() && usage_it->is_object()) {
+    usage = &*usage_it;
+  } else {
+    // Anthropic `message_start` nests the usage in the message
+    const auto message_it = event.find("message");
+    if (message_it != event.end() && message_it->is_object()) {
+      const auto nested_it = message_it->find("usage");
+      if (nested_it != message_it->end() && nested_it->is_object()) {
+        usage = &*nested_it;
+      }
+    }
+  }
+
+  bool found = false;
+  if (usage != nullptr) {
+    // OpenAI
+    found |= readTokenCount(*usage, "prompt_tokens", usage_.prompt_tokens);
+    found |=
+        readTokenCount(*usage, "completion_tokens", usage_.completion_tokens);
+    if (readTokenCount(*usage, "total_tokens", usage_.total_tokens)) {
+      found = total_reported_ = true;
+    }
+    // Anthropic
+    found |= readTokenCount(*usage, "input_tokens", usage_.prompt_tokens);
+    found |= readTokenCount(*usage, "output_tokens", usage_.completion_tokens);
+    // Bedrock
+    found |= readTokenCount(*usage, "inputTokens", usage_.prompt_tokens);
+    found |= readTokenCount(*usage, "outputTokens", usage_.completion_tokens);
+    if (readTokenCount(*usage, "totalTokens", usage_.total_tokens)) {
+      found = total_reported_ = true;
+    }
+  }
+
+  // Gemini reports the running usage on every chunk
+  const auto metadata_it = event.find("usageMetadata");
+  if (metadata_it != event.end() && metadata_it->is_object()) {
+    found |= readTokenCount(*metadata_it, "promptTokenCount",
+                            usage_.prompt_tokens);
+    found |= readTokenCount(*metadata_it, "candidatesTokenCount",
+                            usage_.completion_tokens);
+    if (readTokenCount(*metadata_it, "totalTokenCount", usage_.total_tokens)) {
+      found = total_reported_ = true;
+    }
+  }
+
+  has_usage_ |= found;
+}
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
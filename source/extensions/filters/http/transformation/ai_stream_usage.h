@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/http/filter.h"
+#include "envoy/http/header_map.h"
+
+#include "nlohmann/json.hpp"
+#include "source/common/common/logger.h"
+#include "source/common/singleton/const_singleton.h"
+#include "source/extensions/filters/http/transformation/ai_event_stream.h"
+#include "source/extensions/filters/http/transformation/transformer.h"
+
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+struct AiStreamUsageValues {
+  const std::string PromptTokens{"prompt_tokens"};
+  const std::string CompletionTokens{"completion_tokens"};
+  const std::string TotalTokens{"total_tokens"};
+};
+
+using AiStreamUsageConstants = ConstSingleton<AiStreamUsageValues>;
+
+struct TokenUsage {
+  uint64_t prompt_tokens{};
+  uint64_t completion_tokens{};
+  uint64_t total_tokens{};
+};
+
+/**
+ * Extracts the token usage reported by an LLM provider from a streamed chat
+ * response, as it passes through the filter.
+ *
+ * The body is split into events on the fly by an AiEventStreamSplitter, and
+ * only events that carry a non-null usage object are parsed as JSON.
+ *
+ * Once the response completes, the usage is written to the
+ * `io.solo.transformation` dynamic metadata namespace as `prompt_tokens`,
+ * `completion_tokens` and `total_tokens`.
+ */
+class AiStreamUsageExtractor : public ResponseBodyObserver,
+                               public Logger::Loggable<Logger::Id::filter> {
+public:
+  // Events larger than this are skipped instead of buffered. Usage events are
+  // tiny, large events are content deltas.
+  static constexpr size_t MaxEventSize = 64 * 1024;
+
+  AiStreamUsageExtractor();
+
+  void onHeaders(const Http::ResponseHeaderMap &headers,
+                 Http::StreamFilterCallbacks &callbacks) override;
+  void onData(const Buffer::Instance &data,
+              Http::StreamFilterCallbacks &callbacks) override;
+  void onComplete(Http::StreamFilterCallbacks &callbacks) override;
+
+  // Feeds raw body bytes to the parser selected by onHeaders().
+  void parse(absl::string_view data);
+
+  const TokenUsage &usage() const { return usage_; }
+  bool hasUsage() const { return has_usage_; }
+
+private:
+  void onEvent(absl::string_view payload);
+  void updateUsage(const nlohmann::json &event);
+
+  AiEventStreamSplitter splitter_;
+  TokenUsage usage_;
+  bool has_usage_{};
+  bool total_reported_{};
+  bool completed_{};
+};
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -1,17 +1,25 @@
 #include "ai_transformer.h"
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <regex>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/str_replace.h"
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/empty_string.h"
 #include "source/common/common/logger.h"
 #include "source/common/common/regex.h"
 #include "source/common/common/utility.h"
 #include "source/common/config/metadata.h"
 #include "source/common/http/header_utility.h"
 #include "source/common/http/headers.h"
+#include "source/common/http/utility.h"
 #include "source/common/protobuf/utility.h"
 #include "source/extensions/filters/http/solo_well_known_names.h"
 
@@ -32,20 +40,16 @@ namespace {
  * @return std::string value pointed to by the key or empty string if key does
  * not exist
  */
-std::string lookupEndpointMetadata(
-    Envoy::Upstream::MetadataConstSharedPtr endpoint_metadata,
-    const std::string &key) {
+std::string
+lookupEndpointMetadata(const envoy::config::core::v3::Metadata &endpoint_metadata,
+                       const std::string &key) {
   static const char delimiter = ':';
   static const std::string trueString{"true"};
   static const std::string falseString{"false"};
 
-  if (!endpoint_metadata) {
-    return "";
-  }
-
   std::vector<std::string> elements = absl::StrSplit(key, delimiter);
   const Protobuf::Value &value = Envoy::Config::Metadata::metadataValue(
-      endpoint_metadata.get(),
+      &endpoint_metadata,
       Extensions::HttpFilters::SoloHttpFilterNames::get().Transformation,
       elements);
 
@@ -294,245 +298,445 @@ json protobufValueToJson(const Protobuf::Value &pb_value) {
   }
 }
 
-enum class PromptAction { PREPEND, APPEND };
-/**
- * @brief Helper function to add prompt for Gemini. The prompt can exist in
- * either the `contents` field for user prompt or the `system_instruction` field
- * for system prompt and the format is the same
- *
- * @param prompt
- * @param contents is the reference to the existing field, it could be the
- * `contents` field or the `system_instruction` field
- * @param action
- */
-void addGeminiPrompts(const PromptEnrichment::Message &prompt,
-                      json::array_t &contents, PromptAction action) {
-  auto new_prompt = json::object();
-  new_prompt["role"] = prompt.role();
-  // note that creating the json::array like this:
-  // json::array({{"text", prompt.content()}});
-  // will sometimes create an array inside the array instead of object inside
-  // the array So, need to be explicit that its an object inside the array
-  new_prompt["parts"] =
-      json::array({json::object({{"text", prompt.content()}})});
-
-  if (action == PromptAction::PREPEND) {
-    contents.insert(contents.begin(), std::move(new_prompt));
-  } else {
-    contents.push_back(std::move(new_prompt));
+bool isSystemPrompt(const PromptEnrichment::Message &prompt) {
+  return prompt.role() == "system" || prompt.role() == "developer";
+}
+
+// Strips the enclosing brackets or quotes from a serialized json array or
+// string
+std::string stripEnclosing(const std::string &serialized) {
+  return serialized.substr(1, serialized.size() - 2);
+}
+
+// Byte range of a value in a raw json document
+struct RawJsonValue {
+  size_t begin;
+  size_t end;
+};
+
+// A change to a raw json document: replace `remove` bytes at `offset` with
+// `text`
+struct RawJsonEdit {
+  size_t offset;
+  size_t remove;
+  absl::string_view text;
+};
+
+size_t skipJsonWhitespace(absl::string_view json, size_t pos) {
+  while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\n' ||
+                               json[pos] == '\r' || json[pos] == '\t')) {
+    pos++;
+  }
+  return pos;
+}
+
+// `pos` is at the opening quote. Returns the position after the closing quote
+// or npos if the string is not terminated.
+size_t skipJsonString(absl::string_view json, size_t pos) {
+  for (pos++; pos < json.size(); pos++) {
+    if (json[pos] == '\\') {
+      pos++;
+    } else if (json[pos] == '"') {
+      return pos + 1;
+    }
+  }
+  return absl::string_view::npos;
+}
+
+// Returns the position after the value starting at `pos` or npos if the value
+// is not terminated. Scalars are not validated, the upstream will reject them.
+size_t skipJsonValue(absl::string_view json, size_t pos) {
+  if (pos >= json.size()) {
+    return absl::string_view::npos;
+  }
+
+  switch (json[pos]) {
+  case '"':
+    return skipJsonString(json, pos);
+  case '{':
+  case '[': {
+    int depth = 0;
+    while (pos != absl::string_view::npos) {
+      switch (json[pos]) {
+      case '"':
+        pos = skipJsonString(json, pos);
+        continue;
+      case '{':
+      case '[':
+        depth++;
+        break;
+      case '}':
+      case ']':
+        if (--depth == 0) {
+          return pos + 1;
+        }
+        break;
+      }
+      pos = json.find_first_of("\"{}[]", pos + 1);
+    }
+    return absl::string_view::npos;
+  }
+  default: {
+    const size_t end = json.find_first_of(",}] \n\r\t", pos);
+    return end == pos ? absl::string_view::npos : end;
+  }
   }
 }
 
 /**
- * @brief Helper function to add prompts for Bedrock. The prompt can exist in
- * either the `messages` field for user prompt or the `system` field
- * for system prompt but the format are different. The `system` field is an array
- * but has no role for the object inside the array. The object can be a union of
- * other object type but we are only use "text" string here:
- * https://docs.aws.amazon.com/bedrock/latest/APIReference/API_runtime_SystemContentBlock.html
- *
- * If the `messages` field or the `system` field are missing, we will create it
+ * @brief Locate the fields of a raw json object without building a DOM
  *
- * @param prompt
- * @param json_body
- * @param action
- * @return true if prompts are added successfully or false otherwise
+ * @param json the raw json document
+ * @param fields receives the value range of every top level field
+ * @param object_end receives the position of the closing brace
+ * @return false if json is not an object, or has escaped or duplicated keys
+ * which cannot be matched reliably without parsing
  */
-bool addBedrockPrompts(const PromptEnrichment::Message &prompt,
-                      json &json_body, PromptAction action) {
-  if (prompt.role() == "system" || prompt.role() == "developer") {
-    if (!json_body.contains("system")) {
-      json_body["system"] = json::array({});
-    }
-    auto &system_prompts = json_body["system"];
-    if (!system_prompts.is_array()) {
+bool scanJsonObjectFields(absl::string_view json,
+                          absl::flat_hash_map<absl::string_view, RawJsonValue> &fields,
+                          size_t &object_end) {
+  size_t pos = skipJsonWhitespace(json, 0);
+  if (pos >= json.size() || json[pos] != '{') {
+    return false;
+  }
+
+  pos = skipJsonWhitespace(json, pos + 1);
+  while (pos < json.size() && json[pos] != '}') {
+    if (json[pos] != '"') {
+      return false;
+    }
+    const size_t key_end = skipJsonString(json, pos);
+    if (key_end == absl::string_view::npos) {
+      return false;
+    }
+    const absl::string_view key = json.substr(pos + 1, key_end - pos - 2);
+    if (key.find('\\') != absl::string_view::npos) {
       return false;
     }
 
-    auto new_prompt = json::object({{"text", prompt.content()}});
-    if (action == PromptAction::PREPEND) {
-      system_prompts.insert(system_prompts.begin(), std::move(new_prompt));
-    } else {
-      system_prompts.push_back(std::move(new_prompt));
+    pos = skipJsonWhitespace(json, key_end);
+    if (pos >= json.size() || json[pos] != ':') {
+      return false;
+    }
+    pos = skipJsonWhitespace(json, pos + 1);
+    const size_t value_end = skipJsonValue(json, pos);
+    if (value_end == absl::string_view::npos) {
+      return false;
+    }
+    if (!fields.emplace(key, RawJsonValue{pos, value_end}).second) {
+      return false;
     }
 
-    return true;
+    pos = skipJsonWhitespace(json, value_end);
+    if (pos < json.size() && json[pos] == ',') {
+      pos = skipJsonWhitespace(json, pos + 1);
+      if (pos < json.size() && json[pos] == '}') {
+        return false;
+      }
+    } else if (pos < json.size() && json[pos] != '}') {
+      return false;
+    }
   }
 
-  // Assume all other roles as user prompts
-  if (!json_body.contains("messages")) {
-    json_body["messages"] = json::array({});
-  }
-  auto &messages = json_body["messages"];
-  if (!messages.is_array()) {
+  if (pos >= json.size()) {
     return false;
   }
-  auto new_prompt = json::object();
-  new_prompt["role"] = prompt.role();
-  new_prompt["content"] =
-      json::array({json::object({{"text", prompt.content()}})});
+  object_end = pos;
+  return skipJsonWhitespace(json, pos + 1) == json.size();
+}
 
-  if (action == PromptAction::PREPEND) {
-    messages.insert(messages.begin(), std::move(new_prompt));
-  } else {
-    messages.push_back(std::move(new_prompt));
+// The value of a string field, or empty if it is missing or not a string
+std::string stringField(const json &object, const char *key) {
+  const auto it = object.find(key);
+  if (it == object.end() || !it->is_string()) {
+    return "";
   }
-  return true;
+  return it->get<std::string>();
 }
 
 /**
- * @brief prepend or append prompts into the existing prompts in `json_body`
- *
- * @param schema the api schema used in `json_body`
- * @param json_body the json_body that contains the original prompts, this will
- * be modified in place
- * @param prompts contains system or user prompt
- * @param action enum to determine if it is prepend or append
+ * @brief Concatenate the text of an OpenAI message content, which is either a
+ * string or an array of content parts. Parts other than text are dropped.
  *
- * @return true if successful
- * @return false if the json_body does not contain the correct object containing
- * the existing prompt
+ * @param content the `content` field of an OpenAI chat message
+ * @return std::string the text of the message
  */
-bool addPrompts(const std::string &schema, json &json_body,
-                const PromptEnrichment::Message &prompt, PromptAction action) {
-  if (schema == AiTransformerConstants::get().SCHEMA_GEMINI) {
-    if (prompt.role() == "system" || prompt.role() == "developer") {
-      if (!json_body.contains("system_instruction")) {
-        json_body["system_instruction"] = json::array({});
-      }
-      auto &value = json_body["system_instruction"];
-      if (!value.is_array()) {
-        return false;
-      }
-      auto &contents = value.get_ref<json::array_t &>();
-      addGeminiPrompts(prompt, contents, action);
-    } else {
-      if (!json_body.contains("contents")) {
-        return false;
-      }
-      auto &value = json_body["contents"];
-      if (!value.is_array()) {
-        return false;
+std::string openAiContentText(const json &content) {
+  if (content.is_string()) {
+    return content.get<std::string>();
+  }
+  std::string text;
+  if (content.is_array()) {
+    for (const auto &part : content) {
+      const auto text_it = part.find("text");
+      if (part.is_object() && text_it != part.end() && text_it->is_string()) {
+        text.append(text_it->get_ref<const std::string &>());
       }
-      auto &contents = value.get_ref<json::array_t &>();
-      addGeminiPrompts(prompt, contents, action);
-    }
-  } else if (schema == AiTransformerConstants::get().SCHEMA_BEDROCK) {
-    return addBedrockPrompts(prompt, json_body, action);
-  } else {
-    if (!json_body.contains("messages")) {
-      return false;
-    }
-    auto &messages = json_body["messages"];
-    if (!messages.is_array()) {
-      return false;
     }
+  }
+  return text;
+}
 
-    // OpenAI
-    auto new_prompt = json::object();
-    new_prompt["role"] = prompt.role();
-    new_prompt["content"] = prompt.content();
+/**
+ * @brief Copy an OpenAI request parameter into the translated request, if the
+ * client set it
+ *
+ * @param request the OpenAI request
+ * @param key the OpenAI parameter name
+ * @param target the object receiving the parameter
+ * @param target_key the parameter name in the translated request
+ */
+void copyParameter(const json &request, const char *key, json &target,
+                   const char *target_key) {
+  const auto it = request.find(key);
+  if (it != request.end() && !it->is_null()) {
+    target[target_key] = *it;
+  }
+}
 
-    if (action == PromptAction::PREPEND) {
-      messages.insert(messages.begin(), std::move(new_prompt));
-    } else {
-      messages.push_back(std::move(new_prompt));
+// `max_completion_tokens` replaced `max_tokens` in the OpenAI api
+const json *openAiMaxTokens(const json &request) {
+  for (const char *key : {"max_completion_tokens", "max_tokens"}) {
+    const auto it = request.find(key);
+    if (it != request.end() && it->is_number_integer()) {
+      return &*it;
     }
   }
+  return nullptr;
+}
 
-  return true;
+// `stop` is either a single sequence or an array of them
+void copyStopSequences(const json &request, json &target,
+                       const char *target_key) {
+  const auto it = request.find("stop");
+  if (it == request.end()) {
+    return;
+  }
+  if (it->is_string()) {
+    target[target_key] = json::array({*it});
+  } else if (it->is_array() && !it->empty()) {
+    target[target_key] = *it;
+  }
 }
 
 /**
- * @brief Helper function to add prompts in the correct field for various api
- * schema
+ * @brief Translate the OpenAI chat messages into the messages array of another
+ * schema. System and developer messages are collected separately, since every
+ * other schema takes them outside the conversation, and consecutive messages
+ * of the same role are merged, since Bedrock requires the roles to alternate.
  *
- * @param schema the api schema used in `json_body`
- * @param json_body the json_body that contains the original prompts, this will
- * be modified in place
- * @param prepend_prompts list of prompts to prepend to existing prompts
- * @param append_prompts list of prompts to append to existing prompts
- * @return true if prompts are successfully added
- * @return false if there is no existing prompt field
+ * @param request the OpenAI request
+ * @param assistant_role the name of the assistant role in the target schema
+ * @param content_field the field holding the content parts of a message
+ * @param text_part builds a content part holding some text
+ * @param system_prompts receives the text of the system and developer messages
+ * @return json the array of translated messages
  */
-bool addPrompts(const std::string &schema, json &json_body,
-                const std::vector<PromptEnrichment::Message> &prepend_prompts,
-                const std::vector<PromptEnrichment::Message> &append_prompts) {
-  std::string anthropic_system_prompt;
-  std::string anthropic_developer_prompt;
-  std::vector<std::reference_wrapper<const PromptEnrichment::Message>>
-      reversed_prepend_prompts;
-  reversed_prepend_prompts.reserve(prepend_prompts.size());
-  for (auto &prompt : prepend_prompts) {
-    if (schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC) {
-      // Anthropic system/developer prompts go to a seperate `system` filed as a
-      // single string. So, accumulate them separately and then set them in the
-      // `system` at the end Each prompt is separated by a newline when
-      // combining into a single string
-
-      if (prompt.role() == "system") {
-        absl::StrAppend(&anthropic_system_prompt, prompt.content(), "\n");
-        continue;
-      } else if (prompt.role() == "developer") {
-        absl::StrAppend(&anthropic_developer_prompt, prompt.content(), "\n");
-        continue;
-      }
+json translateOpenAiMessages(const json &request,
+                             const std::string &assistant_role,
+                             const char *content_field,
+                             const std::function<json(std::string)> &text_part,
+                             std::vector<std::string> &system_prompts) {
+  json messages = json::array();
+  const auto messages_it = request.find("messages");
+  if (messages_it == request.end() || !messages_it->is_array()) {
+    return messages;
+  }
+
+  for (const auto &message : *messages_it) {
+    if (!message.is_object()) {
+      continue;
+    }
+    std::string role = stringField(message, "role");
+    if (role.empty()) {
+      role = "user";
+    }
+    const auto content_it = message.find("content");
+    std::string text = content_it == message.end()
+                           ? std::string()
+                           : openAiContentText(*content_it);
+    if (role == "system" || role == "developer") {
+      system_prompts.push_back(std::move(text));
+      continue;
+    }
+    if (text.empty()) {
+      continue;
     }
 
-    reversed_prepend_prompts.insert(reversed_prepend_prompts.begin(), prompt);
+    // tool results are handed back to the model as user input
+    const std::string target_role =
+        role == "assistant" ? assistant_role : role == "tool" ? "user" : role;
+    if (!messages.empty() && messages.back()["role"] == target_role) {
+      messages.back()[content_field].push_back(text_part(std::move(text)));
+    } else {
+      messages.push_back(
+          {{"role", target_role},
+           {content_field, json::array({text_part(std::move(text))})}});
+    }
   }
+  return messages;
+}
 
-  // Have to create a vector to store the prompt in reverse order because some
-  // provider uses separate field for system prompt, so cannot just track the
-  // order with a single offset index.
-  for (auto &prompt : reversed_prepend_prompts) {
-    if (!addPrompts(schema, json_body, prompt, PromptAction::PREPEND)) {
-      return false;
+// Used when an OpenAI request does not limit the completion
+constexpr uint64_t AnthropicDefaultMaxTokens = 4096;
+
+json toAnthropicRequest(const json &request, bool stream) {
+  std::vector<std::string> system_prompts;
+  json translated = {
+      {"messages", translateOpenAiMessages(
+                       request, "assistant", "content",
+                       [](std::string text) {
+                         return json{{"type", "text"},
+                                     {"text", std::move(text)}};
+                       },
+                       system_prompts)}};
+  if (!system_prompts.empty()) {
+    translated["system"] = absl::StrJoin(system_prompts, "\n");
+  }
+  copyParameter(request, "model", translated, "model");
+  // max_tokens is required by the Anthropic messages api
+  const json *max_tokens = openAiMaxTokens(request);
+  translated["max_tokens"] =
+      max_tokens ? *max_tokens : json(AnthropicDefaultMaxTokens);
+  copyParameter(request, "temperature", translated, "temperature");
+  copyParameter(request, "top_p", translated, "top_p");
+  copyStopSequences(request, translated, "stop_sequences");
+  if (stream) {
+    translated["stream"] = true;
+  }
+  return translated;
+}
+
+json toGeminiRequest(const json &request) {
+  std::vector<std::string> system_prompts;
+  json translated = {
+      {"contents", translateOpenAiMessages(
+                       request, "model", "parts",
+                       [](std::string text) {
+                         return json{{"text", std::move(text)}};
+                       },
+                       system_prompts)}};
+  if (!system_prompts.empty()) {
+    json parts = json::array();
+    for (auto &prompt : system_prompts) {
+      parts.push_back({{"text", std::move(prompt)}});
     }
+    translated["systemInstruction"] = {{"parts", std::move(parts)}};
   }
 
-  for (auto &prompt : append_prompts) {
-    if (schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC) {
-      // Anthropic system/developer prompts go to a seperate `system` filed as a
-      // single string. So, accumulate them separately and then set them in the
-      // `system` at the end Each prompt is separated by a newline when
-      // combining into a single string
+  json generation_config = json::object();
+  if (const json *max_tokens = openAiMaxTokens(request)) {
+    generation_config["maxOutputTokens"] = *max_tokens;
+  }
+  copyParameter(request, "temperature", generation_config, "temperature");
+  copyParameter(request, "top_p", generation_config, "topP");
+  copyParameter(request, "n", generation_config, "candidateCount");
+  copyStopSequences(request, generation_config, "stopSequences");
+  if (!generation_config.empty()) {
+    translated["generationConfig"] = std::move(generation_config);
+  }
+  return translated;
+}
 
-      if (prompt.role() == "system") {
-        absl::StrAppend(&anthropic_system_prompt, prompt.content(), "\n");
-        continue;
-      } else if (prompt.role() == "developer") {
-        absl::StrAppend(&anthropic_developer_prompt, prompt.content(), "\n");
-        continue;
-      }
+json toBedrockRequest(const json &request) {
+  std::vector<std::string> system_prompts;
+  json translated = {
+      {"messages", translateOpenAiMessages(
+                       request, "assistant", "content",
+                       [](std::string text) {
+                         return json{{"text", std::move(text)}};
+                       },
+                       system_prompts)}};
+  if (!system_prompts.empty()) {
+    json system = json::array();
+    for (auto &prompt : system_prompts) {
+      system.push_back({{"text", std::move(prompt)}});
     }
+    translated["system"] = std::move(system);
+  }
 
-    if (!addPrompts(schema, json_body, prompt, PromptAction::APPEND)) {
-      return false;
-    }
+  json inference_config = json::object();
+  if (const json *max_tokens = openAiMaxTokens(request)) {
+    inference_config["maxTokens"] = *max_tokens;
+  }
+  copyParameter(request, "temperature", inference_config, "temperature");
+  copyParameter(request, "top_p", inference_config, "topP");
+  copyStopSequences(request, inference_config, "stopSequences");
+  if (!inference_config.empty()) {
+    translated["inferenceConfig"] = std::move(inference_config);
   }
+  return translated;
+}
 
-  if (!anthropic_system_prompt.empty() || !anthropic_developer_prompt.empty()) {
-    const std::string *existing_system_prompt = nullptr;
-    if (json_body.contains("system") && json_body["system"].is_string()) {
-      existing_system_prompt =
-          json_body["system"].get_ptr<const json::string_t *>();
-    }
-    if (!existing_system_prompt) {
-      json_body["system"] = absl::StrCat(anthropic_system_prompt, "\n",
-                                         anthropic_developer_prompt);
-    } else {
-      // For Anthropic, we group system and developer prompt separately and
-      // always append to existing system prompt regardless if they are in the
-      // prepend or append prompts as I don't think the prepend/append concept
-      // applies to Anthropic's single system prompt field.
-      json_body["system"] =
-          absl::StrCat(*existing_system_prompt, "\n", anthropic_system_prompt,
-                       "\n", anthropic_developer_prompt);
+/**
+ * @brief Map the stop reason of a provider onto an OpenAI `finish_reason`
+ *
+ * @param reason Anthropic `stop_reason`, Gemini `finishReason` or Bedrock
+ * `stopReason`
+ * @return the OpenAI finish reason
+ */
+using FinishReasons = absl::flat_hash_map<std::string, std::string>;
+
+const FinishReasons &finishReasons() {
+  CONSTRUCT_ON_FIRST_USE(FinishReasons,
+                         {{"end_turn", "stop"},
+                          {"stop_sequence", "stop"},
+                          {"STOP", "stop"},
+                          {"max_tokens", "length"},
+                          {"MAX_TOKENS", "length"},
+                          {"tool_use", "tool_calls"},
+                          {"SAFETY", "content_filter"},
+                          {"RECITATION", "content_filter"},
+                          {"BLOCKLIST", "content_filter"},
+                          {"PROHIBITED_CONTENT", "content_filter"},
+                          {"SPII", "content_filter"},
+                          {"guardrail_intervened", "content_filter"},
+                          {"content_filtered", "content_filter"}});
+}
+
+/**
+ * @brief Map the stop reason of a provider onto an OpenAI `finish_reason`
+ *
+ * @param reason Anthropic `stop_reason`, Gemini `finishReason` or Bedrock
+ * `stopReason`
+ * @return the OpenAI finish reason
+ */
+std::string openAiFinishReason(const std::string &reason) {
+  const auto it = finishReasons().find(reason);
+  return it == finishReasons().end() ? "stop" : it->second;
+}
+
+// Reads a token count, leaving `count` untouched if the field is missing
+void readTokenCount(const json &usage, const char *key, uint64_t &count) {
+  const auto it = usage.find(key);
+  if (it != usage.end() && it->is_number_unsigned()) {
+    count = it->get<uint64_t>();
+  }
+}
+
+// Concatenates the text of Anthropic `content`, Gemini `parts` or Bedrock
+// `content` blocks.
+std::string contentBlocksText(const json &blocks) {
+  std::string text;
+  if (blocks.is_array()) {
+    for (const auto &block : blocks) {
+      const auto text_it = block.find("text");
+      if (block.is_object() && text_it != block.end() && text_it->is_string()) {
+        text.append(text_it->get_ref<const std::string &>());
+      }
     }
   }
+  return text;
+}
 
-  return true;
+// The first Gemini candidate, if any
+const json *firstGeminiCandidate(const json &response) {
+  const auto it = response.find("candidates");
+  if (it == response.end() || !it->is_array() || it->empty() ||
+      !it->front().is_object()) {
+    return nullptr;
+  }
+  return &it->front();
 }
 
 } // namespace
@@ -554,27 +758,695 @@ FieldDefault::FieldDefault(
       value_(protobufValueToJson(field_default.value())),
       override_(field_default.override()) {}
 
+AiEndpointMetadata::AiEndpointMetadata(
+    const envoy::config::core::v3::Metadata &metadata)
+    : provider_(lookupEndpointMetadata(metadata, "provider")),
+      auth_token_(lookupEndpointMetadata(metadata, "auth_token")),
+      json_schema_(lookupEndpointMetadata(metadata, "json_schema")),
+      model_(lookupEndpointMetadata(metadata, "model")),
+      model_path_(lookupEndpointMetadata(metadata, "model_path")),
+      path_(lookupEndpointMetadata(metadata, "path")),
+      base_path_(lookupEndpointMetadata(metadata, "base_path")),
+      platform_api_base_path_(
+          lookupEndpointMetadata(metadata, "platform_api_base_path")),
+      version_(lookupEndpointMetadata(metadata, "version")) {}
+
+AiEndpointMetadataConstSharedPtr AiEndpointMetadataCache::get(
+    const Upstream::MetadataConstSharedPtr &metadata) {
+  auto it = entries_.find(metadata.get());
+  // The address of a freed Metadata can be reused by a new one, so only trust
+  // the entry while the Metadata it was parsed from is alive.
+  if (it != entries_.end() && it->second.metadata_.lock() == metadata) {
+    return it->second.parsed_;
+  }
+
+  if (it == entries_.end() && entries_.size() >= MaxEntries) {
+    absl::erase_if(entries_, [](const auto &entry) {
+      return entry.second.metadata_.expired();
+    });
+    if (entries_.size() >= MaxEntries) {
+      entries_.clear();
+    }
+  }
+
+  auto parsed = std::make_shared<const AiEndpointMetadata>(*metadata);
+  entries_[metadata.get()] = Entry{metadata, parsed};
+  return parsed;
+}
+
+CompiledPromptEnrichment::CompiledPromptEnrichment(
+    const PromptEnrichment &prompt_enrichment, const std::string &schema) {
+  const bool is_anthropic =
+      schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC;
+
+  auto fragmentFor = [this](const std::string &field,
+                            bool create_if_missing) -> ArrayFragment & {
+    for (auto &fragment : arrays_) {
+      if (fragment.field == field) {
+        return fragment;
+      }
+    }
+    auto &fragment = arrays_.emplace_back();
+    fragment.field = field;
+    fragment.create_if_missing = create_if_missing;
+    return fragment;
+  };
+
+  auto addPrompt = [&](const PromptEnrichment::Message &prompt, bool prepend) {
+    if (is_anthropic && isSystemPrompt(prompt)) {
+      // Anthropic system/developer prompts go to a seperate `system` field as
+      // a single string. Each prompt is separated by a newline.
+      absl::StrAppend(prompt.role() == "system" ? &system_prompt_
+                                                : &developer_prompt_,
+                      prompt.content(), "\n");
+      has_system_prompt_ = true;
+      return;
+    }
+
+    json message;
+    ArrayFragment *fragment;
+    if (schema == AiTransformerConstants::get().SCHEMA_GEMINI) {
+      // System prompts go to the `system_instruction` field, user prompts to
+      // `contents`, both use the same format.
+      message = json::object();
+      message["role"] = prompt.role();
+      // note that creating the json::array like this:
+      // json::array({{"text", prompt.content()}});
+      // will sometimes create an array inside the array instead of object
+      // inside the array So, need to be explicit that its an object inside the
+      // array
+      message["parts"] =
+          json::array({json::object({{"text", prompt.content()}})});
+      fragment = isSystemPrompt(prompt)
+                     ? &fragmentFor("system_instruction", true)
+                     : &fragmentFor("contents", false);
+    } else if (schema == AiTransformerConstants::get().SCHEMA_BEDROCK) {
+      // The Bedrock `system` field has no role, the object inside the array
+      // can be a union of other object type but we are only use "text" here:
+      // https://docs.aws.amazon.com/bedrock/latest/APIReference/API_runtime_SystemContentBlock.html
+      // Missing `messages` or `system` fields are created.
+      if (isSystemPrompt(prompt)) {
+        message = json::object({{"text", prompt.content()}});
+        fragment = &fragmentFor("system", true);
+      } else {
+        message = json::object();
+        message["role"] = prompt.role();
+        message["content"] =
+            json::array({json::object({{"text", prompt.content()}})});
+        fragment = &fragmentFor("messages", true);
+      }
+    } else {
+      // OpenAI
+      message = json::object();
+      message["role"] = prompt.role();
+      message["content"] = prompt.content();
+      fragment = &fragmentFor("messages", false);
+    }
+
+    (prepend ? fragment->prepend_json : fragment->append_json)
+        .push_back(std::move(message));
+  };
+
+  for (const auto &prompt : prompt_enrichment.prepend()) {
+    addPrompt(prompt, true);
+  }
+  for (const auto &prompt : prompt_enrichment.append()) {
+    addPrompt(prompt, false);
+  }
+
+  for (auto &fragment : arrays_) {
+    if (!fragment.prepend_json.empty()) {
+      fragment.prepend = stripEnclosing(fragment.prepend_json.dump());
+      fragment.prepend_with_comma = absl::StrCat(fragment.prepend, ",");
+    }
+    if (!fragment.append_json.empty()) {
+      fragment.append = stripEnclosing(fragment.append_json.dump());
+      fragment.append_with_comma = absl::StrCat(",", fragment.append);
+    }
+    fragment.both = absl::StrJoin(
+        {absl::string_view(fragment.prepend), absl::string_view(fragment.append)},
+        fragment.prepend.empty() || fragment.append.empty() ? "" : ",");
+    fragment.new_field =
+        absl::StrCat(json(fragment.field).dump(), ":[", fragment.both, "]");
+    fragment.new_field_with_comma = absl::StrCat(",", fragment.new_field);
+  }
+
+  if (has_system_prompt_) {
+    escaped_system_suffix_ = stripEnclosing(
+        json(absl::StrCat("\n", system_prompt_, "\n", developer_prompt_))
+            .dump());
+    new_system_value_ =
+        json(absl::StrCat(system_prompt_, "\n", developer_prompt_)).dump();
+    new_system_field_ = absl::StrCat("\"system\":", new_system_value_);
+    new_system_field_with_comma_ = absl::StrCat(",", new_system_field_);
+  }
+}
+
+bool CompiledPromptEnrichment::apply(json &json_body) const {
+  if (!json_body.is_object()) {
+    return false;
+  }
+
+  for (const auto &fragment : arrays_) {
+    const auto it = json_body.find(fragment.field);
+    if (it == json_body.end() ? !fragment.create_if_missing
+                              : !it->is_array()) {
+      return false;
+    }
+  }
+
+  for (const auto &fragment : arrays_) {
+    auto &value = json_body[fragment.field];
+    if (value.is_null()) {
+      value = json::array();
+    }
+    value.insert(value.begin(), fragment.prepend_json.begin(),
+                 fragment.prepend_json.end());
+    value.insert(value.end(), fragment.append_json.begin(),
+                 fragment.append_json.end());
+  }
+
+  if (has_system_prompt_) {
+    const auto it = json_body.find("system");
+    if (it == json_body.end() || !it->is_string()) {
+      json_body["system"] =
+          absl::StrCat(system_prompt_, "\n", developer_prompt_);
+    } else {
+      // For Anthropic, we group system and developer prompt separately and
+      // always append to existing system prompt regardless if they are in the
+      // prepend or append prompts as I don't think the prepend/append concept
+      // applies to Anthropic's single system prompt field.
+      *it = absl::StrCat(it->get_ref<const json::string_t &>(), "\n",
+                         system_prompt_, "\n", developer_prompt_);
+    }
+  }
+
+  return true;
+}
+
+bool CompiledPromptEnrichment::splice(absl::string_view body,
+                                      Buffer::Instance &output) const {
+  absl::flat_hash_map<absl::string_view, RawJsonValue> fields;
+  size_t object_end;
+  if (!scanJsonObjectFields(body, fields, object_end)) {
+    return false;
+  }
+
+  bool object_empty = fields.empty();
+  absl::InlinedVector<RawJsonEdit, 8> edits;
+  for (const auto &fragment : arrays_) {
+    const auto it = fields.find(fragment.field);
+    if (it == fields.end()) {
+      if (!fragment.create_if_missing) {
+        return false;
+      }
+      edits.push_back({object_end, 0,
+                       object_empty ? fragment.new_field
+                                    : fragment.new_field_with_comma});
+      object_empty = false;
+      continue;
+    }
+
+    const RawJsonValue &value = it->second;
+    if (body[value.begin] != '[') {
+      return false;
+    }
+    if (skipJsonWhitespace(body, value.begin + 1) == value.end - 1) {
+      edits.push_back({value.begin + 1, 0, fragment.both});
+      continue;
+    }
+    if (!fragment.prepend.empty()) {
+      edits.push_back({value.begin + 1, 0, fragment.prepend_with_comma});
+    }
+    if (!fragment.append.empty()) {
+      edits.push_back({value.end - 1, 0, fragment.append_with_comma});
+    }
+  }
+
+  if (has_system_prompt_) {
+    const auto it = fields.find("system");
+    if (it == fields.end()) {
+      edits.push_back({object_end, 0,
+                       object_empty ? new_system_field_
+                                    : new_system_field_with_comma_});
+    } else if (body[it->second.begin] == '"') {
+      edits.push_back({it->second.end - 1, 0, escaped_system_suffix_});
+    } else {
+      edits.push_back({it->second.begin, it->second.end - it->second.begin,
+                       new_system_value_});
+    }
+  }
+
+  std::stable_sort(edits.begin(), edits.end(),
+                   [](const RawJsonEdit &a, const RawJsonEdit &b) {
+                     return a.offset < b.offset;
+                   });
+  size_t pos = 0;
+  for (const auto &edit : edits) {
+    output.add(body.substr(pos, edit.offset - pos));
+    output.add(edit.text);
+    pos = edit.offset + edit.remove;
+  }
+  output.add(body.substr(pos));
+  return true;
+}
+
 AiTransformer::AiTransformer(
     const envoy::api::v2::filter::http::AiTransformation &transformation,
-    google::protobuf::BoolValue log_request_response_info)
+    google::protobuf::BoolValue log_request_response_info,
+    ThreadLocal::SlotAllocator &tls)
     : Transformer(log_request_response_info),
       enable_chat_streaming_(transformation.enable_chat_streaming()),
-      prompt_enrichment_(transformation.prompt_enrichment()) {
+      extract_streaming_usage_(transformation.extract_streaming_usage()),
+      translate_schema_(transformation.translate_schema()),
+      prompt_enrichment_(transformation.prompt_enrichment()),
+      openai_prompts_(prompt_enrichment_,
+                      AiTransformerConstants::get().SCHEMA_OPENAI),
+      anthropic_prompts_(prompt_enrichment_,
+                         AiTransformerConstants::get().SCHEMA_ANTHROPIC),
+      gemini_prompts_(prompt_enrichment_,
+                      AiTransformerConstants::get().SCHEMA_GEMINI),
+      bedrock_prompts_(prompt_enrichment_,
+                       AiTransformerConstants::get().SCHEMA_BEDROCK) {
   for (const auto &field_default : transformation.field_defaults()) {
     field_defaults_.emplace_back(field_default);
   }
+
+  tls_ = ThreadLocal::TypedSlot<AiEndpointMetadataCache>::makeUnique(tls);
+  tls_->set([](Event::Dispatcher &) {
+    return std::make_shared<AiEndpointMetadataCache>();
+  });
 };
 
+const CompiledPromptEnrichment &
+AiTransformer::compiledPromptEnrichment(const std::string &schema) const {
+  if (schema == AiTransformerConstants::get().SCHEMA_GEMINI) {
+    return gemini_prompts_;
+  } else if (schema == AiTransformerConstants::get().SCHEMA_BEDROCK) {
+    return bedrock_prompts_;
+  } else if (schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC) {
+    return anthropic_prompts_;
+  }
+  return openai_prompts_;
+}
+
+ResponseBodyObserverPtr AiTransformer::createResponseBodyObserver() const {
+  if (!extract_streaming_usage_) {
+    return nullptr;
+  }
+  return std::make_unique<AiStreamUsageExtractor>();
+}
+
+ResponseBodyTranscoderPtr AiTransformer::createResponseBodyTranscoder() const {
+  if (!translate_schema_) {
+    return nullptr;
+  }
+  return std::make_unique<AiResponseTranscoder>(*tls_->get());
+}
+
+AiResponseTranscoder::AiResponseTranscoder(
+    AiEndpointMetadataCache &metadata_cache)
+    : metadata_cache_(metadata_cache),
+      splitter_(MaxEventSize,
+                [this](absl::string_view event_type, absl::string_view payload) {
+                  onEvent(event_type, payload);
+                }) {}
+
+void AiResponseTranscoder::onHeaders(Http::ResponseHeaderMap &headers,
+                                     Http::StreamFilterCallbacks &callbacks) {
+  active_ = false;
+  // Error responses are passed through as the provider sent them
+  const uint64_t status = Http::Utility::getResponseStatus(headers);
+  if (status < 200 || status >= 300) {
+    return;
+  }
+
+  if (!callbacks.upstreamCallbacks().has_value()) {
+    return;
+  }
+  const auto upstream_info = callbacks.upstreamCallbacks()
+                                 .value()
+                                 .get()
+                                 .upstreamStreamInfo()
+                                 .upstreamInfo();
+  if (!upstream_info || !upstream_info->upstreamHost() ||
+      !upstream_info->upstreamHost()->metadata()) {
+    return;
+  }
+  const AiEndpointMetadataConstSharedPtr endpoint_metadata =
+      metadata_cache_.get(upstream_info->upstreamHost()->metadata());
+  const std::string &json_schema = endpoint_metadata->json_schema_;
+  if (json_schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC) {
+    schema_ = Schema::Anthropic;
+  } else if (json_schema == AiTransformerConstants::get().SCHEMA_GEMINI) {
+    schema_ = Schema::Gemini;
+  } else if (json_schema == AiTransformerConstants::get().SCHEMA_BEDROCK) {
+    schema_ = Schema::Bedrock;
+  } else {
+    return;
+  }
+
+  const auto format = AiEventStreamSplitter::formatForContentType(
+      headers.getContentTypeValue());
+  streaming_ = format != AiEventStreamSplitter::Format::None;
+  if (streaming_) {
+    splitter_.setFormat(format);
+    headers.setContentType(AiEventStreamConstants::get().EventStreamContentType);
+  } else if (!absl::StartsWithIgnoreCase(
+                 headers.getContentTypeValue(),
+                 Http::Headers::get().ContentTypeValues.Json)) {
+    return;
+  }
+  headers.removeContentLength();
+
+  model_ = endpoint_metadata->model_;
+  id_ = absl::StrCat("chatcmpl-", callbacks.streamId());
+  created_ = std::chrono::duration_cast<std::chrono::seconds>(
+                 callbacks.dispatcher()
+                     .timeSource()
+                     .systemTime()
+                     .time_since_epoch())
+                 .count();
+  active_ = true;
+  ENVOY_STREAM_LOG(debug, "translating {} {} response to openai", callbacks,
+                   json_schema, streaming_ ? "streamed" : "complete");
+}
+
+void AiResponseTranscoder::transcode(Buffer::Instance &data, bool end_stream,
+                                     Http::StreamFilterCallbacks &callbacks) {
+  if (!active_) {
+    return;
+  }
+
+  if (!streaming_) {
+    // The filter buffers the response, so this is the complete body.
+    if (!end_stream) {
+      return;
+    }
+    const char *body = static_cast<const char *>(data.linearize(data.length()));
+    const json response =
+        json::parse(body, body + data.length(), nullptr, false);
+    json translated;
+    if (!response.is_discarded() && response.is_object() &&
+        translateResponse(response, translated)) {
+      data.drain(data.length());
+      // The upstream text may not be valid UTF-8, which is replaced rather
+      // than thrown on.
+      data.add(translated.dump(-1, ' ', false, json::error_handler_t::replace));
+    } else {
+      ENVOY_STREAM_LOG(debug, "unexpected response, passing through",
+                       callbacks);
+    }
+    active_ = false;
+    return;
+  }
+
+  for (const Buffer::RawSlice &slice : data.getRawSlices()) {
+    splitter_.parse(
+        absl::string_view(static_cast<const char *>(slice.mem_), slice.len_));
+  }
+  data.drain(data.length());
+  if (end_stream) {
+    finishStream();
+  }
+  if (!output_.empty()) {
+    data.add(output_);
+    output_.clear();
+  }
+}
+
+void AiResponseTranscoder::onEvent(absl::string_view event_type,
+                                   absl::string_view payload) {
+  const json event = json::parse(payload, nullptr, false);
+  if (event.is_discarded() || !event.is_object()) {
+    ENVOY_LOG(debug, "failed to parse streamed event as json, dropping it");
+    return;
+  }
+
+  switch (schema_) {
+  case Schema::Anthropic:
+    onAnthropicEvent(event);
+    break;
+  case Schema::Gemini:
+    onGeminiEvent(event);
+    break;
+  case Schema::Bedrock:
+    onBedrockEvent(event_type, event);
+    break;
+  }
+}
+
+void AiResponseTranscoder::onAnthropicEvent(const json &event) {
+  const std::string type = stringField(event, "type");
+  if (type == "message_start") {
+    const auto message_it = event.find("message");
+    if (message_it != event.end() && message_it->is_object()) {
+      updateIdAndModel(stringField(*message_it, "id"),
+                       stringField(*message_it, "model"));
+      const auto usage_it = message_it->find("usage");
+      if (usage_it != message_it->end() && usage_it->is_object()) {
+        updateUsage(*usage_it, "input_tokens", "output_tokens", nullptr);
+      }
+    }
+    writeChunk({{"content", ""}});
+  } else if (type == "content_block_delta") {
+    const auto delta_it = event.find("delta");
+    if (delta_it != event.end() && delta_it->is_object()) {
+      const std::string text = stringField(*delta_it, "text");
+      if (!text.empty()) {
+        writeChunk({{"content", text}});
+      }
+    }
+  } else if (type == "message_delta") {
+    const auto usage_it = event.find("usage");
+    if (usage_it != event.end() && usage_it->is_object()) {
+      updateUsage(*usage_it, "input_tokens", "output_tokens", nullptr);
+    }
+    const auto delta_it = event.find("delta");
+    if (delta_it != event.end() && delta_it->is_object()) {
+      const std::string stop_reason = stringField(*delta_it, "stop_reason");
+      if (!stop_reason.empty()) {
+        writeChunk(json::object(), openAiFinishReason(stop_reason));
+      }
+    }
+  } else if (type == "error") {
+    writeEvent({{"error", event.value("error", json::object())}});
+  }
+}
+
+void AiResponseTranscoder::onGeminiEvent(const json &event) {
+  updateIdAndModel(stringField(event, "responseId"),
+                   stringField(event, "modelVersion"));
+  const auto usage_it = event.find("usageMetadata");
+  if (usage_it != event.end() && usage_it->is_object()) {
+    updateUsage(*usage_it, "promptTokenCount", "candidatesTokenCount",
+                "totalTokenCount");
+  }
+
+  const json *candidate = firstGeminiCandidate(event);
+  if (candidate == nullptr) {
+    return;
+  }
+  std::string text;
+  const auto content_it = candidate->find("content");
+  if (content_it != candidate->end() && content_it->is_object()) {
+    text = contentBlocksText(content_it->value("parts", json::array()));
+  }
+  const std::string finish_reason = stringField(*candidate, "finishReason");
+  if (text.empty() && finish_reason.empty()) {
+    return;
+  }
+  json delta = json::object();
+  if (!text.empty()) {
+    delta["content"] = std::move(text);
+  }
+  writeChunk(std::move(delta), finish_reason.empty()
+                                   ? json(nullptr)
+                                   : json(openAiFinishReason(finish_reason)));
+}
+
+void AiResponseTranscoder::onBedrockEvent(absl::string_view event_type,
+                                          const json &event) {
+  // The payload of each event type has a distinct shape
+  if (event_type == "contentBlockDelta") {
+    const auto delta_it = event.find("delta");
+    if (delta_it != event.end() && delta_it->is_object()) {
+      const std::string text = stringField(*delta_it, "text");
+      if (!text.empty()) {
+        writeChunk({{"content", text}});
+      }
+    }
+  } else if (event_type == "messageStop") {
+    writeChunk(json::object(),
+               openAiFinishReason(stringField(event, "stopReason")));
+  } else if (event_type == "metadata") {
+    const auto usage_it = event.find("usage");
+    if (usage_it != event.end() && usage_it->is_object()) {
+      updateUsage(*usage_it, "inputTokens", "outputTokens", "totalTokens");
+    }
+  } else if (event_type == "messageStart") {
+    writeChunk({{"content", ""}});
+  } else if (absl::EndsWith(event_type, "Exception")) {
+    // exceptions only carry a message
+    writeEvent({{"error",
+                 {{"type", std::string(event_type)},
+                  {"message", stringField(event, "message")}}}});
+  }
+}
+
+bool AiResponseTranscoder::translateResponse(const json &response,
+                                             json &translated) {
+  std::string text;
+  std::string finish_reason;
+  switch (schema_) {
+  case Schema::Anthropic: {
+    if (stringField(response, "type") != "message") {
+      return false;
+    }
+    updateIdAndModel(stringField(response, "id"),
+                     stringField(response, "model"));
+    text = contentBlocksText(response.value("content", json::array()));
+    finish_reason = stringField(response, "stop_reason");
+    const auto usage_it = response.find("usage");
+    if (usage_it != response.end() && usage_it->is_object()) {
+      updateUsage(*usage_it, "input_tokens", "output_tokens", nullptr);
+    }
+    break;
+  }
+  case Schema::Gemini: {
+    const json *candidate = firstGeminiCandidate(response);
+    if (candidate == nullptr) {
+      return false;
+    }
+    updateIdAndModel(stringField(response, "responseId"),
+                     stringField(response, "modelVersion"));
+    const auto content_it = candidate->find("content");
+    if (content_it != candidate->end() && content_it->is_object()) {
+      text = contentBlocksText(content_it->value("parts", json::array()));
+    }
+    finish_reason = stringField(*candidate, "finishReason");
+    const auto usage_it = response.find("usageMetadata");
+    if (usage_it != response.end() && usage_it->is_object()) {
+      updateUsage(*usage_it, "promptTokenCount", "candidatesTokenCount",
+                  "totalTokenCount");
+    }
+    break;
+  }
+  case Schema::Bedrock: {
+    const auto output_it = response.find("output");
+    if (output_it == response.end() || !output_it->is_object()) {
+      return false;
+    }
+    const auto message_it = output_it->find("message");
+    if (message_it == output_it->end() || !message_it->is_object()) {
+      return false;
+    }
+    text = contentBlocksText(message_it->value("content", json::array()));
+    finish_reason = stringField(response, "stopReason");
+    const auto usage_it = response.find("usage");
+    if (usage_it != response.end() && usage_it->is_object()) {
+      updateUsage(*usage_it, "inputTokens", "outputTokens", "totalTokens");
+    }
+    break;
+  }
+  }
+
+  json choice = {{"index", 0},
+                 {"message", {{"role", "assistant"}, {"content", text}}},
+                 {"finish_reason", openAiFinishReason(finish_reason)}};
+  translated = {{"id", id_},
+                {"object", "chat.completion"},
+                {"created", created_},
+                {"model", model_},
+                {"choices", json::array({std::move(choice)})}};
+  if (has_usage_) {
+    translated["usage"] = usageJson();
+  }
+  return true;
+}
+
+void AiResponseTranscoder::updateIdAndModel(const std::string &id,
+                                            const std::string &model) {
+  if (!id.empty()) {
+    id_ = id;
+  }
+  if (!model.empty()) {
+    model_ = model;
+  }
+}
+
+void AiResponseTranscoder::updateUsage(const json &usage,
+                                       const char *prompt_key,
+                                       const char *completion_key,
+                                       const char *total_key) {
+  readTokenCount(usage, prompt_key, usage_.prompt_tokens);
+  readTokenCount(usage, completion_key, usage_.completion_tokens);
+  if (total_key != nullptr && usage.contains(total_key)) {
+    readTokenCount(usage, total_key, usage_.total_tokens);
+    total_reported_ = true;
+  }
+  has_usage_ = true;
+}
+
+json AiResponseTranscoder::usageJson() const {
+  return {{"prompt_tokens", usage_.prompt_tokens},
+          {"completion_tokens", usage_.completion_tokens},
+          {"total_tokens",
+           total_reported_ ? usage_.total_tokens
+                           : usage_.prompt_tokens + usage_.completion_tokens}};
+}
+
+void AiResponseTranscoder::writeChunk(json delta, json finish_reason) {
+  // The first chunk of an OpenAI stream announces the role
+  if (!sent_role_) {
+    delta["role"] = "assistant";
+    sent_role_ = true;
+  }
+  json choice = {{"index", 0},
+                 {"delta", std::move(delta)},
+                 {"finish_reason", std::move(finish_reason)}};
+  writeEvent({{"id", id_},
+              {"object", "chat.completion.chunk"},
+              {"created", created_},
+              {"model", model_},
+              {"choices", json::array({std::move(choice)})}});
+}
+
+void AiResponseTranscoder::writeEvent(const json &event) {
+  absl::StrAppend(
+      &output_, "data: ",
+      event.dump(-1, ' ', false, json::error_handler_t::replace), "\n\n");
+}
+
+void AiResponseTranscoder::finishStream() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  splitter_.finish();
+  // Sent as the final chunk with no choices, as OpenAI does for
+  // `stream_options.include_usage`
+  if (has_usage_) {
+    writeEvent({{"id", id_},
+                {"object", "chat.completion.chunk"},
+                {"created", created_},
+                {"model", model_},
+                {"choices", json::array()},
+                {"usage", usageJson()}});
+  }
+  absl::StrAppend(&output_, "data: [DONE]\n\n");
+}
+
 std::tuple<bool, bool> AiTransformer::transformHeaders(
     Http::RequestHeaderMap *request_headers,
-    Envoy::Upstream::MetadataConstSharedPtr endpoint_metadata,
+    const AiEndpointMetadata &endpoint_metadata,
     Http::StreamFilterCallbacks &callbacks, const std::string &model) const {
   std::string path;
   bool in_bypass_mode = false;
   bool update_model_in_body = false;
-  auto provider = lookupEndpointMetadata(endpoint_metadata, "provider");
+  const auto &provider = endpoint_metadata.provider_;
   bool in_auth_token_passthru_mode = false;
-  auto auth_token = lookupEndpointMetadata(endpoint_metadata, "auth_token");
+  std::string_view auth_token = endpoint_metadata.auth_token_;
   if (auth_token.empty()) {
     in_auth_token_passthru_mode = true;
     auth_token = getTokenFromAuthorizationHeader(request_headers);
@@ -583,18 +1455,18 @@ std::tuple<bool, bool> AiTransformer::transformHeaders(
   std::string_view original_path = getRequestPath(request_headers);
   if (provider == AiTransformerConstants::get().PROVIDER_AZURE) {
     ASSERT(!model.empty(), "Azure OpenAI: required model setting is missing!");
-    path = replaceModelInPath(lookupEndpointMetadata(endpoint_metadata, "path"),
+    path = replaceModelInPath(endpoint_metadata.path_,
                               model);
     setProviderKeyHeader(request_headers,
                          AiTransformerConstants::get().AzureApiKeyHeader,
                          auth_token, in_auth_token_passthru_mode);
 
   } else if (provider == AiTransformerConstants::get().PROVIDER_GEMINI) {
-    path = lookupEndpointMetadata(endpoint_metadata, "path");
+    path = endpoint_metadata.path_;
     if (path.empty()) {
       ASSERT(!model.empty(), "Gemini: required model setting is missing!");
       path = replaceModelInPath(
-          lookupEndpointMetadata(endpoint_metadata, "base_path"), model);
+          endpoint_metadata.base_path_, model);
       if (enable_chat_streaming_) {
         absl::StrAppend(
             &path, AiTransformerConstants::get().GEMINI_STREAM_GENERATE_CONTENT,
@@ -618,11 +1490,11 @@ std::tuple<bool, bool> AiTransformer::transformHeaders(
                          auth_token, in_auth_token_passthru_mode);
 
   } else if (provider == AiTransformerConstants::get().PROVIDER_BEDROCK) {
-    path = lookupEndpointMetadata(endpoint_metadata, "path");
+    path = endpoint_metadata.path_;
     if (path.empty()) {
       ASSERT(!model.empty(), "Bedrock: required model setting is missing!");
       path = replaceModelInPath(
-          lookupEndpointMetadata(endpoint_metadata, "base_path"), model);
+          endpoint_metadata.base_path_, model);
       if (enable_chat_streaming_) {
         absl::StrAppend(&path, AiTransformerConstants::get().BEDROCK_CONVERSE_STREAM);
       } else {
@@ -630,12 +1502,12 @@ std::tuple<bool, bool> AiTransformer::transformHeaders(
       }
     }
   } else if (provider == AiTransformerConstants::get().PROVIDER_VERTEXAI) {
-    path = lookupEndpointMetadata(endpoint_metadata, "path");
+    path = endpoint_metadata.path_;
     if (path.empty()) {
       ASSERT(!model.empty(), "VertexAI: required model setting is missing!");
       path = replaceModelInPath(
-          lookupEndpointMetadata(endpoint_metadata, "base_path"), model);
-      auto model_path = lookupEndpointMetadata(endpoint_metadata, "model_path");
+          endpoint_metadata.base_path_, model);
+      const auto &model_path = endpoint_metadata.model_path_;
       if (model_path.empty()) {
         if (enable_chat_streaming_) {
           absl::StrAppend(
@@ -662,7 +1534,7 @@ std::tuple<bool, bool> AiTransformer::transformHeaders(
     if (is_platform_api_request) {
       // platform_api_base_path is set by the control plane when there is a
       // Custom PathOverride with BasePath
-      auto base_path = lookupEndpointMetadata(endpoint_metadata, "platform_api_base_path");
+      const auto &base_path = endpoint_metadata.platform_api_base_path_;
       if (base_path.empty()) {
         path = std::move(new_path);
       } else {
@@ -673,14 +1545,18 @@ std::tuple<bool, bool> AiTransformer::transformHeaders(
       if (!model.empty()) {
         update_model_in_body = true;
       }
-      path = lookupEndpointMetadata(endpoint_metadata, "path");
+      path = endpoint_metadata.path_;
       if (path.empty()) {
-        path = "/v1/chat/completions";
+        // OpenAI requests translated for Anthropic go to the messages api
+        path = translate_schema_ && endpoint_metadata.json_schema_ ==
+                                        AiTransformerConstants::get().SCHEMA_ANTHROPIC
+                   ? "/v1/messages"
+                   : "/v1/chat/completions";
       }
     }
 
     if (provider == AiTransformerConstants::get().PROVIDER_ANTHROPIC) {
-      auto version = lookupEndpointMetadata(endpoint_metadata, "version");
+      const auto &version = endpoint_metadata.version_;
       if (!version.empty()) {
         request_headers->setReferenceKey(
             AiTransformerConstants::get().AnthropicVersionHeader, version);
@@ -705,7 +1581,7 @@ std::tuple<bool, bool> AiTransformer::transformHeaders(
 
 void AiTransformer::transformBody(
     Http::RequestHeaderMap *request_headers,
-    Envoy::Upstream::MetadataConstSharedPtr endpoint_metadata,
+    const AiEndpointMetadata &endpoint_metadata,
     Buffer::Instance &body, Http::StreamFilterCallbacks &callbacks,
     const std::string &model) const {
   bool body_modified = false;
@@ -751,24 +1627,64 @@ void AiTransformer::transformBody(
     }
   }
 
-  auto json_schema = lookupEndpointMetadata(endpoint_metadata, "json_schema");
-  auto &prepend_prompts = prompt_enrichment_.prepend();
-  auto &append_prompts = prompt_enrichment_.append();
-  if (prepend_prompts.size() > 0 || append_prompts.size() > 0) {
+  const auto &json_schema = endpoint_metadata.json_schema_;
+  // The client speaks OpenAI, the body is translated to the endpoint schema
+  // once everything else is applied.
+  const bool translate =
+      translate_schema_ &&
+      (json_schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC ||
+       json_schema == AiTransformerConstants::get().SCHEMA_GEMINI ||
+       json_schema == AiTransformerConstants::get().SCHEMA_BEDROCK);
+  const bool enable_stream_in_body =
+      enable_chat_streaming_ && !translate &&
+      (json_schema == AiTransformerConstants::get().SCHEMA_OPENAI ||
+       json_schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC);
+  const auto &prompts = compiledPromptEnrichment(
+      translate ? AiTransformerConstants::get().SCHEMA_OPENAI : json_schema);
+  if (!prompts.empty()) {
+    if (!body_modified && !enable_stream_in_body && !translate) {
+      // Nothing else changes the body, so splice the pre-serialized prompts
+      // into the raw bytes instead of going through the DOM.
+      const absl::string_view raw_body(
+          static_cast<const char *>(body.linearize(body.length())),
+          body.length());
+      Buffer::OwnedImpl enriched_body;
+      if (prompts.splice(raw_body, enriched_body)) {
+        request_headers->removeContentLength();
+        body.drain(body.length());
+        body.move(enriched_body);
+        request_headers->setContentLength(body.length());
+        return;
+      }
+    }
+
     if (!parseJson()) {
       return;
     }
 
-    if (!addPrompts(json_schema, json_body, prepend_prompts, append_prompts)) {
+    if (!prompts.apply(json_body)) {
       ENVOY_STREAM_LOG(error, "failed to add prompts!", callbacks);
     } else {
       body_modified = true;
     }
   }
 
-  if (enable_chat_streaming_) {
-    if (json_schema == AiTransformerConstants::get().SCHEMA_OPENAI ||
-        json_schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC) {
+  if (translate) {
+    if (!parseJson()) {
+      return;
+    }
+    if (json_schema == AiTransformerConstants::get().SCHEMA_ANTHROPIC) {
+      json_body = toAnthropicRequest(json_body, enable_chat_streaming_);
+    } else if (json_schema == AiTransformerConstants::get().SCHEMA_GEMINI) {
+      json_body = toGeminiRequest(json_body);
+    } else {
+      json_body = toBedrockRequest(json_body);
+    }
+    ENVOY_STREAM_LOG(debug, "translated request from openai to {}", callbacks,
+                     json_schema);
+    body_modified = true;
+  } else if (enable_chat_streaming_) {
+    if (enable_stream_in_body) {
       json_body["stream"] = bool(true);
       body_modified = true;
     }
@@ -820,15 +1736,17 @@ void AiTransformer::transform(Http::RequestOrResponseHeaderMap & /*header_map*/,
     return;
   }
 
-  auto model = lookupEndpointMetadata(endpoint_metadata, "model");
+  const AiEndpointMetadataConstSharedPtr ai_metadata =
+      tls_->get()->get(endpoint_metadata);
+  const auto &model = ai_metadata->model_;
   auto [in_bypass_mode, update_model_in_body] =
-      transformHeaders(request_headers, endpoint_metadata, callbacks, model);
+      transformHeaders(request_headers, *ai_metadata, callbacks, model);
   if (in_bypass_mode || body.length() == 0) {
     return;
   }
 
-  transformBody(request_headers, endpoint_metadata, body, callbacks,
-                update_model_in_body ? model : std::string{""});
+  transformBody(request_headers, *ai_metadata, body, callbacks,
+                update_model_in_body ? model : EMPTY_STRING);
 }
 
 } // namespace Transformation
@@ -5,6 +5,10 @@
 #include "api/envoy/config/filter/http/transformation/v2/transformation_filter.pb.validate.h"
 
 #include "envoy/http/filter.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/host_description.h"
+
+#include "absl/container/flat_hash_map.h"
 #include "nlohmann/json.hpp"
 #include "source/common/common/logger.h"
 #include "source/common/common/matchers.h"
@@ -12,6 +16,8 @@
 #include "source/common/http/header_utility.h"
 #include "source/common/regex/regex.h"
 #include "source/common/singleton/const_singleton.h"
+#include "ai_event_stream.h"
+#include "ai_stream_usage.h"
 #include "transformer.h"
 
 namespace Envoy {
@@ -90,6 +96,68 @@ private:
   }
 };
 
+/**
+ * Prompt enrichment pre-serialized for one api schema at config time. The
+ * prompts are kept both as json values, to merge into an already parsed body,
+ * and as raw json fragments that are spliced into the body bytes, so a request
+ * that needs no other body change is enriched without building a DOM.
+ */
+class CompiledPromptEnrichment {
+public:
+  CompiledPromptEnrichment(const PromptEnrichment &prompt_enrichment,
+                           const std::string &schema);
+
+  bool empty() const { return arrays_.empty() && !has_system_prompt_; }
+
+  /**
+   * @brief Add the prompts to a parsed body
+   *
+   * @param json_body modified in place
+   * @return false if the body does not have the fields holding the prompts, in
+   * which case it is left untouched
+   */
+  bool apply(nlohmann::json &json_body) const;
+
+  /**
+   * @brief Splice the pre-serialized prompts into a raw json body
+   *
+   * @param body the original body
+   * @param output receives the enriched body
+   * @return false if the body is not a json object with the fields holding
+   * the prompts, in which case nothing is written to output
+   */
+  bool splice(absl::string_view body, Buffer::Instance &output) const;
+
+private:
+  // The prompts that go into one array field of the request body
+  struct ArrayFragment {
+    std::string field;
+    bool create_if_missing{};
+    nlohmann::json prepend_json = nlohmann::json::array();
+    nlohmann::json append_json = nlohmann::json::array();
+    // comma separated json of the messages
+    std::string prepend;
+    std::string append;
+    // pre-joined variants, so that splicing never formats anything
+    std::string prepend_with_comma;
+    std::string append_with_comma;
+    std::string both;
+    std::string new_field;
+    std::string new_field_with_comma;
+  };
+
+  std::vector<ArrayFragment> arrays_;
+
+  // Anthropic takes system and developer prompts as a single `system` string
+  bool has_system_prompt_{};
+  std::string system_prompt_;
+  std::string developer_prompt_;
+  std::string escaped_system_suffix_;
+  std::string new_system_value_;
+  std::string new_system_field_;
+  std::string new_system_field_with_comma_;
+};
+
 struct FieldDefault {
   FieldDefault(const envoy::api::v2::filter::http::FieldDefault &);
   virtual ~FieldDefault() = default;
@@ -112,13 +180,120 @@ private:
 
 using AiTransformerConstants = ConstSingleton<AiTransformerValues>;
 
+/**
+ * The AI settings the control plane puts in the `io.solo.transformation`
+ * endpoint metadata, parsed once per metadata instance instead of walking the
+ * protobuf on every request.
+ */
+struct AiEndpointMetadata {
+  AiEndpointMetadata(const envoy::config::core::v3::Metadata &metadata);
+
+  const std::string provider_;
+  const std::string auth_token_;
+  const std::string json_schema_;
+  const std::string model_;
+  const std::string model_path_;
+  const std::string path_;
+  const std::string base_path_;
+  const std::string platform_api_base_path_;
+  const std::string version_;
+};
+
+using AiEndpointMetadataConstSharedPtr =
+    std::shared_ptr<const AiEndpointMetadata>;
+
+/**
+ * Per worker cache of parsed endpoint metadata, keyed by the host's metadata
+ * instance. An EDS update that changes the metadata of a host replaces the
+ * instance, so stale entries are never returned and are dropped once the
+ * cache is full.
+ */
+class AiEndpointMetadataCache : public ThreadLocal::ThreadLocalObject {
+public:
+  static constexpr size_t MaxEntries = 1024;
+
+  AiEndpointMetadataConstSharedPtr
+  get(const Upstream::MetadataConstSharedPtr &metadata);
+
+  size_t size() const { return entries_.size(); }
+
+private:
+  struct Entry {
+    std::weak_ptr<const envoy::config::core::v3::Metadata> metadata_;
+    AiEndpointMetadataConstSharedPtr parsed_;
+  };
+
+  absl::flat_hash_map<const envoy::config::core::v3::Metadata *, Entry>
+      entries_;
+};
+
+/**
+ * Translates the response to a request that was translated from the OpenAI
+ * schema back into an OpenAI chat completion. Streamed responses are
+ * transcoded event by event into `chat.completion.chunk` server-sent events,
+ * ending with a usage chunk and `[DONE]`; only the event being received is
+ * held in memory. Complete responses are buffered by the filter. Error
+ * responses and unexpected bodies are passed through.
+ */
+class AiResponseTranscoder : public ResponseBodyTranscoder,
+                             public Logger::Loggable<Logger::Id::filter> {
+public:
+  // Larger streamed events are dropped.
+  static constexpr size_t MaxEventSize = 1024 * 1024;
+
+  // The cache is the worker's, which outlives the stream.
+  AiResponseTranscoder(AiEndpointMetadataCache &metadata_cache);
+
+  void onHeaders(Http::ResponseHeaderMap &headers,
+                 Http::StreamFilterCallbacks &callbacks) override;
+  void transcode(Buffer::Instance &data, bool end_stream,
+                 Http::StreamFilterCallbacks &callbacks) override;
+  bool needsCompleteBody() const override { return active_ && !streaming_; }
+
+private:
+  enum class Schema { Anthropic, Gemini, Bedrock };
+
+  void onEvent(absl::string_view event_type, absl::string_view payload);
+  void onAnthropicEvent(const nlohmann::json &event);
+  void onGeminiEvent(const nlohmann::json &event);
+  void onBedrockEvent(absl::string_view event_type,
+                      const nlohmann::json &event);
+  bool translateResponse(const nlohmann::json &response,
+                         nlohmann::json &translated);
+  void updateIdAndModel(const std::string &id, const std::string &model);
+  void updateUsage(const nlohmann::json &usage, const char *prompt_key,
+                   const char *completion_key, const char *total_key);
+  nlohmann::json usageJson() const;
+  void writeChunk(nlohmann::json delta,
+                  nlohmann::json finish_reason = nullptr);
+  void writeEvent(const nlohmann::json &event);
+  void finishStream();
+
+  AiEndpointMetadataCache &metadata_cache_;
+  AiEventStreamSplitter splitter_;
+  Schema schema_{Schema::Anthropic};
+  bool active_{};
+  bool streaming_{};
+  bool sent_role_{};
+  bool finished_{};
+  std::string id_;
+  std::string model_;
+  uint64_t created_{};
+  // Transcoded events not yet written to the body.
+  std::string output_;
+  TokenUsage usage_;
+  bool has_usage_{};
+  bool total_reported_{};
+};
+
 class AiTransformer
     : public Envoy::Extensions::HttpFilters::Transformation::Transformer,
       public Logger::Loggable<Logger::Id::filter> {
 public:
   AiTransformer(
       const envoy::api::v2::filter::http::AiTransformation &transformation,
-      google::protobuf::BoolValue log_request_response_info);
+      google::protobuf::BoolValue log_request_response_info,
+      ThreadLocal::SlotAllocator &tls);
   virtual ~AiTransformer() = default;
 
   void transform(Http::RequestOrResponseHeaderMap &map,
@@ -126,22 +301,34 @@ public:
                  Buffer::Instance &body,
                  Http::StreamFilterCallbacks &callbacks) const override;
   bool passthrough_body() const override { return false; };
+  ResponseBodyObserverPtr createResponseBodyObserver() const override;
+  ResponseBodyTranscoderPtr createResponseBodyTranscoder() const override;
 
 private:
   std::tuple<bool, bool>
   transformHeaders(Http::RequestHeaderMap *request_headers,
-                   Envoy::Upstream::MetadataConstSharedPtr endpoint_metadata,
+                   const AiEndpointMetadata &endpoint_metadata,
                    Http::StreamFilterCallbacks &callbacks,
                    const std::string &model) const;
   void transformBody(Http::RequestHeaderMap *request_headers,
-                     Envoy::Upstream::MetadataConstSharedPtr endpoint_metadata,
+                     const AiEndpointMetadata &endpoint_metadata,
                      Buffer::Instance &body,
                      Http::StreamFilterCallbacks &callbacks,
                      const std::string &model) const;
 
+  const CompiledPromptEnrichment &
+  compiledPromptEnrichment(const std::string &schema) const;
+
   bool enable_chat_streaming_{false};
+  bool extract_streaming_usage_{false};
+  bool translate_schema_{false};
   std::vector<FieldDefault> field_defaults_;
   PromptEnrichment prompt_enrichment_;
+  const CompiledPromptEnrichment openai_prompts_;
+  const CompiledPromptEnrichment anthropic_prompts_;
+  const CompiledPromptEnrichment gemini_prompts_;
+  const CompiledPromptEnrichment bedrock_prompts_;
+  ThreadLocal::TypedSlotPtr<AiEndpointMetadataCache> tls_;
 };
 
 } // namespace Transformation
@@ -291,6 +291,9 @@ TransformerInstance::TransformerInstance(Runtime::Loader& runtime, ThreadLocal::
   env_.add_callback("word_count", 1, [](Arguments &args) {
     return word_count_callback(args);
   });
+  env_.add_callback("token_estimate", 1, [](Arguments &args) {
+    return token_estimate_callback(args);
+  });
 }
 
 
@@ -537,74 +540,41 @@ json TransformerInstance::base64url_decode_callback(const inja::Arguments &args)
 }
 
 json TransformerInstance::word_count_callback(const inja::Arguments &args) {
-  return json_word_count(args.at(0));
+  TextStats stats;
+  const uint64_t scalars = json_text_stats(*args.at(0), stats);
+  return stats.words() + scalars;
+}
+
+json TransformerInstance::token_estimate_callback(const inja::Arguments &args) {
+  TextStats stats;
+  const uint64_t scalars = json_text_stats(*args.at(0), stats);
+  return stats.estimateTokens() + scalars;
 }
 
-int TransformerInstance::json_word_count(const nlohmann::json* input)  {
-  if (input->is_string()) {
-    const std::string &input_string = input->get_ref<const std::string &>();
-    return word_count(input_string);
-  } else if (input->is_array()) {
-    int total_word_count = 0;
-    const auto &input_array = input->get_ref<const std::vector<json> &>();
-    for (auto & element : input_array) {
-      total_word_count += json_word_count(&element);
+uint64_t TransformerInstance::json_text_stats(const nlohmann::json &input,
+                                              TextStats &stats) {
+  if (input.is_string()) {
+    stats.add(input.get_ref<const std::string &>());
+  } else if (input.is_array()) {
+    uint64_t scalars = 0;
+    for (const auto &element : input.get_ref<const json::array_t &>()) {
+      scalars += json_text_stats(element, stats);
     }
-    return total_word_count;
-  } else if (input->is_object()) {
-    int total_word_count = 0;
-    const auto element_obj = input->get_ref<const json::object_t &>();
-    for (auto & [key, value] : element_obj) {
-      total_word_count += word_count(key);
-      total_word_count += json_word_count(&value);
+    return scalars;
+  } else if (input.is_object()) {
+    uint64_t scalars = 0;
+    for (const auto &[key, value] : input.get_ref<const json::object_t &>()) {
+      stats.add(key);
+      scalars += json_text_stats(value, stats);
     }
-    return total_word_count;
-  } else if (input->is_number() || input->is_boolean()) {
+    return scalars;
+  } else if (input.is_number() || input.is_boolean()) {
     // Booleans and numbers are constant
     return 1;
   }
   return 0;
 }
 
-int TransformerInstance::word_count(const std::string& input_string)  {
-    unsigned long ctr = 0; // Initializing a counter variable to count words
-
-    // Advance through all spaces at the beginning
-
-
-    unsigned long first_char = 0;
-    for (unsigned long x = 0; x < input_string.length(); x++) {
-      // https://en.cppreference.com/w/cpp/string/byte/isspace
-      if (!isspace(input_string[x] )){
-        first_char = x;
-        break;
-      }
-    }
-
-    // Loop through the string and count spaces to determine words
-    bool in_white_space = false;
-    for (unsigned long x = first_char; x < input_string.length(); x++) {
-      // https://en.cppreference.com/w/cpp/string/byte/isspace
-      if (isspace(input_string[x] )){ // Checking for spaces to count words
-        if (!in_white_space){
-          ctr++; // Increment the counter for each new "word"
-        }
-        in_white_space = true;
-      } else{
-        in_white_space = false;
-      }
-    }
-    // Return the count of words by adding 1 to the total number of spaces
-    // (plus 1 for the last word without a trailing space
-    // unless it ends with a space 
-    if (isspace(input_string[input_string.length() - 1] )){
-      return ctr;
-    } else {
-      return ctr + 1;
-    }
-}
-
-
 // return a substring of the input string, starting at the start position
 // and extending for length characters. If length is not provided, the
 // substring will extend to the end of the string.
@@ -10,6 +10,7 @@
 
 #include "envoy/thread_local/thread_local_object.h"
 #include "envoy/thread_local/thread_local.h"
+#include "source/extensions/filters/http/transformation/text_stats.h"
 #include "source/extensions/filters/http/transformation/transformer.h"
 #include "source/common/config/datasource.h"
 
@@ -88,8 +89,11 @@ private:
                                                   char delimiter,
                                                   const inja::Arguments &args);
   static nlohmann::json word_count_callback(const inja::Arguments &args);
-  static int json_word_count(const nlohmann::json* str);
-  static int word_count(const std::string& str);
+  static nlohmann::json token_estimate_callback(const inja::Arguments &args);
+  // Adds the strings and keys of a json value to the stats, and returns the
+  // number of numbers and booleans, which count as one word or token each.
+  static uint64_t json_text_stats(const nlohmann::json &input,
+                                  TextStats &stats);
 
   inja::Environment env_;
   absl::flat_hash_map<std::string, std::string> pattern_replacements_;
@@ -0,0 +1,261 @@
+#include "source/extensions/filters/http/transformation/text_stats.h"
+
+#include <algorithm>
+
+#include "absl/numeric/bits.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TEXT_STATS_X86_64
+#include <immintrin.h>
+#endif
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+namespace {
+
+constexpr size_t BlockSize = 64;
+
+// Bit i of each mask is set if byte i of a block is of the class.
+struct BlockMasks {
+  uint64_t whitespace{};
+  std::array<uint64_t, TextStats::ByteClassCount> classes{};
+};
+
+// Average bytes per token of each byte class, in tenths of a byte. This is
+// the approximation table of TextStats::estimateTokens().
+constexpr std::array<uint64_t, TextStats::ByteClassCount> BytesPerTokenX10 = {
+    40, // Letter: common English words are a single token of about 4 letters
+    30, // Digit: numbers are split in groups of up to 3 digits
+    15, // Punctuation: mostly one token each, common pairs are merged
+    25, // NonAscii: a 3 byte CJK character is one or two tokens
+    40, // Newline: a run of newlines is one token, long runs are split
+};
+
+constexpr uint8_t WhitespaceBit = 1 << TextStats::ByteClassCount;
+
+constexpr std::array<uint8_t, 256> makeByteClassTable() {
+  std::array<uint8_t, 256> table{};
+  for (int c = 0; c < 256; c++) {
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+      table[c] = WhitespaceBit;
+      if (c == '\n') {
+        table[c] |= 1 << TextStats::Newline;
+      }
+    } else if (c >= 0x80) {
+      table[c] = 1 << TextStats::NonAscii;
+    } else if (c >= '0' && c <= '9') {
+      table[c] = 1 << TextStats::Digit;
+    } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+      table[c] = 1 << TextStats::Letter;
+    } else {
+      table[c] = 1 << TextStats::Punctuation;
+    }
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, 256> ByteClassTable = makeByteClassTable();
+
+BlockMasks scalarMasks(const char *data, size_t length) {
+  BlockMasks masks;
+  for (size_t i = 0; i < length; i++) {
+    const uint8_t bits = ByteClassTable[static_cast<uint8_t>(data[i])];
+    masks.whitespace |= uint64_t((bits & WhitespaceBit) != 0) << i;
+    for (size_t c = 0; c < TextStats::ByteClassCount; c++) {
+      masks.classes[c] |= uint64_t((bits >> c) & 1) << i;
+    }
+  }
+  return masks;
+}
+
+// Counts of one call to TextStats::add(), kept apart from the TextStats so
+// that the compiler holds them in registers.
+struct Counter {
+  uint64_t words{};
+  std::array<TextStats::ClassCount, TextStats::ByteClassCount> counts{};
+  // Whether the last byte of the previous block was part of a run
+  bool in_word{};
+  std::array<bool, TextStats::ByteClassCount> in_run{};
+
+  /**
+   * @brief Add the words, bytes and runs of one block
+   *
+   * @param masks the classes of the bytes of the block
+   * @param length the number of bytes in the block, at least 1
+   */
+  inline __attribute__((always_inline)) void add(const BlockMasks &masks,
+                                                 size_t length) {
+    const uint64_t valid =
+        length == BlockSize ? ~uint64_t(0) : (uint64_t(1) << length) - 1;
+    // A run starts at a byte of the class that does not follow one
+    auto count_runs = [length, valid](uint64_t mask, bool &in_run,
+                                      uint64_t &runs) {
+      mask &= valid;
+      runs += absl::popcount(mask & ~((mask << 1) | uint64_t(in_run)));
+      in_run = (mask >> (length - 1)) & 1;
+      return mask;
+    };
+
+    count_runs(~masks.whitespace, in_word, words);
+    for (size_t c = 0; c < TextStats::ByteClassCount; c++) {
+      const uint64_t mask =
+          count_runs(masks.classes[c], in_run[c], counts[c].runs);
+      counts[c].bytes += absl::popcount(mask);
+    }
+  }
+
+  void addTo(uint64_t &total_words,
+             std::array<TextStats::ClassCount, TextStats::ByteClassCount>
+                 &total_counts) const {
+    total_words += words;
+    for (size_t c = 0; c < TextStats::ByteClassCount; c++) {
+      total_counts[c].bytes += counts[c].bytes;
+      total_counts[c].runs += counts[c].runs;
+    }
+  }
+};
+
+#ifdef TEXT_STATS_X86_64
+
+// Bytes in [lo, hi], compared as unsigned
+__attribute__((target("sse4.2,popcnt"))) uint64_t rangeMask(__m128i bytes,
+                                                            char lo, char hi) {
+  const __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(lo));
+  return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(
+      _mm_min_epu8(offset, _mm_set1_epi8(hi - lo)), offset)));
+}
+
+__attribute__((target("sse4.2,popcnt"))) uint64_t movemask(__m128i bytes) {
+  return uint32_t(_mm_movemask_epi8(bytes));
+}
+
+__attribute__((target("sse4.2,popcnt"))) BlockMasks sse42Masks(const char *data) {
+  BlockMasks masks;
+  for (int part = 0; part < 4; part++) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * part));
+    const int shift = 16 * part;
+    masks.whitespace |=
+        (movemask(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))) |
+         rangeMask(bytes, '\t', '\r'))
+        << shift;
+    masks.classes[TextStats::Newline] |=
+        movemask(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))) << shift;
+    masks.classes[TextStats::Digit] |= rangeMask(bytes, '0', '9') << shift;
+    // setting 0x20 lowercases ASCII letters
+    masks.classes[TextStats::Letter] |=
+        rangeMask(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z') << shift;
+    masks.classes[TextStats::NonAscii] |= movemask(bytes) << shift;
+  }
+  masks.classes[TextStats::Punctuation] =
+      ~(masks.whitespace | masks.classes[TextStats::Letter] |
+        masks.classes[TextStats::Digit] | masks.classes[TextStats::NonAscii]);
+  return masks;
+}
+
+__attribute__((target("avx2,popcnt"))) uint64_t rangeMask(__m256i bytes,
+                                                          char lo, char hi) {
+  const __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(lo));
+  return uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+      _mm256_min_epu8(offset, _mm256_set1_epi8(hi - lo)), offset)));
+}
+
+__attribute__((target("avx2,popcnt"))) uint64_t movemask(__m256i bytes) {
+  return uint32_t(_mm256_movemask_epi8(bytes));
+}
+
+__attribute__((target("avx2,popcnt"))) BlockMasks avx2Masks(const char *data) {
+  BlockMasks masks;
+  for (int part = 0; part < 2; part++) {
+    const __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32 * part));
+    const int shift = 32 * part;
+    masks.whitespace |=
+        (movemask(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))) |
+         rangeMask(bytes, '\t', '\r'))
+        << shift;
+    masks.classes[TextStats::Newline] |=
+        movemask(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'))) << shift;
+    masks.classes[TextStats::Digit] |= rangeMask(bytes, '0', '9') << shift;
+    masks.classes[TextStats::Letter] |=
+        rangeMask(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z')
+        << shift;
+    masks.classes[TextStats::NonAscii] |= movemask(bytes) << shift;
+  }
+  masks.classes[TextStats::Punctuation] =
+      ~(masks.whitespace | masks.classes[TextStats::Letter] |
+        masks.classes[TextStats::Digit] | masks.classes[TextStats::NonAscii]);
+  return masks;
+}
+
+// The block loops are duplicated so that the mask functions are inlined.
+__attribute__((target("avx2,popcnt"))) size_t
+countAvx2Blocks(absl::string_view text, Counter &counter) {
+  size_t pos = 0;
+  for (; pos + BlockSize <= text.size(); pos += BlockSize) {
+    counter.add(avx2Masks(text.data() + pos), BlockSize);
+  }
+  return pos;
+}
+
+__attribute__((target("sse4.2,popcnt"))) size_t
+countSse42Blocks(absl::string_view text, Counter &counter) {
+  size_t pos = 0;
+  for (; pos + BlockSize <= text.size(); pos += BlockSize) {
+    counter.add(sse42Masks(text.data() + pos), BlockSize);
+  }
+  return pos;
+}
+
+#endif
+
+} // namespace
+
+void TextStats::add(absl::string_view text) {
+#ifdef TEXT_STATS_X86_64
+  enum class Isa { Avx2, Sse42, None };
+  static const Isa isa = __builtin_cpu_supports("avx2")     ? Isa::Avx2
+                         : __builtin_cpu_supports("sse4.2") ? Isa::Sse42
+                                                            : Isa::None;
+  if (isa != Isa::None) {
+    Counter counter;
+    const size_t pos = isa == Isa::Avx2 ? countAvx2Blocks(text, counter)
+                                        : countSse42Blocks(text, counter);
+    if (pos < text.size()) {
+      counter.add(scalarMasks(text.data() + pos, text.size() - pos),
+                  text.size() - pos);
+    }
+    counter.addTo(words_, counts_);
+    return;
+  }
+#endif
+  addScalar(text);
+}
+
+void TextStats::addScalar(absl::string_view text) {
+  Counter counter;
+  for (size_t pos = 0; pos < text.size(); pos += BlockSize) {
+    const size_t length = std::min(BlockSize, text.size() - pos);
+    counter.add(scalarMasks(text.data() + pos, length), length);
+  }
+  counter.addTo(words_, counts_);
+}
+
+uint64_t TextStats::estimateTokens() const {
+  uint64_t tokens = 0;
+  for (size_t c = 0; c < ByteClassCount; c++) {
+    const ClassCount &count = counts_[c];
+    const uint64_t by_size =
+        (count.bytes * 10 + BytesPerTokenX10[c] - 1) / BytesPerTokenX10[c];
+    tokens += std::max(count.runs, by_size);
+  }
+  return tokens;
+}
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
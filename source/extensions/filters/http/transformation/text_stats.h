@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+/**
+ * Single pass word and byte class counter, used by templates that budget LLM
+ * prompts. Bytes are classified 64 at a time with AVX2 or SSE4.2 when the cpu
+ * has them, and one at a time otherwise; both give the same result.
+ */
+class TextStats {
+public:
+  // Classes of the bytes that are not whitespace, plus newlines.
+  enum ByteClass { Letter, Digit, Punctuation, NonAscii, Newline, ByteClassCount };
+
+  struct ClassCount {
+    uint64_t bytes{};
+    // Runs of consecutive bytes of the class
+    uint64_t runs{};
+  };
+
+  // Accumulates the counts of `text`. Runs do not span separate calls.
+  void add(absl::string_view text);
+  // Same as add(), without vector instructions.
+  void addScalar(absl::string_view text);
+
+  // Runs of bytes that are not ASCII whitespace
+  uint64_t words() const { return words_; }
+  const ClassCount &count(ByteClass byte_class) const {
+    return counts_[byte_class];
+  }
+
+  /**
+   * Approximates the number of tokens a BPE tokenizer of the cl100k / o200k
+   * family produces for the text: each class costs its byte count divided by
+   * the average bytes per token of the class, and at least one token per run.
+   * Whitespace is folded into the following word, except for newlines.
+   */
+  uint64_t estimateTokens() const;
+
+private:
+  uint64_t words_{};
+  std::array<ClassCount, ByteClassCount> counts_{};
+};
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -33,7 +33,8 @@ TransformerConstSharedPtr Transformation::getTransformer(
   }
   case envoy::api::v2::filter::http::Transformation::kAiTransformation:
     return std::make_unique<AiTransformer>(transformation.ai_transformation(),
-                                           transformation.log_request_response_info());
+                                           transformation.log_request_response_info(),
+                                           context.threadLocal());
   case envoy::api::v2::filter::http::Transformation::
       TRANSFORMATION_TYPE_NOT_SET:
     ENVOY_LOG(trace, "Request transformation type not set");
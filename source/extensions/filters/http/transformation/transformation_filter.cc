@@ -101,6 +101,17 @@ TransformationFilter::encodeHeaders(Http::ResponseHeaderMap &header_map,
                                     bool end_stream) {
   response_headers_ = &header_map;
 
+  if (response_body_observer_) {
+    response_body_observer_->onHeaders(header_map, *encoder_callbacks_);
+    if (end_stream) {
+      response_body_observer_->onComplete(*encoder_callbacks_);
+    }
+  }
+  // The observer sees the body as the upstream sent it, before transcoding.
+  if (response_body_transcoder_) {
+    response_body_transcoder_->onHeaders(header_map, *encoder_callbacks_);
+  }
+
   if (!response_transformation_ && route_config_ != nullptr) {
     const TransformConfig *staged_config =
         route_config_->transformConfigForStage(filter_config_->stage());
@@ -129,6 +140,33 @@ TransformationFilter::encodeHeaders(Http::ResponseHeaderMap &header_map,
 
 Http::FilterDataStatus TransformationFilter::encodeData(Buffer::Instance &data,
                                                         bool end_stream) {
+  if (response_body_observer_ && !need_websocket_passthrough_) {
+    response_body_observer_->onData(data, *encoder_callbacks_);
+    if (end_stream) {
+      response_body_observer_->onComplete(*encoder_callbacks_);
+    }
+  }
+  if (response_body_transcoder_ && !need_websocket_passthrough_) {
+    if (!response_body_transcoder_->needsCompleteBody()) {
+      response_body_transcoder_->transcode(data, end_stream,
+                                           *encoder_callbacks_);
+    } else if (responseActive()) {
+      // The body is buffered for the response transformation anyway, and is
+      // transcoded before it.
+      if (end_stream) {
+        response_body_.move(data);
+        response_body_transcoder_->transcode(response_body_, true,
+                                             *encoder_callbacks_);
+      }
+    } else if (!end_stream) {
+      // The connection manager enforces the buffer limit of the stream.
+      return Http::FilterDataStatus::StopIterationAndBuffer;
+    } else {
+      encoder_callbacks_->addEncodedData(data, false);
+      transcodeEncodingBuffer();
+    }
+  }
+
   if (!responseActive() || need_websocket_passthrough_) {
     return destroyed_ ? Http::FilterDataStatus::StopIterationNoBuffer : Http::FilterDataStatus::Continue;
   }
@@ -152,6 +190,28 @@ Http::FilterDataStatus TransformationFilter::encodeData(Buffer::Instance &data,
 
 Http::FilterTrailersStatus
 TransformationFilter::encodeTrailers(Http::ResponseTrailerMap &) {
+  if (response_body_observer_) {
+    response_body_observer_->onComplete(*encoder_callbacks_);
+  }
+  if (response_body_transcoder_ &&
+      response_body_transcoder_->needsCompleteBody()) {
+    if (responseActive()) {
+      response_body_transcoder_->transcode(response_body_, true,
+                                           *encoder_callbacks_);
+    } else {
+      transcodeEncodingBuffer();
+    }
+  } else if (response_body_transcoder_) {
+    Buffer::OwnedImpl tail;
+    response_body_transcoder_->transcode(tail, true, *encoder_callbacks_);
+    if (tail.length() > 0) {
+      if (responseActive()) {
+        response_body_.move(tail);
+      } else {
+        encoder_callbacks_->addEncodedData(tail, false);
+      }
+    }
+  }
   if (responseActive()) {
     filter_config_->stats().response_body_transformations_.inc();
     transformResponse();
@@ -186,6 +246,14 @@ void TransformationFilter::setupTransformationPair() {
         active_transformer_pair->getResponseTranformation();
     on_stream_completion_transformation_ =
         active_transformer_pair->getOnStreamCompletionTransformation();
+    // The request transformation is released once applied, so the observer
+    // for its response has to be created up front.
+    if (request_transformation_ != nullptr) {
+      response_body_observer_ =
+          request_transformation_->createResponseBodyObserver();
+      response_body_transcoder_ =
+          request_transformation_->createResponseBodyTranscoder();
+    }
   }
 }
 
@@ -215,6 +283,16 @@ void TransformationFilter::addEncoderData(Buffer::Instance &data) {
   encoder_callbacks_->addEncodedData(data, false);
 }
 
+void TransformationFilter::transcodeEncodingBuffer() {
+  // Nothing is buffered for a response without a body.
+  if (encoder_callbacks_->encodingBuffer() == nullptr) {
+    return;
+  }
+  encoder_callbacks_->modifyEncodingBuffer([this](Buffer::Instance &body) {
+    response_body_transcoder_->transcode(body, true, *encoder_callbacks_);
+  });
+}
+
 void TransformationFilter::transformOnStreamCompletion() {
   if (on_stream_completion_transformation_ == nullptr) {
     return;
@@ -91,6 +91,8 @@ private:
 
   void addDecoderData(Buffer::Instance &data);
   void addEncoderData(Buffer::Instance &data);
+  // Transcodes the complete response body held in the encoding buffer.
+  void transcodeEncodingBuffer();
   void
   transformSomething(Http::StreamFilterCallbacks &callbacks,
                      TransformerConstSharedPtr &transformation,
@@ -115,6 +117,8 @@ private:
   TransformerConstSharedPtr request_transformation_;
   TransformerConstSharedPtr response_transformation_;
   TransformerConstSharedPtr on_stream_completion_transformation_;
+  ResponseBodyObserverPtr response_body_observer_;
+  ResponseBodyTranscoderPtr response_body_transcoder_;
   absl::optional<Error> error_;
   Http::Code error_code_;
   std::string error_messgae_;
@@ -14,6 +14,49 @@ namespace Extensions {
 namespace HttpFilters {
 namespace Transformation {
 
+/**
+ * Observes a response body as it streams through the filter. Unlike a
+ * response transformation, an observer never buffers the body: it is handed
+ * each chunk of data before the filter forwards it.
+ */
+class ResponseBodyObserver {
+public:
+  virtual ~ResponseBodyObserver() = default;
+
+  virtual void onHeaders(const Http::ResponseHeaderMap &headers,
+                         Http::StreamFilterCallbacks &callbacks) PURE;
+  virtual void onData(const Buffer::Instance &data,
+                      Http::StreamFilterCallbacks &callbacks) PURE;
+  // Called once the response is complete. May be called more than once.
+  virtual void onComplete(Http::StreamFilterCallbacks &callbacks) PURE;
+};
+
+typedef std::unique_ptr<ResponseBodyObserver> ResponseBodyObserverPtr;
+
+/**
+ * Rewrites a response body chunk by chunk as it streams through the filter,
+ * e.g. to translate one event stream format into another, without buffering
+ * more than one incomplete event. A transcoder may instead ask for the
+ * complete body, which the filter then buffers.
+ */
+class ResponseBodyTranscoder {
+public:
+  virtual ~ResponseBodyTranscoder() = default;
+
+  virtual void onHeaders(Http::ResponseHeaderMap &headers,
+                         Http::StreamFilterCallbacks &callbacks) PURE;
+  // Replaces `data` with its transcoded form. Bytes of an incomplete event are
+  // held back until the rest of the event arrives.
+  virtual void transcode(Buffer::Instance &data, bool end_stream,
+                         Http::StreamFilterCallbacks &callbacks) PURE;
+  // Known once `onHeaders()` has been called. When true, the filter buffers
+  // the body within the buffer limits of the stream, and calls `transcode()`
+  // once, with the complete body, at the end of the stream.
+  virtual bool needsCompleteBody() const { return false; }
+};
+
+typedef std::unique_ptr<ResponseBodyTranscoder> ResponseBodyTranscoderPtr;
+
 class Transformer {
 public:
   Transformer(google::protobuf::BoolValue log_request_response_info) : log_request_response_info_(log_request_response_info) {}
@@ -28,6 +71,18 @@ public:
                          Buffer::Instance &body,
                          Http::StreamFilterCallbacks &callbacks) const PURE;
 
+  // Request transformers may observe the matching response body as it streams
+  // back through the filter. Returns nullptr if no observer is needed.
+  virtual ResponseBodyObserverPtr createResponseBodyObserver() const {
+    return nullptr;
+  }
+
+  // Request transformers may also rewrite the matching response body as it
+  // streams back. Returns nullptr if the response is passed through as is.
+  virtual ResponseBodyTranscoderPtr createResponseBodyTranscoder() const {
+    return nullptr;
+  }
+
   google::protobuf::BoolValue logRequestResponseInfo() const { return log_request_response_info_; }
 
 private:
@@ -1,5 +1,6 @@
 #include "source/extensions/transformers/aws_lambda/api_gateway_transformer.h"
 
+#include "source/common/buffer/buffer_utility.h"
 #include "source/common/http/headers.h"
 #include "source/common/http/utility.h"
 #include "source/common/common/base64.h"
@@ -205,20 +206,19 @@ void ApiGatewayTransformer::transform_response(
 
   // set response body
   body.drain(body.length());
-  if (json_body.contains("body")) {
-    std::string body_dump;
-    if (json_body["body"].is_string()) {
-      body_dump = json_body["body"].get<std::string>();
+  const auto body_it = json_body.find("body");
+  if (body_it != json_body.end()) {
+    std::string body_dump = body_it->is_string()
+                                ? std::move(body_it->get_ref<std::string &>())
+                                : body_it->dump();
+    const auto is_base64_it = json_body.find("isBase64Encoded");
+    if (is_base64_it != json_body.end() && is_base64_it->is_boolean() &&
+        is_base64_it->get<bool>()) {
+      // invalid base64 leaves the body empty
+      Buffer::BufferUtility::base64DecodeToBuffer(body_dump, body);
     } else {
-      body_dump = json_body["body"].dump();
+      Buffer::BufferUtility::moveStringToBuffer(std::move(body_dump), body);
     }
-    if (json_body.contains("isBase64Encoded")) {
-      auto is_base64 = json_body["isBase64Encoded"];
-      if (is_base64.is_boolean() && is_base64.get<bool>() == true) {
-        body_dump = Base64::decode(body_dump);
-      }
-    }
-    body.add(body_dump);
   } else {
     body.add("{}");
   }
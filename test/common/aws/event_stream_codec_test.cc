@@ -0,0 +1,129 @@
+#include <string>
+#include <vector>
+
+#include "source/common/aws/event_stream_codec.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace AwsEventStream {
+namespace {
+
+class EventStreamDecoderTest : public testing::Test {
+protected:
+  Decoder decoder(size_t max_message_size = 1024) {
+    return Decoder(max_message_size, [this](const Message &message) {
+      event_types_.emplace_back(message.header(":event-type"));
+      payloads_.emplace_back(message.payload);
+    });
+  }
+
+  std::vector<std::string> event_types_;
+  std::vector<std::string> payloads_;
+};
+
+TEST_F(EventStreamDecoderTest, EncodesEmptyMessage) {
+  // The example of the AWS event stream encoding documentation
+  std::string message;
+  encode({}, "", message);
+  EXPECT_EQ(std::string("\x00\x00\x00\x10\x00\x00\x00\x00\x05\xc2\x48\xeb"
+                        "\x7d\x98\xc8\xff",
+                        16),
+            message);
+}
+
+TEST_F(EventStreamDecoderTest, DecodesAcrossSplits) {
+  std::string stream;
+  encode({{":event-type", "PayloadChunk"}, {":message-type", "event"}},
+         "hello", stream);
+  encode({{":event-type", "InvokeComplete"}}, "{}", stream);
+
+  for (size_t split : {1, 3, 12, 13, 1000}) {
+    event_types_.clear();
+    payloads_.clear();
+    Decoder stream_decoder = decoder();
+    for (size_t i = 0; i < stream.size(); i += split) {
+      EXPECT_TRUE(stream_decoder.decode(
+          absl::string_view(stream).substr(i, split)));
+    }
+    EXPECT_FALSE(stream_decoder.hasPartialMessage());
+    EXPECT_EQ((std::vector<std::string>{"PayloadChunk", "InvokeComplete"}),
+              event_types_);
+    EXPECT_EQ((std::vector<std::string>{"hello", "{}"}), payloads_);
+  }
+}
+
+TEST_F(EventStreamDecoderTest, HeaderLookup) {
+  std::string stream;
+  encode({{":message-type", "exception"},
+          {":exception-type", "throttlingException"}},
+         "", stream);
+  Decoder stream_decoder(1024, [](const Message &message) {
+    EXPECT_EQ("exception", message.header(":message-type"));
+    EXPECT_EQ("throttlingException", message.header(":exception-type"));
+    EXPECT_EQ("", message.header(":event-type"));
+  });
+  EXPECT_TRUE(stream_decoder.decode(stream));
+}
+
+TEST_F(EventStreamDecoderTest, RejectsCorruptMessages) {
+  std::string stream;
+  encode({{":event-type", "PayloadChunk"}}, "hello", stream);
+
+  // prelude, headers and payload are all covered by a CRC
+  for (size_t offset : {size_t(2), size_t(9), size_t(14), stream.size() - 6,
+                        stream.size() - 1}) {
+    std::string corrupt = stream;
+    corrupt[offset] ^= 0x10;
+    Decoder stream_decoder = decoder();
+    EXPECT_FALSE(stream_decoder.decode(corrupt)) << offset;
+    EXPECT_TRUE(stream_decoder.failed());
+    // Once failed, the rest of the stream is ignored
+    EXPECT_FALSE(stream_decoder.decode(stream));
+  }
+  EXPECT_TRUE(payloads_.empty());
+}
+
+TEST_F(EventStreamDecoderTest, SkipsOversizedMessages) {
+  std::string stream;
+  encode({}, std::string(2000, 'a'), stream);
+  encode({}, "ok", stream);
+
+  for (size_t split : {1, 100, 10000}) {
+    payloads_.clear();
+    Decoder stream_decoder = decoder();
+    for (size_t i = 0; i < stream.size(); i += split) {
+      EXPECT_TRUE(stream_decoder.decode(
+          absl::string_view(stream).substr(i, split)));
+    }
+    EXPECT_EQ(std::vector<std::string>{"ok"}, payloads_);
+  }
+}
+
+TEST_F(EventStreamDecoderTest, FailsOnOversizedMessages) {
+  std::string stream;
+  encode({}, "ok", stream);
+  encode({}, std::string(2000, 'a'), stream);
+
+  for (size_t split : {1, 100, 10000}) {
+    payloads_.clear();
+    Decoder stream_decoder(
+        1024,
+        [this](const Message &message) {
+          payloads_.emplace_back(message.payload);
+        },
+        Decoder::Oversized::Fail);
+    bool decoded = true;
+    for (size_t i = 0; i < stream.size() && decoded; i += split) {
+      decoded =
+          stream_decoder.decode(absl::string_view(stream).substr(i, split));
+    }
+    EXPECT_FALSE(decoded) << split;
+    EXPECT_TRUE(stream_decoder.failed());
+    EXPECT_EQ(std::vector<std::string>{"ok"}, payloads_);
+  }
+}
+
+} // namespace
+} // namespace AwsEventStream
+} // namespace Envoy
@@ -1,7 +1,9 @@
+#include <memory>
 #include <string>
 
 #include "source/common/buffer/buffer_impl.h"
 #include "source/common/buffer/buffer_utility.h"
+#include "source/common/common/base64.h"
 
 #include "gtest/gtest.h"
 
@@ -23,6 +25,58 @@ TEST(BufferUtilityTest, DrainBufferToString) {
   EXPECT_EQ(0, buffer.length());
 }
 
+TEST(BufferUtilityTest, MoveStringToBuffer) {
+  Buffer::OwnedImpl buffer("head ");
+  std::string data("moved\0bytes", 11);
+  BufferUtility::moveStringToBuffer(std::move(data), buffer);
+  EXPECT_EQ(std::string("head moved\0bytes", 16), buffer.toString());
+
+  BufferUtility::moveStringToBuffer(std::string(), buffer);
+  EXPECT_EQ(16, buffer.length());
+}
+
+TEST(BufferUtilityTest, AddSharedBuffer) {
+  auto data = std::make_shared<Buffer::OwnedImpl>();
+  data->appendSliceForTest("shared ");
+  data->appendSliceForTest("slices");
+  const Buffer::RawSliceVector data_slices = data->getRawSlices();
+
+  Buffer::OwnedImpl buffer("head ");
+  BufferUtility::addSharedBuffer(data, buffer);
+  EXPECT_EQ("head shared slices", buffer.toString());
+
+  // The slices are referenced rather than copied, and kept alive by the
+  // buffer alone.
+  const Buffer::RawSliceVector slices = buffer.getRawSlices();
+  ASSERT_EQ(3, slices.size());
+  EXPECT_EQ(data_slices[0].mem_, slices[1].mem_);
+  EXPECT_EQ(data_slices[1].mem_, slices[2].mem_);
+  std::weak_ptr<Buffer::OwnedImpl> weak_data = data;
+  data.reset();
+  EXPECT_FALSE(weak_data.expired());
+  buffer.drain(buffer.length());
+  EXPECT_TRUE(weak_data.expired());
+}
+
+TEST(BufferUtilityTest, Base64DecodeToBuffer) {
+  const std::string binary("\0\x01\x02\xff\xfe binary", 12);
+  for (size_t length = 0; length <= binary.size(); length++) {
+    const std::string data = binary.substr(0, length);
+    Buffer::OwnedImpl buffer;
+    EXPECT_TRUE(
+        BufferUtility::base64DecodeToBuffer(Base64::encode(data.data(), data.size()), buffer));
+    EXPECT_EQ(data, buffer.toString());
+  }
+
+  // Nothing is added for invalid input, including non canonical padding bits
+  for (const char *invalid : {"abc", "a===", "ab=c", "SGV*", "SGVsbG9="}) {
+    Buffer::OwnedImpl buffer("unchanged");
+    EXPECT_FALSE(BufferUtility::base64DecodeToBuffer(invalid, buffer))
+        << invalid;
+    EXPECT_EQ("unchanged", buffer.toString());
+  }
+}
+
 } // namespace
 } // namespace Buffer
 } // namespace Envoy
@@ -0,0 +1,57 @@
+#include <algorithm>
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/nats/codec_impl.h"
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Nats {
+
+namespace {
+
+// Counts the decoded values, which are dropped right away.
+class CountingCallbacks : public Tcp::DecoderCallbacks<Message> {
+public:
+  void onValue(MessagePtr &&value) override {
+    decoded_bytes_ += value->asString().size();
+  }
+
+  size_t decoded_bytes_{};
+};
+
+constexpr size_t MESSAGES_PER_ITERATION = 64;
+constexpr size_t SLICE_SIZE = 4096;
+
+} // namespace
+
+// Decodes MSG frames with payloads of `state.range(0)` bytes, delivered in
+// slices of 4KiB as they would be read from the socket.
+static void BM_DecodeNatsMsg(benchmark::State &state) {
+  const std::string payload(state.range(0), 'p');
+  std::string frames;
+  for (size_t i = 0; i < MESSAGES_PER_ITERATION; i++) {
+    absl::StrAppend(&frames, "MSG _INBOX.", i, " 1 ", payload.size(), "\r\n",
+                    payload, "\r\n");
+  }
+
+  CountingCallbacks callbacks;
+  DecoderImpl decoder(callbacks);
+  for (auto _ : state) {
+    Buffer::OwnedImpl buffer;
+    for (size_t offset = 0; offset < frames.size(); offset += SLICE_SIZE) {
+      buffer.appendSliceForTest(frames.data() + offset,
+                                std::min(SLICE_SIZE, frames.size() - offset));
+    }
+    decoder.decode(buffer);
+  }
+  benchmark::DoNotOptimize(callbacks.decoded_bytes_);
+  state.SetBytesProcessed(state.iterations() * frames.size());
+}
+BENCHMARK(BM_DecodeNatsMsg)->Arg(16)->Arg(1024)->Arg(64 * 1024);
+
+} // namespace Nats
+} // namespace Envoy
+
+BENCHMARK_MAIN();
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "include/envoy/nats/codec.h"
 
 #include "source/common/buffer/buffer_impl.h"
@@ -6,6 +8,7 @@
 
 #include "test/mocks/nats/mocks.h"
 
+#include "absl/strings/str_cat.h"
 #include "gtest/gtest.h"
 
 namespace Envoy {
@@ -112,5 +115,94 @@ TEST_F(NatsEncoderDecoderImplTest, InvalidSimpleStringExpectLF) {
   EXPECT_THROW(decoder_.decode(buffer_), ProtocolError);
 }
 
+TEST_F(NatsEncoderDecoderImplTest, MsgPayload) {
+  // The payload is read by its size, whatever bytes it holds
+  const char data[] = "MSG subject 1 reply 6\r\na\r\nb\0c\r\nPING\r\n";
+  buffer_.add(data, sizeof(data) - 1);
+  decoder_.decode(buffer_);
+  ASSERT_EQ(3, decoded_values_.size());
+  EXPECT_EQ("MSG subject 1 reply 6", decoded_values_[0]->asString());
+  EXPECT_EQ(std::string("a\r\nb\0c", 6), decoded_values_[1]->asString());
+  EXPECT_EQ("PING", decoded_values_[2]->asString());
+  EXPECT_EQ(0UL, buffer_.length());
+}
+
+TEST_F(NatsEncoderDecoderImplTest, EmptyMsgPayload) {
+  buffer_.add("msg\tsubject 1 0 \r\n\r\nPONG\r\n");
+  decoder_.decode(buffer_);
+  ASSERT_EQ(3, decoded_values_.size());
+  EXPECT_EQ("", decoded_values_[1]->asString());
+  EXPECT_EQ("PONG", decoded_values_[2]->asString());
+}
+
+TEST_F(NatsEncoderDecoderImplTest, HMsgPayload) {
+  // The headers are part of the payload, which is read by its total size
+  buffer_.add("HMSG subject 1 reply 16 18\r\nNATS/1.0 503\r\n\r\nab\r\n"
+              "hmsg subject 1 12 12\r\nNATS/1.0\r\n\r\n\r\n");
+  decoder_.decode(buffer_);
+  ASSERT_EQ(4, decoded_values_.size());
+  EXPECT_EQ("HMSG subject 1 reply 16 18", decoded_values_[0]->asString());
+  EXPECT_EQ("NATS/1.0 503\r\n\r\nab", decoded_values_[1]->asString());
+  EXPECT_EQ("NATS/1.0\r\n\r\n", decoded_values_[3]->asString());
+  EXPECT_EQ(0UL, buffer_.length());
+}
+
+TEST_F(NatsEncoderDecoderImplTest, MsgPayloadFragmentedDecode) {
+  const std::string stream =
+      "MSG subject 1 12\r\nhello\r\nworld\r\n"
+      "MSG subject 1 reply 3\r\n\r\n\r\r\n";
+  // Every split of the stream, across decode calls and across slices
+  for (size_t split = 0; split <= stream.size(); split++) {
+    decoded_values_.clear();
+    buffer_.add(stream.substr(0, split));
+    decoder_.decode(buffer_);
+    buffer_.appendSliceForTest(stream.substr(split, 3));
+    if (split + 3 < stream.size()) {
+      buffer_.appendSliceForTest(stream.substr(split + 3));
+    }
+    decoder_.decode(buffer_);
+
+    ASSERT_EQ(4, decoded_values_.size()) << split;
+    EXPECT_EQ("MSG subject 1 12", decoded_values_[0]->asString());
+    EXPECT_EQ("hello\r\nworld", decoded_values_[1]->asString());
+    EXPECT_EQ("MSG subject 1 reply 3", decoded_values_[2]->asString());
+    EXPECT_EQ("\r\n\r", decoded_values_[3]->asString());
+  }
+}
+
+TEST_F(NatsEncoderDecoderImplTest, InvalidMsgPayloadSize) {
+  buffer_.add("MSG subject 1 reply abc\r\n");
+  EXPECT_THROW(decoder_.decode(buffer_), ProtocolError);
+}
+
+TEST_F(NatsEncoderDecoderImplTest, InvalidHMsgPayloadSize) {
+  buffer_.add("HMSG subject 1 12 abc\r\n");
+  EXPECT_THROW(decoder_.decode(buffer_), ProtocolError);
+}
+
+TEST_F(NatsEncoderDecoderImplTest, InvalidMsgExpectCRLFAfterPayload) {
+  buffer_.add("MSG subject 1 2\r\nabc\r\n");
+  EXPECT_THROW(decoder_.decode(buffer_), ProtocolError);
+}
+
+TEST_F(NatsEncoderDecoderImplTest, EncodePayload) {
+  // A 1MB payload is referenced by the encoded buffer, not copied
+  auto payload =
+      std::make_shared<Buffer::OwnedImpl>(std::string(1 << 20, 'p'));
+  Message value("PUB subject reply 1048576", payload);
+  encoder_.encode(value, buffer_);
+  EXPECT_EQ(absl::StrCat("PUB subject reply 1048576\r\n",
+                         std::string(1 << 20, 'p'), "\r\n"),
+            buffer_.toString());
+
+  const Buffer::RawSliceVector slices = buffer_.getRawSlices();
+  for (const Buffer::RawSlice &payload_slice : payload->getRawSlices()) {
+    EXPECT_TRUE(std::any_of(slices.begin(), slices.end(),
+                            [&payload_slice](const Buffer::RawSlice &slice) {
+                              return slice.mem_ == payload_slice.mem_;
+                            }));
+  }
+}
+
 } // namespace Nats
 } // namespace Envoy
@@ -0,0 +1,229 @@
+#include "source/common/nats/jetstream/client_impl.h"
+#include "source/common/nats/message_builder.h"
+
+#include "test/common/stats/stat_test_utility.h"
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/nats/mocks.h"
+#include "test/mocks/nats/streaming/mocks.h"
+#include "test/mocks/runtime/mocks.h"
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+
+namespace Envoy {
+namespace Nats {
+namespace JetStream {
+
+using Streaming::MockPublishCallbacks;
+using Streaming::PublishRequestPtr;
+
+class NatsJetStreamClientImplTest : public testing::Test {
+public:
+  void SetUp() override {
+    ON_CALL(*conn_pool_, makeRequest(_, _))
+        .WillByDefault(
+            Invoke([this](const std::string &, const Message &message) {
+              sent_.push_back(message);
+            }));
+  }
+
+  void createClient(uint32_t max_inflight, uint32_t max_pending) {
+    // The timers are created by the client in this order.
+    pub_ack_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    connect_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    reconnect_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    client_ = std::make_unique<ClientImpl>(
+        Tcp::ConnPoolNats::InstancePtr<Message>{conn_pool_}, random_,
+        dispatcher_, op_timeout_, max_inflight, max_pending,
+        ClientImpl::generateStats("test.", *store_.rootScope()));
+  }
+
+  PublishRequestPtr publish(MockPublishCallbacks &callbacks,
+                            const std::string &header_lines = "") {
+    Buffer::OwnedImpl headers(header_lines);
+    Buffer::OwnedImpl payload("hello");
+    return client_->makeRequest("subject1", "cluster_id", "discover_prefix",
+                                headers, payload, callbacks);
+  }
+
+  void receive(const std::string &message) {
+    client_->onResponse(std::make_unique<Message>(message));
+  }
+
+  void receiveMsg(const std::string &subject, const std::string &payload) {
+    receive(absl::StrCat("MSG ", subject, " 1 ", payload.size()));
+    receive(payload);
+  }
+
+  void ack(const std::string &pub_ack_inbox) {
+    receiveMsg(pub_ack_inbox, R"({"stream":"stream1","seq":1})");
+  }
+
+  // The published requests, in order.
+  std::vector<Message> pubs() const {
+    std::vector<Message> pubs;
+    for (const Message &message : sent_) {
+      if (absl::StartsWith(message.asString(), "HPUB subject1 ")) {
+        pubs.push_back(message);
+      }
+    }
+    return pubs;
+  }
+
+  // HPUB <subject> <reply-to> <#header bytes> <#total bytes>
+  static std::string replyTo(const Message &pub) {
+    const std::vector<absl::string_view> tokens =
+        absl::StrSplit(pub.asString(), ' ');
+    return std::string(tokens[2]);
+  }
+
+  static std::string msgId(const Message &pub) {
+    const std::string pub_msg = pub.payload()->toString();
+    const size_t begin = pub_msg.find("Nats-Msg-Id: ") + 13;
+    return pub_msg.substr(begin, pub_msg.find("\r\n", begin) - begin);
+  }
+
+  uint64_t gauge(const std::string &name) {
+    return store_
+        .gaugeFromString("test.nats_streaming." + name,
+                         Stats::Gauge::ImportMode::Accumulate)
+        .value();
+  }
+
+  NiceMock<Nats::ConnPoolNats::MockInstance> *conn_pool_{
+      new NiceMock<Nats::ConnPoolNats::MockInstance>()};
+  NiceMock<Random::MockRandomGenerator> random_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<Event::MockTimer> *pub_ack_timer_{};
+  NiceMock<Event::MockTimer> *connect_timer_{};
+  NiceMock<Event::MockTimer> *reconnect_timer_{};
+  std::chrono::milliseconds op_timeout_{5000};
+  Stats::TestUtil::TestStore store_;
+  std::unique_ptr<ClientImpl> client_;
+  std::vector<Message> sent_;
+};
+
+TEST_F(NatsJetStreamClientImplTest, Connect) {
+  createClient(0, 0);
+  client_->connect("", "");
+  ASSERT_EQ(1, sent_.size());
+  EXPECT_EQ(MessageBuilder::createConnectMessageWithHeaders(), sent_[0]);
+
+  // There is no handshake beyond subscribing to the ack inbox.
+  receive("INFO {}");
+  ASSERT_EQ(2, sent_.size());
+  EXPECT_TRUE(absl::StartsWith(sent_[1].asString(), "SUB _INBOX."));
+  EXPECT_TRUE(absl::EndsWith(sent_[1].asString(), ".* 1"));
+  EXPECT_FALSE(connect_timer_->enabled());
+}
+
+TEST_F(NatsJetStreamClientImplTest, Publish) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks1, callbacks2;
+  PublishRequestPtr request1 = publish(callbacks1);
+  receive("INFO {}");
+  PublishRequestPtr request2 = publish(callbacks2);
+
+  // Both requests are in flight, each with a message ID of its own.
+  std::vector<Message> published = pubs();
+  ASSERT_EQ(2, published.size());
+  const std::string headers = absl::StrCat(
+      "NATS/1.0\r\nNats-Msg-Id: ", msgId(published[0]), "\r\n\r\n");
+  EXPECT_EQ(absl::StrCat("HPUB subject1 ", replyTo(published[0]), " ",
+                         headers.size(), " ", headers.size() + 5),
+            published[0].asString());
+  EXPECT_EQ(headers + "hello", published[0].payload()->toString());
+  EXPECT_NE(msgId(published[0]), msgId(published[1]));
+  EXPECT_EQ(2, gauge("publish_in_flight"));
+
+  EXPECT_CALL(callbacks2, onResponse());
+  ack(replyTo(published[1]));
+
+  // A duplicate is acked as well.
+  EXPECT_CALL(callbacks1, onResponse());
+  receiveMsg(replyTo(published[0]),
+             R"({"stream":"stream1","seq":1,"duplicate":true})");
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsJetStreamClientImplTest, PublishHeaders) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request =
+      publish(callbacks, "method: POST\r\ncontent-type: text/plain\r\n");
+  receive("INFO {}");
+
+  // The request headers follow the message ID, and the payload is the body.
+  std::vector<Message> published = pubs();
+  ASSERT_EQ(1, published.size());
+  const std::string headers =
+      absl::StrCat("NATS/1.0\r\nNats-Msg-Id: ", msgId(published[0]),
+                   "\r\nmethod: POST\r\ncontent-type: text/plain\r\n\r\n");
+  EXPECT_EQ(absl::StrCat("HPUB subject1 ", replyTo(published[0]), " ",
+                         headers.size(), " ", headers.size() + 5),
+            published[0].asString());
+  EXPECT_EQ(headers + "hello", published[0].payload()->toString());
+
+  EXPECT_CALL(callbacks, onResponse());
+  ack(replyTo(published[0]));
+}
+
+TEST_F(NatsJetStreamClientImplTest, PublishError) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  receive("INFO {}");
+
+  EXPECT_CALL(callbacks, onFailure());
+  receiveMsg(
+      replyTo(pubs()[0]),
+      R"({"error":{"code":503,"err_code":10077,"description":"maximum messages exceeded"}})");
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsJetStreamClientImplTest, NoResponders) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  receive("INFO {}");
+
+  // The server replies at once when no stream captures the subject.
+  EXPECT_CALL(callbacks, onFailure());
+  receive(absl::StrCat("HMSG ", replyTo(pubs()[0]), " 1 16 16"));
+  receive("NATS/1.0 503\r\n\r\n");
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsJetStreamClientImplTest, ReplayAfterReconnect) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  receive("INFO {}");
+  const Message pub = pubs()[0];
+  client_->onClose();
+
+  // The replayed request has the same message ID, for the stream to drop it
+  // if the first one was stored.
+  sent_.clear();
+  reconnect_timer_->invokeCallback();
+  receive("INFO {}");
+  std::vector<Message> replayed_pubs = pubs();
+  ASSERT_EQ(1, replayed_pubs.size());
+  EXPECT_EQ(pub, replayed_pubs[0]);
+  EXPECT_EQ(pub.payload(), replayed_pubs[0].payload());
+
+  EXPECT_CALL(callbacks, onResponse());
+  ack(replyTo(replayed_pubs[0]));
+}
+
+} // namespace JetStream
+} // namespace Nats
+} // namespace Envoy
@@ -0,0 +1,92 @@
+#include "source/common/nats/jetstream/pub_ack_handler.h"
+
+#include "test/mocks/nats/streaming/mocks.h"
+
+#include "gmock/gmock.h"
+
+namespace Envoy {
+namespace Nats {
+namespace JetStream {
+
+using Streaming::MockPublishCallbacks;
+using Streaming::PubRequest;
+
+class NatsJetStreamPubAckHandlerTest : public testing::Test {
+protected:
+  MockPublishCallbacks publish_callbacks_;
+};
+
+TEST_F(NatsJetStreamPubAckHandlerTest, PubAck) {
+  EXPECT_EQ(absl::nullopt,
+            PubAckHandler::getError(0, R"({"stream":"stream1","seq":1})"));
+  EXPECT_EQ(absl::nullopt,
+            PubAckHandler::getError(
+                0, R"({"stream":"stream1","seq":1,"duplicate":true})"));
+}
+
+TEST_F(NatsJetStreamPubAckHandlerTest, Error) {
+  EXPECT_EQ(
+      "maximum messages exceeded",
+      PubAckHandler::getError(
+          0,
+          R"({"error":{"code":503,"err_code":10077,"description":"maximum messages exceeded"}})"));
+  EXPECT_EQ("error", PubAckHandler::getError(0, R"({"error":"oops"})"));
+  EXPECT_EQ("error", PubAckHandler::getError(0, R"({"error":{"code":503}})"));
+  EXPECT_EQ("error", PubAckHandler::getError(
+                         0, R"({"error":{"code":503,"description":503}})"));
+  EXPECT_EQ("error", PubAckHandler::getError(
+                         0, R"({"error":{"description":null}})"));
+}
+
+TEST_F(NatsJetStreamPubAckHandlerTest, Status) {
+  EXPECT_EQ("503", PubAckHandler::getError(16, "NATS/1.0 503\r\n\r\n"));
+  EXPECT_EQ("408 Request Timeout",
+            PubAckHandler::getError(
+                32, "NATS/1.0 408 Request Timeout\r\n\r\n"));
+}
+
+TEST_F(NatsJetStreamPubAckHandlerTest, HeadersWithoutStatus) {
+  const std::string headers{"NATS/1.0\r\nA: b\r\n\r\n"};
+  EXPECT_EQ(absl::nullopt,
+            PubAckHandler::getError(
+                headers.size(), headers + R"({"stream":"stream1","seq":1})"));
+}
+
+TEST_F(NatsJetStreamPubAckHandlerTest, InvalidPayload) {
+  EXPECT_EQ("invalid PubAck", PubAckHandler::getError(0, ""));
+  EXPECT_EQ("invalid PubAck",
+            PubAckHandler::getError(0, "This is not a PubAck message."));
+  EXPECT_EQ("PubAck without stream", PubAckHandler::getError(0, "{}"));
+}
+
+TEST_F(NatsJetStreamPubAckHandlerTest, OnMessage) {
+  PubRequestMap request_per_inbox;
+  request_per_inbox.emplace(1, PubRequest{&publish_callbacks_, "subject1",
+                                          nullptr});
+  request_per_inbox.emplace(2, PubRequest{&publish_callbacks_, "subject1",
+                                          nullptr});
+
+  EXPECT_CALL(publish_callbacks_, onResponse());
+  PubAckHandler::onMessage(1, 0, R"({"stream":"stream1","seq":1})",
+                           request_per_inbox);
+  EXPECT_EQ(request_per_inbox.end(), request_per_inbox.find(1));
+
+  EXPECT_CALL(publish_callbacks_, onFailure());
+  PubAckHandler::onMessage(2, 0, "{}", request_per_inbox);
+  EXPECT_TRUE(request_per_inbox.empty());
+}
+
+TEST_F(NatsJetStreamPubAckHandlerTest, OnMessageMissingInbox) {
+  PubRequestMap request_per_inbox;
+  request_per_inbox.emplace(1, PubRequest{&publish_callbacks_, "subject1",
+                                          nullptr});
+
+  EXPECT_CALL(publish_callbacks_, onResponse()).Times(0);
+  PubAckHandler::onMessage(2, 0, R"({"stream":"stream1","seq":1})",
+                           request_per_inbox);
+  EXPECT_NE(request_per_inbox.end(), request_per_inbox.find(1));
+}
+
+} // namespace JetStream
+} // namespace Nats
+} // namespace Envoy
@@ -1,3 +1,4 @@
+#include "source/common/buffer/buffer_impl.h"
 #include "source/common/common/assert.h"
 #include "source/common/nats/message_builder.h"
 
@@ -20,6 +21,13 @@ TEST_F(NatsMessageBuilderTest, ConnectMessage) {
   ASSERT_EQ(expected_message, actual_message);
 }
 
+TEST_F(NatsMessageBuilderTest, ConnectMessageWithHeaders) {
+  Message expected_message{
+      R"(CONNECT {"verbose":false,"pedantic":false,"tls_required":false,"name":"","lang":"cpp","version":"1.2.2","protocol":1,"headers":true,"no_responders":true})"};
+  auto actual_message = MessageBuilder::createConnectMessageWithHeaders();
+  ASSERT_EQ(expected_message, actual_message);
+}
+
 TEST_F(NatsMessageBuilderTest, PubMessage) {
   Message expected_message{"PUB subject1 0\r\n"};
   auto actual_message = MessageBuilder::createPubMessage("subject1");
@@ -33,6 +41,32 @@ TEST_F(NatsMessageBuilderTest, PubMessageWithReplyToAndPayload) {
   ASSERT_EQ(expected_message, actual_message);
 }
 
+TEST_F(NatsMessageBuilderTest, PubMessageWithReplyToAndPayloadBuffer) {
+  Message expected_message{"PUB subject1 reply_to1 8\r\npayload1"};
+  auto payload = std::make_shared<Buffer::OwnedImpl>("payload1");
+  auto actual_message =
+      MessageBuilder::createPubMessage("subject1", "reply_to1", payload);
+  EXPECT_EQ("PUB subject1 reply_to1 8", actual_message.asString());
+  EXPECT_EQ(payload, actual_message.payload());
+  ASSERT_EQ(expected_message, actual_message);
+}
+
+TEST_F(NatsMessageBuilderTest, HpubMessage) {
+  auto payload =
+      std::make_shared<Buffer::OwnedImpl>("NATS/1.0\r\nA: b\r\n\r\npayload1");
+  auto actual_message =
+      MessageBuilder::createHpubMessage("subject1", "reply_to1", 18, payload);
+  EXPECT_EQ("HPUB subject1 reply_to1 18 26", actual_message.asString());
+  EXPECT_EQ(payload, actual_message.payload());
+}
+
+TEST_F(NatsMessageBuilderTest, AddHeader) {
+  Buffer::OwnedImpl headers;
+  MessageBuilder::addHeader("A", "b", headers);
+  MessageBuilder::addHeader("content-type", "text/plain", headers);
+  EXPECT_EQ("A: b\r\ncontent-type: text/plain\r\n", headers.toString());
+}
+
 TEST_F(NatsMessageBuilderTest, SubMessage) {
   Message expected_message{"SUB subject1 6"};
   auto actual_message = MessageBuilder::createSubMessage("subject1", 6);
@@ -1,16 +1,21 @@
 #include "source/common/nats/streaming/client_impl.h"
 
+#include "test/common/stats/stat_test_utility.h"
 #include "test/mocks/common.h"
 #include "test/mocks/event/mocks.h"
 #include "test/mocks/nats/mocks.h"
 #include "test/mocks/nats/streaming/mocks.h"
 #include "test/mocks/runtime/mocks.h"
 
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::_;
+using testing::Invoke;
 using testing::NiceMock;
-using testing::Return;
 
 namespace Envoy {
 namespace Nats {
@@ -18,19 +23,416 @@ namespace Streaming {
 
 class NatsStreamingClientImplTest : public testing::Test {
 public:
-  Nats::ConnPoolNats::MockInstance *conn_pool_{
-      new Nats::ConnPoolNats::MockInstance()};
+  void SetUp() override {
+    ON_CALL(*conn_pool_, makeRequest(_, _))
+        .WillByDefault(
+            Invoke([this](const std::string &, const Message &message) {
+              sent_.push_back(message.asString());
+            }));
+  }
+
+  void createClient(uint32_t max_inflight, uint32_t max_pending) {
+    // The timers are created by the client in this order.
+    pub_ack_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    connect_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    reconnect_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    client_ = std::make_unique<ClientImpl>(
+        Tcp::ConnPoolNats::InstancePtr<Message>{conn_pool_}, random_,
+        dispatcher_, op_timeout_, max_inflight, max_pending,
+        ClientImpl::generateStats("test.", *store_.rootScope()));
+  }
+
+  PublishRequestPtr publish(MockPublishCallbacks &callbacks) {
+    Buffer::OwnedImpl headers;
+    Buffer::OwnedImpl payload("hello");
+    return client_->makeRequest("subject1", "cluster_id", "discover_prefix",
+                                headers, payload, callbacks);
+  }
+
+  // Completes the connection started by the first request, or by a reconnect.
+  void connect() {
+    receive("INFO {}");
+    const std::string connect_response_inbox = replyTo(sent_.back());
+    receiveMsg(connect_response_inbox,
+               MessageUtility::createConnectResponseMessage("pub_prefix_1", "",
+                                                            "", ""));
+  }
+
+  void ack(const std::string &pub_ack_inbox) {
+    receiveMsg(pub_ack_inbox, MessageUtility::createPubAckMessage("guid", ""));
+  }
+
+  void receive(const std::string &message) {
+    client_->onResponse(std::make_unique<Message>(message));
+  }
+
+  void receiveMsg(const std::string &subject, const std::string &payload) {
+    receive(absl::StrCat("MSG ", subject, " 1 ", payload.size()));
+    receive(payload);
+  }
+
+  // The ack inboxes of the published requests, in order.
+  std::vector<std::string> pubAckInboxes() const {
+    std::vector<std::string> pub_ack_inboxes;
+    for (const std::string &message : sent_) {
+      if (absl::StartsWith(message, "PUB pub_prefix_1.subject1 ")) {
+        pub_ack_inboxes.push_back(replyTo(message));
+      }
+    }
+    return pub_ack_inboxes;
+  }
+
+  static std::string replyTo(const std::string &pub_message) {
+    const std::vector<absl::string_view> tokens = absl::StrSplit(
+        absl::string_view(pub_message).substr(0, pub_message.find("\r\n")),
+        ' ');
+    return std::string(tokens[2]);
+  }
+
+  uint64_t gauge(const std::string &name) {
+    return store_
+        .gaugeFromString("test.nats_streaming." + name,
+                         Stats::Gauge::ImportMode::Accumulate)
+        .value();
+  }
+
+  uint64_t counter(const std::string &name) {
+    return store_.counterFromString("test.nats_streaming." + name).value();
+  }
+
+  NiceMock<Nats::ConnPoolNats::MockInstance> *conn_pool_{
+      new NiceMock<Nats::ConnPoolNats::MockInstance>()};
   NiceMock<Random::MockRandomGenerator> random_;
-  Event::MockDispatcher dispatcher_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<Event::MockTimer> *pub_ack_timer_{};
+  NiceMock<Event::MockTimer> *connect_timer_{};
+  NiceMock<Event::MockTimer> *reconnect_timer_{};
   std::chrono::milliseconds op_timeout_{5000};
-  MockPublishCallbacks callbacks_;
-  PublishRequestPtr handle_;
+  Stats::TestUtil::TestStore store_;
+  std::unique_ptr<ClientImpl> client_;
+  std::vector<std::string> sent_;
 };
 
-TEST_F(NatsStreamingClientImplTest, Empty) {
-  // TODO(talnordan): This is a dummy test.
-  ClientImpl client{Tcp::ConnPoolNats::InstancePtr<Message>{conn_pool_},
-                    random_, dispatcher_, op_timeout_};
+TEST_F(NatsStreamingClientImplTest, PublishOnceConnected) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  EXPECT_NE(nullptr, request);
+  EXPECT_EQ(1, gauge("publish_queued"));
+
+  connect();
+  std::vector<std::string> pub_ack_inboxes = pubAckInboxes();
+  ASSERT_EQ(1, pub_ack_inboxes.size());
+  EXPECT_EQ(0, gauge("publish_queued"));
+  EXPECT_EQ(1, gauge("publish_in_flight"));
+
+  EXPECT_CALL(callbacks, onResponse());
+  ack(pub_ack_inboxes[0]);
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsStreamingClientImplTest, QueueBeyondMaxInflight) {
+  createClient(2, 0);
+  MockPublishCallbacks callbacks1, callbacks2, callbacks3;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+  PublishRequestPtr request3 = publish(callbacks3);
+  EXPECT_EQ(2, pubAckInboxes().size());
+  EXPECT_EQ(2, gauge("publish_in_flight"));
+  EXPECT_EQ(1, gauge("publish_queued"));
+
+  // An ack makes room for the queued request.
+  EXPECT_CALL(callbacks1, onResponse());
+  ack(pubAckInboxes()[0]);
+  std::vector<std::string> pub_ack_inboxes = pubAckInboxes();
+  EXPECT_EQ(3, pub_ack_inboxes.size());
+  EXPECT_EQ(2, gauge("publish_in_flight"));
+  EXPECT_EQ(0, gauge("publish_queued"));
+
+  EXPECT_CALL(callbacks3, onResponse());
+  ack(pub_ack_inboxes[2]);
+  EXPECT_CALL(callbacks2, onResponse());
+  ack(pub_ack_inboxes[1]);
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsStreamingClientImplTest, RejectBeyondMaxPending) {
+  createClient(1, 1);
+  MockPublishCallbacks callbacks1, callbacks2, callbacks3;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+
+  EXPECT_CALL(callbacks3, onOverflow());
+  EXPECT_EQ(nullptr, publish(callbacks3));
+  EXPECT_EQ(1, counter("publish_overflow"));
+  EXPECT_EQ(1, gauge("publish_in_flight"));
+  EXPECT_EQ(1, gauge("publish_queued"));
+}
+
+TEST_F(NatsStreamingClientImplTest, RejectWhileConnecting) {
+  createClient(0, 1);
+  MockPublishCallbacks callbacks1, callbacks2;
+  PublishRequestPtr request1 = publish(callbacks1);
+
+  EXPECT_CALL(callbacks2, onOverflow());
+  EXPECT_EQ(nullptr, publish(callbacks2));
+  EXPECT_EQ(1, counter("publish_overflow"));
+}
+
+TEST_F(NatsStreamingClientImplTest, CancelQueuedRequest) {
+  createClient(1, 0);
+  MockPublishCallbacks callbacks1, callbacks2, callbacks3;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+  PublishRequestPtr request3 = publish(callbacks3);
+  EXPECT_EQ(2, gauge("publish_queued"));
+
+  request2->cancel();
+  EXPECT_EQ(1, gauge("publish_queued"));
+
+  // Cancelling the request in flight makes room for the next queued one.
+  request1->cancel();
+  std::vector<std::string> pub_ack_inboxes = pubAckInboxes();
+  ASSERT_EQ(2, pub_ack_inboxes.size());
+  EXPECT_EQ(1, gauge("publish_in_flight"));
+  EXPECT_EQ(0, gauge("publish_queued"));
+
+  EXPECT_CALL(callbacks3, onResponse());
+  ack(pub_ack_inboxes[1]);
+}
+
+TEST_F(NatsStreamingClientImplTest, WatchWindow) {
+  createClient(1, 0);
+  MockPublishCallbacks callbacks1, callbacks2;
+  MockWindowCallbacks window_callbacks;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+
+  // A full window with nothing queued behind it is not watched.
+  EXPECT_EQ(nullptr, client_->watchWindow("subject1", window_callbacks));
+
+  PublishRequestPtr request2 = publish(callbacks2);
+  WindowWatchPtr window_watch =
+      client_->watchWindow("subject1", window_callbacks);
+  EXPECT_NE(nullptr, window_watch);
+
+  EXPECT_CALL(callbacks1, onResponse());
+  EXPECT_CALL(window_callbacks, onWindowOpen());
+  ack(pubAckInboxes()[0]);
+  EXPECT_EQ(2, pubAckInboxes().size());
+
+  // Cancelling a watch that was notified does nothing.
+  window_watch->cancel();
+}
+
+TEST_F(NatsStreamingClientImplTest, CancelWindowWatch) {
+  createClient(1, 0);
+  MockPublishCallbacks callbacks1, callbacks2;
+  MockWindowCallbacks window_callbacks;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+  WindowWatchPtr window_watch =
+      client_->watchWindow("subject1", window_callbacks);
+  window_watch->cancel();
+
+  EXPECT_CALL(callbacks1, onResponse());
+  EXPECT_CALL(window_callbacks, onWindowOpen()).Times(0);
+  ack(pubAckInboxes()[0]);
+}
+
+TEST_F(NatsStreamingClientImplTest, Timeout) {
+  createClient(1, 0);
+  NiceMock<Event::MockTimer> *timer = pub_ack_timer_;
+  MockPublishCallbacks callbacks1, callbacks2;
+  PublishRequestPtr request1 = publish(callbacks1);
+  PublishRequestPtr request2;
+  connect();
+  EXPECT_TRUE(timer->enabled());
+
+  // The second request is queued halfway through the timeout of the first.
+  for (uint32_t i = 0; i < TimeoutWheel::TICKS_PER_TIMEOUT; ++i) {
+    if (i == TimeoutWheel::TICKS_PER_TIMEOUT / 2) {
+      request2 = publish(callbacks2);
+    }
+    timer->invokeCallback();
+  }
+
+  // A timeout makes room for the queued request.
+  EXPECT_CALL(callbacks1, onTimeout());
+  timer->invokeCallback();
+  std::vector<std::string> pub_ack_inboxes = pubAckInboxes();
+  ASSERT_EQ(2, pub_ack_inboxes.size());
+  EXPECT_EQ(1, gauge("publish_in_flight"));
+  EXPECT_EQ(0, gauge("publish_queued"));
+
+  // An acked request does not time out.
+  EXPECT_CALL(callbacks2, onResponse());
+  ack(pub_ack_inboxes[1]);
+  EXPECT_CALL(callbacks2, onTimeout()).Times(0);
+  for (uint32_t i = 0; i <= TimeoutWheel::TICKS_PER_TIMEOUT; ++i) {
+    timer->invokeCallback();
+  }
+  EXPECT_FALSE(timer->enabled());
+}
+
+TEST_F(NatsStreamingClientImplTest, QueuedRequestTimeout) {
+  createClient(0, 0);
+  NiceMock<Event::MockTimer> *timer = pub_ack_timer_;
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  EXPECT_EQ(1, gauge("publish_queued"));
+
+  // A request queued while connecting times out like one awaiting its ack.
+  for (uint32_t i = 0; i < TimeoutWheel::TICKS_PER_TIMEOUT; ++i) {
+    timer->invokeCallback();
+  }
+  EXPECT_CALL(callbacks, onTimeout());
+  timer->invokeCallback();
+  EXPECT_EQ(0, gauge("publish_queued"));
+
+  // It is not published once connected.
+  connect();
+  EXPECT_EQ(0, pubAckInboxes().size());
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsStreamingClientImplTest, ConnectAheadOfFirstRequest) {
+  createClient(0, 0);
+  EXPECT_CALL(*connect_timer_, enableTimer(op_timeout_, _));
+  client_->connect("cluster_id", "discover_prefix");
+  ASSERT_EQ(1, sent_.size());
+  EXPECT_TRUE(absl::StartsWith(sent_[0], "CONNECT "));
+  connect();
+  EXPECT_FALSE(connect_timer_->enabled());
+
+  // Connecting again does nothing.
+  client_->connect("cluster_id", "discover_prefix");
+
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  ASSERT_EQ(1, pubAckInboxes().size());
+  EXPECT_EQ(1, gauge("publish_in_flight"));
+  EXPECT_EQ(0, gauge("publish_queued"));
+}
+
+TEST_F(NatsStreamingClientImplTest, ReplayAfterReconnect) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks1, callbacks2, callbacks3;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+  std::vector<std::string> pub_ack_inboxes = pubAckInboxes();
+  ASSERT_EQ(2, pub_ack_inboxes.size());
+
+  EXPECT_CALL(*reconnect_timer_,
+              enableTimer(std::chrono::milliseconds(
+                              ClientImpl::RECONNECT_BASE_INTERVAL_MS),
+                          _));
+  client_->onClose();
+
+  // Requests are queued while reconnecting.
+  PublishRequestPtr request3 = publish(callbacks3);
+  EXPECT_EQ(2, gauge("publish_in_flight"));
+  EXPECT_EQ(1, gauge("publish_queued"));
+
+  sent_.clear();
+  reconnect_timer_->invokeCallback();
+  EXPECT_EQ(1, counter("reconnect"));
+  ASSERT_EQ(1, sent_.size());
+  EXPECT_TRUE(absl::StartsWith(sent_[0], "CONNECT "));
+
+  // The requests in flight are published again with the same ack inboxes,
+  // ahead of the queued one.
+  connect();
+  std::vector<std::string> replayed_pub_ack_inboxes = pubAckInboxes();
+  ASSERT_EQ(3, replayed_pub_ack_inboxes.size());
+  EXPECT_EQ(pub_ack_inboxes[0], replayed_pub_ack_inboxes[0]);
+  EXPECT_EQ(pub_ack_inboxes[1], replayed_pub_ack_inboxes[1]);
+  EXPECT_EQ(2, counter("publish_replayed"));
+  EXPECT_EQ(3, gauge("publish_in_flight"));
+  EXPECT_EQ(0, gauge("publish_queued"));
+
+  EXPECT_CALL(callbacks1, onResponse());
+  ack(replayed_pub_ack_inboxes[0]);
+  EXPECT_CALL(callbacks2, onResponse());
+  ack(replayed_pub_ack_inboxes[1]);
+  EXPECT_CALL(callbacks3, onResponse());
+  ack(replayed_pub_ack_inboxes[2]);
+  EXPECT_EQ(0, gauge("publish_in_flight"));
+}
+
+TEST_F(NatsStreamingClientImplTest, CancelWhileReconnecting) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks1, callbacks2;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+  client_->onClose();
+
+  request1->cancel();
+  EXPECT_EQ(1, gauge("publish_in_flight"));
+
+  sent_.clear();
+  reconnect_timer_->invokeCallback();
+  connect();
+  EXPECT_EQ(1, pubAckInboxes().size());
+  EXPECT_EQ(1, counter("publish_replayed"));
+}
+
+TEST_F(NatsStreamingClientImplTest, ReconnectBackoff) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks;
+  PublishRequestPtr request = publish(callbacks);
+  EXPECT_TRUE(connect_timer_->enabled());
+
+  // A connection which is not established in time is closed.
+  EXPECT_CALL(*conn_pool_, close());
+  EXPECT_CALL(*reconnect_timer_,
+              enableTimer(std::chrono::milliseconds(
+                              ClientImpl::RECONNECT_BASE_INTERVAL_MS),
+                          _));
+  connect_timer_->invokeCallback();
+
+  reconnect_timer_->invokeCallback();
+  EXPECT_TRUE(connect_timer_->enabled());
+  EXPECT_CALL(*reconnect_timer_,
+              enableTimer(std::chrono::milliseconds(
+                              2 * ClientImpl::RECONNECT_BASE_INTERVAL_MS),
+                          _));
+  client_->onClose();
+  EXPECT_FALSE(connect_timer_->enabled());
+
+  // The backoff is reset once connected.
+  reconnect_timer_->invokeCallback();
+  connect();
+  EXPECT_CALL(*reconnect_timer_,
+              enableTimer(std::chrono::milliseconds(
+                              ClientImpl::RECONNECT_BASE_INTERVAL_MS),
+                          _));
+  client_->onClose();
+}
+
+TEST_F(NatsStreamingClientImplTest, FailureClosesConnection) {
+  createClient(0, 0);
+  MockPublishCallbacks callbacks1, callbacks2;
+  PublishRequestPtr request1 = publish(callbacks1);
+  connect();
+  PublishRequestPtr request2 = publish(callbacks2);
+  std::vector<std::string> pub_ack_inboxes = pubAckInboxes();
+
+  // The rest of the data read from the closed connection is ignored.
+  EXPECT_CALL(*conn_pool_, close()).WillOnce(Invoke([&]() {
+    client_->onClose();
+    ack(pub_ack_inboxes[1]);
+  }));
+  EXPECT_CALL(callbacks2, onResponse()).Times(0);
+  receiveMsg(pub_ack_inboxes[0], "");
+  EXPECT_TRUE(reconnect_timer_->enabled());
+  EXPECT_EQ(1, gauge("publish_in_flight"));
 }
 
 } // namespace Streaming
@@ -0,0 +1,154 @@
+#include "source/common/nats/streaming/client_pool.h"
+
+#include "test/common/stats/stat_test_utility.h"
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/nats/mocks.h"
+#include "test/mocks/nats/streaming/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::_;
+using testing::NiceMock;
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+class NatsStreamingClientPoolTest : public testing::Test {
+public:
+  void SetUp() override { cm_.initializeThreadLocalClusters({"cluster"}); }
+
+  // Each client queues a single request while connecting, so a request is
+  // rejected when made on a client that already has one. Unless the main
+  // dispatcher is given, the thread local clients are those of a worker.
+  void createPool(uint32_t max_connections,
+                  ConnectionSelection connection_selection,
+                  Protocol protocol = Protocol::NatsStreaming,
+                  const std::string &prewarm_cluster_id = "",
+                  Event::Dispatcher *main_dispatcher = nullptr) {
+    pool_ = std::make_unique<ClientPool>(
+        "cluster", cm_, client_factory_, tls_,
+        main_dispatcher ? *main_dispatcher : main_dispatcher_, random_,
+        std::chrono::milliseconds(5000), protocol, max_connections,
+        connection_selection, 0, 1, prewarm_cluster_id, "discover_prefix",
+        ClientBase::generateStats("test.", *store_.rootScope()));
+  }
+
+  PublishRequestPtr publish(const std::string &subject,
+                            MockPublishCallbacks &callbacks) {
+    Buffer::OwnedImpl headers;
+    Buffer::OwnedImpl payload("hello");
+    return pool_->makeRequest(subject, "cluster_id", "discover_prefix",
+                              headers, payload, callbacks);
+  }
+
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ConnPoolNats::MockClientFactory> client_factory_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<Event::MockDispatcher> main_dispatcher_;
+  NiceMock<Random::MockRandomGenerator> random_;
+  Stats::TestUtil::TestStore store_;
+  std::unique_ptr<ClientPool> pool_;
+};
+
+TEST_F(NatsStreamingClientPoolTest, SingleConnection) {
+  createPool(1, ConnectionSelection::RoundRobin);
+  Client &client = pool_->selectClient("subject1");
+  EXPECT_EQ(&client, &pool_->selectClient("subject1"));
+  EXPECT_EQ(&client, &pool_->selectClient("subject2"));
+}
+
+TEST_F(NatsStreamingClientPoolTest, RoundRobinSelection) {
+  createPool(3, ConnectionSelection::RoundRobin);
+  Client &client1 = pool_->selectClient("subject1");
+  Client &client2 = pool_->selectClient("subject1");
+  Client &client3 = pool_->selectClient("subject1");
+  EXPECT_NE(&client1, &client2);
+  EXPECT_NE(&client1, &client3);
+  EXPECT_NE(&client2, &client3);
+  EXPECT_EQ(&client1, &pool_->selectClient("subject1"));
+}
+
+TEST_F(NatsStreamingClientPoolTest, RoundRobinSpreadsPublishes) {
+  createPool(3, ConnectionSelection::RoundRobin);
+  MockPublishCallbacks callbacks1, callbacks2, callbacks3, callbacks4;
+
+  // Each request goes to the next client, which connects.
+  EXPECT_CALL(client_factory_, create_(_)).Times(3);
+  PublishRequestPtr request1 = publish("subject1", callbacks1);
+  PublishRequestPtr request2 = publish("subject1", callbacks2);
+  PublishRequestPtr request3 = publish("subject1", callbacks3);
+  EXPECT_NE(nullptr, request1);
+  EXPECT_NE(nullptr, request2);
+  EXPECT_NE(nullptr, request3);
+
+  // Back to the first client, whose queue is full.
+  EXPECT_CALL(callbacks4, onOverflow());
+  EXPECT_EQ(nullptr, publish("subject1", callbacks4));
+}
+
+TEST_F(NatsStreamingClientPoolTest, SubjectHashSelection) {
+  createPool(3, ConnectionSelection::SubjectHash);
+  Client &client = pool_->selectClient("subject1");
+  EXPECT_EQ(&client, &pool_->selectClient("subject1"));
+  EXPECT_EQ(&client, &pool_->selectClient("subject1"));
+
+  // Other subjects are spread over the other clients.
+  bool other_client = false;
+  for (int i = 2; i < 100 && !other_client; ++i) {
+    other_client =
+        &pool_->selectClient(absl::StrCat("subject", i)) != &client;
+  }
+  EXPECT_TRUE(other_client);
+}
+
+TEST_F(NatsStreamingClientPoolTest, SubjectHashKeepsPublishesTogether) {
+  createPool(3, ConnectionSelection::SubjectHash);
+  MockPublishCallbacks callbacks1, callbacks2;
+
+  // Both requests go to the same client, which connects once.
+  EXPECT_CALL(client_factory_, create_(_));
+  PublishRequestPtr request1 = publish("subject1", callbacks1);
+  EXPECT_NE(nullptr, request1);
+  EXPECT_CALL(callbacks2, onOverflow());
+  EXPECT_EQ(nullptr, publish("subject1", callbacks2));
+}
+
+TEST_F(NatsStreamingClientPoolTest, PrewarmOnWorker) {
+  // Each client of the worker connects as soon as it is created.
+  EXPECT_CALL(client_factory_, create_(_)).Times(2);
+  createPool(2, ConnectionSelection::RoundRobin, Protocol::NatsStreaming,
+             "cluster_id");
+}
+
+TEST_F(NatsStreamingClientPoolTest, NoPrewarmOnMainThread) {
+  EXPECT_CALL(client_factory_, create_(_)).Times(0);
+  createPool(2, ConnectionSelection::RoundRobin, Protocol::NatsStreaming,
+             "cluster_id", &tls_.dispatcher_);
+}
+
+TEST_F(NatsStreamingClientPoolTest, NoPrewarmWithoutClusterId) {
+  EXPECT_CALL(client_factory_, create_(_)).Times(0);
+  createPool(2, ConnectionSelection::RoundRobin);
+}
+
+TEST_F(NatsStreamingClientPoolTest, JetStreamPrewarmOnWorker) {
+  // A JetStream client needs no cluster ID to connect ahead of time.
+  EXPECT_CALL(client_factory_, create_(_)).Times(2);
+  createPool(2, ConnectionSelection::RoundRobin, Protocol::JetStream);
+}
+
+TEST_F(NatsStreamingClientPoolTest, JetStreamNoPrewarmOnMainThread) {
+  EXPECT_CALL(client_factory_, create_(_)).Times(0);
+  createPool(2, ConnectionSelection::RoundRobin, Protocol::JetStream, "",
+             &tls_.dispatcher_);
+}
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
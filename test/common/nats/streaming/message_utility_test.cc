@@ -1,8 +1,10 @@
+#include "source/common/buffer/buffer_impl.h"
 #include "source/common/common/assert.h"
 #include "source/common/nats/streaming/message_utility.h"
 
 #include "test/test_common/utility.h"
 
+#include "absl/strings/str_cat.h"
 #include "api/envoy/type/streaming/protocol.pb.h"
 
 namespace Envoy {
@@ -55,6 +57,41 @@ TEST_F(NatsStreamingMessageUtilityTest, PubMsgMessage) {
   EXPECT_EQ(data, pub_msg.data());
 }
 
+TEST_F(NatsStreamingMessageUtilityTest, PubMsgMessageFromBuffer) {
+  const std::string data(1000, 'd');
+  Buffer::OwnedImpl data_buffer(data);
+  Buffer::OwnedImpl message;
+  MessageUtility::createPubMsgMessage("client1", "guid1", "subject1",
+                                      data_buffer, message);
+  EXPECT_EQ(0, data_buffer.length());
+
+  pb::PubMsg pub_msg;
+  EXPECT_TRUE(pub_msg.ParseFromString(message.toString()));
+  EXPECT_EQ("client1", pub_msg.clientid());
+  EXPECT_EQ("guid1", pub_msg.guid());
+  EXPECT_EQ("subject1", pub_msg.subject());
+  EXPECT_EQ(data, pub_msg.data());
+
+  // The same bytes as a regular serialization
+  EXPECT_EQ(MessageUtility::createPubMsgMessage("client1", "guid1", "subject1",
+                                                data),
+            message.toString());
+}
+
+TEST_F(NatsStreamingMessageUtilityTest, MoveBytesField) {
+  Buffer::OwnedImpl empty;
+  Buffer::OwnedImpl out;
+  MessageUtility::moveBytesField(2, empty, out);
+  EXPECT_EQ(0, out.length());
+
+  // Field numbers and lengths needing multi-byte varints
+  Buffer::OwnedImpl value(std::string(300, 'v'));
+  MessageUtility::moveBytesField(20, value, out);
+  EXPECT_EQ(absl::StrCat("\xa2\x01\xac\x02", std::string(300, 'v')),
+            out.toString());
+  EXPECT_EQ(0, value.length());
+}
+
 TEST_F(NatsStreamingMessageUtilityTest, PubAckMessage) {
   const std::string uuid{"13581321-dead-beef-b77c-24f6818b6043"};
   const std::string error{"E\"R\rR\0O\t \nR\v"};
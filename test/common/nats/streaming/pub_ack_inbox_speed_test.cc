@@ -0,0 +1,88 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "source/common/common/random_generator.h"
+#include "source/common/nats/subject_utility.h"
+#include "source/common/nats/token_generator_impl.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+namespace {
+
+// The number of publish requests awaiting their ack.
+constexpr uint64_t IN_FLIGHT_REQUESTS = 1000;
+
+const std::string ROOT_PUB_ACK_INBOX{"_STAN.acks.M2kl72gBUTGH12kgXu5c9i"};
+
+} // namespace
+
+// The ack inbox bookkeeping of a publish request, from making the reply
+// subject to finding the request of the ack, with random child inboxes kept
+// in a `std::map`.
+static void BM_RandomPubAckInbox(benchmark::State &state) {
+  Random::RandomGeneratorImpl random;
+  TokenGeneratorImpl token_generator(random);
+  std::map<std::string, uint64_t> request_per_inbox;
+  std::vector<std::string> in_flight;
+  for (uint64_t i = 0; i < IN_FLIGHT_REQUESTS; i++) {
+    in_flight.push_back(
+        SubjectUtility::randomChild(ROOT_PUB_ACK_INBOX, token_generator));
+    request_per_inbox.emplace(in_flight.back(), i);
+  }
+
+  uint64_t oldest = 0;
+  for (auto _ : state) {
+    std::string inbox{
+        SubjectUtility::randomChild(ROOT_PUB_ACK_INBOX, token_generator)};
+    request_per_inbox.emplace(inbox, oldest);
+
+    // The ack of the oldest request
+    std::string &acked_inbox = in_flight[oldest % IN_FLIGHT_REQUESTS];
+    auto it = request_per_inbox.find(acked_inbox);
+    benchmark::DoNotOptimize(it->second);
+    request_per_inbox.erase(it);
+    acked_inbox = std::move(inbox);
+    oldest++;
+  }
+}
+BENCHMARK(BM_RandomPubAckInbox);
+
+// The same bookkeeping with numbered child inboxes kept in a
+// `flat_hash_map`, the number being parsed out of the ack subject.
+static void BM_NumericPubAckInbox(benchmark::State &state) {
+  absl::flat_hash_map<uint64_t, uint64_t> request_per_inbox;
+  for (uint64_t i = 0; i < IN_FLIGHT_REQUESTS; i++) {
+    request_per_inbox.emplace(i, i);
+  }
+
+  uint64_t next = IN_FLIGHT_REQUESTS;
+  for (auto _ : state) {
+    const std::string inbox{
+        SubjectUtility::numericChild(ROOT_PUB_ACK_INBOX, next)};
+    benchmark::DoNotOptimize(inbox);
+    request_per_inbox.emplace(next, next);
+
+    // The ack of the oldest request
+    const std::string ack_subject{SubjectUtility::numericChild(
+        ROOT_PUB_ACK_INBOX, next - IN_FLIGHT_REQUESTS)};
+    auto it = request_per_inbox.find(
+        SubjectUtility::parseNumericChild(ROOT_PUB_ACK_INBOX, ack_subject)
+            .value());
+    benchmark::DoNotOptimize(it->second);
+    request_per_inbox.erase(it);
+    next++;
+  }
+}
+BENCHMARK(BM_NumericPubAckInbox);
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
+
+BENCHMARK_MAIN();
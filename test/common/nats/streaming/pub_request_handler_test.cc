@@ -2,13 +2,10 @@
 #include "source/common/nats/streaming/message_utility.h"
 #include "source/common/nats/streaming/pub_request_handler.h"
 
-#include "test/mocks/event/mocks.h"
 #include "test/mocks/nats/streaming/mocks.h"
 
 #include "gmock/gmock.h"
 
-using testing::NiceMock;
-
 namespace Envoy {
 namespace Nats {
 namespace Streaming {
@@ -82,12 +79,11 @@ TEST_F(NatsStreamingPubRequestHandlerTest, InvalidPayload) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, MapNoPayload) {
-  const std::string inbox{"inbox1"};
+  const uint64_t inbox{1};
   const absl::optional<std::string> reply_to{};
   const std::string payload{};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(inbox_callbacks_, onFailure("incoming PubAck without payload"))
@@ -99,14 +95,13 @@ TEST_F(NatsStreamingPubRequestHandlerTest, MapNoPayload) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, MapError) {
-  const std::string inbox{"inbox1"};
+  const uint64_t inbox{1};
   const absl::optional<std::string> reply_to{};
   const std::string guid{"guid1"};
   const std::string error{"error1"};
   const std::string payload{MessageUtility::createPubAckMessage(guid, error)};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onFailure()).Times(1);
@@ -117,14 +112,13 @@ TEST_F(NatsStreamingPubRequestHandlerTest, MapError) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, MapInvalidPayload) {
-  const std::string inbox{"inbox1"};
+  const uint64_t inbox{1};
   const absl::optional<std::string> reply_to{};
   const std::string guid{"guid1"};
   const std::string error{};
   const std::string payload{"This is not a PubAck message."};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onFailure()).Times(1);
@@ -135,14 +129,13 @@ TEST_F(NatsStreamingPubRequestHandlerTest, MapInvalidPayload) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, MapNoError) {
-  const std::string inbox{"inbox1"};
+  const uint64_t inbox{1};
   const absl::optional<std::string> reply_to{};
   const std::string guid{"guid1"};
   const std::string error{};
   const std::string payload{MessageUtility::createPubAckMessage(guid, error)};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onResponse()).Times(1);
@@ -153,27 +146,25 @@ TEST_F(NatsStreamingPubRequestHandlerTest, MapNoError) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, MapMissingInbox) {
-  const std::string inbox{"inbox1"};
+  const uint64_t inbox{1};
   const absl::optional<std::string> reply_to{};
   const std::string guid{"guid1"};
   const std::string error{};
   const std::string payload{MessageUtility::createPubAckMessage(guid, error)};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
-  PubRequestHandler::onMessage("inbox2", reply_to, payload, inbox_callbacks_,
+  PubRequestHandler::onMessage(2, reply_to, payload, inbox_callbacks_,
                                request_per_inbox);
 
   EXPECT_NE(request_per_inbox.end(), request_per_inbox.find(inbox));
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, OnTimeout) {
-  const std::string inbox{"inbox1"};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  const uint64_t inbox{1};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onTimeout()).Times(1);
@@ -183,23 +174,21 @@ TEST_F(NatsStreamingPubRequestHandlerTest, OnTimeout) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, OnTimeoutMissingInbox) {
-  const std::string inbox{"inbox1"};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  const uint64_t inbox{1};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onTimeout()).Times(0);
-  PubRequestHandler::onTimeout("inbox2", request_per_inbox);
+  PubRequestHandler::onTimeout(2, request_per_inbox);
 
   EXPECT_NE(request_per_inbox.end(), request_per_inbox.find(inbox));
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, OnCancel) {
-  const std::string inbox{"inbox1"};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  const uint64_t inbox{1};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onResponse()).Times(0);
@@ -211,16 +200,15 @@ TEST_F(NatsStreamingPubRequestHandlerTest, OnCancel) {
 }
 
 TEST_F(NatsStreamingPubRequestHandlerTest, OnCancelMissingInbox) {
-  const std::string inbox{"inbox1"};
-  auto timeout_timer = Event::TimerPtr(new NiceMock<Event::MockTimer>);
-  std::map<std::string, PubRequest> request_per_inbox;
-  PubRequest pub_request{&publish_callbacks_, std::move(timeout_timer)};
+  const uint64_t inbox{1};
+  PubRequestMap request_per_inbox;
+  PubRequest pub_request{&publish_callbacks_, "subject1", nullptr};
   request_per_inbox.emplace(inbox, std::move(pub_request));
 
   EXPECT_CALL(publish_callbacks_, onResponse()).Times(0);
   EXPECT_CALL(publish_callbacks_, onFailure()).Times(0);
   EXPECT_CALL(publish_callbacks_, onTimeout()).Times(0);
-  PubRequestHandler::onCancel("inbox2", request_per_inbox);
+  PubRequestHandler::onCancel(2, request_per_inbox);
 
   EXPECT_NE(request_per_inbox.end(), request_per_inbox.find(inbox));
 }
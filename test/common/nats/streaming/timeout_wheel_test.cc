@@ -0,0 +1,115 @@
+#include "source/common/nats/streaming/timeout_wheel.h"
+
+#include "test/mocks/event/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+
+namespace Envoy {
+namespace Nats {
+namespace Streaming {
+
+class NatsStreamingTimeoutWheelTest : public testing::Test {
+public:
+  void createWheel(const std::chrono::milliseconds &timeout) {
+    timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    wheel_ = std::make_unique<TimeoutWheel>(
+        dispatcher_, timeout, [this](const std::vector<uint64_t> &ids) {
+          expired_.push_back(ids);
+        });
+  }
+
+  // Ticks the wheel until just before the ids added now expire.
+  void tickUntilTimeout() {
+    for (uint32_t i = 0; i < TimeoutWheel::TICKS_PER_TIMEOUT; ++i) {
+      timer_->invokeCallback();
+    }
+  }
+
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<Event::MockTimer> *timer_{};
+  std::unique_ptr<TimeoutWheel> wheel_;
+  std::vector<std::vector<uint64_t>> expired_;
+};
+
+TEST_F(NatsStreamingTimeoutWheelTest, Tick) {
+  createWheel(std::chrono::milliseconds(5000));
+  EXPECT_EQ(std::chrono::milliseconds(625), wheel_->tick());
+
+  createWheel(std::chrono::milliseconds(5001));
+  EXPECT_EQ(std::chrono::milliseconds(626), wheel_->tick());
+
+  createWheel(std::chrono::milliseconds(0));
+  EXPECT_EQ(std::chrono::milliseconds(1), wheel_->tick());
+}
+
+TEST_F(NatsStreamingTimeoutWheelTest, Expire) {
+  createWheel(std::chrono::milliseconds(5000));
+  EXPECT_FALSE(timer_->enabled());
+
+  wheel_->add(1);
+  EXPECT_TRUE(timer_->enabled());
+
+  tickUntilTimeout();
+  EXPECT_TRUE(expired_.empty());
+  EXPECT_TRUE(timer_->enabled());
+
+  timer_->invokeCallback();
+  ASSERT_EQ(1, expired_.size());
+  EXPECT_EQ(std::vector<uint64_t>({1}), expired_[0]);
+
+  // The timer stops once there is nothing left to expire.
+  EXPECT_FALSE(timer_->enabled());
+}
+
+TEST_F(NatsStreamingTimeoutWheelTest, ExpireInBatches) {
+  createWheel(std::chrono::milliseconds(5000));
+  wheel_->add(1);
+  wheel_->add(2);
+  timer_->invokeCallback();
+  wheel_->add(3);
+
+  tickUntilTimeout();
+  ASSERT_EQ(1, expired_.size());
+  EXPECT_EQ(std::vector<uint64_t>({1, 2}), expired_[0]);
+  EXPECT_TRUE(timer_->enabled());
+
+  timer_->invokeCallback();
+  ASSERT_EQ(2, expired_.size());
+  EXPECT_EQ(std::vector<uint64_t>({3}), expired_[1]);
+  EXPECT_FALSE(timer_->enabled());
+}
+
+TEST_F(NatsStreamingTimeoutWheelTest, AddOnExpiry) {
+  timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+  TimeoutWheel *wheel{};
+  wheel_ = std::make_unique<TimeoutWheel>(
+      dispatcher_, std::chrono::milliseconds(5000),
+      [this, &wheel](const std::vector<uint64_t> &ids) {
+        expired_.push_back(ids);
+        if (ids[0] == 1) {
+          wheel->add(2);
+        }
+      });
+  wheel = wheel_.get();
+
+  wheel_->add(1);
+  tickUntilTimeout();
+  timer_->invokeCallback();
+  ASSERT_EQ(1, expired_.size());
+
+  // An id added on expiry keeps the timer running, and gets a full timeout.
+  EXPECT_TRUE(timer_->enabled());
+  tickUntilTimeout();
+  EXPECT_EQ(1, expired_.size());
+  timer_->invokeCallback();
+  ASSERT_EQ(2, expired_.size());
+  EXPECT_EQ(std::vector<uint64_t>({2}), expired_[1]);
+  EXPECT_FALSE(timer_->enabled());
+}
+
+} // namespace Streaming
+} // namespace Nats
+} // namespace Envoy
@@ -42,6 +42,31 @@ TEST_F(NatsSubjectUtilityTest, RandomGrandchild) {
   EXPECT_EQ(expected_subject, actual_subject);
 }
 
+TEST_F(NatsSubjectUtilityTest, NumericChild) {
+  EXPECT_EQ("_STAN.acks.M2kl72gBUTGH12kgXu5c9i.0",
+            SubjectUtility::numericChild("_STAN.acks.M2kl72gBUTGH12kgXu5c9i",
+                                         0));
+  EXPECT_EQ("_INBOX.18446744073709551615",
+            SubjectUtility::numericChild("_INBOX", UINT64_MAX));
+}
+
+TEST_F(NatsSubjectUtilityTest, ParseNumericChild) {
+  EXPECT_EQ(42, SubjectUtility::parseNumericChild("_STAN.acks.M2kl",
+                                                  "_STAN.acks.M2kl.42"));
+  EXPECT_EQ(UINT64_MAX,
+            SubjectUtility::parseNumericChild(
+                "_INBOX", SubjectUtility::numericChild("_INBOX", UINT64_MAX)));
+
+  for (const char *subject :
+       {"_INBOX", "_INBOX.", "_INBOXX.1", "_INBOX-1", "_OTHER.1", "_INBOX.a",
+        "_INBOX.1a", "_INBOX.+1", "_INBOX. 1", "_INBOX.1.2",
+        "_INBOX.18446744073709551616"}) {
+    EXPECT_EQ(absl::nullopt,
+              SubjectUtility::parseNumericChild("_INBOX", subject))
+        << subject;
+  }
+}
+
 TEST_F(NatsSubjectUtilityTest, ChildWildcard) {
   std::string expected_subject{"_INBOX.M2kl72gBUTGH12kgXu5c9i.*"};
   auto actual_subject =
@@ -78,6 +78,7 @@ public:
   }
 
   void finishSetup() {
+    flush_callback_ = new NiceMock<Event::MockSchedulableCallback>(&dispatcher_);
     upstream_connection_ = new NiceMock<Network::MockClientConnection>();
     Upstream::MockHost::MockCreateConnectionData conn_info;
     conn_info.connection_ = upstream_connection_;
@@ -100,6 +101,7 @@ public:
   const std::string cluster_name_{"foo"};
   std::shared_ptr<Upstream::MockHost> host_{new NiceMock<Upstream::MockHost>()};
   Event::MockDispatcher dispatcher_;
+  Event::MockSchedulableCallback *flush_callback_{};
   MockEncoder *encoder_{new MockEncoder()};
   MockDecoder *decoder_{new MockDecoder()};
   DecoderCallbacks<T> *callbacks_{};
@@ -311,6 +313,7 @@ TEST_F(TcpClientImplTest, ConnectFail) {
 
 class ConfigOutlierDisabled : public Config {
   bool disableOutlierEvents() const override { return true; }
+  uint32_t maxBufferSizeBeforeFlush() const override { return 64 * 1024; }
 };
 
 TEST_F(TcpClientImplTest, OutlierDisabled) {
@@ -332,6 +335,72 @@ TEST_F(TcpClientImplTest, OutlierDisabled) {
   EXPECT_EQ(1UL, host_->stats_.cx_connect_fail_.value());
 }
 
+TEST_F(TcpClientImplTest, CoalescedWrites) {
+  InSequence s;
+
+  setup();
+  onConnected();
+
+  // The requests of a dispatcher iteration are written once, at its end
+  EXPECT_CALL(*upstream_connection_, write(_, _)).Times(0);
+  client_->makeRequest("request1");
+  client_->makeRequest("request2");
+  EXPECT_TRUE(flush_callback_->enabled_);
+
+  EXPECT_CALL(*upstream_connection_, write(_, false))
+      .WillOnce(Invoke([](Buffer::Instance &data, bool) -> void {
+        EXPECT_EQ("+request1\r\n+request2\r\n", data.toString());
+        data.drain(data.length());
+      }));
+  flush_callback_->invokeCallback();
+
+  EXPECT_EQ(2UL, host_->cluster_.trafficStats()->upstream_rq_total_.value());
+
+  EXPECT_CALL(pool_callbacks_, onClose());
+  client_->close();
+}
+
+class ConfigSmallFlushBuffer : public ConfigImpl {
+  uint32_t maxBufferSizeBeforeFlush() const override { return 20; }
+};
+
+TEST_F(TcpClientImplTest, FlushAboveMaxBufferSize) {
+  InSequence s;
+
+  setup(std::make_unique<ConfigSmallFlushBuffer>());
+  onConnected();
+
+  EXPECT_CALL(*upstream_connection_, write(_, _)).Times(0);
+  client_->makeRequest("request1");
+
+  // The buffered requests are written as soon as they reach the limit
+  EXPECT_CALL(*upstream_connection_, write(_, false))
+      .WillOnce(Invoke([](Buffer::Instance &data, bool) -> void {
+        EXPECT_EQ("+request1\r\n+request2\r\n", data.toString());
+        data.drain(data.length());
+      }));
+  client_->makeRequest("request2");
+  EXPECT_FALSE(flush_callback_->enabled_);
+
+  EXPECT_CALL(pool_callbacks_, onClose());
+  client_->close();
+}
+
+TEST_F(TcpClientImplTest, NoWriteAfterClose) {
+  InSequence s;
+
+  setup();
+  onConnected();
+
+  client_->makeRequest("request1");
+
+  EXPECT_CALL(pool_callbacks_, onClose());
+  client_->close();
+
+  EXPECT_CALL(*upstream_connection_, write(_, _)).Times(0);
+  flush_callback_->invokeCallback();
+}
+
 TEST(TcpClientFactoryImplTest, Basic) {
   ClientFactoryImpl<T, MockEncoder, MockDecoder> factory;
   Upstream::MockHost::MockCreateConnectionData conn_info;
@@ -435,6 +504,37 @@ TEST_F(TcpConnPoolImplTest, RemoteClose) {
   conn_pool_ = {};
 }
 
+TEST_F(TcpConnPoolImplTest, Close) {
+  InSequence s;
+
+  // Closing without a connection does nothing.
+  conn_pool_->close();
+
+  T value;
+  MockClient *client = new NiceMock<MockClient>();
+
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_));
+  EXPECT_CALL(*this, create_(_)).WillOnce(Return(client));
+  EXPECT_CALL(*client, makeRequest(Ref(value))).Times(1);
+  conn_pool_->makeRequest("foo", value);
+
+  EXPECT_CALL(*client, close()).WillOnce(Invoke([client] {
+    client->raiseEvent(Network::ConnectionEvent::LocalClose);
+  }));
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  conn_pool_->close();
+
+  // The next request opens a new connection.
+  MockClient *client2 = new NiceMock<MockClient>();
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_));
+  EXPECT_CALL(*this, create_(_)).WillOnce(Return(client2));
+  EXPECT_CALL(*client2, makeRequest(Ref(value))).Times(1);
+  conn_pool_->makeRequest("foo", value);
+
+  EXPECT_CALL(*client2, close());
+  conn_pool_ = {};
+}
+
 } // namespace ConnPoolNats
 } // namespace Tcp
 } // namespace Envoy
@@ -0,0 +1,132 @@
+#include <string>
+#include <vector>
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/extensions/filters/http/aws_lambda/alb_response_parser.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+namespace {
+
+// Adds the payload in slices of `slice_size` bytes, so that every token
+// crosses slice boundaries for small sizes.
+void addSlices(absl::string_view payload, size_t slice_size,
+               Buffer::OwnedImpl &buffer) {
+  for (size_t pos = 0; pos < payload.size(); pos += slice_size) {
+    buffer.appendSliceForTest(payload.substr(pos, slice_size));
+  }
+}
+
+TEST(AlbResponseParserTest, ParsesAcrossSlices) {
+  const std::string payload =
+      "{ \"isBase64Encoded\": false, \"statusCode\": 201,"
+      " \"statusDescription\": \"201 Created\","
+      " \"ignored\": [1, {\"nested\": [true, null, -1.5e3]}, \"\\\"\"],"
+      " \"headers\": {\"Content-Type\": \"text/plain\", \"X-Number\": 5},"
+      " \"multiValueHeaders\": {\"Set-Cookie\": [\"a=1\", \"b=2\"]},"
+      " \"body\": \"caf\\u00e9 \\ud83d\\ude00\\n\\\"\\\\\\/\\u0000end\" }\n";
+
+  for (size_t slice_size : {1, 2, 3, 7, 4096}) {
+    Buffer::OwnedImpl json;
+    addSlices(payload, slice_size, json);
+    Http::TestResponseHeaderMapImpl headers{{":status", "200"}};
+    Buffer::OwnedImpl body;
+
+    ASSERT_TRUE(AlbResponseParser::parse(json, headers, body)) << slice_size;
+    EXPECT_EQ("201", headers.getStatusValue());
+    EXPECT_EQ("text/plain", headers.get_("content-type"));
+    // Headers that are not strings are added empty
+    EXPECT_EQ("", headers.get_("x-number"));
+    const auto cookies = headers.get(Http::LowerCaseString("set-cookie"));
+    ASSERT_EQ(2, cookies.size());
+    EXPECT_EQ("a=1", cookies[0]->value().getStringView());
+    EXPECT_EQ("b=2", cookies[1]->value().getStringView());
+    EXPECT_EQ(std::string("caf\xc3\xa9 \xf0\x9f\x98\x80\n\"\\/\0end", 18),
+              body.toString());
+  }
+}
+
+TEST(AlbResponseParserTest, DecodesBase64BodyBeforeFlag) {
+  Buffer::OwnedImpl json("{\"body\": \"AAEC/w==\", \"isBase64Encoded\": true}");
+  Http::TestResponseHeaderMapImpl headers;
+  Buffer::OwnedImpl body;
+
+  ASSERT_TRUE(AlbResponseParser::parse(json, headers, body));
+  EXPECT_EQ(std::string("\0\x01\x02\xff", 4), body.toString());
+}
+
+TEST(AlbResponseParserTest, AcceptsTrailingCommas) {
+  Buffer::OwnedImpl json(
+      "{\"multiValueHeaders\": {\"x-a\": [\"1\", \"2\",],}, \"body\": \"b\",}");
+  Http::TestResponseHeaderMapImpl headers;
+  Buffer::OwnedImpl body;
+
+  ASSERT_TRUE(AlbResponseParser::parse(json, headers, body));
+  EXPECT_EQ(2, headers.get(Http::LowerCaseString("x-a")).size());
+  EXPECT_EQ("b", body.toString());
+}
+
+TEST(AlbResponseParserTest, RejectsInvalidPayloads) {
+  const std::vector<std::string> payloads = {
+      "",
+      "[]",
+      "{",
+      "{,}",
+      "{\"a\":}",
+      "{\"a\" 1}",
+      "{\"a\": 1 \"b\": 2}",
+      "{} trailing",
+      "{\"x\": tru}",
+      "{\"isBase64Encoded\": floof, \"body\": \"b\"}",
+      "{\"isBase64Encoded\": \"true\", \"body\": \"b\"}",
+      "{\"statusCode\": \"200\"}",
+      "{\"body\": \"\\q\"}",
+      "{\"body\": \"\\ud800\"}",
+      "{\"body\": \"raw\nnewline\"}",
+      "{\"body\": \"unterminated}",
+      "{\"x\": " + std::string(100, '[') + std::string(100, ']') + "}",
+  };
+
+  for (const std::string &payload : payloads) {
+    Buffer::OwnedImpl json;
+    addSlices(payload, 2, json);
+    Http::TestResponseHeaderMapImpl headers;
+    Buffer::OwnedImpl body;
+
+    EXPECT_FALSE(AlbResponseParser::parse(json, headers, body)) << payload;
+    EXPECT_EQ(0, body.length()) << payload;
+  }
+}
+
+TEST(AlbResponseParserTest, IgnoresHeadersOfInvalidPayloads) {
+  const std::vector<std::string> payloads = {
+      "{\"headers\": {\"x-a\": \"1\"}, \"statusCode\": \"201\"}",
+      "{\"statusCode\": 201, \"multiValueHeaders\": {\"x-a\": [\"1\"]},"
+      " \"isBase64Encoded\": 1, \"body\": \"b\"}",
+      "{\"headers\": {\"x-a\": \"1\"}, \"statusCode\": 201} trailing",
+  };
+
+  for (const std::string &payload : payloads) {
+    Buffer::OwnedImpl json(payload);
+    Http::TestResponseHeaderMapImpl headers{{":status", "200"}};
+    Buffer::OwnedImpl body;
+
+    // The headers and status that were parsed before the error are not applied
+    EXPECT_FALSE(AlbResponseParser::parse(json, headers, body)) << payload;
+    EXPECT_EQ("200", headers.getStatusValue()) << payload;
+    EXPECT_TRUE(headers.get(Http::LowerCaseString("x-a")).empty()) << payload;
+    EXPECT_EQ(0, body.length()) << payload;
+  }
+}
+
+} // namespace
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,54 @@
+#include "source/common/buffer/buffer_impl.h"
+#include "source/extensions/filters/http/aws_lambda/aws_authenticator.h"
+
+#include "test/test_common/simulated_time_system.h"
+#include "test/test_common/utility.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+
+// SigV4 signature of a lambda invocation, deriving the signing key on every
+// request (0) or caching it and reusing the worker's buffers (1).
+static void BM_SignLambdaRequest(benchmark::State &state) {
+  Event::SimulatedTimeSystem time_system;
+  const std::string access_key = "AKIDEXAMPLE";
+  const std::string secret_key = "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY";
+  const HeaderList headers_to_sign = AwsAuthenticator::createHeaderToSign(
+      {Http::Headers::get().HostLegacy, Http::Headers::get().ContentType});
+  const Buffer::OwnedImpl body("{\"key\": \"value\"}");
+  SigningKeyCache signing_keys;
+  signing_keys.onCredentials(access_key, secret_key);
+  SigningScratch scratch;
+  SigningKeyCache *cache = state.range(0) ? &signing_keys : nullptr;
+
+  size_t output_bytes = 0;
+  for (auto _ : state) {
+    Http::TestRequestHeaderMapImpl headers{
+        {":method", "POST"},
+        {":authority", "lambda.us-east-1.amazonaws.com"},
+        {":path", "/2015-03-31/functions/my-function/invocations"},
+        {"content-type", "application/json"}};
+    AwsAuthenticator aws(time_system);
+    aws.init(&access_key, &secret_key, nullptr, cache);
+    if (state.range(0)) {
+      aws.setScratch(&scratch);
+    }
+    aws.updatePayloadHash(body);
+    aws.sign(&headers, headers_to_sign, "us-east-1");
+    output_bytes += headers.get_("authorization").size();
+  }
+  benchmark::DoNotOptimize(output_bytes);
+}
+BENCHMARK(BM_SignLambdaRequest)->Arg(0)->Arg(1);
+
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
+
+// Run the benchmark
+BENCHMARK_MAIN();
@@ -1,3 +1,4 @@
+#include "source/common/aws/event_stream_codec.h"
 #include "source/extensions/filters/http/aws_lambda/aws_authenticator.h"
 #include "source/extensions/filters/http/aws_lambda/aws_lambda_filter.h"
 #include "source/extensions/filters/http/aws_lambda/aws_lambda_filter_config_factory.h"
@@ -8,6 +9,8 @@
 #include "test/test_common/utility.h"
 
 
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "fmt/format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -35,7 +38,17 @@ public:
     return getCreds(callbacks);
   }
 
+  SigningKeyCache &signingKeyCache() const override {
+    return signing_keys_;
+  }
+
+  SigningScratch &signingScratch() const override {
+    return signing_scratch_;
+  }
+
   CredentialsConstSharedPtr credentials_;
+  mutable SigningKeyCache signing_keys_;
+  mutable SigningScratch signing_scratch_;
   mutable bool called_{};
 
   bool propagateOriginalRouting() const override{
@@ -82,7 +95,9 @@ protected:
 
   void setupRoute(bool sessionToken = false, bool noCredentials = false,
                 bool persistOriginalHeaders = false, bool unwrapAsAlb = false,
-                bool unmanagedCredentials = false, bool unwrapAsApiGateway = false) {
+                bool unmanagedCredentials = false, bool unwrapAsApiGateway = false,
+                bool unsignedPayload = false,
+                bool streamingSignedPayload = false) {
     factory_context_.server_factory_context_.cluster_manager_.initializeClusters({"fake_cluster"}, {});
     factory_context_.server_factory_context_.cluster_manager_.initializeThreadLocalClusters({"fake_cluster"});
 
@@ -101,6 +116,8 @@ protected:
         protoextconfig;
     protoextconfig.set_host("lambda.us-east-1.amazonaws.com");
     protoextconfig.set_region("us-east-1");
+    protoextconfig.set_unsigned_payload(unsignedPayload);
+    protoextconfig.set_streaming_signed_payload(streamingSignedPayload);
     filter_config_ = std::make_shared<testing::NiceMock<
                                       AWSLambdaConfigTestImpl>>();
 
@@ -301,6 +318,25 @@ TEST_F(AWSLambdaFilterTest, FuncWithEmptyQualifierCalled) {
             headers.get_(":path"));
 }
 
+// see:
+// https://docs.aws.amazon.com/lambda/latest/api/API_InvokeWithResponseStream.html
+TEST_F(AWSLambdaFilterTest, ResponseStreamingFuncCalled) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"}};
+
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+            filter_->decodeHeaders(headers, true));
+
+  EXPECT_EQ("/2021-11-15/functions/" + routeconfig_.name() +
+                "/response-streaming-invocations?Qualifier=" +
+                routeconfig_.qualifier(),
+            headers.get_(":path"));
+}
+
 TEST_F(AWSLambdaFilterTest, AsyncCalled) {
   Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
                                          {":authority", "www.solo.io"},
@@ -367,6 +403,162 @@ TEST_F(AWSLambdaFilterTest, SignOnTrailedEndStream) {
   EXPECT_TRUE(headers.has("Authorization"));
 }
 
+TEST_F(AWSLambdaFilterTest, UnsignedPayloadStreamsBody) {
+  setupRoute(false, false, false, false, false, false, true);
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+            filter_->decodeHeaders(headers, false));
+
+  EXPECT_TRUE(headers.has("Authorization"));
+  EXPECT_THAT(headers.get_("Authorization"),
+              testing::HasSubstr("x-amz-content-sha256"));
+  EXPECT_EQ(headers.get_(AwsAuthenticatorConsts::get().ContentSha256Header),
+            "UNSIGNED-PAYLOAD");
+
+  Buffer::OwnedImpl data("data");
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, false));
+  Http::TestRequestTrailerMapImpl trailers;
+  EXPECT_EQ(Http::FilterTrailersStatus::Continue,
+            filter_->decodeTrailers(trailers));
+}
+
+TEST_F(AWSLambdaFilterTest, UnsignedPayloadWaitsForCredentials) {
+  setupRoute(false, false, false, false, true, false, true);
+
+  StsConnectionPool::Context::Callbacks *callbackReference{};
+  StsContextStub fakeContext;
+  EXPECT_CALL(*filter_config_, getCreds)
+      .WillOnce([&](StsConnectionPool::Context::Callbacks *callbacks)
+                    -> StsConnectionPool::Context * {
+        callbackReference = callbacks;
+        return &fakeContext;
+      });
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+  Buffer::OwnedImpl data("data");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer,
+            filter_->decodeData(data, false));
+
+  // The headers are signed and the buffered body released before the end of
+  // the stream
+  EXPECT_CALL(filter_callbacks_, continueDecoding());
+  callbackReference->onSuccess(filter_config_->credentials_);
+  EXPECT_TRUE(headers.has("Authorization"));
+  EXPECT_EQ(headers.get_(AwsAuthenticatorConsts::get().ContentSha256Header),
+            "UNSIGNED-PAYLOAD");
+
+  Buffer::OwnedImpl more_data("more data");
+  EXPECT_EQ(Http::FilterDataStatus::Continue,
+            filter_->decodeData(more_data, true));
+}
+
+TEST_F(AWSLambdaFilterTest, UnsignedPayloadSignsHeadersOnlyRequest) {
+  setupRoute(false, false, false, false, false, false, true);
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+            filter_->decodeHeaders(headers, true));
+
+  // Without a body to stream, the empty payload is signed
+  EXPECT_TRUE(headers.has("Authorization"));
+  EXPECT_FALSE(headers.has(AwsAuthenticatorConsts::get().ContentSha256Header));
+}
+
+TEST_F(AWSLambdaFilterTest, StreamingSignedPayloadFramesChunks) {
+  setupRoute(false, false, false, false, false, false, false, true);
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"},
+                                         {"content-length", "70000"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+            filter_->decodeHeaders(headers, false));
+
+  EXPECT_THAT(headers.get_("Authorization"),
+              testing::HasSubstr("x-amz-decoded-content-length"));
+  EXPECT_EQ(headers.get_(AwsAuthenticatorConsts::get().ContentSha256Header),
+            "STREAMING-AWS4-HMAC-SHA256-PAYLOAD");
+  EXPECT_EQ("70000", headers.get_("x-amz-decoded-content-length"));
+  EXPECT_EQ("aws-chunked", headers.get_("content-encoding"));
+  EXPECT_EQ(absl::StrCat(AwsAuthenticator::streamingContentLength(70000)),
+            headers.get_("content-length"));
+
+  // Less than a chunk is held back until more data arrives
+  Buffer::OwnedImpl data(std::string(60000, 'a'));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, false));
+  EXPECT_EQ(0, data.length());
+
+  Buffer::OwnedImpl more_data(std::string(10000, 'a'));
+  EXPECT_EQ(Http::FilterDataStatus::Continue,
+            filter_->decodeData(more_data, true));
+  EXPECT_EQ(AwsAuthenticator::streamingContentLength(70000),
+            more_data.length());
+  EXPECT_TRUE(absl::StartsWith(more_data.toString(), "10000;chunk-signature="));
+}
+
+TEST_F(AWSLambdaFilterTest, StreamingSignedPayloadWaitsForCredentials) {
+  setupRoute(false, false, false, false, true, false, false, true);
+
+  StsConnectionPool::Context::Callbacks *callbackReference{};
+  StsContextStub fakeContext;
+  EXPECT_CALL(*filter_config_, getCreds)
+      .WillOnce([&](StsConnectionPool::Context::Callbacks *callbacks)
+                    -> StsConnectionPool::Context * {
+        callbackReference = callbacks;
+        return &fakeContext;
+      });
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"},
+                                         {"content-length", "4"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+  Buffer::OwnedImpl data("data");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer,
+            filter_->decodeData(data, true));
+
+  // The buffered body is framed once the headers are signed
+  Buffer::OwnedImpl buffered("data");
+  EXPECT_CALL(filter_callbacks_, decodingBuffer())
+      .WillRepeatedly(Return(&buffered));
+  EXPECT_CALL(filter_callbacks_, modifyDecodingBuffer(_))
+      .WillOnce(Invoke([&](std::function<void(Buffer::Instance &)> callback) {
+        callback(buffered);
+      }));
+  EXPECT_CALL(filter_callbacks_, continueDecoding());
+  callbackReference->onSuccess(filter_config_->credentials_);
+
+  EXPECT_EQ(headers.get_(AwsAuthenticatorConsts::get().ContentSha256Header),
+            "STREAMING-AWS4-HMAC-SHA256-PAYLOAD");
+  EXPECT_EQ(AwsAuthenticator::streamingContentLength(4), buffered.length());
+  EXPECT_TRUE(absl::StartsWith(buffered.toString(), "4;chunk-signature="));
+}
+
+TEST_F(AWSLambdaFilterTest, StreamingSignedPayloadNeedsContentLength) {
+  setupRoute(false, false, false, false, false, false, false, true);
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                                         {":authority", "www.solo.io"},
+                                         {":path", "/getsomething"}};
+  // Without a content length the body is buffered and hashed
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+  Buffer::OwnedImpl data("data");
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, true));
+  EXPECT_FALSE(headers.has(AwsAuthenticatorConsts::get().ContentSha256Header));
+  EXPECT_EQ("data", data.toString());
+}
+
 TEST_F(AWSLambdaFilterTest, SignsDataSetByPreviousFilters) {
   // there are cases where even if our filter is waiting on decode headers
   // decode data can still happen. We need to verify that bodysha is still
@@ -587,6 +779,164 @@ TEST_F(AWSLambdaFilterTest, UpstreamErrorSetTo504) {
 
 }
 
+TEST_F(AWSLambdaFilterTest, ResponseStreamingForwardsPayloadChunks) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                     {":authority", "www.solo.io"}, {":path", "/getsomething"}};
+  filter_->decodeHeaders(headers, true);
+  Http::TestResponseHeaderMapImpl response_headers{
+      {":status", "200"},
+      {"content-type", "text/plain"},
+      {"content-length", "1000"}};
+  filter_->setEncoderFilterCallbacks(filter_encode_callbacks_);
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+            filter_->encodeHeaders(response_headers, false));
+  EXPECT_EQ(nullptr, response_headers.ContentLength());
+
+  std::string stream;
+  AwsEventStream::encode(
+      {{":event-type", "PayloadChunk"}, {":message-type", "event"}}, "Hello",
+      stream);
+  const size_t first_event = stream.size();
+  AwsEventStream::encode(
+      {{":event-type", "PayloadChunk"}, {":message-type", "event"}},
+      " from Lambda", stream);
+  AwsEventStream::encode(
+      {{":event-type", "InvokeComplete"}, {":message-type", "event"}},
+      R"({"LogResult":""})", stream);
+
+  // Each chunk is forwarded as soon as its event is complete
+  EXPECT_CALL(filter_encode_callbacks_, resetStream()).Times(0);
+  Buffer::OwnedImpl data(stream.substr(0, first_event + 10));
+  EXPECT_EQ(Http::FilterDataStatus::Continue,
+            filter_->encodeData(data, false));
+  EXPECT_EQ("Hello", data.toString());
+
+  Buffer::OwnedImpl more_data(stream.substr(first_event + 10));
+  EXPECT_EQ(Http::FilterDataStatus::Continue,
+            filter_->encodeData(more_data, true));
+  EXPECT_EQ(" from Lambda", more_data.toString());
+}
+
+TEST_F(AWSLambdaFilterTest, ResponseStreamingResetsOnFunctionError) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                     {":authority", "www.solo.io"}, {":path", "/getsomething"}};
+  filter_->decodeHeaders(headers, true);
+  Http::TestResponseHeaderMapImpl response_headers{{":status", "200"}};
+  filter_->setEncoderFilterCallbacks(filter_encode_callbacks_);
+  filter_->encodeHeaders(response_headers, false);
+
+  std::string stream;
+  AwsEventStream::encode(
+      {{":event-type", "InvokeComplete"}, {":message-type", "event"}},
+      R"({"ErrorCode":"Unhandled","ErrorDetails":"boom"})", stream);
+
+  EXPECT_CALL(filter_encode_callbacks_, resetStream());
+  Buffer::OwnedImpl data(stream);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->encodeData(data, true));
+}
+
+TEST_F(AWSLambdaFilterTest, ResponseStreamingResetsOnCorruptStream) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                     {":authority", "www.solo.io"}, {":path", "/getsomething"}};
+  filter_->decodeHeaders(headers, true);
+  Http::TestResponseHeaderMapImpl response_headers{{":status", "200"}};
+  filter_->setEncoderFilterCallbacks(filter_encode_callbacks_);
+  filter_->encodeHeaders(response_headers, false);
+
+  std::string stream;
+  AwsEventStream::encode(
+      {{":event-type", "PayloadChunk"}, {":message-type", "event"}}, "Hello",
+      stream);
+  stream[stream.size() - 1] ^= 1;
+
+  EXPECT_CALL(filter_encode_callbacks_, resetStream());
+  Buffer::OwnedImpl data(stream);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->encodeData(data, false));
+}
+
+TEST_F(AWSLambdaFilterTest, ResponseStreamingResetsOnTruncatedStream) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                     {":authority", "www.solo.io"}, {":path", "/getsomething"}};
+  filter_->decodeHeaders(headers, true);
+  Http::TestResponseHeaderMapImpl response_headers{{":status", "200"}};
+  filter_->setEncoderFilterCallbacks(filter_encode_callbacks_);
+  filter_->encodeHeaders(response_headers, false);
+
+  std::string stream;
+  AwsEventStream::encode(
+      {{":event-type", "PayloadChunk"}, {":message-type", "event"}}, "Hello",
+      stream);
+  AwsEventStream::encode(
+      {{":event-type", "InvokeComplete"}, {":message-type", "event"}},
+      R"({"LogResult":""})", stream);
+
+  // The final event is cut short
+  EXPECT_CALL(filter_encode_callbacks_, resetStream());
+  Buffer::OwnedImpl data(stream.substr(0, stream.size() - 1));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->encodeData(data, true));
+}
+
+TEST_F(AWSLambdaFilterTest, ResponseStreamingResetsWithoutInvokeComplete) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                     {":authority", "www.solo.io"}, {":path", "/getsomething"}};
+  filter_->decodeHeaders(headers, true);
+  Http::TestResponseHeaderMapImpl response_headers{{":status", "200"}};
+  filter_->setEncoderFilterCallbacks(filter_encode_callbacks_);
+  filter_->encodeHeaders(response_headers, false);
+
+  std::string stream;
+  AwsEventStream::encode(
+      {{":event-type", "PayloadChunk"}, {":message-type", "event"}}, "Hello",
+      stream);
+
+  EXPECT_CALL(filter_encode_callbacks_, resetStream());
+  Buffer::OwnedImpl data(stream);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->encodeData(data, true));
+}
+
+TEST_F(AWSLambdaFilterTest, ResponseStreamingResetsOnOversizedEvent) {
+  routeconfig_.set_response_streaming(true);
+  setup_func();
+
+  Http::TestRequestHeaderMapImpl headers{{":method", "GET"},
+                     {":authority", "www.solo.io"}, {":path", "/getsomething"}};
+  filter_->decodeHeaders(headers, true);
+  Http::TestResponseHeaderMapImpl response_headers{{":status", "200"}};
+  filter_->setEncoderFilterCallbacks(filter_encode_callbacks_);
+  filter_->encodeHeaders(response_headers, false);
+
+  // An event too large to decode fails the stream as soon as its prelude is
+  // read, rather than being dropped from the body
+  std::string stream;
+  AwsEventStream::encode(
+      {{":event-type", "PayloadChunk"}, {":message-type", "event"}},
+      std::string(17 * 1024 * 1024, 'a'), stream);
+
+  EXPECT_CALL(filter_encode_callbacks_, resetStream());
+  Buffer::OwnedImpl data(stream.substr(0, 1024));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->encodeData(data, false));
+}
+
 TEST_F(AWSLambdaFilterTest, ALBDecodingBasic) {
   setupRoute(false, false, false, true);
 
@@ -685,6 +1035,24 @@ TEST_F(AWSLambdaFilterTest, ALBDecodingBase64) {
   EXPECT_EQ("201", response_headers.getStatusValue());
 }
 
+TEST_F(AWSLambdaFilterTest, ALBDecodingBase64Binary) {
+  setupRoute(false, false, false, true);
+  auto response_headers = setup_encode();
+
+  Buffer::OwnedImpl buf{};
+  buf.add("{ \"isBase64Encoded\": true, \"statusCode\": 200,"
+            "\"body\": \"AAEC/w==\"}");
+
+  auto on_buf_mod = [&buf](std::function<void(Buffer::Instance&)> cb){cb(buf);};
+  EXPECT_CALL(filter_encode_callbacks_, encodingBuffer).WillOnce(Return(&buf));
+  EXPECT_CALL(filter_encode_callbacks_, modifyEncodingBuffer)
+      .WillOnce(Invoke(on_buf_mod));
+
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(buf, true));
+  EXPECT_EQ(std::string("\0\x01\x02\xff", 4), buf.toString());
+  EXPECT_EQ("4", response_headers.get_("content-length"));
+}
+
 TEST_F(AWSLambdaFilterTest, ALBDecodingInvalidTypes) {
   setupRoute(false, false, false, true);
   auto response_headers = setup_encode();
@@ -772,6 +1140,22 @@ TEST_F(AWSLambdaFilterTest, ApiGatewayDecodingBasic) {
   EXPECT_EQ("cookies", cookieHeader[0]->value().getStringView());
 }
 
+TEST_F(AWSLambdaFilterTest, ApiGatewayDecodingKeepsNulBytes) {
+  setupRoute(false, false, false, false, false, true);
+  auto response_headers = setup_encode();
+
+  Buffer::OwnedImpl buf{};
+  buf.add("{\"statusCode\": 200, \"body\": \"before\\u0000after\"}");
+  auto on_buf_mod = [&buf](std::function<void(Buffer::Instance&)> cb){cb(buf);};
+  EXPECT_CALL(filter_encode_callbacks_, encodingBuffer).WillOnce(Return(&buf));
+  EXPECT_CALL(filter_encode_callbacks_, modifyEncodingBuffer)
+      .WillOnce(Invoke(on_buf_mod));
+
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(buf, true));
+  EXPECT_EQ(std::string("before\0after", 12), buf.toString());
+  EXPECT_EQ("12", response_headers.get_("content-length"));
+}
+
 
 } // namespace AwsLambda
 } // namespace HttpFilters
@@ -43,7 +43,17 @@ public:
     return nullptr;
   }
 
+  SigningKeyCache &signingKeyCache() const override {
+    return signing_keys_;
+  }
+
+  SigningScratch &signingScratch() const override {
+    return signing_scratch_;
+  }
+
   CredentialsConstSharedPtr credentials_;
+  mutable SigningKeyCache signing_keys_;
+  mutable SigningScratch signing_scratch_;
   mutable bool called_{};
 
   bool propagateOriginalRouting() const override{
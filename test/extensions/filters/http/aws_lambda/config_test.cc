@@ -51,7 +51,8 @@ protected:
     NiceMock<Event::MockTimer> *timer =
         new NiceMock<Event::MockTimer>(&context_.server_factory_context_.dispatcher_);
     protoconfig.mutable_use_default_credentials()->set_value(true);
-    EXPECT_CALL(context_.server_factory_context_.thread_local_, allocateSlot()).Times(1);
+    // The credentials and the signing state slots
+    EXPECT_CALL(context_.server_factory_context_.thread_local_, allocateSlot()).Times(2);
     return timer;
   }
 
@@ -295,16 +296,40 @@ TEST_F(ConfigTest, WithStsCreds) {
   std::shared_ptr<const AWSLambdaProtocolExtensionConfig> ext_config =
       std::make_shared<const AWSLambdaProtocolExtensionConfig>(protoextconfig);
 
+  // The worker asks the main thread, which assumes the role once
+  Event::PostCb post_cb;
+  EXPECT_CALL(context_.server_factory_context_.dispatcher_, post(_))
+      .WillOnce(Invoke([&](Event::PostCb cb) { post_cb = std::move(cb); }));
+  StsConnectionPool::Context *context = config->getCredentials(ext_config, &callbacks);
+  EXPECT_NE(nullptr, context);
+
+  StsConnectionPool::Context::Callbacks *fetch_callbacks{};
   EXPECT_CALL(*sts_cred_provider_, find(_, _, _))
       .WillOnce(Invoke([&](const absl::optional<std::string> &role_arn_arg,
                         bool,
-                           StsConnectionPool::Context::Callbacks *)
+                           StsConnectionPool::Context::Callbacks *cb)
                            -> StsConnectionPool::Context * {
         EXPECT_EQ(ext_config->roleArn().value(), role_arn_arg);
+        fetch_callbacks = cb;
         return nullptr;
       }));
-  auto ptr = config->getCredentials(ext_config, &callbacks);
-  EXPECT_EQ(nullptr, ptr);
+  post_cb();
+  ASSERT_NE(nullptr, fetch_callbacks);
+
+  auto credentials = std::make_shared<const StsCredentials>(
+      "access_key", "secret_key", "session_token",
+      context_.server_factory_context_.api_.timeSource().systemTime() +
+          std::chrono::hours(1));
+  EXPECT_CALL(callbacks, onSuccess(_))
+      .WillOnce(Invoke(
+          [&](std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+                  result) { EXPECT_EQ(credentials, result); }));
+  fetch_callbacks->onSuccess(credentials);
+
+  // Published credentials are served without going to the main thread
+  NiceMock<MockStsContextCallbacks> callbacks_2;
+  EXPECT_CALL(callbacks_2, onSuccess(_));
+  EXPECT_EQ(nullptr, config->getCredentials(ext_config, &callbacks_2));
 }
 
 } // namespace AwsLambda
@@ -84,6 +84,10 @@ public:
               (const absl::optional<std::string> &role_arn,
               bool disable_role_chaining,
                StsConnectionPool::Context::Callbacks *callbacks));
+  MOCK_METHOD(StsConnectionPool::Context *, refresh,
+              (const absl::optional<std::string> &role_arn,
+               bool disable_role_chaining,
+               StsConnectionPool::Context::Callbacks *callbacks));
   MOCK_METHOD(void, setWebToken, (std::string_view web_token));
 };
 
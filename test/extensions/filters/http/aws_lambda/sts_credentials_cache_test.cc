@@ -0,0 +1,328 @@
+#include <chrono>
+
+#include "source/extensions/filters/http/aws_lambda/sts_credentials_cache.h"
+
+#include "test/common/stats/stat_test_utility.h"
+#include "test/extensions/filters/http/aws_lambda/mocks.h"
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/simulated_time_system.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+namespace {
+
+class StsCredentialsCacheTest : public testing::Test,
+                                public Event::TestUsingSimulatedTime {
+public:
+  void SetUp() override {
+    auto provider = std::make_unique<NiceMock<MockStsCredentialsProvider>>();
+    provider_ = provider.get();
+    // Posts to the main thread are queued, as the dispatcher always does, and
+    // run when the test says so
+    ON_CALL(main_dispatcher_, post(_))
+        .WillByDefault(Invoke(
+            [this](Event::PostCb cb) { posted_.push_back(std::move(cb)); }));
+    auto fetch = [this](const absl::optional<std::string> &, bool,
+                        StsConnectionPool::Context::Callbacks *cb)
+        -> StsConnectionPool::Context * {
+      fetch_callbacks_ = cb;
+      return &fetch_context_;
+    };
+    ON_CALL(*provider_, find(_, _, _)).WillByDefault(Invoke(fetch));
+    ON_CALL(*provider_, refresh(_, _, _)).WillByDefault(Invoke(fetch));
+    // Refreshes at 5/8 of the lifetime
+    ON_CALL(random_, random()).WillByDefault(Return(500));
+    cache_ = std::make_shared<StsCredentialsCache>(
+        main_dispatcher_, tls_, time_system_, random_,
+        StsCredentialsCache::generateStats("test.", *store_.rootScope()),
+        std::move(provider), "default");
+  }
+
+  // Fetches the role, and returns the timer of its refresh
+  NiceMock<Event::MockTimer> *fetchRole(const std::string &role,
+                                        bool disable_role_chaining,
+                                        std::chrono::seconds lifetime) {
+    NiceMock<MockStsContextCallbacks> callbacks;
+    auto *timer = new NiceMock<Event::MockTimer>(&main_dispatcher_);
+    cache_->find(role, disable_role_chaining, &callbacks);
+    runPosted();
+    fetch_callbacks_->onSuccess(credentials(lifetime));
+    return timer;
+  }
+
+  uint64_t counter(const std::string &name) {
+    return store_.counterFromString("test.aws_lambda." + name).value();
+  }
+
+  void runPosted() {
+    auto posted = std::move(posted_);
+    posted_.clear();
+    for (auto &cb : posted) {
+      cb();
+    }
+  }
+
+  StsCredentialsConstSharedPtr credentials(std::chrono::seconds lifetime) {
+    return std::make_shared<const StsCredentials>(
+        "access_key", "secret_key", "session_token",
+        time_system_.systemTime() + lifetime);
+  }
+
+  Stats::TestUtil::TestStore store_;
+  NiceMock<Random::MockRandomGenerator> random_;
+  NiceMock<Event::MockDispatcher> main_dispatcher_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  std::vector<Event::PostCb> posted_;
+  NiceMock<MockStsCredentialsProvider> *provider_{};
+  StsConnectionPool::Context::Callbacks *fetch_callbacks_{};
+  NiceMock<MockStsContext> fetch_context_;
+  StsCredentialsCacheSharedPtr cache_;
+};
+
+TEST_F(StsCredentialsCacheTest, CoalescesFetches) {
+  NiceMock<MockStsContextCallbacks> callbacks_1;
+  NiceMock<MockStsContextCallbacks> callbacks_2;
+
+  EXPECT_NE(nullptr, cache_->find("role", false, &callbacks_1));
+  EXPECT_NE(nullptr, cache_->find("role", false, &callbacks_2));
+  // A single request reaches the main thread, which fetches once
+  EXPECT_EQ(1, posted_.size());
+  EXPECT_CALL(*provider_, find(absl::optional<std::string>("role"), false, _));
+  runPosted();
+
+  const auto result = credentials(std::chrono::hours(1));
+  EXPECT_CALL(callbacks_1, onSuccess(_))
+      .WillOnce(Invoke(
+          [&](std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+                  creds) { EXPECT_EQ(result, creds); }));
+  EXPECT_CALL(callbacks_2, onSuccess(_));
+  fetch_callbacks_->onSuccess(result);
+
+  // Served from the published snapshot
+  NiceMock<MockStsContextCallbacks> callbacks_3;
+  EXPECT_CALL(callbacks_3, onSuccess(_));
+  EXPECT_CALL(*provider_, find(_, _, _)).Times(0);
+  EXPECT_EQ(nullptr, cache_->find("role", false, &callbacks_3));
+  EXPECT_TRUE(posted_.empty());
+}
+
+TEST_F(StsCredentialsCacheTest, JoinsFetchInFlight) {
+  NiceMock<MockStsContextCallbacks> callbacks_1;
+  NiceMock<MockStsContextCallbacks> callbacks_2;
+
+  EXPECT_CALL(*provider_, find(_, _, _));
+  cache_->find(absl::nullopt, false, &callbacks_1);
+  runPosted();
+  // Another worker missing its snapshot joins the same fetch
+  StsConnectionPool::Context *context =
+      cache_->find(absl::nullopt, false, &callbacks_2);
+  EXPECT_NE(nullptr, context);
+  context->cancel();
+  cache_->find(absl::nullopt, false, &callbacks_2);
+  runPosted();
+
+  EXPECT_CALL(callbacks_1, onFailure(CredentialsFailureStatus::Network));
+  EXPECT_CALL(callbacks_2, onFailure(CredentialsFailureStatus::Network));
+  fetch_callbacks_->onFailure(CredentialsFailureStatus::Network);
+}
+
+TEST_F(StsCredentialsCacheTest, SeparatesUnchainedRoles) {
+  NiceMock<MockStsContextCallbacks> callbacks_1;
+  NiceMock<MockStsContextCallbacks> callbacks_2;
+
+  EXPECT_CALL(*provider_, find(absl::optional<std::string>("role"), false, _));
+  EXPECT_CALL(*provider_, find(absl::optional<std::string>("role"), true, _));
+  cache_->find("role", false, &callbacks_1);
+  cache_->find("role", true, &callbacks_2);
+  EXPECT_EQ(2, posted_.size());
+  runPosted();
+}
+
+TEST_F(StsCredentialsCacheTest, RefreshesWithinGracePeriod) {
+  NiceMock<MockStsContextCallbacks> callbacks;
+
+  cache_->find("role", false, &callbacks);
+  runPosted();
+  fetch_callbacks_->onSuccess(credentials(std::chrono::minutes(10)));
+
+  time_system_.advanceTimeWait(std::chrono::minutes(6));
+  EXPECT_CALL(callbacks, onSuccess(_)).Times(0);
+  EXPECT_NE(nullptr, cache_->find("role", false, &callbacks));
+  EXPECT_CALL(*provider_, find(_, _, _));
+  runPosted();
+}
+
+TEST_F(StsCredentialsCacheTest, CompletesInlineWhenCached) {
+  NiceMock<MockStsContextCallbacks> callbacks;
+  const auto result = credentials(std::chrono::hours(1));
+
+  // The provider already holds fresh credentials
+  EXPECT_CALL(*provider_, find(_, _, _))
+      .WillOnce(Invoke([&](const absl::optional<std::string> &, bool,
+                           StsConnectionPool::Context::Callbacks *cb)
+                           -> StsConnectionPool::Context * {
+        cb->onSuccess(result);
+        return nullptr;
+      }));
+  // The request still waits for the main thread to publish the result
+  EXPECT_NE(nullptr, cache_->find("role", false, &callbacks));
+  EXPECT_CALL(callbacks, onSuccess(_));
+  runPosted();
+}
+
+TEST_F(StsCredentialsCacheTest, CancelsFetchOnDestruction) {
+  NiceMock<MockStsContextCallbacks> callbacks;
+
+  StsConnectionPool::Context *context = cache_->find("role", false, &callbacks);
+  runPosted();
+  context->cancel();
+  EXPECT_CALL(fetch_context_, cancel());
+  cache_.reset();
+}
+
+TEST_F(StsCredentialsCacheTest, DropsRequestsAfterDestruction) {
+  NiceMock<MockStsContextCallbacks> callbacks;
+
+  StsConnectionPool::Context *context = cache_->find("role", false, &callbacks);
+  context->cancel();
+  EXPECT_CALL(*provider_, find(_, _, _)).Times(0);
+  cache_.reset();
+  runPosted();
+}
+
+TEST_F(StsCredentialsCacheTest, RefreshesInBackground) {
+  NiceMock<MockStsContextCallbacks> callbacks;
+  auto *timer = new NiceMock<Event::MockTimer>(&main_dispatcher_);
+
+  cache_->find("role", false, &callbacks);
+  runPosted();
+  time_system_.advanceTimeWait(std::chrono::milliseconds(250));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(2250000), _));
+  fetch_callbacks_->onSuccess(credentials(std::chrono::hours(1)));
+  EXPECT_EQ(std::vector<uint64_t>({250}),
+            store_.histogramValues("test.aws_lambda.sts_fetch_latency", false));
+
+  // The refresh assumes the role again while the credentials are fresh
+  EXPECT_CALL(*provider_, refresh(absl::optional<std::string>("role"), false, _));
+  timer->invokeCallback();
+  const auto refreshed = credentials(std::chrono::hours(1));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(2250000), _));
+  fetch_callbacks_->onSuccess(refreshed);
+  EXPECT_EQ(1, counter("sts_refresh_success"));
+
+  // The workers are handed the refreshed credentials
+  EXPECT_CALL(callbacks, onSuccess(_))
+      .WillOnce(Invoke(
+          [&](std::shared_ptr<const Envoy::Extensions::Common::Aws::Credentials>
+                  creds) { EXPECT_EQ(refreshed, creds); }));
+  EXPECT_EQ(nullptr, cache_->find("role", false, &callbacks));
+}
+
+TEST_F(StsCredentialsCacheTest, RefreshesUnchainedRoles) {
+  auto *timer = fetchRole("role", true, std::chrono::hours(1));
+
+  EXPECT_CALL(*provider_, refresh(absl::optional<std::string>("role"), true, _));
+  timer->invokeCallback();
+}
+
+TEST_F(StsCredentialsCacheTest, RefreshesBeforeGracePeriod) {
+  // 5/8 of the lifetime would be within the grace period
+  auto *timer = new NiceMock<Event::MockTimer>(&main_dispatcher_);
+  NiceMock<MockStsContextCallbacks> callbacks;
+  cache_->find("role", false, &callbacks);
+  runPosted();
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(330000), _));
+  fetch_callbacks_->onSuccess(credentials(std::chrono::minutes(11)));
+}
+
+TEST_F(StsCredentialsCacheTest, DoesNotRefreshShortLivedCredentials) {
+  auto *timer = new NiceMock<Event::MockTimer>(&main_dispatcher_);
+  NiceMock<MockStsContextCallbacks> callbacks;
+  cache_->find("role", false, &callbacks);
+  runPosted();
+  EXPECT_CALL(*timer, enableTimer(_, _)).Times(0);
+  EXPECT_CALL(*timer, disableTimer());
+  fetch_callbacks_->onSuccess(credentials(std::chrono::minutes(5)));
+}
+
+TEST_F(StsCredentialsCacheTest, RetriesFailedRefresh) {
+  auto *timer = fetchRole("role", false, std::chrono::hours(1));
+
+  timer->invokeCallback();
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(30000), _));
+  fetch_callbacks_->onFailure(CredentialsFailureStatus::Network);
+  EXPECT_EQ(1, counter("sts_refresh_failed"));
+
+  // Given up once the workers would fetch the role themselves
+  time_system_.advanceTimeWait(std::chrono::minutes(55));
+  timer->invokeCallback();
+  EXPECT_CALL(*timer, enableTimer(_, _)).Times(0);
+  EXPECT_CALL(*timer, disableTimer());
+  fetch_callbacks_->onFailure(CredentialsFailureStatus::Network);
+  EXPECT_EQ(2, counter("sts_refresh_failed"));
+}
+
+TEST_F(StsCredentialsCacheTest, RefreshJoinsFetchInFlight) {
+  auto *timer = fetchRole("role", false, std::chrono::minutes(10));
+
+  // A worker in the grace period fetched the role before the refresh fired
+  time_system_.advanceTimeWait(std::chrono::minutes(6));
+  NiceMock<MockStsContextCallbacks> callbacks;
+  cache_->find("role", false, &callbacks);
+  runPosted();
+  EXPECT_CALL(*provider_, refresh(_, _, _)).Times(0);
+  timer->invokeCallback();
+}
+
+TEST_F(StsCredentialsCacheTest, KeepsRefreshingUsedRoles) {
+  auto *timer = fetchRole("role", false, std::chrono::hours(1));
+  timer->invokeCallback();
+  fetch_callbacks_->onSuccess(credentials(std::chrono::hours(1)));
+
+  // Served by a worker since the refresh
+  NiceMock<MockStsContextCallbacks> callbacks;
+  EXPECT_EQ(nullptr, cache_->find("role", false, &callbacks));
+  EXPECT_CALL(*provider_, refresh(absl::optional<std::string>("role"), false, _));
+  timer->invokeCallback();
+}
+
+TEST_F(StsCredentialsCacheTest, StopsRefreshingUnusedRoles) {
+  auto *timer = fetchRole("role", false, std::chrono::hours(1));
+  // The request that fetched the role counts as a use
+  EXPECT_CALL(*provider_, refresh(_, _, _));
+  timer->invokeCallback();
+  fetch_callbacks_->onSuccess(credentials(std::chrono::hours(1)));
+
+  // Not used since the refresh
+  EXPECT_CALL(*provider_, refresh(_, _, _)).Times(0);
+  timer->invokeCallback();
+
+  // Fetched again once the credentials the workers hold expire
+  time_system_.advanceTimeWait(std::chrono::minutes(56));
+  NiceMock<MockStsContextCallbacks> callbacks;
+  new NiceMock<Event::MockTimer>(&main_dispatcher_);
+  EXPECT_NE(nullptr, cache_->find("role", false, &callbacks));
+  EXPECT_CALL(*provider_, find(absl::optional<std::string>("role"), false, _));
+  runPosted();
+  EXPECT_CALL(callbacks, onSuccess(_));
+  fetch_callbacks_->onSuccess(credentials(std::chrono::hours(1)));
+}
+
+} // namespace
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -156,6 +156,42 @@ TEST_F(StsCredentialsProviderTest, TestFullFlow) {
   
 }
 
+TEST_F(StsCredentialsProviderTest, RefreshIgnoresCachedCredentials) {
+  std::string role_arn = "test_arn";
+  std::string token = "test_token";
+  std::unique_ptr<testing::NiceMock<MockStsConnectionPoolFactory>> factory_ = std::move(sts_connection_pool_factory_);
+  auto* factory = factory_.get();
+  auto sts_provider = StsCredentialsProvider::create(
+      config_, mock_factory_ctx_.server_factory_context_.api_, mock_factory_ctx_.server_factory_context_.cluster_manager_,
+      std::move(factory_), token, role_arn);
+
+  std::unique_ptr<testing::NiceMock<MockStsConnectionPool>> unique_pool = std::move(sts_connection_pool_);
+  auto* sts_connection_pool = unique_pool.get();
+  StsConnectionPool::Callbacks *credentials_provider_callbacks;
+  EXPECT_CALL(*factory, build(_, _, _, _))
+      .WillOnce(Invoke([&](const absl::string_view, const absl::string_view,
+                           StsConnectionPool::Callbacks *callbacks,
+                           StsFetcherPtr) -> StsConnectionPoolPtr {
+        credentials_provider_callbacks = callbacks;
+        return std::move(unique_pool);
+      }));
+
+  testing::NiceMock<MockStsContextCallbacks> ctx_callbacks_1;
+  sts_provider->find(role_arn, false, &ctx_callbacks_1);
+  auto credentials = std::make_shared<const StsCredentials>(
+      "access_key", "secret_key", "session_token",
+      SystemTime(expiry_time - std::chrono::minutes(5)));
+  std::list<std::string> to_chain;
+  credentials_provider_callbacks->onResult(credentials, role_arn, to_chain);
+
+  // The cached credentials are fresh, yet the role is assumed again
+  testing::NiceMock<MockStsContextCallbacks> ctx_callbacks_2;
+  EXPECT_CALL(ctx_callbacks_2, onSuccess(_)).Times(0);
+  EXPECT_CALL(*sts_connection_pool, init(_, _, token, _));
+  EXPECT_CALL(*sts_connection_pool, add(&ctx_callbacks_2));
+  sts_provider->refresh(role_arn, false, &ctx_callbacks_2);
+}
+
 TEST_F(StsCredentialsProviderTest, TestFullChainedFlow) {
   // Setup
   std::string base_role_arn = "test_arn";
@@ -0,0 +1,174 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "source/extensions/filters/http/aws_lambda/sts_response_parser.h"
+
+#include "absl/strings/str_cat.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace AwsLambda {
+namespace {
+
+const std::string valid_response = R"(
+<AssumeRoleWithWebIdentityResponse xmlns="https://sts.amazonaws.com/doc/2011-06-15/">
+  <AssumeRoleWithWebIdentityResult>
+    <SubjectFromWebIdentityToken>system:serviceaccount:gloo:envoy</SubjectFromWebIdentityToken>
+    <Credentials>
+      <AccessKeyId>some_access_key</AccessKeyId>
+      <SecretAccessKey>some_secret_key</SecretAccessKey>
+      <SessionToken>some_session_token</SessionToken>
+      <Expiration>2100-07-28T21:20:25Z</Expiration>
+    </Credentials>
+  </AssumeRoleWithWebIdentityResult>
+</AssumeRoleWithWebIdentityResponse>
+)";
+
+// Whether `value` is a view into `body` between `<name>` and `</name>`.
+bool isElementValue(absl::string_view body, absl::string_view name,
+                    absl::string_view value) {
+  if (value.data() < body.data() ||
+      value.data() + value.size() > body.data() + body.size()) {
+    return false;
+  }
+  const size_t pos = value.data() - body.data();
+  const std::string open = absl::StrCat("<", name, ">");
+  const std::string close = absl::StrCat("</", name, ">");
+  return pos >= open.size() &&
+         body.substr(pos - open.size(), open.size()) == open &&
+         body.substr(pos + value.size(), close.size()) == close;
+}
+
+TEST(StsResponseParserTest, ParsesCredentials) {
+  StsResponseFields fields;
+  ASSERT_TRUE(StsResponseParser::parse(valid_response, fields));
+  EXPECT_EQ("some_access_key", fields.access_key_id_);
+  EXPECT_EQ("some_secret_key", fields.secret_access_key_);
+  EXPECT_EQ("some_session_token", fields.session_token_);
+  EXPECT_EQ("2100-07-28T21:20:25Z", fields.expiration_);
+}
+
+TEST(StsResponseParserTest, ParsesElementsInAnyOrder) {
+  StsResponseFields fields;
+  ASSERT_TRUE(StsResponseParser::parse(
+      "<Expiration>e</Expiration><SessionToken></SessionToken>"
+      "<SecretAccessKey>s</SecretAccessKey><AccessKeyId>a</AccessKeyId>"
+      "<AccessKeyId>ignored</AccessKeyId>",
+      fields));
+  EXPECT_EQ("a", fields.access_key_id_);
+  EXPECT_EQ("s", fields.secret_access_key_);
+  EXPECT_EQ("", fields.session_token_);
+  EXPECT_EQ("e", fields.expiration_);
+}
+
+TEST(StsResponseParserTest, KeepsNestedContent) {
+  StsResponseFields fields;
+  ASSERT_TRUE(StsResponseParser::parse(
+      "<AccessKeyId>a<b>c</b></AccessKeyIdx></AccessKeyId>"
+      "<SecretAccessKey>s</SecretAccessKey><SessionToken>t</SessionToken>"
+      "<Expiration>e</Expiration>",
+      fields));
+  EXPECT_EQ("a<b>c</b></AccessKeyIdx>", fields.access_key_id_);
+}
+
+TEST(StsResponseParserTest, ParsesLargeSessionToken) {
+  // Large enough to overflow the stack of std::regex
+  const std::string token(1 << 20, 'T');
+  const std::string body = absl::StrCat(
+      "<AccessKeyId>a</AccessKeyId><SecretAccessKey>s</SecretAccessKey>"
+      "<SessionToken>",
+      token, "</SessionToken><Expiration>e</Expiration>");
+  StsResponseFields fields;
+  ASSERT_TRUE(StsResponseParser::parse(body, fields));
+  EXPECT_EQ(token, fields.session_token_);
+}
+
+TEST(StsResponseParserTest, RejectsIncompleteResponses) {
+  const std::vector<std::string> bodies = {
+      "",
+      "<ErrorResponse><Error><Code>ExpiredTokenException</Code></Error>"
+      "</ErrorResponse>",
+      "<AccessKeyId>a</AccessKeyId><SecretAccessKey>s</SecretAccessKey>"
+      "<SessionToken>t</SessionToken>",
+      "<AccessKeyId>a</AccessKeyId><SecretAccessKey>s</SecretAccessKey>"
+      "<SessionToken>t</SessionToken><Expiration>e</Expiration",
+      "<AccessKeyId>a</AccessKeyId><SecretAccessKey>s</SecretAccessKey>"
+      "<SessionToken>t</SessionToken><Expiration>e</Expirationx>",
+      "<AccessKeyId>a</AccessKeyId><SecretAccessKey>s</SecretAccessKey>"
+      "<SessionToken>t<Expiration>e</Expiration>",
+      "<AccessKeyId>a</AccessKeyId><SecretAccessKey>s</SecretAccessKey>"
+      "<SessionToken>t</SessionToken><Expiration",
+  };
+
+  for (const std::string &body : bodies) {
+    StsResponseFields fields;
+    EXPECT_FALSE(StsResponseParser::parse(body, fields)) << body;
+  }
+}
+
+TEST(StsResponseParserTest, RejectsTruncatedResponses) {
+  const size_t complete =
+      valid_response.find("</Expiration>") + sizeof("</Expiration>") - 1;
+  for (size_t size = 0; size <= valid_response.size(); size++) {
+    const absl::string_view body = absl::string_view(valid_response).substr(0, size);
+    StsResponseFields fields;
+    EXPECT_EQ(size >= complete, StsResponseParser::parse(body, fields)) << size;
+  }
+}
+
+// Mutates the response at random, and checks that whatever is returned is the
+// content of the expected elements of the mutated response.
+TEST(StsResponseParserTest, FuzzMutatedResponses) {
+  static constexpr char Alphabet[] = "<>/ aAE\n";
+  std::mt19937 random(42);
+  size_t parsed = 0;
+
+  for (int i = 0; i < 20000; i++) {
+    std::string body = valid_response;
+    const int mutations = 1 + random() % 4;
+    for (int m = 0; m < mutations; m++) {
+      const size_t pos = random() % body.size();
+      switch (random() % 3) {
+      case 0:
+        body[pos] = Alphabet[random() % (sizeof(Alphabet) - 1)];
+        break;
+      case 1:
+        body.erase(pos, 1 + random() % 16);
+        break;
+      default:
+        body.insert(pos, 1, Alphabet[random() % (sizeof(Alphabet) - 1)]);
+        break;
+      }
+      if (body.empty()) {
+        body = "<";
+      }
+    }
+
+    StsResponseFields fields;
+    if (!StsResponseParser::parse(body, fields)) {
+      continue;
+    }
+    parsed++;
+    EXPECT_TRUE(isElementValue(body, "AccessKeyId", fields.access_key_id_))
+        << body;
+    EXPECT_TRUE(
+        isElementValue(body, "SecretAccessKey", fields.secret_access_key_))
+        << body;
+    EXPECT_TRUE(isElementValue(body, "SessionToken", fields.session_token_))
+        << body;
+    EXPECT_TRUE(isElementValue(body, "Expiration", fields.expiration_))
+        << body;
+  }
+  // Mutations outside of the credentials leave them readable
+  EXPECT_GT(parsed, 0);
+}
+
+} // namespace
+} // namespace AwsLambda
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -6,15 +6,18 @@
 #include "test/mocks/nats/streaming/mocks.h"
 #include "test/mocks/server/mocks.h"
 #include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
 
 #include "api/envoy/config/filter/http/nats/streaming/v2/nats_streaming.pb.validate.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 using testing::_;
+using testing::Invoke;
 using testing::NiceMock;
 using testing::Ref;
 using testing::Return;
+using testing::ReturnRef;
 
 namespace Envoy {
 namespace Extensions {
@@ -216,6 +219,91 @@ TEST_F(NatsStreamingFilterTest, RequestWithHeadersAndOneChunkOfData) {
   EXPECT_EQ("a", actual_payload.headers().at("some-header"));
   EXPECT_EQ("b", actual_payload.headers().at("other-header"));
   EXPECT_EQ("hello world", actual_payload.body());
+  EXPECT_TRUE(nats_streaming_client_->last_headers_.empty());
+}
+
+TEST_F(NatsStreamingFilterTest, RequestWithNatsHeaders) {
+  envoy::config::filter::http::nats::streaming::v2::NatsStreaming proto_config;
+  proto_config.set_max_connections(1);
+  proto_config.set_cluster("cluster");
+  proto_config.set_protocol(envoy::config::filter::http::nats::streaming::v2::
+                                NatsStreaming::JETSTREAM);
+  proto_config.set_nats_headers(true);
+  config_.reset(new NatsStreamingFilterConfig(
+      proto_config, factory_context_.server_factory_context_.clusterManager()));
+  filter_.reset(new NatsStreamingFilter(config_, nats_streaming_client_));
+  filter_->setDecoderFilterCallbacks(callbacks_);
+
+  // `nats_streaming_client_->makeRequest()` should be called exactly once.
+  EXPECT_CALL(*nats_streaming_client_,
+              makeRequest_("Subject1", "cluster_id", "discover_prefix1", _,
+                           Ref(*filter_)))
+      .Times(1);
+
+  const auto &&config =
+      routeSpecificFilterConfig("Subject1", "cluster_id", "discover_prefix1");
+  ON_CALL(callbacks_, mostSpecificPerFilterConfig())
+      .WillByDefault(Return(&config));
+
+  callbacks_.buffer_.reset(new Buffer::OwnedImpl);
+
+  // The `Nats-` headers of the client are not published.
+  Http::TestRequestHeaderMapImpl headers{{":method", "POST"},
+                                         {"some-header", "a"},
+                                         {"nats-msg-id", "1"},
+                                         {"Nats-Rollup", "all"},
+                                         {"some-header", "b"},
+                                         {"nats-expected-stream", "stream1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+
+  Buffer::OwnedImpl data("hello world");
+  callbacks_.buffer_->add(data);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->decodeData(data, true));
+
+  // The body is published as is, without a `Payload` around it.
+  EXPECT_EQ("method: POST\r\nsome-header: a\r\nsome-header: b\r\n",
+            nats_streaming_client_->last_headers_);
+  EXPECT_EQ("hello world", nats_streaming_client_->last_payload_);
+}
+
+TEST_F(NatsStreamingFilterTest, NatsHeadersRequireJetStream) {
+  envoy::config::filter::http::nats::streaming::v2::NatsStreaming proto_config;
+  proto_config.set_max_connections(1);
+  proto_config.set_cluster("cluster");
+  proto_config.set_nats_headers(true);
+  EXPECT_THROW_WITH_MESSAGE(
+      NatsStreamingFilterConfig(
+          proto_config,
+          factory_context_.server_factory_context_.clusterManager()),
+      EnvoyException,
+      "nats-streaming filter: nats_headers requires the JETSTREAM protocol");
+}
+
+TEST_F(NatsStreamingFilterTest, MaxConnectionsMustBePositive) {
+  envoy::config::filter::http::nats::streaming::v2::NatsStreaming proto_config;
+  proto_config.set_cluster("cluster");
+  EXPECT_THROW_WITH_MESSAGE(
+      NatsStreamingFilterConfig(
+          proto_config,
+          factory_context_.server_factory_context_.clusterManager()),
+      EnvoyException,
+      "nats-streaming filter: max_connections must be at least 1");
+}
+
+TEST_F(NatsStreamingFilterTest, SeveralConnections) {
+  envoy::config::filter::http::nats::streaming::v2::NatsStreaming proto_config;
+  proto_config.set_max_connections(4);
+  proto_config.set_connection_selection(
+      envoy::config::filter::http::nats::streaming::v2::NatsStreaming::
+          SUBJECT_HASH);
+  proto_config.set_cluster("cluster");
+  NatsStreamingFilterConfig config(
+      proto_config, factory_context_.server_factory_context_.clusterManager());
+  EXPECT_EQ(4, config.maxConnections());
+  EXPECT_EQ(Envoy::Nats::Streaming::ConnectionSelection::SubjectHash,
+            config.connectionSelection());
 }
 
 TEST_F(NatsStreamingFilterTest, RequestWithTrailers) {
@@ -257,6 +345,105 @@ TEST_F(NatsStreamingFilterTest, RequestWithTrailers) {
   EXPECT_EQ("hello world", actual_payload.body());
 }
 
+TEST_F(NatsStreamingFilterTest, RequestOverflow) {
+  EXPECT_CALL(*nats_streaming_client_, makeRequest_(_, _, _, _, _))
+      .WillOnce(Invoke([](const std::string &, const std::string &,
+                          const std::string &, const std::string &,
+                          Envoy::Nats::Streaming::PublishCallbacks &callbacks)
+                           -> Envoy::Nats::Streaming::PublishRequestPtr {
+        callbacks.onOverflow();
+        return nullptr;
+      }));
+  EXPECT_CALL(callbacks_,
+              sendLocalReply(Http::Code::ServiceUnavailable, _, _, _, _));
+
+  const auto &&config =
+      routeSpecificFilterConfig("Subject1", "cluster_id", "discover_prefix1");
+  ON_CALL(callbacks_, mostSpecificPerFilterConfig())
+      .WillByDefault(Return(&config));
+
+  Http::TestRequestHeaderMapImpl headers;
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, true));
+}
+
+TEST_F(NatsStreamingFilterTest, ReadDisabledWhileWindowIsFull) {
+  const auto &&config =
+      routeSpecificFilterConfig("Subject1", "cluster_id", "discover_prefix1");
+  ON_CALL(callbacks_, mostSpecificPerFilterConfig())
+      .WillByDefault(Return(&config));
+
+  EXPECT_CALL(*nats_streaming_client_, watchWindow("Subject1", Ref(*filter_)))
+      .WillOnce(Invoke([](const std::string &,
+                          Envoy::Nats::Streaming::WindowCallbacks &)
+                           -> Envoy::Nats::Streaming::WindowWatchPtr {
+        return std::make_unique<
+            NiceMock<Envoy::Nats::Streaming::MockWindowWatch>>();
+      }));
+  EXPECT_CALL(callbacks_, onDecoderFilterAboveWriteBufferHighWatermark());
+
+  Http::TestRequestHeaderMapImpl headers;
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+
+  EXPECT_CALL(callbacks_, onDecoderFilterBelowWriteBufferLowWatermark());
+  filter_->onWindowOpen();
+}
+
+TEST_F(NatsStreamingFilterTest, WindowWatchCanceledOnDestroy) {
+  const auto &&config =
+      routeSpecificFilterConfig("Subject1", "cluster_id", "discover_prefix1");
+  ON_CALL(callbacks_, mostSpecificPerFilterConfig())
+      .WillByDefault(Return(&config));
+
+  auto *window_watch = new Envoy::Nats::Streaming::MockWindowWatch();
+  EXPECT_CALL(*nats_streaming_client_, watchWindow("Subject1", Ref(*filter_)))
+      .WillOnce(
+          Invoke([window_watch](const std::string &,
+                                Envoy::Nats::Streaming::WindowCallbacks &) {
+            return Envoy::Nats::Streaming::WindowWatchPtr{window_watch};
+          }));
+
+  Http::TestRequestHeaderMapImpl headers;
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+
+  // The watermark is lowered rather than left raised.
+  EXPECT_CALL(*window_watch, cancel());
+  EXPECT_CALL(callbacks_, onDecoderFilterBelowWriteBufferLowWatermark());
+  filter_->onDestroy();
+}
+
+TEST_F(NatsStreamingFilterTest, WatchAndPublishOnSelectedClient) {
+  const auto &&config =
+      routeSpecificFilterConfig("Subject1", "cluster_id", "discover_prefix1");
+  ON_CALL(callbacks_, mostSpecificPerFilterConfig())
+      .WillByDefault(Return(&config));
+
+  // The client is selected once per request, and both the window watch and
+  // the publish go to it.
+  NiceMock<Envoy::Nats::Streaming::MockClient> selected_client;
+  EXPECT_CALL(*nats_streaming_client_, selectClient("Subject1"))
+      .WillOnce(ReturnRef(selected_client));
+  EXPECT_CALL(*nats_streaming_client_, watchWindow(_, _)).Times(0);
+  EXPECT_CALL(*nats_streaming_client_, makeRequest_(_, _, _, _, _)).Times(0);
+  EXPECT_CALL(selected_client, watchWindow("Subject1", Ref(*filter_)));
+  EXPECT_CALL(selected_client,
+              makeRequest_("Subject1", "cluster_id", "discover_prefix1", _,
+                           Ref(*filter_)));
+
+  callbacks_.buffer_.reset(new Buffer::OwnedImpl);
+
+  Http::TestRequestHeaderMapImpl headers;
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+            filter_->decodeHeaders(headers, false));
+
+  Buffer::OwnedImpl data("hello");
+  callbacks_.buffer_->add(data);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer,
+            filter_->decodeData(data, true));
+}
+
 } // namespace Streaming
 } // namespace Nats
 } // namespace HttpFilters
@@ -0,0 +1,190 @@
+#include "source/extensions/filters/http/solo_well_known_names.h"
+#include "source/extensions/filters/http/transformation/ai_stream_usage.h"
+
+#include "source/common/aws/event_stream_codec.h"
+#include "source/common/buffer/buffer_impl.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::_;
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+namespace {
+
+// Builds a vnd.amazon.eventstream frame.
+std::string eventStreamFrame(absl::string_view payload) {
+  std::string frame;
+  AwsEventStream::encode(
+      {{":event-type", "metadata"}, {":message-type", "event"}}, payload,
+      frame);
+  return frame;
+}
+
+class AiStreamUsageExtractorTest : public testing::Test {
+protected:
+  // Feeds `body` to the extractor `chunk_size` bytes at a time.
+  void stream(absl::string_view content_type, absl::string_view body,
+              size_t chunk_size) {
+    Http::TestResponseHeaderMapImpl headers{{":status", "200"},
+                                            {"content-type", content_type}};
+    extractor_.onHeaders(headers, callbacks_);
+    while (!body.empty()) {
+      Buffer::OwnedImpl data(body.substr(0, chunk_size));
+      body.remove_prefix(std::min(chunk_size, body.size()));
+      extractor_.onData(data, callbacks_);
+    }
+    extractor_.onComplete(callbacks_);
+  }
+
+  double usageMetadata(const std::string &key) {
+    const auto &filter_metadata =
+        callbacks_.stream_info_.dynamicMetadata().filter_metadata();
+    const auto it =
+        filter_metadata.find(SoloHttpFilterNames::get().Transformation);
+    if (it == filter_metadata.end()) {
+      return -1;
+    }
+    return it->second.fields().at(key).number_value();
+  }
+
+  NiceMock<Http::MockStreamEncoderFilterCallbacks> callbacks_;
+  AiStreamUsageExtractor extractor_;
+};
+
+class AiStreamUsageChunkingTest
+    : public AiStreamUsageExtractorTest,
+      public testing::WithParamInterface<size_t> {};
+
+INSTANTIATE_TEST_SUITE_P(ChunkSizes, AiStreamUsageChunkingTest,
+                         testing::Values(1, 3, 16, 4096));
+
+TEST_P(AiStreamUsageChunkingTest, OpenAi) {
+  stream("text/event-stream; charset=utf-8",
+         "data: {\"choices\":[{\"delta\":{\"content\":\"Hi\"}}],\"usage\":null}"
+         "\n\n"
+         "data: {\"choices\":[],\"usage\":{\"prompt_tokens\":19,"
+         "\"completion_tokens\":10,\"total_tokens\":29}}\n\n"
+         "data: [DONE]\n\n",
+         GetParam());
+
+  EXPECT_EQ(19, usageMetadata("prompt_tokens"));
+  EXPECT_EQ(10, usageMetadata("completion_tokens"));
+  EXPECT_EQ(29, usageMetadata("total_tokens"));
+}
+
+TEST_P(AiStreamUsageChunkingTest, Anthropic) {
+  stream("text/event-stream",
+         "event: message_start\r\n"
+         "data: {\"type\":\"message_start\",\"message\":{\"usage\":"
+         "{\"input_tokens\":25,\"output_tokens\":1}}}\r\n\r\n"
+         "event: content_block_delta\r\n"
+         "data: {\"type\":\"content_block_delta\",\"delta\":{\"text\":\"Hi\"}}"
+         "\r\n\r\n"
+         "event: message_delta\r\n"
+         "data: {\"type\":\"message_delta\",\"usage\":{\"output_tokens\":15}}"
+         "\r\n\r\n",
+         GetParam());
+
+  EXPECT_EQ(25, usageMetadata("prompt_tokens"));
+  EXPECT_EQ(15, usageMetadata("completion_tokens"));
+  EXPECT_EQ(40, usageMetadata("total_tokens"));
+}
+
+TEST_P(AiStreamUsageChunkingTest, Gemini) {
+  // The last event is not terminated by a blank line
+  stream("text/event-stream",
+         "data: {\"candidates\":[],\"usageMetadata\": {\"promptTokenCount\":4,"
+         "\"candidatesTokenCount\":5,\"totalTokenCount\":9}}\r\n\r\n"
+         "data: {\"candidates\":[],\"usageMetadata\": {\"promptTokenCount\":4,"
+         "\"candidatesTokenCount\":568,\"totalTokenCount\":572}}",
+         GetParam());
+
+  EXPECT_EQ(4, usageMetadata("prompt_tokens"));
+  EXPECT_EQ(568, usageMetadata("completion_tokens"));
+  EXPECT_EQ(572, usageMetadata("total_tokens"));
+}
+
+TEST_P(AiStreamUsageChunkingTest, Bedrock) {
+  stream("application/vnd.amazon.eventstream",
+         absl::StrCat(eventStreamFrame(R"({"delta":{"text":"Hi"}})"),
+                      eventStreamFrame(R"({"metrics":{"latencyMs":12},)"
+                                       R"("usage":{"inputTokens":3,)"
+                                       R"("outputTokens":4,"totalTokens":7}})")),
+         GetParam());
+
+  EXPECT_EQ(3, usageMetadata("prompt_tokens"));
+  EXPECT_EQ(4, usageMetadata("completion_tokens"));
+  EXPECT_EQ(7, usageMetadata("total_tokens"));
+}
+
+TEST_F(AiStreamUsageExtractorTest, OversizedEventsAreSkipped) {
+  stream("text/event-stream",
+         absl::StrCat("data: ",
+                      std::string(AiStreamUsageExtractor::MaxEventSize, 'a'),
+                      "\n\n",
+                      "data: {\"usage\":{\"prompt_tokens\":1,"
+                      "\"completion_tokens\":2}}\n\n"),
+         1024);
+
+  EXPECT_EQ(3, usageMetadata("total_tokens"));
+}
+
+TEST_F(AiStreamUsageExtractorTest, OversizedFramesAreSkipped) {
+  stream("application/vnd.amazon.eventstream",
+         absl::StrCat(eventStreamFrame(std::string(
+                          AiStreamUsageExtractor::MaxEventSize, 'a')),
+                      eventStreamFrame(R"({"usage":{"inputTokens":3,)"
+                                       R"("outputTokens":4,"totalTokens":7}})")),
+         1024);
+
+  EXPECT_EQ(7, usageMetadata("total_tokens"));
+}
+
+TEST_F(AiStreamUsageExtractorTest, CorruptFramesStopSplitting) {
+  std::string corrupt = eventStreamFrame(R"({"delta":{"text":"Hi"}})");
+  corrupt[corrupt.size() - 5] ^= 1;
+  EXPECT_CALL(callbacks_.stream_info_, setDynamicMetadata(_, _)).Times(0);
+  stream("application/vnd.amazon.eventstream",
+         absl::StrCat(corrupt,
+                      eventStreamFrame(R"({"usage":{"inputTokens":3,)"
+                                       R"("outputTokens":4,"totalTokens":7}})")),
+         1024);
+  EXPECT_FALSE(extractor_.hasUsage());
+}
+
+TEST_F(AiStreamUsageExtractorTest, NonStreamingResponseIsIgnored) {
+  EXPECT_CALL(callbacks_.stream_info_, setDynamicMetadata(_, _)).Times(0);
+  stream("application/json",
+         R"({"usage":{"prompt_tokens":1,"completion_tokens":2}})", 4096);
+  EXPECT_FALSE(extractor_.hasUsage());
+}
+
+TEST_F(AiStreamUsageExtractorTest, NoUsageReported) {
+  EXPECT_CALL(callbacks_.stream_info_, setDynamicMetadata(_, _)).Times(0);
+  stream("text/event-stream",
+         "data: {\"choices\":[],\"usage\":null}\n\ndata: [DONE]\n\n", 4096);
+}
+
+TEST_F(AiStreamUsageExtractorTest, CompletesOnce) {
+  EXPECT_CALL(callbacks_.stream_info_, setDynamicMetadata(_, _)).Times(1);
+  stream("text/event-stream",
+         "data: {\"usage\":{\"prompt_tokens\":1,\"completion_tokens\":2}}\n\n",
+         4096);
+  extractor_.onComplete(callbacks_);
+}
+
+} // namespace
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -1,11 +1,15 @@
+#include "source/common/aws/event_stream_codec.h"
 #include "source/extensions/filters/http/transformation/ai_transformer.h"
 
 #include "test/mocks/common.h"
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/server/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "fmt/format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -282,7 +286,7 @@ class AiTransformerTest : public ::testing::Test {
     TestUtility::loadFromYaml(ai_transformation_yaml, aiTransformation);
     google::protobuf::BoolValue val;
     val.set_value(log_request_response_info);
-    return std::make_shared<AiTransformer>(aiTransformation, val);
+    return std::make_shared<AiTransformer>(aiTransformation, val, tls_);
   }
 
   std::string_view getPath() {
@@ -326,6 +330,7 @@ class AiTransformerTest : public ::testing::Test {
   NiceMock<Http::MockStreamDecoderFilterCallbacks> filter_callbacks_;
   NiceMock<MockUpstreamStreamFilterCallbacks> upstream_callbacks_;
   NiceMock<Envoy::StreamInfo::MockStreamInfo> stream_info_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
   Upstream::MetadataConstSharedPtr metadata_;
 
   Http::TestRequestHeaderMapImpl headers_;
@@ -1141,6 +1146,484 @@ TEST_F(AiTransformerTest, BedrockPromptEnrichmentTransformation) {
   EXPECT_EQ(expected_system_json, parsed_body["system"]) << "\nbody: " << body_.toString();
 }
 
+TEST_F(AiTransformerTest, TranslateOpenAiRequestToGemini) {
+  auto aiTransformer = createAiTransformer(
+    "translate_schema: true",
+    GEMINI_UPSTREAM_METADATA
+  );
+
+  setPath("/v1/chat/completions");
+  setBody(R"(
+  {
+    "model": "gpt-4o",
+    "max_completion_tokens": 256,
+    "temperature": 0.2,
+    "stop": "END",
+    "messages": [
+      {"role": "system", "content": "You are terse."},
+      {"role": "user", "content": "Hello!"},
+      {"role": "assistant", "content": "Hi."},
+      {"role": "user", "content": [{"type": "text", "text": "Tell me a joke."}]}
+    ]
+  }
+  )");
+
+  aiTransformer->transform(headers_, &headers_, body_, filter_callbacks_);
+  EXPECT_EQ("/v1beta/models/gemini-1.5-flash-001:generateContent", getPath());
+  auto expected_body = json::parse(R"(
+  {
+    "systemInstruction": {"parts": [{"text": "You are terse."}]},
+    "contents": [
+      {"role": "user", "parts": [{"text": "Hello!"}]},
+      {"role": "model", "parts": [{"text": "Hi."}]},
+      {"role": "user", "parts": [{"text": "Tell me a joke."}]}
+    ],
+    "generationConfig": {
+      "maxOutputTokens": 256,
+      "temperature": 0.2,
+      "stopSequences": ["END"]
+    }
+  }
+  )");
+  EXPECT_EQ(expected_body, json::parse(body_.toString()));
+}
+
+TEST_F(AiTransformerTest, TranslateOpenAiRequestToBedrock) {
+  auto aiTransformer = createAiTransformer(
+    R"(
+      enable_chat_streaming: true
+      translate_schema: true
+      prompt_enrichment:
+        prepend:
+          - role: system
+            content: you are a helpful assistant.
+    )",
+    BEDROCK_UPSTREAM_METADATA
+  );
+
+  setPath("/v1/chat/completions");
+  setBody(R"(
+  {
+    "model": "gpt-4o",
+    "max_tokens": 100,
+    "messages": [
+      {"role": "user", "content": "Hello!"},
+      {"role": "user", "content": "Anyone there?"}
+    ]
+  }
+  )");
+
+  aiTransformer->transform(headers_, &headers_, body_, filter_callbacks_);
+  EXPECT_EQ("/model/anthropic.claude-3-5-haiku-20241022-v1:0/converse-stream",
+            getPath());
+  // consecutive messages of a role are merged, as Bedrock requires the roles
+  // to alternate
+  auto expected_body = json::parse(R"(
+  {
+    "system": [{"text": "you are a helpful assistant."}],
+    "messages": [
+      {"role": "user", "content": [{"text": "Hello!"}, {"text": "Anyone there?"}]}
+    ],
+    "inferenceConfig": {"maxTokens": 100}
+  }
+  )");
+  EXPECT_EQ(expected_body, json::parse(body_.toString()));
+}
+
+TEST_F(AiTransformerTest, TranslateOpenAiRequestToAnthropic) {
+  auto aiTransformer = createAiTransformer(
+    R"(
+      enable_chat_streaming: true
+      translate_schema: true
+    )",
+    ANTHROPIC_UPSTREAM_METADATA
+  );
+
+  setPath("/v1/chat/completions");
+  setBody(R"(
+  {
+    "model": "claude-3-7-sonnet-20250219",
+    "messages": [
+      {"role": "developer", "content": "You are terse."},
+      {"role": "user", "content": "Hello!"}
+    ]
+  }
+  )");
+
+  aiTransformer->transform(headers_, &headers_, body_, filter_callbacks_);
+  EXPECT_EQ("/v1/messages", getPath());
+  auto expected_body = json::parse(R"(
+  {
+    "model": "claude-3-7-sonnet-20250219",
+    "system": "You are terse.",
+    "messages": [
+      {"role": "user", "content": [{"type": "text", "text": "Hello!"}]}
+    ],
+    "max_tokens": 4096,
+    "stream": true
+  }
+  )");
+  EXPECT_EQ(expected_body, json::parse(body_.toString()));
+}
+
+TEST_F(AiTransformerTest, TranscodeStreamedGeminiResponse) {
+  auto aiTransformer = createAiTransformer(
+    R"(
+      enable_chat_streaming: true
+      translate_schema: true
+    )",
+    GEMINI_UPSTREAM_METADATA
+  );
+  auto transcoder = aiTransformer->createResponseBodyTranscoder();
+  ASSERT_NE(nullptr, transcoder);
+
+  Http::TestResponseHeaderMapImpl response_headers{
+      {":status", "200"},
+      {"content-type", "text/event-stream"},
+      {"content-length", "1000"}};
+  transcoder->onHeaders(response_headers, filter_callbacks_);
+  EXPECT_EQ("text/event-stream", response_headers.getContentTypeValue());
+  EXPECT_EQ(nullptr, response_headers.ContentLength());
+  EXPECT_FALSE(transcoder->needsCompleteBody());
+
+  const std::string upstream_body =
+      "data: {\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"Why\"}],"
+      "\"role\":\"model\"}}],\"modelVersion\":\"gemini-1.5-flash-001\"}\r\n\r\n"
+      "data: {\"candidates\":[{\"content\":{\"parts\":[{\"text\":\" not?\"}],"
+      "\"role\":\"model\"},\"finishReason\":\"STOP\"}],\"usageMetadata\":"
+      "{\"promptTokenCount\":4,\"candidatesTokenCount\":2,"
+      "\"totalTokenCount\":6}}\r\n\r\n";
+  // feed the events a few bytes at a time
+  std::string downstream_body;
+  for (size_t i = 0; i < upstream_body.size(); i += 7) {
+    Buffer::OwnedImpl data(upstream_body.substr(i, 7));
+    transcoder->transcode(data, false, filter_callbacks_);
+    downstream_body += data.toString();
+  }
+  Buffer::OwnedImpl data;
+  transcoder->transcode(data, true, filter_callbacks_);
+  downstream_body += data.toString();
+
+  std::vector<std::string> events =
+      absl::StrSplit(downstream_body, "\n\n", absl::SkipEmpty());
+  ASSERT_EQ(4, events.size()) << downstream_body;
+  EXPECT_EQ("data: [DONE]", events[3]);
+
+  std::vector<json> chunks;
+  for (size_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(absl::StartsWith(events[i], "data: ")) << events[i];
+    chunks.push_back(json::parse(events[i].substr(6)));
+    EXPECT_EQ("chat.completion.chunk", chunks[i]["object"]);
+    EXPECT_EQ("gemini-1.5-flash-001", chunks[i]["model"]);
+  }
+  EXPECT_EQ(json::parse(R"({"role": "assistant", "content": "Why"})"),
+            chunks[0]["choices"][0]["delta"]);
+  EXPECT_TRUE(chunks[0]["choices"][0]["finish_reason"].is_null());
+  EXPECT_EQ(json::parse(R"({"content": " not?"})"),
+            chunks[1]["choices"][0]["delta"]);
+  EXPECT_EQ("stop", chunks[1]["choices"][0]["finish_reason"]);
+  EXPECT_EQ(json::parse(
+                R"({"prompt_tokens": 4, "completion_tokens": 2, "total_tokens": 6})"),
+            chunks[2]["usage"]);
+}
+
+TEST_F(AiTransformerTest, TranscodeBedrockResponse) {
+  auto aiTransformer = createAiTransformer(
+    "translate_schema: true",
+    BEDROCK_UPSTREAM_METADATA
+  );
+  auto transcoder = aiTransformer->createResponseBodyTranscoder();
+  ASSERT_NE(nullptr, transcoder);
+
+  Http::TestResponseHeaderMapImpl response_headers{
+      {":status", "200"}, {"content-type", "application/json"}};
+  transcoder->onHeaders(response_headers, filter_callbacks_);
+  // The filter buffers the response and passes it at once
+  EXPECT_TRUE(transcoder->needsCompleteBody());
+  Buffer::OwnedImpl data(R"({
+    "output": {"message": {"role": "assistant", "content": [{"text": "Hi!"}]}},
+    "stopReason": "max_tokens",
+    "usage": {"inputTokens": 3, "outputTokens": 4, "totalTokens": 7}
+  })");
+  transcoder->transcode(data, true, filter_callbacks_);
+
+  auto response = json::parse(data.toString());
+  EXPECT_EQ("chat.completion", response["object"]);
+  EXPECT_EQ("anthropic.claude-3-5-haiku-20241022-v1:0", response["model"]);
+  EXPECT_EQ(json::parse(R"(
+  [{
+    "index": 0,
+    "message": {"role": "assistant", "content": "Hi!"},
+    "finish_reason": "length"
+  }]
+  )"), response["choices"]);
+  EXPECT_EQ(7, response["usage"]["total_tokens"]);
+}
+
+TEST_F(AiTransformerTest, TranscodeStreamedBedrockResponse) {
+  auto aiTransformer = createAiTransformer(
+    R"(
+      enable_chat_streaming: true
+      translate_schema: true
+    )",
+    BEDROCK_UPSTREAM_METADATA
+  );
+  auto transcoder = aiTransformer->createResponseBodyTranscoder();
+  ASSERT_NE(nullptr, transcoder);
+
+  Http::TestResponseHeaderMapImpl response_headers{
+      {":status", "200"},
+      {"content-type", "application/vnd.amazon.eventstream"}};
+  transcoder->onHeaders(response_headers, filter_callbacks_);
+  EXPECT_EQ("text/event-stream", response_headers.getContentTypeValue());
+
+  // The event type is only carried in the frame headers
+  std::string upstream_body;
+  auto add_event = [&upstream_body](absl::string_view type,
+                                    absl::string_view payload) {
+    AwsEventStream::encode({{":event-type", type},
+                            {":content-type", "application/json"},
+                            {":message-type", "event"}},
+                           payload, upstream_body);
+  };
+  add_event("messageStart", R"({"role":"assistant"})");
+  add_event("contentBlockDelta",
+            R"({"contentBlockIndex":0,"delta":{"text":"Hi"}})");
+  add_event("contentBlockStop", R"({"contentBlockIndex":0})");
+  add_event("messageStop", R"({"stopReason":"end_turn"})");
+  add_event("metadata", R"({"usage":{"inputTokens":3,"outputTokens":4,)"
+                        R"("totalTokens":7},"metrics":{"latencyMs":12}})");
+
+  std::string downstream_body;
+  for (size_t i = 0; i < upstream_body.size(); i += 7) {
+    Buffer::OwnedImpl data(upstream_body.substr(i, 7));
+    transcoder->transcode(data, false, filter_callbacks_);
+    downstream_body += data.toString();
+  }
+  Buffer::OwnedImpl data;
+  transcoder->transcode(data, true, filter_callbacks_);
+  downstream_body += data.toString();
+
+  std::vector<std::string> events =
+      absl::StrSplit(downstream_body, "\n\n", absl::SkipEmpty());
+  ASSERT_EQ(5, events.size()) << downstream_body;
+  EXPECT_EQ("data: [DONE]", events[4]);
+  std::vector<json> chunks;
+  for (size_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(absl::StartsWith(events[i], "data: ")) << events[i];
+    chunks.push_back(json::parse(events[i].substr(6)));
+  }
+  EXPECT_EQ(json::parse(R"({"role": "assistant", "content": ""})"),
+            chunks[0]["choices"][0]["delta"]);
+  EXPECT_EQ(json::parse(R"({"content": "Hi"})"),
+            chunks[1]["choices"][0]["delta"]);
+  EXPECT_EQ("stop", chunks[2]["choices"][0]["finish_reason"]);
+  EXPECT_EQ(7, chunks[3]["usage"]["total_tokens"]);
+}
+
+TEST_F(AiTransformerTest, TranscodeStreamedBedrockResponseWithInvalidUtf8) {
+  auto aiTransformer = createAiTransformer(
+    R"(
+      enable_chat_streaming: true
+      translate_schema: true
+    )",
+    BEDROCK_UPSTREAM_METADATA
+  );
+  auto transcoder = aiTransformer->createResponseBodyTranscoder();
+  ASSERT_NE(nullptr, transcoder);
+
+  Http::TestResponseHeaderMapImpl response_headers{
+      {":status", "200"},
+      {"content-type", "application/vnd.amazon.eventstream"}};
+  transcoder->onHeaders(response_headers, filter_callbacks_);
+
+  // The frame headers are not validated as UTF-8, unlike the payload
+  std::string upstream_body;
+  AwsEventStream::encode({{":exception-type", "\xff\xfe" "Exception"},
+                          {":content-type", "application/json"},
+                          {":message-type", "exception"}},
+                         R"({"message":"oops"})", upstream_body);
+  Buffer::OwnedImpl data(upstream_body);
+  EXPECT_NO_THROW(transcoder->transcode(data, true, filter_callbacks_));
+
+  std::vector<std::string> events =
+      absl::StrSplit(data.toString(), "\n\n", absl::SkipEmpty());
+  ASSERT_EQ(2, events.size()) << data.toString();
+  const json error = json::parse(events[0].substr(6));
+  // Each invalid byte is replaced with U+FFFD
+  EXPECT_EQ("\xef\xbf\xbd\xef\xbf\xbd"
+            "Exception",
+            error["error"]["type"]);
+  EXPECT_EQ("oops", error["error"]["message"]);
+}
+
+TEST_F(AiTransformerTest, TranscoderPassesThroughErrors) {
+  auto aiTransformer = createAiTransformer(
+    "translate_schema: true",
+    ANTHROPIC_UPSTREAM_METADATA
+  );
+  auto transcoder = aiTransformer->createResponseBodyTranscoder();
+  ASSERT_NE(nullptr, transcoder);
+
+  const std::string error =
+      R"({"type":"error","error":{"type":"overloaded_error"}})";
+  Http::TestResponseHeaderMapImpl response_headers{
+      {":status", "529"}, {"content-type", "application/json"}};
+  transcoder->onHeaders(response_headers, filter_callbacks_);
+  EXPECT_FALSE(transcoder->needsCompleteBody());
+  Buffer::OwnedImpl data(error);
+  transcoder->transcode(data, true, filter_callbacks_);
+  EXPECT_EQ(error, data.toString());
+
+  // Not translated unless enabled
+  EXPECT_EQ(nullptr,
+            createAiTransformer(AI_STREAMING_ENABLED, ANTHROPIC_UPSTREAM_METADATA)
+                ->createResponseBodyTranscoder());
+}
+
+Upstream::MetadataConstSharedPtr parseMetadata(const std::string &json) {
+  auto metadata = std::make_shared<envoy::config::core::v3::Metadata>();
+  TestUtility::loadFromJson(json, *metadata);
+  return metadata;
+}
+
+TEST(AiEndpointMetadataCache, ParsesEndpointMetadata) {
+  AiEndpointMetadataCache cache;
+  const auto parsed = cache.get(parseMetadata(R"({
+    "filter_metadata": {
+      "io.solo.transformation": {
+        "provider": "anthropic",
+        "auth_token": "secret",
+        "json_schema": "anthropic",
+        "model": "claude",
+        "path": "/v1/messages",
+        "version": "2023-06-01"
+      }
+    }
+  })"));
+
+  EXPECT_EQ("anthropic", parsed->provider_);
+  EXPECT_EQ("secret", parsed->auth_token_);
+  EXPECT_EQ("anthropic", parsed->json_schema_);
+  EXPECT_EQ("claude", parsed->model_);
+  EXPECT_EQ("/v1/messages", parsed->path_);
+  EXPECT_EQ("2023-06-01", parsed->version_);
+  EXPECT_EQ("", parsed->base_path_);
+  EXPECT_EQ("", parsed->model_path_);
+  EXPECT_EQ("", parsed->platform_api_base_path_);
+}
+
+TEST(AiEndpointMetadataCache, ReusesParsedMetadataUntilReplaced) {
+  const std::string json = R"({
+    "filter_metadata": {"io.solo.transformation": {"model": "gpt-4o"}}
+  })";
+  AiEndpointMetadataCache cache;
+  auto metadata = parseMetadata(json);
+  const auto parsed = cache.get(metadata);
+  EXPECT_EQ(parsed, cache.get(metadata));
+  EXPECT_EQ(1, cache.size());
+
+  // an EDS update hands the host a new metadata instance
+  auto updated = parseMetadata(R"({
+    "filter_metadata": {"io.solo.transformation": {"model": "gpt-4o-mini"}}
+  })");
+  EXPECT_EQ("gpt-4o-mini", cache.get(updated)->model_);
+  EXPECT_EQ("gpt-4o", cache.get(metadata)->model_);
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(AiEndpointMetadataCache, DropsExpiredEntriesWhenFull) {
+  const std::string json = R"({
+    "filter_metadata": {"io.solo.transformation": {"model": "gpt-4o"}}
+  })";
+  AiEndpointMetadataCache cache;
+  auto live = parseMetadata(json);
+  const auto parsed = cache.get(live);
+  std::vector<Upstream::MetadataConstSharedPtr> removed_hosts;
+  for (size_t i = 1; i < AiEndpointMetadataCache::MaxEntries; i++) {
+    removed_hosts.push_back(parseMetadata(json));
+    cache.get(removed_hosts.back());
+  }
+  EXPECT_EQ(AiEndpointMetadataCache::MaxEntries, cache.size());
+
+  removed_hosts.clear();
+  auto added = parseMetadata(json);
+  cache.get(added);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(parsed, cache.get(live));
+}
+
+class CompiledPromptEnrichmentTest : public testing::TestWithParam<std::string> {
+protected:
+  CompiledPromptEnrichmentTest() {
+    const std::string yaml = R"(
+      prepend:
+        - role: system
+          content: you are a "helpful" assistant.
+        - role: developer
+          content: reply everything with programming analogy.
+        - role: user
+          content: my name is Bond.
+      append:
+        - role: user
+          content: I live in the US.
+        - role: system
+          content: reply in British accent.
+    )";
+    envoy::api::v2::filter::http::PromptEnrichment pe;
+    TestUtility::loadFromYaml(yaml, pe);
+    prompt_enrichment_ = std::make_unique<PromptEnrichment>(pe);
+  }
+
+  // Checks that splicing the raw body and applying to the parsed body agree
+  void expectSameAsDom(const std::string &body) {
+    CompiledPromptEnrichment prompts(*prompt_enrichment_, GetParam());
+    Buffer::OwnedImpl spliced;
+    ASSERT_TRUE(prompts.splice(body, spliced)) << body;
+
+    auto expected = json::parse(body);
+    ASSERT_TRUE(prompts.apply(expected)) << body;
+    EXPECT_EQ(expected, json::parse(spliced.toString()))
+        << "\nspliced: " << spliced.toString();
+  }
+
+  std::unique_ptr<PromptEnrichment> prompt_enrichment_;
+};
+
+INSTANTIATE_TEST_SUITE_P(Schemas, CompiledPromptEnrichmentTest,
+                         testing::Values("openai", "anthropic", "gemini",
+                                         "bedrock"));
+
+TEST_P(CompiledPromptEnrichmentTest, SpliceMatchesDom) {
+  const std::string field =
+      GetParam() == "gemini" ? "contents" : "messages";
+  expectSameAsDom(fmt::format(R"(  {{ "{}": [ {{"role": "user"}} ] }}  )", field));
+  expectSameAsDom(fmt::format(R"({{"{}":[]}})", field));
+  expectSameAsDom(fmt::format(R"({{"{}":[ ], "x": {{"a": [1, "]}}\"["]}}}})", field));
+  if (GetParam() != "bedrock") {
+    // Bedrock only takes an array of system prompts
+    expectSameAsDom(fmt::format(
+        R"({{"system":"be brief","{}":[{{"role":"user"}}],"n":1.5e3,"b":true}})",
+        field));
+  }
+  expectSameAsDom(fmt::format(
+      R"({{"system":[{{"text":"Bob"}}],"system_instruction":[],"{}":[{{}}]}})",
+      field));
+}
+
+TEST_P(CompiledPromptEnrichmentTest, SpliceRejectsUnexpectedBodies) {
+  CompiledPromptEnrichment prompts(*prompt_enrichment_, GetParam());
+  for (const std::string body :
+       {"hello world", "[1, 2]", R"({"messages":[],"contents":[]} x)",
+        R"({"messages":[],"contents":[],})", R"({"messages":{},"contents":{}})",
+        R"({"messages":[],"contents":[],"messages":[]})",
+        R"({"messages":[],"contents":[],"mess\u0061ges":[]})"}) {
+    Buffer::OwnedImpl spliced;
+    EXPECT_FALSE(prompts.splice(body, spliced)) << body;
+    EXPECT_EQ(0, spliced.length());
+  }
+}
+
 } // namespace
 
 } // namespace Transformation
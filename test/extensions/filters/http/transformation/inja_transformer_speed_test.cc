@@ -1,6 +1,7 @@
 #include "source/common/common/empty_string.h"
 
 #include "source/extensions/filters/http/transformation/inja_transformer.h"
+#include "source/extensions/filters/http/transformation/text_stats.h"
 
 #include "test/mocks/http/mocks.h"
 #include "test/test_common/utility.h"
@@ -40,6 +41,29 @@ static void BM_ExrtactHeader(benchmark::State &state) {
 // Register the function as a benchmark
 BENCHMARK(BM_ExrtactHeader);
 
+// Token budget of a 200 KB prompt
+static void BM_TextStats(benchmark::State &state) {
+  std::string prompt;
+  while (prompt.size() < 200 * 1024) {
+    prompt += fmt::format("Line {}: the quick brown fox, jumps over the lazy "
+                          "dog. \"{}\"\n",
+                          prompt.size(), prompt.size() * 31);
+  }
+  uint64_t tokens = 0;
+  for (auto _ : state) {
+    TextStats stats;
+    if (state.range(0)) {
+      stats.add(prompt);
+    } else {
+      stats.addScalar(prompt);
+    }
+    tokens += stats.estimateTokens();
+  }
+  benchmark::DoNotOptimize(tokens);
+  state.SetBytesProcessed(state.iterations() * prompt.size());
+}
+BENCHMARK(BM_TextStats)->Arg(0)->Arg(1);
+
 } // namespace Transformation
 } // namespace HttpFilters
 } // namespace Extensions
@@ -0,0 +1,67 @@
+#include <random>
+
+#include "source/extensions/filters/http/transformation/text_stats.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace HttpFilters {
+namespace Transformation {
+
+TEST(TextStats, CountsWords) {
+  TextStats stats;
+  stats.add("why don't you accept me");
+  EXPECT_EQ(stats.words(), 5);
+  EXPECT_EQ(stats.count(TextStats::Letter).bytes, 18);
+  EXPECT_EQ(stats.count(TextStats::Letter).runs, 6);
+  EXPECT_EQ(stats.count(TextStats::Punctuation).bytes, 1);
+  EXPECT_EQ(stats.estimateTokens(), 7);
+}
+
+TEST(TextStats, EmptyAndWhitespace) {
+  TextStats stats;
+  stats.add("");
+  stats.add(" \t\r\n\v\f ");
+  EXPECT_EQ(stats.words(), 0);
+  EXPECT_EQ(stats.count(TextStats::Newline).runs, 1);
+  EXPECT_EQ(stats.estimateTokens(), 1);
+}
+
+TEST(TextStats, RunsAcrossBlocks) {
+  TextStats stats;
+  stats.add(std::string(100, 'a') + " " + std::string(100, '7'));
+  EXPECT_EQ(stats.words(), 2);
+  EXPECT_EQ(stats.count(TextStats::Letter).runs, 1);
+  EXPECT_EQ(stats.count(TextStats::Letter).bytes, 100);
+  EXPECT_EQ(stats.count(TextStats::Digit).runs, 1);
+  EXPECT_EQ(stats.count(TextStats::Digit).bytes, 100);
+  EXPECT_EQ(stats.estimateTokens(), 25 + 34);
+}
+
+TEST(TextStats, VectorMatchesScalar) {
+  const std::string alphabet("aZ09 \t\n\r.,{}\"\xc3\xa9\xe4\xb8\xad");
+  std::mt19937 rng(0);
+  for (int i = 0; i < 2000; i++) {
+    std::string text(rng() % 300, ' ');
+    for (char &c : text) {
+      c = alphabet[rng() % alphabet.size()];
+    }
+
+    TextStats vector;
+    TextStats scalar;
+    vector.add(text);
+    scalar.addScalar(text);
+    ASSERT_EQ(vector.words(), scalar.words()) << text;
+    for (int c = 0; c < TextStats::ByteClassCount; c++) {
+      const auto byte_class = static_cast<TextStats::ByteClass>(c);
+      ASSERT_EQ(vector.count(byte_class).bytes, scalar.count(byte_class).bytes);
+      ASSERT_EQ(vector.count(byte_class).runs, scalar.count(byte_class).runs);
+    }
+  }
+}
+
+} // namespace Transformation
+} // namespace HttpFilters
+} // namespace Extensions
+} // namespace Envoy
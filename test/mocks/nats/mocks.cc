@@ -1,10 +1,22 @@
 #include "mocks.h"
 
+#include "source/common/buffer/buffer_impl.h"
+
+using testing::_;
+using testing::Invoke;
+
 namespace Envoy {
 namespace Nats {
 
+// Messages are equal when they are encoded the same, whether or not their
+// payloads are carried separately.
 bool operator==(const Message &lhs, const Message &rhs) {
-  return lhs.asString() == rhs.asString();
+  EncoderImpl encoder;
+  Buffer::OwnedImpl lhs_buffer;
+  Buffer::OwnedImpl rhs_buffer;
+  encoder.encode(lhs, lhs_buffer);
+  encoder.encode(rhs, rhs_buffer);
+  return lhs_buffer.toString() == rhs_buffer.toString();
 }
 
 namespace ConnPoolNats {
@@ -12,6 +24,18 @@ namespace ConnPoolNats {
 MockInstance::MockInstance() {}
 MockInstance::~MockInstance() {}
 
+MockClient::MockClient() {}
+MockClient::~MockClient() {}
+
+// Each connection is a new client.
+MockClientFactory::MockClientFactory() {
+  ON_CALL(*this, create_(_))
+      .WillByDefault(Invoke([](Upstream::HostConstSharedPtr) {
+        return new testing::NiceMock<MockClient>();
+      }));
+}
+MockClientFactory::~MockClientFactory() {}
+
 } // namespace ConnPoolNats
 
 } // namespace Nats
@@ -23,6 +23,36 @@ public:
 
   MOCK_METHOD2(makeRequest,
                void(const std::string &hash_key, const Message &request));
+  MOCK_METHOD0(close, void());
+};
+
+class MockClient : public Tcp::ConnPoolNats::Client<Message> {
+public:
+  MockClient();
+  ~MockClient();
+
+  MOCK_METHOD1(addConnectionCallbacks,
+               void(Network::ConnectionCallbacks &callbacks));
+  MOCK_METHOD0(close, void());
+  MOCK_METHOD1(makeRequest, void(const Message &request));
+  MOCK_METHOD0(cancel, void());
+};
+
+class MockClientFactory : public Tcp::ConnPoolNats::ClientFactory<Message> {
+public:
+  MockClientFactory();
+  ~MockClientFactory();
+
+  // Tcp::ConnPoolNats::ClientFactory
+  Tcp::ConnPoolNats::ClientPtr<Message>
+  create(Upstream::HostConstSharedPtr host, Event::Dispatcher &,
+         Tcp::ConnPoolNats::PoolCallbacks<Message> &,
+         const Tcp::ConnPoolNats::Config &) override {
+    return Tcp::ConnPoolNats::ClientPtr<Message>{create_(host)};
+  }
+
+  MOCK_METHOD1(create_, Tcp::ConnPoolNats::Client<Message> *(
+                            Upstream::HostConstSharedPtr host));
 };
 
 } // namespace ConnPoolNats
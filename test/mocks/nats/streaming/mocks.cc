@@ -1,9 +1,11 @@
 #include "mocks.h"
 
+#include "source/common/buffer/buffer_utility.h"
 #include "source/common/common/macros.h"
 
 using testing::_;
 using testing::Invoke;
+using testing::ReturnRef;
 
 namespace Envoy {
 namespace Nats {
@@ -12,7 +14,14 @@ namespace Streaming {
 MockPublishCallbacks::MockPublishCallbacks() {}
 MockPublishCallbacks::~MockPublishCallbacks() {}
 
+MockWindowWatch::MockWindowWatch() {}
+MockWindowWatch::~MockWindowWatch() {}
+
+MockWindowCallbacks::MockWindowCallbacks() {}
+MockWindowCallbacks::~MockWindowCallbacks() {}
+
 MockClient::MockClient() {
+  ON_CALL(*this, selectClient(_)).WillByDefault(ReturnRef(*this));
   ON_CALL(*this, makeRequest_(_, _, _, _, _))
       .WillByDefault(Invoke(
           [this](const std::string &subject, const std::string &cluster_id,
@@ -33,9 +42,13 @@ MockClient::~MockClient() {}
 PublishRequestPtr MockClient::makeRequest(const std::string &subject,
                                           const std::string &cluster_id,
                                           const std::string &discover_prefix,
-                                          std::string &&payload,
+                                          Buffer::Instance &headers,
+                                          Buffer::Instance &payload,
                                           PublishCallbacks &callbacks) {
-  return makeRequest_(subject, cluster_id, discover_prefix, payload, callbacks);
+  last_headers_ = Buffer::BufferUtility::drainBufferToString(headers);
+  return makeRequest_(subject, cluster_id, discover_prefix,
+                      Buffer::BufferUtility::drainBufferToString(payload),
+                      callbacks);
 }
 
 } // namespace Streaming
@@ -16,6 +16,23 @@ public:
   MOCK_METHOD0(onResponse, void());
   MOCK_METHOD0(onFailure, void());
   MOCK_METHOD0(onTimeout, void());
+  MOCK_METHOD0(onOverflow, void());
+};
+
+class MockWindowWatch : public WindowWatch {
+public:
+  MockWindowWatch();
+  ~MockWindowWatch();
+
+  MOCK_METHOD0(cancel, void());
+};
+
+class MockWindowCallbacks : public WindowCallbacks {
+public:
+  MockWindowCallbacks();
+  ~MockWindowCallbacks();
+
+  MOCK_METHOD0(onWindowOpen, void());
 };
 
 class MockClient : public Client {
@@ -26,14 +43,19 @@ public:
   PublishRequestPtr makeRequest(const std::string &subject,
                                 const std::string &cluster_id,
                                 const std::string &discover_prefix,
-                                std::string &&payload,
+                                Buffer::Instance &headers,
+                                Buffer::Instance &payload,
                                 PublishCallbacks &callbacks) override;
 
+  MOCK_METHOD1(selectClient, Client &(const std::string &subject));
   MOCK_METHOD5(makeRequest_,
                PublishRequestPtr(const std::string &, const std::string &,
                                  const std::string &, const std::string &,
                                  PublishCallbacks &callbacks));
+  MOCK_METHOD2(watchWindow, WindowWatchPtr(const std::string &subject,
+                                           WindowCallbacks &callbacks));
 
+  std::string last_headers_;
   std::string last_payload_;
 };
 
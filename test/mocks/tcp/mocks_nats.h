@@ -89,6 +89,7 @@ public:
 
   MOCK_METHOD2(makeRequest,
                void(const std::string &hash_key, const T &request));
+  MOCK_METHOD0(close, void());
 };
 
 } // namespace ConnPoolNats